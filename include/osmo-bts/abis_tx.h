@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <time.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+
+struct gsm_bts;
+struct e1inp_sign_link;
+
+#define ABIS_TX_BATCH_MAX	64	/* messages per writev() */
+#define ABIS_TX_COALESCE_MAX_MS	100
+
+/* Output stage of an IPA connection (OML+OSMO, or the RSL of one TRX).  If
+ * enabled ('abis-tx-coalesce'), messages are held back until the end of the
+ * current main loop iteration (or for up to a latency budget), and then
+ * written with a single writev() instead of one write() per message by
+ * libosmo-abis.  The queued messages are already IPA framed.  If the socket
+ * does not take all of them, the queue takes over the osmo_fd of libosmo-abis
+ * until they are written, see abis_tx_fd_own(). */
+struct abis_tx_queue {
+	struct gsm_bts *bts;
+	/* the link owning the connection, e.g. &bts->oml_link */
+	struct e1inp_sign_link **link;
+	/* the first message may have been written partially */
+	struct llist_head msgs;
+	unsigned int num_msgs;
+	bool partial;
+	struct timespec first_queued;
+	struct osmo_timer_list flush_timer;
+
+	/* osmo_fd of libosmo-abis taken over while waiting for the socket, and
+	 * the callback to give it back */
+	struct osmo_fd *ofd;
+	int (*ofd_cb)(struct osmo_fd *ofd, unsigned int what);
+	struct llist_head ofd_entry;
+};
+
+void abis_tx_queue_init(struct abis_tx_queue *q, struct gsm_bts *bts,
+			struct e1inp_sign_link **link);
+int abis_tx_queue_send(struct abis_tx_queue *q, struct msgb *msg);
+void abis_tx_queue_flush(struct abis_tx_queue *q);
+void abis_tx_queue_drop(struct abis_tx_queue *q);
@@ -6,9 +6,12 @@
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/bts_trx.h>
 #include <osmo-bts/osmux.h>
+#include <osmo-bts/abis_tx.h>
+#include <osmo-bts/oml_snapshot.h>
 
 
 struct gsm_bts_trx;
+struct gsmtap_tap;
 
 enum bts_global_status {
 	BTS_STATUS_RF_ACTIVE,
@@ -40,6 +43,17 @@ enum {
 	BTS_CTR_RTP_RX_DROP_V110_DEC,
 	BTS_CTR_RTP_TX_TOTAL,
 	BTS_CTR_RTP_TX_MARKER,
+	BTS_CTR_GSMTAP_DROP,
+	BTS_CTR_ABIS_TX_BATCH,
+	BTS_CTR_ABIS_TX_BATCH_MSGS,
+	BTS_CTR_ABIS_TX_BATCH_DELAY,
+	BTS_CTR_DYN_TS_SWITCH,
+	BTS_CTR_DYN_TS_SWITCH_TIME,
+	BTS_CTR_DYN_TS_SWITCH_LT_2MS,
+	BTS_CTR_DYN_TS_SWITCH_LT_10MS,
+	BTS_CTR_DYN_TS_SWITCH_LT_50MS,
+	BTS_CTR_DYN_TS_SWITCH_LT_200MS,
+	BTS_CTR_DYN_TS_SWITCH_GE_200MS,
 };
 
 /* Used by OML layer for BTS Attribute reporting */
@@ -76,6 +90,9 @@ enum bts_impl_flag {
 	BTS_INTERNAL_FLAG_NM_RCHANNEL_DEPENDS_RCARRIER,
 	/* Whether the BTS model reports interference measurements to L1SAP. */
 	BTS_INTERNAL_FLAG_INTERF_MEAS,
+	/* Whether the BTS model can provision its PHY from the OML snapshot,
+	 * before the BSC configures it (see bts_model_warm_start()). */
+	BTS_INTERNAL_FLAG_WARM_START,
 
 	_BTS_INTERNAL_FLAG_NUM, /* must be at the end */
 };
@@ -153,6 +170,15 @@ struct bsc_oml_host {
 #define BTS_PCU_SOCK_WQUEUE_LEN_DEFAULT 100
 
 /* One BTS */
+/* Classes of messages in the AGCH queue, in order of descending priority.
+ * They are served in weighted round robin, see bts_agch_class_weight[]. */
+enum bts_agch_class {
+	BTS_AGCH_CLASS_CS,	/* IMMEDIATE ASSIGNMENT from the BSC */
+	BTS_AGCH_CLASS_PS,	/* IMMEDIATE ASSIGNMENT from the PCU */
+	BTS_AGCH_CLASS_REJ,	/* IMMEDIATE ASSIGNMENT REJECT */
+	_NUM_BTS_AGCH_CLASS
+};
+
 struct gsm_bts {
 	/* list header in g_bts_sm->bts_list */
 	struct llist_head list;
@@ -191,6 +217,12 @@ struct gsm_bts {
 	struct timespec oml_conn_established_timestamp;
 	/* OSMO extenion link associated to same line as oml_link: */
 	struct e1inp_sign_link *osmo_link;
+	/* output stage shared by oml_link and osmo_link */
+	struct abis_tx_queue oml_tx_queue;
+	/* Abis Tx coalescing latency budget in ms, -1: disabled */
+	int abis_tx_coalesce_ms;
+	/* configuration persisted for a warm restart */
+	struct oml_snapshot oml_snapshot;
 
 	/* Abis network management O&M handle */
 	struct gsm_abis_mo mo;
@@ -280,14 +312,24 @@ struct gsm_bts {
 
 	/* AGCH queuing */
 	struct {
-		struct llist_head queue;
-		int length;
+		struct llist_head queue[_NUM_BTS_AGCH_CLASS];	/* one FIFO per class */
+		int length;		/* total number of messages in all classes */
 		int max_length;
 
 		int thresh_level;	/* Cleanup threshold in percent of max len */
 		int low_level;		/* Low water mark in percent of max len */
 		int high_level;		/* High water mark in percent of max len */
 
+		/* accumulated drop probability (0x10000 = 1) of the RED-style queue management */
+		int drop_credit;
+		/* pending IMM ASS REJ with free request reference slots, new rejects are merged into it */
+		struct msgb *rej_open;
+		/* class served by the weighted round robin, and how many more messages it may send */
+		enum bts_agch_class wrr_class;
+		int wrr_credit;
+		/* sequence number of the next enqueued message, to find the oldest one across classes */
+		uint32_t seq;
+
 		/* TODO: Use a rate counter group instead */
 		uint64_t dropped_msgs;
 		uint64_t merged_msgs;
@@ -335,6 +377,13 @@ struct gsm_bts {
 	} support;
 	struct {
 		uint8_t tc4_ctr;
+		/* BCCH Norm schedule and CCCH block types, resolved from the
+		 * SI by bts_sysinfo_sched_update() */
+		struct {
+			uint8_t si_type[4];	/* enum osmo_sysinfo_type, rotating if num > 1 */
+			uint8_t num;
+		} bcch_sched[8];		/* indexed by TC */
+		int8_t ccch_msgt[51];		/* enum ccch_msgt, -1 for no CCCH block */
 	} si;
 	struct gsm_time gsm_time;
 	/* frame number statistics (FN in PH-RTS.ind vs. PH-DATA.ind */
@@ -377,11 +426,15 @@ struct gsm_bts {
 	struct {
 		char *sock_path;
 		unsigned int sock_wqueue_len_max;
+		/* cell attributes already received for the INFO.ind */
+		bool avail_lai;
+		bool avail_cell;
 	} pcu;
 
 	/* GSMTAP Um logging (disabled by default) */
 	struct {
 		struct gsmtap_inst *inst;
+		struct gsmtap_tap *tap;		/* writer thread, NULL: send synchronously */
 		char *remote_host;
 		char *local_host;
 		uint32_t sapi_mask;
@@ -434,6 +487,7 @@ enum ccch_msgt {
 int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt, enum ccch_msgt ccch);
 int bts_supports_cipher(struct gsm_bts *bts, int rsl_cipher);
 uint8_t *bts_sysinfo_get(struct gsm_bts *bts, const struct gsm_time *g_time);
+void bts_sysinfo_sched_update(struct gsm_bts *bts);
 void regenerate_si3_restoctets(struct gsm_bts *bts);
 void regenerate_si4_restoctets(struct gsm_bts *bts);
 int get_si4_ro_offset(const uint8_t *si4_buf);
@@ -462,6 +516,8 @@ int bts_set_c0_pwr_red(struct gsm_bts *bts, const uint8_t red);
 struct bts_agch_msg_cb {
 	uint32_t msg_id;
 	bool confirm;
+	bool is_ps;		/* message was sent by the PCU */
+	uint32_t seq;		/* order of enqueuing, set by bts_agch_enqueue() */
 } __attribute__ ((packed));
 
 #endif /* _BTS_H */
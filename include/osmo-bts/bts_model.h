@@ -44,6 +44,10 @@ void bts_model_config_write_phy_inst(struct vty *vty, const struct phy_instance
 
 int bts_model_oml_estab(struct gsm_bts *bts);
 
+/* Provision the PHY from the configuration restored by oml_snapshot_warm_start(),
+ * only called if BTS_INTERNAL_FLAG_WARM_START is set */
+int bts_model_warm_start(struct gsm_bts *bts);
+
 /* Implementation should call power_trx_change_compl() to confirm power change applied */
 int bts_model_change_power(struct gsm_bts_trx *trx, int p_trxout_mdBm);
 int bts_model_adjst_ms_pwr(struct gsm_lchan *lchan);
@@ -2,6 +2,7 @@
 
 #include <osmocom/core/sockaddr_str.h>
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/abis_tx.h>
 
 struct gsm_bts_bb_trx {
 	struct gsm_abis_mo mo;
@@ -10,6 +11,7 @@ struct gsm_bts_bb_trx {
 		struct osmo_sockaddr_str rem_addrstr;
 		uint8_t tei;
 		struct e1inp_sign_link *link;
+		struct abis_tx_queue tx_queue;
 	} rsl;
 };
 
@@ -40,6 +42,14 @@ struct gsm_bts_trx {
 	struct gsm_power_ctrl_params *bs_dpc_params; /* BS Dynamic Power Control */
 	struct gsm_power_ctrl_params *ms_dpc_params; /* MS Dynamic Power Control */
 	bool ms_pwr_ctl_soft; /* is power control loop done by osmocom software? */
+	/* SACCH blocks waiting for the TA/power control loops */
+	struct lchan_ctrl_batch *ctrl_batch;
+
+	/* Intave periods since the interference levels were last sent */
+	struct {
+		uint8_t rsl_age;
+		uint8_t pcu_age;
+	} interf_report;
 
 	/* The associated PHY instance */
 	struct phy_instance *pinst;
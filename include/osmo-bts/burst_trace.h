@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <osmocom/core/utils.h>
+
+/* Binary trace of per-burst scheduler events.  Unlike the DEBUG logging,
+ * emitting a record does not format any text: fixed size records are
+ * written into an mmap()ed ring buffer file, which is rendered into log
+ * text offline by osmo-bts-burst-trace. */
+
+#define BURST_TRACE_MAGIC	"OBTStrc1"
+#define BURST_TRACE_NUM_ARGS	4
+#define BURST_TRACE_CHAN_MAX	64	/* >= _TRX_CHAN_MAX */
+#define BURST_TRACE_CHAN_NONE	0xff	/* event not related to a logical channel */
+#define BURST_TRACE_NAME_LEN	16
+#define BURST_TRACE_FMT_LEN	96
+#define BURST_TRACE_HDR_SIZE	8192	/* records start at this offset */
+
+#define BURST_TRACE_RECS_DEF	(1 << 16)
+#define BURST_TRACE_RECS_MIN	1024
+#define BURST_TRACE_RECS_MAX	(1 << 24)
+
+enum burst_trace_event {
+	BURST_TRACE_EV_TRXD_RX,
+	BURST_TRACE_EV_TRXD_NOPE,
+	BURST_TRACE_EV_UL_DATA,
+	BURST_TRACE_EV_UL_TCHF,
+	BURST_TRACE_EV_UL_TCHH,
+	BURST_TRACE_EV_UL_PDTCH,
+	BURST_TRACE_EV_UL_RACH,
+	BURST_TRACE_EV_UL_MASK,
+	BURST_TRACE_EV_UL_AMR_DTX,
+	BURST_TRACE_EV_DL_BURST,
+	BURST_TRACE_EV_DL_FCCH,
+	BURST_TRACE_EV_DL_SCH,
+	_BURST_TRACE_EV_MAX
+};
+
+/* A single trace record.  seq is written last, a slot whose seq does not
+ * match its position in the ring has been overwritten while being read. */
+struct burst_trace_rec {
+	uint32_t seq;		/* 1 + number of records written before this one */
+	uint32_t fn;
+	uint32_t time_us;	/* CLOCK_MONOTONIC, wraps after ~71 minutes */
+	uint8_t trx;
+	uint8_t tn;
+	uint8_t chan;		/* enum trx_chan_type or BURST_TRACE_CHAN_NONE */
+	uint8_t event;		/* enum burst_trace_event */
+	int32_t arg[BURST_TRACE_NUM_ARGS];
+};
+
+/* File header, describes everything needed to render the records */
+struct burst_trace_hdr {
+	char magic[8];
+	uint32_t rec_size;
+	uint32_t num_recs;
+	uint64_t head;		/* number of records written so far */
+	char chan_names[BURST_TRACE_CHAN_MAX][BURST_TRACE_NAME_LEN];
+	char event_fmts[_BURST_TRACE_EV_MAX][BURST_TRACE_FMT_LEN];
+};
+
+osmo_static_assert(sizeof(struct burst_trace_hdr) <= BURST_TRACE_HDR_SIZE, burst_trace_hdr_size);
+
+struct burst_trace {
+	struct burst_trace_hdr *hdr;	/* NULL if not tracing */
+	struct burst_trace_rec *recs;
+	uint32_t num_recs;
+	size_t map_len;
+	char *path;
+	unsigned int num_writers;	/* threads in _burst_trace_put() */
+};
+
+extern struct burst_trace g_burst_trace;
+
+int burst_trace_start(const char *path, unsigned int num_recs);
+void burst_trace_stop(void);
+
+void _burst_trace_put(uint8_t trx, uint8_t tn, uint8_t chan, uint32_t fn,
+		      enum burst_trace_event event, int32_t a0, int32_t a1, int32_t a2, int32_t a3);
+
+/* Cheap enough to be left in the per-burst paths unconditionally */
+#define BURST_TRACE(trx, tn, chan, fn, event, a0, a1, a2, a3) \
+	do { \
+		if (OSMO_UNLIKELY(__atomic_load_n(&g_burst_trace.hdr, __ATOMIC_RELAXED) != NULL)) \
+			_burst_trace_put(trx, tn, chan, fn, event, a0, a1, a2, a3); \
+	} while (0)
+
+/* Trace helper adding context from trx_{ul,dl}_burst_{ind,req}, see LOGL1SB() */
+#define BURST_TRACE_L1SB(l1ts, b, event, a0, a1, a2, a3) \
+	BURST_TRACE((l1ts)->ts->trx->nr, (l1ts)->ts->nr, (b)->chan, (b)->fn, event, a0, a1, a2, a3)
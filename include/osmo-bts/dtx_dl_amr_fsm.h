@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #include <osmocom/core/fsm.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/logging.h>
@@ -27,6 +29,7 @@ enum dtx_dl_amr_fsm_states {
 	ST_ONSET_V_REC,
 	ST_ONSET_F_REC,
 	ST_FACCH,
+	_ST_DTX_DL_AMR_NUM
 };
 
 enum dtx_dl_amr_fsm_events {
@@ -38,7 +41,28 @@ enum dtx_dl_amr_fsm_events {
 	E_INHIB,
 	E_SID_F,
 	E_SID_U,
+	_E_DTX_DL_AMR_NUM
+};
+
+/* Compact equivalent of dtx_dl_amr_fsm, evaluated for every frame */
+struct dtx_dl_amr_trans {
+	uint8_t in_event_mask;
+	/* current state for events which are permitted but ignored */
+	uint8_t next_state[_E_DTX_DL_AMR_NUM];
 };
 
+extern const struct dtx_dl_amr_trans dtx_dl_amr_fsm_trans[_ST_DTX_DL_AMR_NUM];
+
+/*! Look up the state following an event.
+ *  \returns new state; negative if the event is not permitted in this state */
+static inline int dtx_dl_amr_fsm_next(uint8_t state, enum dtx_dl_amr_fsm_events e)
+{
+	const struct dtx_dl_amr_trans *t = &dtx_dl_amr_fsm_trans[state];
+
+	if (!(t->in_event_mask & X(e)))
+		return -1;
+	return t->next_state[e];
+}
+
 extern const struct value_string dtx_dl_amr_fsm_event_names[];
 extern struct osmo_fsm dtx_dl_amr_fsm;
@@ -124,6 +124,9 @@ struct gsm_bts_trx_ts {
 	struct {
 		enum gsm_phys_chan_config pchan_is;
 		enum gsm_phys_chan_config pchan_want;
+		/* start of an ongoing switch, for the latency statistics */
+		struct timespec switch_start;
+		bool switching;
 	} dyn;
 
 	unsigned int flags;
@@ -163,6 +166,11 @@ struct gsm_bts_trx_ts {
 		bool is_shadow;
 	} vamos;
 
+	/* Number of interference samples per band (1..5), see gsm_lchan_interf_meas_push(),
+	 * of the current and of the last complete Intave period */
+	uint32_t interf_band_hist[5];
+	uint32_t interf_band_hist_last[5];
+
 	struct gsm_lchan lchan[TS_MAX_LCHAN];
 };
 
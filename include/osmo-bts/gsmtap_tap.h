@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+struct gsm_bts;
+
+#define GSMTAP_TAP_RING_SIZE_DEFAULT	1024	/* entries, power of two */
+#define GSMTAP_TAP_DATA_MAX		256	/* largest payload of a single frame */
+#define GSMTAP_TAP_BATCH_MAX		32	/* frames per sendmmsg() */
+
+/* A frame as handed over by the RT path, the GSMTAP header is built by the writer */
+struct gsmtap_tap_entry {
+	uint32_t fn;
+	uint16_t arfcn;
+	uint16_t len;
+	uint8_t type;
+	uint8_t ts;
+	uint8_t chan_type;
+	uint8_t ss;
+	int8_t signal_dbm;
+	uint8_t snr;
+	uint8_t data[GSMTAP_TAP_DATA_MAX];
+};
+
+/* Single producer (main thread), single consumer (writer thread) ring.
+ * The writer thread does not call into libosmocore, it only formats the
+ * GSMTAP header and sends on the already connected socket. */
+struct gsmtap_tap {
+	int fd;				/* connected GSMTAP socket */
+	int efd;			/* eventfd to wake up the writer */
+	pthread_t thread;
+	bool running;
+
+	struct gsmtap_tap_entry *ring;
+	uint32_t size;			/* number of entries, power of two */
+	uint32_t head;			/* written by the producer only */
+	uint32_t tail;			/* written by the writer only */
+
+	bool sleeping;			/* writer waits on efd */
+	bool stop;
+	uint64_t send_err;		/* frames the writer failed to send */
+	uint64_t sent;			/* frames sent by the writer */
+};
+
+struct gsmtap_tap *gsmtap_tap_alloc(void *ctx, int fd, uint32_t size);
+int gsmtap_tap_start(struct gsmtap_tap *tap);
+void gsmtap_tap_free(struct gsmtap_tap *tap);
+
+int gsmtap_tap_send(struct gsmtap_tap *tap, uint8_t type, uint16_t arfcn, uint8_t ts,
+		    uint8_t chan_type, uint8_t ss, uint32_t fn, int8_t signal_dbm,
+		    uint8_t snr, const uint8_t *data, unsigned int len);
+
+int bts_gsmtap_send(struct gsm_bts *bts, uint8_t type, uint16_t arfcn, uint8_t ts,
+		    uint8_t chan_type, uint8_t ss, uint32_t fn, int8_t signal_dbm,
+		    uint8_t snr, const uint8_t *data, unsigned int len);
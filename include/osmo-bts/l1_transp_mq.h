@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/write_queue.h>
+
+/* Number of primitives read from a message queue at once, adapted to the load */
+#define L1_MQ_RX_BATCH_MIN	1
+#define L1_MQ_RX_BATCH_INIT	3
+#define L1_MQ_RX_BATCH_MAX	16
+/* Maximum number of primitives written to a message queue at once */
+#define L1_MQ_TX_BATCH_MAX	32
+
+/* Called for each primitive read from a message queue, takes ownership of msg */
+typedef int l1_mq_rx_cb_t(void *data, struct msgb *msg, int queue);
+
+/* Read side of a DSP message queue carrying fixed size primitives */
+struct l1_mq_rx {
+	struct osmo_fd ofd;
+	uint32_t prim_size;
+	unsigned int batch;			/* primitives per readv(), adaptive */
+	struct msgb *msg[L1_MQ_RX_BATCH_MAX];	/* preallocated, only consumed ones are replaced */
+	l1_mq_rx_cb_t *rx_cb;
+};
+
+int l1_mq_setup(struct l1_mq_rx *rx, struct osmo_wqueue *wq, int queue,
+		int rd_fd, int wr_fd, unsigned int wq_len,
+		uint32_t prim_size, l1_mq_rx_cb_t *rx_cb, void *data);
+int l1_mq_open(struct l1_mq_rx *rx, struct osmo_wqueue *wq, int queue,
+	       const char *rd_path, const char *wr_path,
+	       uint32_t prim_size, l1_mq_rx_cb_t *rx_cb, void *data);
+void l1_mq_close(struct l1_mq_rx *rx, struct osmo_wqueue *wq);
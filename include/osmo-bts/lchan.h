@@ -43,6 +43,8 @@ enum gsm_lchan_state {
 };
 
 #define MAX_NUM_UL_MEAS	104
+/* maximum number of measurements per reporting period (TCH: 24 blocks + SACCH) */
+#define MAX_UL_MEAS_WINDOW	25
 #define LC_UL_M_F_L1_VALID	(1 << 0)
 #define LC_UL_M_F_RES_VALID	(1 << 1)
 #define LC_UL_M_F_OSMO_EXT_VALID (1 << 2)
@@ -63,6 +65,25 @@ struct bts_ul_meas {
 	uint8_t inv_rssi;
 };
 
+/* Running sums over the uplink measurements of the current reporting period,
+ * updated by lchan_new_ul_meas() so that the period end does not need to walk
+ * all samples. */
+struct bts_ul_meas_acc {
+	uint32_t ber10k_sum;
+	uint32_t ber10k_sub_sum;
+	uint32_t inv_rssi_sum;
+	uint32_t inv_rssi_sub_sum;
+	int32_t ci_cb_sum;
+	int32_t ci_cb_sub_sum;
+	int32_t toa256_sum;
+	uint64_t toa256_sq_sum;
+	int16_t toa256_min;
+	int16_t toa256_max;
+	uint8_t num_sub;
+	/* a sample was removed, toa256_min/max must be recomputed */
+	bool minmax_stale;
+};
+
 struct amr_mode {
 	uint8_t mode;
 	uint8_t threshold;
@@ -234,9 +255,15 @@ struct gsm_lchan {
 		uint8_t flags;
 		/* RSL measurement result number, 0 at lchan_act */
 		uint8_t res_nr;
-		/* number of measurements stored in array below */
+		/* number of measurements received in the current period */
 		uint8_t num_ul_meas;
-		struct bts_ul_meas uplink[MAX_NUM_UL_MEAS];
+		/* the most recent measurements (ring buffer), excess ones are removed
+		 * from the running sums when the period ends */
+		struct bts_ul_meas uplink[MAX_UL_MEAS_WINDOW];
+		struct bts_ul_meas_acc ul_acc;
+		/* TS 45.008 8.3 SUB frame map (by FN % 104) for the channel type/mode in sub_map_key */
+		const uint8_t *sub_map;
+		uint32_t sub_map_key;
 		/* last L1 header from the MS */
 		struct rsl_l1_info l1_info;
 		struct gsm_meas_rep_unidir ul_res;
@@ -256,13 +283,17 @@ struct gsm_lchan {
 		} ext;
 		/* Interference levels reported by PHY (in dBm) */
 		int16_t interf_meas_avg_dbm; /* Average value */
-		int16_t interf_meas_dbm[31]; /* Intave max is 31 */
-		uint8_t interf_meas_num;
+		int32_t interf_meas_sum; /* Sum of the samples of the current Intave period */
+		uint16_t interf_meas_num;
 		uint8_t interf_band;
 	} meas;
 	struct {
 		struct amr_multirate_conf amr_mr;
 		struct {
+			/* DTX DL AMR state machine, see dtx_dl_amr_dispatch() */
+			bool dl_amr_active;
+			uint8_t dl_amr_state; /* enum dtx_dl_amr_fsm_states */
+			/* mirror of dl_amr_state for logging, may be NULL */
 			struct osmo_fsm_inst *dl_amr_fsm;
 			/* TCH cache */
 			uint8_t cache[20];
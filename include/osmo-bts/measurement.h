@@ -20,6 +20,6 @@ bool ts45008_83_is_sub(struct gsm_lchan *lchan, uint32_t fn);
 
 int is_meas_complete(struct gsm_lchan *lchan, uint32_t fn);
 
-void lchan_meas_handle_sacch(struct gsm_lchan *lchan, struct msgb *msg);
+void lchan_meas_handle_sacch(struct gsm_lchan *lchan, struct msgb *msg, uint32_t fn);
 
 #endif
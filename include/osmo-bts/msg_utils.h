@@ -40,6 +40,7 @@ enum {
 
 void lchan_set_marker(bool t, struct gsm_lchan *lchan);
 bool dtx_dl_amr_enabled(const struct gsm_lchan *lchan);
+int dtx_dl_amr_dispatch(struct gsm_lchan *lchan, enum dtx_dl_amr_fsm_events e);
 void dtx_dispatch(struct gsm_lchan *lchan, enum dtx_dl_amr_fsm_events e);
 bool dtx_recursion(const struct gsm_lchan *lchan);
 void dtx_int_signal(struct gsm_lchan *lchan);
@@ -7,6 +7,8 @@ struct gsm_bts;
 struct gsm_abis_mo;
 struct msgb;
 struct gsm_lchan;
+struct gsm_bts_trx_ts;
+struct tlv_parsed;
 
 /* Network Management State */
 struct gsm_nm_state {
@@ -39,6 +41,10 @@ struct gsm_abis_mo {
 int oml_init(void);
 int down_oml(struct gsm_bts *bts, struct msgb *msg);
 
+int oml_tlv_parse(struct tlv_parsed *tp, const uint8_t *buf, int len);
+int oml_tlv_encode(struct msgb *msg, const struct tlv_parsed *tp);
+int handle_chan_comb(struct gsm_bts_trx_ts *ts, const uint8_t comb);
+
 struct msgb *oml_msgb_alloc(void);
 int oml_send_msg(struct msgb *msg, int is_mauf);
 int oml_mo_send_msg(const struct gsm_abis_mo *mo, struct msgb *msg, uint8_t msg_type);
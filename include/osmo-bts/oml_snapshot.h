@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <osmocom/core/timer.h>
+#include <osmocom/core/select.h>
+#include <osmocom/gsm/tlv.h>
+#include <osmocom/gsm/sysinfo.h>
+
+struct gsm_bts;
+struct gsm_bts_trx;
+struct gsm_abis_mo;
+struct msgb;
+
+#define OML_SNAPSHOT_WRITE_DELAY	1	/* seconds to collect changes before writing */
+#define OML_SNAPSHOT_SI_GRACE		10	/* seconds after RSL up to drop SI the BSC did not send */
+#define OML_SNAPSHOT_BSC_TIMEOUT	60	/* seconds after a warm start to get RSL of C0 up */
+
+/* The configuration applied by the BSC (OML attributes of the BTS, Radio
+ * Carrier and Channel objects, administrative state of the Radio Carriers and
+ * the BCCH SI) is persisted to a file.  After a restart, the PHY is
+ * provisioned from that file while Abis is still being established, and the
+ * configuration sent by the BSC is then compared against it. */
+struct oml_snapshot {
+	/* file to persist the configuration to, NULL: disabled */
+	char *path;
+	/* running from the snapshot, not (yet) confirmed by the BSC */
+	bool warm;
+	/* bitmask of BCCH SI from the snapshot, which the BSC did not send yet */
+	uint32_t si_stale;
+	/* contents of the file the BTS was warm started from */
+	uint8_t *data;
+	size_t data_len;
+	struct osmo_timer_list write_timer;
+	struct osmo_timer_list reconcile_timer;
+	/* bounds the time on air from the snapshot without a BSC */
+	struct osmo_timer_list bsc_timer;
+
+	/* the file is written on a separate thread, not to block the main loop */
+	struct {
+		bool running;
+		bool again;		/* changed while writing, write once more */
+		bool done;		/* set by the thread when it completed */
+		pthread_t thread;
+		struct osmo_fd ofd;	/* eventfd, signalled by the thread when done */
+		char *path;
+		struct msgb *msg;
+		int rc;
+	} writer;
+};
+
+void oml_snapshot_init(struct gsm_bts *bts);
+void oml_snapshot_free(struct gsm_bts *bts);
+int oml_snapshot_set_path(struct gsm_bts *bts, const char *path);
+
+int oml_snapshot_warm_start(struct gsm_bts *bts);
+void oml_snapshot_changed(struct gsm_bts *bts);
+void oml_snapshot_rx_attr(const struct gsm_abis_mo *mo, const struct tlv_parsed *tp);
+void oml_snapshot_si_refreshed(struct gsm_bts *bts, enum osmo_sysinfo_type osmo_si);
+void oml_snapshot_rsl_up(struct gsm_bts_trx *trx);
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
 #include <osmocom/netif/osmux.h>
 
 struct gsm_bts;
@@ -23,6 +24,9 @@ struct osmux_state {
 	unsigned int batch_size;
 	bool dummy_padding;
 	struct llist_head osmux_handle_list;
+	/* Bitmask of allocated local Osmux circuit IDs, +7 to round up to 8 bit boundary */
+	uint8_t cid_bitmap[OSMO_BYTES_FOR_BITS(OSMUX_CID_MAX + 1)];
+	uint8_t next_free_cid_lookup;
 };
 
 /* Contains a "struct osmux_in_handle" towards a specific peer (remote IPaddr+port) */
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <linux/if_packet.h>
+
+/* Geometry of the mmap'ed rings of an AF_PACKET (SOCK_DGRAM) link */
+#define PKT_RING_FRAME_SIZE	2048
+#define PKT_RING_BLOCK_SIZE	(1 << 16)
+#define PKT_RING_RX_BLOCK_NR	8
+#define PKT_RING_TX_BLOCK_NR	2
+/* a partially filled RX block is handed to us after this many ms */
+#define PKT_RING_RX_RETIRE_MS	1
+
+struct pkt_ring {
+	/* TPACKET_V3 RX ring, receives proto on the bound interface */
+	int rx_fd;
+	uint8_t *rx_map;
+	unsigned int rx_block_cur;
+
+	/* TPACKET_V2 TX ring, on a separate socket as the version is per socket */
+	int tx_fd;
+	uint8_t *tx_map;
+	unsigned int tx_frame_cur;
+	unsigned int tx_pending;	/* frames put since the last flush */
+};
+
+/* Called for each frame found in the RX ring, buf is only valid during the call */
+typedef void pkt_ring_rx_cb_t(void *data, const uint8_t *buf, size_t len);
+
+int pkt_ring_open(struct pkt_ring *ring, uint16_t proto, int ifindex);
+void pkt_ring_close(struct pkt_ring *ring);
+
+int pkt_ring_rx(struct pkt_ring *ring, pkt_ring_rx_cb_t *rx_cb, void *data);
+
+int pkt_ring_tx_put(struct pkt_ring *ring, const uint8_t *buf, size_t len);
+int pkt_ring_tx_flush(struct pkt_ring *ring, const struct sockaddr_ll *dst);
@@ -84,6 +84,34 @@ int paging_si_update(struct paging_state *ps, struct gsm48_control_channel_descr
 int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
 			const uint8_t *identity_lv, uint8_t chan_needed);
 
+/* A CS paging request (as received with an RSL PAGING COMMAND) */
+struct paging_identity {
+	uint8_t paging_group;
+	uint8_t chan_needed;
+	uint8_t identity_lv[9];
+};
+
+/* A PS paging request (ready formatted MAC block, as received from the PCU) */
+struct paging_macblock {
+	uint32_t msg_id;
+	const char *imsi;
+	bool confirm;
+	const uint8_t *macblock;
+};
+
+/* Add a batch of identities to the paging queue, returns the number of identities added */
+int paging_add_identities(struct paging_state *ps, const struct paging_identity *ids, unsigned int num_ids);
+
+/* Add a batch of MAC blocks to the paging queue, returns the number of MAC blocks added or deferred */
+int paging_add_macblocks(struct paging_state *ps, const struct paging_macblock *mbs, unsigned int num_mbs);
+
+/* Queue an identity for batched admission at the end of the current main loop iteration */
+int paging_enqueue_identity(struct paging_state *ps, uint8_t paging_group,
+			    const uint8_t *identity_lv, uint8_t chan_needed);
+
+/* Admit all identities queued by paging_enqueue_identity() to the paging queue */
+void paging_flush_identities(struct paging_state *ps);
+
 /* Add a ready formatted MAC block message to the paging queue, this can be an IMMEDIATE ASSIGNMENT, or a
  * PAGING COMMAND (from the PCU) */
 int paging_add_macblock(struct paging_state *ps, uint32_t msg_id, const char *imsi, bool confirm, const uint8_t *macblock);
@@ -102,6 +130,7 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 /* inspection methods below */
 int paging_group_queue_empty(struct paging_state *ps, uint8_t group);
 int paging_queue_length(struct paging_state *ps);
+int paging_deferred_length(struct paging_state *ps);
 int paging_buffer_space(struct paging_state *ps);
 
 #endif
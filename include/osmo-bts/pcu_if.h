@@ -20,10 +20,10 @@ int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 int pcu_tx_rach_ind(uint8_t bts_nr, uint8_t trx_nr, uint8_t ts_nr,
 		    int16_t qta, uint16_t ra, uint32_t fn, uint8_t is_11bit,
 		    enum ph_burst_type burst_type, uint8_t sapi);
-int pcu_tx_time_ind(uint32_t fn);
+int pcu_tx_time_ind(const struct gsm_bts *bts, uint32_t fn);
 int pcu_tx_interf_ind(const struct gsm_bts_trx *trx, uint32_t fn);
-int pcu_tx_pag_req(const uint8_t *identity_lv, uint8_t chan_needed);
-int pcu_tx_data_cnf(uint32_t msg_id, uint8_t sapi);
+int pcu_tx_pag_req(const struct gsm_bts *bts, const uint8_t *identity_lv, uint8_t chan_needed);
+int pcu_tx_data_cnf(const struct gsm_bts *bts, uint32_t msg_id, uint8_t sapi);
 int pcu_tx_susp_req(struct gsm_lchan *lchan, uint32_t tlli, const uint8_t *ra_id, uint8_t cause);
 int pcu_sock_send(struct msgb *msg);
 
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <osmo-bts/pcuif_proto.h>
+
+#define PCU_SHM_NUM_SLOTS_DEFAULT	256
+#define PCU_SHM_NUM_SLOTS_MAX		4096
+
+/* Shared memory transport towards the PCU, see PCU_IF_MSG_SHM_REQ */
+struct pcu_shm {
+	int mem_fd;			/* memfd of the shared memory */
+	uint8_t *mem;			/* mapping of mem_fd */
+	size_t size;			/* size of the mapping */
+	uint32_t num_slots;		/* slots per ring, power of two */
+
+	struct gsm_pcu_if_shm_ring *tx;	/* BTS -> PCU */
+	struct gsm_pcu_if_shm_ring *rx;	/* PCU -> BTS */
+	uint32_t tx_head;		/* private copies of the indexes we own */
+	uint32_t rx_tail;
+
+	int tx_efd;			/* eventfd signalled by the BTS */
+	int rx_efd;			/* eventfd signalled by the PCU */
+};
+
+struct pcu_shm *pcu_shm_alloc(void *ctx, uint32_t num_slots);
+void pcu_shm_free(struct pcu_shm *shm);
+void pcu_shm_fill_cnf(const struct pcu_shm *shm, struct gsm_pcu_if_shm *cnf);
+
+struct gsm_pcu_if *pcu_shm_reserve(struct pcu_shm *shm);
+void pcu_shm_commit(struct pcu_shm *shm, size_t len);
+int pcu_shm_push(struct pcu_shm *shm, const struct gsm_pcu_if *pcu_prim, size_t len);
+struct gsm_pcu_if *pcu_shm_peek(struct pcu_shm *shm, size_t *len);
+void pcu_shm_pop(struct pcu_shm *shm);
+
+int pcu_shm_signal(const struct pcu_shm *shm);
+int pcu_shm_ack(const struct pcu_shm *shm);
@@ -23,8 +23,12 @@
 #define PCU_IF_MSG_TIME_IND	0x52	/* GSM time indication */
 #define PCU_IF_MSG_INTERF_IND	0x53	/* interference report */
 #define PCU_IF_MSG_PAG_REQ	0x60	/* paging request */
+#define PCU_IF_MSG_PCH_BATCH	0x61	/* batch of (confirmed) MAC blocks for PCH */
 #define PCU_IF_MSG_TXT_IND	0x70	/* Text indication for BTS */
 #define PCU_IF_MSG_CONTAINER	0x80	/* Transparent container message */
+#define PCU_IF_MSG_BATCH	0x90	/* Several primitives coalesced into one message */
+#define PCU_IF_MSG_SHM_REQ	0x91	/* PCU requests the shared memory transport */
+#define PCU_IF_MSG_SHM_CNF	0x92	/* BTS hands over the shared memory transport */
 
 /* sapi */
 #define PCU_IF_SAPI_RACH	0x01	/* channel request on CCCH */
@@ -38,6 +42,9 @@
 /* flags */
 #define PCU_IF_FLAG_ACTIVE	(1 << 0)/* BTS is active */
 #define PCU_IF_FLAG_DIRECT_PHY	(1 << 1)/* access PHY directly via dedicated hardware support */
+#define PCU_IF_FLAG_PCH_BATCH	(1 << 2)/* BTS accepts PCU_IF_MSG_PCH_BATCH */
+#define PCU_IF_FLAG_BATCH	(1 << 3)/* BTS supports PCU_IF_MSG_BATCH */
+#define PCU_IF_FLAG_SHM		(1 << 4)/* BTS supports PCU_IF_MSG_SHM_REQ */
 #define PCU_IF_FLAG_CS1		(1 << 16)
 #define PCU_IF_FLAG_CS2		(1 << 17)
 #define PCU_IF_FLAG_CS3		(1 << 18)
@@ -257,6 +264,79 @@ struct gsm_pcu_if_agch {
 	bool confirm;
 } __attribute__((packed));
 
+/* Container of several primitives (PCU_IF_MSG_BATCH), all primitives generated for
+ * one TDMA frame are sent in one message instead of one message each. Each
+ * primitive in data[] is preceded by its length (uint16_t, network byte order)
+ * and may be truncated to the size of the used member of the union u. The
+ * BTS starts a new batch with each TIME.ind, and sends a batch at the latest
+ * at the end of its main loop iteration.
+ *
+ * Negotiation: the BTS indicates PCU_IF_FLAG_BATCH in the INFO.ind. A PCU that
+ * supports the extension sends a (possibly empty) batch with the version it
+ * implements, from then on both sides may coalesce their primitives. */
+#define PCU_IF_BATCH_VERSION	1
+struct gsm_pcu_if_batch {
+	uint8_t		version;	/* PCU_IF_BATCH_VERSION */
+	uint8_t		num_prims;	/* number of primitives in data[] */
+	uint16_t	length;		/* length of data[], network byte order */
+	uint8_t		data[0];
+} __attribute__ ((packed));
+
+/* Batch of PCH MAC blocks, all admitted to the paging queue of the BTS in one
+ * go. Only sent by the PCU if the BTS indicates PCU_IF_FLAG_PCH_BATCH. */
+#define PCU_IF_PCH_BATCH_MAX	32
+struct gsm_pcu_if_pch_batch {
+	uint8_t		num_pch;	/* number of entries in pch[] */
+	uint8_t		spare[3];
+	struct gsm_pcu_if_pch pch[0];
+} __attribute__((packed));
+
+/* Shared memory transport: instead of the socket, primitives are exchanged
+ * through two single-producer/single-consumer rings in a memory region shared
+ * between BTS and PCU. The socket is only used for the handover.
+ *
+ * Negotiation: the BTS indicates PCU_IF_FLAG_SHM in the INFO.ind. The PCU sends
+ * a PCU_IF_MSG_SHM_REQ, the BTS answers with a PCU_IF_MSG_SHM_CNF that carries
+ * three file descriptors (SCM_RIGHTS): the memfd of the shared memory, the
+ * eventfd signalled by the BTS and the eventfd signalled by the PCU. A CNF with
+ * version 0 and no file descriptors means the request was rejected. Every
+ * primitive the BTS sends after the CNF is sent through the ring.
+ *
+ * Each side signals its eventfd after it produced into its TX ring or consumed
+ * from its RX ring, the peer then drains its RX ring and retries what did not
+ * fit into its TX ring. Primitives on the rings are never batched. */
+#define PCU_IF_SHM_VERSION	1
+#define PCU_IF_SHM_CACHELINE	64
+
+struct gsm_pcu_if_shm {
+	uint8_t		version;	/* PCU_IF_SHM_VERSION, 0 in a rejecting CNF */
+	uint8_t		spare[3];
+	uint32_t	num_slots;	/* REQ: wanted slots per ring (0 = default), CNF: actual */
+	uint32_t	slot_size;	/* CNF: size of a slot, including its header */
+	uint32_t	size;		/* CNF: size of the shared memory */
+	uint32_t	ring_offset[2];	/* CNF: offset of BTS->PCU [0] and PCU->BTS [1] ring */
+} __attribute__ ((packed));
+
+/* Header of a ring in the shared memory. Indexes are free running, a slot is
+ * addressed by (index & (num_slots - 1)). head is only written by the producer,
+ * tail only by the consumer (store with release, load with acquire semantics). */
+struct gsm_pcu_if_shm_ring {
+	uint32_t	head;		/* next slot to be produced */
+	uint8_t		_pad0[PCU_IF_SHM_CACHELINE - sizeof(uint32_t)];
+	uint32_t	tail;		/* next slot to be consumed */
+	uint8_t		_pad1[PCU_IF_SHM_CACHELINE - sizeof(uint32_t)];
+	uint32_t	num_slots;	/* power of two */
+	uint32_t	slot_size;	/* multiple of PCU_IF_SHM_CACHELINE */
+	uint8_t		_pad2[PCU_IF_SHM_CACHELINE - 2 * sizeof(uint32_t)];
+	uint8_t		slots[0];
+} __attribute__ ((packed));
+
+struct gsm_pcu_if_shm_slot {
+	uint16_t	len;		/* length of prim[], host byte order */
+	uint8_t		spare[2];
+	uint8_t		prim[0];	/* struct gsm_pcu_if, possibly truncated */
+} __attribute__ ((packed));
+
 struct gsm_pcu_if {
 	/* context based information */
 	uint8_t		msg_type;	/* message type */
@@ -278,6 +358,9 @@ struct gsm_pcu_if {
 		struct gsm_pcu_if_app_info_req	app_info_req;
 		struct gsm_pcu_if_interf_ind	interf_ind;
 		struct gsm_pcu_if_container	container;
+		struct gsm_pcu_if_pch_batch	pch_batch;
+		struct gsm_pcu_if_batch		batch;
+		struct gsm_pcu_if_shm		shm;
 	} u;
 } __attribute__ ((packed));
 
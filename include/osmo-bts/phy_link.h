@@ -12,6 +12,8 @@
 
 
 struct virt_um_inst;
+struct ul_dec_pool;
+struct osmo_trx_clock_state;
 
 enum phy_link_type {
 	PHY_LINK_T_NONE,
@@ -49,6 +51,11 @@ struct phy_link {
 			uint32_t rts_advance;
 			bool use_legacy_setbsic;
 			uint8_t trxd_pdu_ver_max; /* Maximum TRXD PDU version to negotiate */
+			unsigned int ul_dec_threads; /* 0: decode UL bursts on the main thread */
+			bool early_ts_connect; /* don't wait for RSP SETSLOT on dynamic TS switches */
+			struct ul_dec_pool *ul_dec;
+			/* scheduler clock, shared by all BTS whose C0 is on this link */
+			struct osmo_trx_clock_state *clk_s;
 			bool powered; /* last POWERON (true) or POWEROFF (false) confirmed */
 			bool poweron_sent; /* is there a POWERON in transit? */
 			bool poweroff_sent; /* is there a POWEROFF in transit? */
@@ -60,6 +67,7 @@ struct phy_link {
 			uint16_t bts_mcast_port;
 			char *ms_mcast_group;		/* MS are listening to this group */
 			uint16_t ms_mcast_port;
+			bool virtual_time;		/* advance FNs as fast as possible */
 			struct virt_um_inst *virt_um;
 		} virt;
 		struct {
@@ -78,6 +86,8 @@ struct phy_link {
 			bool tx_atten_flag;
 			uint32_t tx_atten_db;
 			bool over_sample_16x;
+			/* use PACKET_MMAP rings instead of recvfrom()/sendto() */
+			bool packet_mmap;
 #if OCTPHY_MULTI_TRX == 1
 			/* arfcn used by TRX with id 0 */
 			uint16_t center_arfcn;
@@ -166,6 +176,7 @@ struct phy_instance *phy_instance_by_num(const struct phy_link *plink, int num);
 struct phy_instance *phy_instance_create(struct phy_link *plink, int num);
 void phy_instance_link_to_trx(struct phy_instance *pinst, struct gsm_bts_trx *trx);
 void phy_instance_destroy(struct phy_instance *pinst);
+bool phy_instance_is_c0(const struct phy_instance *pinst);
 const char *phy_instance_name(const struct phy_instance *pinst);
 
 static inline struct phy_instance *trx_phy_instance(const struct gsm_bts_trx *trx)
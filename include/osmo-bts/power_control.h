@@ -88,3 +88,59 @@ int lchan_ms_pwr_ctrl(struct gsm_lchan *lchan,
 
 int lchan_bs_pwr_ctrl(struct gsm_lchan *lchan,
 		      const struct gsm48_meas_res *mr);
+
+/* Maximum number of lchans on a TRX, including the VAMOS shadow ones */
+#define LCHAN_CTRL_BATCH_MAX	(8 * 8 * 2)
+
+/* Measurement pre-processing of one measurement type for a batch of lchans */
+struct pwr_ctrl_avg_batch {
+	uint8_t ewma[LCHAN_CTRL_BATCH_MAX];	/* entry is due, GSM_PWR_CTRL_MEAS_AVG_ALGO_OSMO_EWMA */
+	uint8_t first[LCHAN_CTRL_BATCH_MAX];	/* no measurement processed yet */
+	uint8_t alpha[LCHAN_CTRL_BATCH_MAX];
+	int Avg100[LCHAN_CTRL_BATCH_MAX];
+	int val[LCHAN_CTRL_BATCH_MAX];
+	int avg[LCHAN_CTRL_BATCH_MAX];
+};
+
+/* Inputs and state of the TA, MS and BS power control loops of all lchans of a TRX
+ * whose SACCH block ended in the same TDMA frame.  The loops run over the whole
+ * batch at once, see lchan_ctrl_batch_flush(). */
+struct lchan_ctrl_batch {
+	uint32_t fn;
+	unsigned int num;
+	struct gsm_lchan *lchan[LCHAN_CTRL_BATCH_MAX];
+
+	/* TA control */
+	uint8_t ta_upd[LCHAN_CTRL_BATCH_MAX];
+	uint8_t ms_ta[LCHAN_CTRL_BATCH_MAX];
+	int16_t toa256[LCHAN_CTRL_BATCH_MAX];
+	int16_t new_ta[LCHAN_CTRL_BATCH_MAX];
+
+	/* MS power control */
+	uint8_t ms_upd[LCHAN_CTRL_BATCH_MAX];
+	uint8_t ms_pwr[LCHAN_CTRL_BATCH_MAX];
+	int8_t ul_rssi_dbm[LCHAN_CTRL_BATCH_MAX];
+	int16_t ul_ci_cb[LCHAN_CTRL_BATCH_MAX];
+	struct pwr_ctrl_avg_batch ms_rxlev;
+	struct pwr_ctrl_avg_batch ms_ci;
+
+	/* BS power control, only for valid DL measurement reports */
+	uint8_t bs_upd[LCHAN_CTRL_BATCH_MAX];
+	uint8_t mr_valid[LCHAN_CTRL_BATCH_MAX];
+	uint8_t dl_dtx[LCHAN_CTRL_BATCH_MAX];
+	uint8_t rxlev_full[LCHAN_CTRL_BATCH_MAX];
+	uint8_t rxqual_full[LCHAN_CTRL_BATCH_MAX];
+	uint8_t rxlev_sub[LCHAN_CTRL_BATCH_MAX];
+	uint8_t rxqual_sub[LCHAN_CTRL_BATCH_MAX];
+	struct pwr_ctrl_avg_batch bs_rxlev;
+	struct pwr_ctrl_avg_batch bs_rxqual;
+};
+
+struct gsm_bts_trx;
+struct lchan_ctrl_batch *lchan_ctrl_batch_alloc(void *ctx);
+void lchan_ctrl_batch_add(struct gsm_lchan *lchan, uint32_t fn,
+			  uint8_t ms_tx_ta, int16_t toa256,
+			  uint8_t ms_power_lvl, int8_t ul_rssi_dbm, int16_t ul_lqual_cb,
+			  const struct gsm48_meas_res *mr);
+void lchan_ctrl_batch_flush(struct gsm_bts_trx *trx);
+void lchan_ctrl_batch_cancel(struct gsm_lchan *lchan);
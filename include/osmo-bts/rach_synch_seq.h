@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+/* 3GPP TS 05.02, section 5.2.7 */
+#define RACH_EXT_TAIL_LEN	8
+#define RACH_SYNCH_SEQ_LEN	41
+
+/* Soft-bits correlated per synch. sequence, RACH_SYNCH_SEQ_LEN rounded up
+ * to the vector width.  The reference bits beyond RACH_SYNCH_SEQ_LEN are 0. */
+#define RACH_SYNCH_SEQ_PAD_LEN	48
+
+/* Maximum number of bursts evaluated by one rach_synch_seq_detect_batch() */
+#define RACH_SYNCH_SEQ_BATCH_MAX	8
+
+enum rach_synch_seq_t {
+	RACH_SYNCH_SEQ_UNKNOWN = -1,
+	RACH_SYNCH_SEQ_TS0, /* GSM, GMSK (default) */
+	RACH_SYNCH_SEQ_TS1, /* EGPRS, 8-PSK */
+	RACH_SYNCH_SEQ_TS2, /* EGPRS, GMSK */
+	RACH_SYNCH_SEQ_NUM
+};
+
+extern const struct value_string rach_synch_seq_names[];
+
+void rach_synch_seq_detect_batch(const sbit_t * const *bursts, unsigned int num,
+				 enum rach_synch_seq_t *seq, int *best_score);
+enum rach_synch_seq_t rach_synch_seq_detect(const sbit_t *burst, int *best_score);
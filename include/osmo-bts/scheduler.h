@@ -5,6 +5,8 @@
 
 #include <osmo-bts/gsm_data.h>
 
+struct phy_link;
+
 #define TRX_GMSK_NB_TSC(br) \
 	_sched_train_seq_gmsk_nb[(br)->tsc_set][(br)->tsc]
 
@@ -88,6 +90,7 @@ struct l1sched_chan_state {
 
 	/* scheduler */
 	bool			active;		/* Channel is active */
+	uint32_t		gen;		/* incremented on each activation */
 	ubit_t			*dl_bursts;	/* burst buffer for TX */
 	enum trx_mod_type	dl_mod_type;	/* Downlink modulation type */
 	uint8_t			dl_mask;	/* mask of transmitted bursts */
@@ -120,6 +123,9 @@ struct l1sched_chan_state {
 
 	uint8_t			dl_facch_bursts;  /* number of remaining DL FACCH bursts */
 
+	/* PDTCH */
+	bool			ul_pdtch_egprs;	/* last UL block decoded was EGPRS */
+
 	/* encryption */
 	int			ul_encr_algo;	/* A5/x encry algo downlink */
 	int			dl_encr_algo;	/* A5/x encry algo uplink */
@@ -133,15 +139,21 @@ struct l1sched_chan_state {
 		/* Active channel measurements (simple ring buffer) */
 		struct l1sched_meas_set buf[24]; /* up to 24 (BUFMAX) entries */
 		unsigned int current; /* current position */
-
-		/* Interference measurements */
-		int interf_avg; /* sliding average */
 	} meas;
 
 	/* handover */
 	bool			ho_rach_detect;	/* if rach detection is on */
 };
 
+enum l1sched_ts_ctr {
+	L1SCHED_TS_CTR_DL_LATE,
+	L1SCHED_TS_CTR_DL_NOT_FOUND,
+	L1SCHED_TS_CTR_DL_XCCH_CACHE_HIT,
+	L1SCHED_TS_CTR_DL_XCCH_CACHE_MISS,
+	L1SCHED_TS_CTR_UL_PDTCH_DEC_FALLBACK,
+	L1SCHED_TS_CTR_UL_PDTCH_HINT_MISMATCH,
+};
+
 struct l1sched_ts {
 	struct gsm_bts_trx_ts	*ts;		/* timeslot we belong to */
 
@@ -171,13 +183,13 @@ int trx_sched_ph_data_req(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap
 int trx_sched_tch_req(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap);
 
 /*! \brief PHY informs us of new (current) GSM frame number */
-int trx_sched_clock(struct gsm_bts *bts, uint32_t fn);
+int trx_sched_clock(struct phy_link *plink, uint32_t fn);
 
 /*! \brief PHY informs us clock indications should start to be received */
-int trx_sched_clock_started(struct gsm_bts *bts);
+int trx_sched_clock_started(struct phy_link *plink);
 
 /*! \brief PHY informs us no more clock indications should be received anymore */
-int trx_sched_clock_stopped(struct gsm_bts *bts);
+int trx_sched_clock_stopped(struct phy_link *plink);
 
 /*! \brief set multiframe scheduler to given physical channel config */
 int trx_sched_set_pchan(struct gsm_bts_trx_ts *ts, enum gsm_phys_chan_config pchan);
@@ -3,3 +3,7 @@
 #include <osmo-bts/gsm_data.h>
 
 void lchan_ms_ta_ctrl(struct gsm_lchan *lchan, uint8_t ms_tx_ta, int16_t toa256);
+
+bool lchan_ms_ta_ctrl_due(struct gsm_lchan *lchan);
+void ta_ctrl_calc(const uint8_t *ms_tx_ta, const int16_t *toa256, int16_t *new_ta, unsigned int num);
+void lchan_ms_ta_ctrl_apply(struct gsm_lchan *lchan, int16_t new_ta, int16_t toa256);
@@ -48,6 +48,7 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
 #include <osmo-bts/rsl.h>
 #include <osmo-bts/oml.h>
 #include <osmo-bts/abis_osmo.h>
@@ -55,8 +56,6 @@
 #include <osmo-bts/bts_trx.h>
 #include <osmo-bts/bts_shutdown_fsm.h>
 
-static struct gsm_bts *g_bts;
-
 static struct e1inp_line_ops line_ops;
 
 static struct ipaccess_unit bts_dev_info;
@@ -83,12 +82,19 @@ struct abis_link_fsm_priv {
 	struct gsm_bts *bts;
 	char *model_name;
 	bool reconnect_to_current_bsc;
+	/* Each BTS has its own IPA connection (E1 input line number = BTS number),
+	 * the line keeps pointers to these */
+	struct e1inp_line_ops line_ops;
+	struct ipaccess_unit dev_info;
 };
 
 static void reset_oml_link(struct gsm_bts *bts)
 {
 	struct e1inp_sign_link *link;
 
+	/* OML and OSMO share the connection and its output stage */
+	abis_tx_queue_drop(&bts->oml_tx_queue);
+
 	if (bts->oml_link) {
 		struct timespec now;
 
@@ -170,25 +176,25 @@ static void abis_link_connecting_onenter(struct osmo_fsm_inst *fi, uint32_t prev
 	LOGP(DABIS, LOGL_NOTICE, "A-bis connection establishment to BSC (%s) in progress...\n", priv->current_bsc->addr);
 
 	/* patch in various data from VTY and other sources */
-	line_ops.cfg.ipa.addr = priv->current_bsc->addr;
-	osmo_get_macaddr(bts_dev_info.mac_addr, "eth0");
-	bts_dev_info.site_id = bts->ip_access.site_id;
-	bts_dev_info.bts_id = bts->ip_access.bts_id;
-	bts_dev_info.unit_name = priv->model_name;
+	priv->line_ops.cfg.ipa.addr = priv->current_bsc->addr;
+	osmo_get_macaddr(priv->dev_info.mac_addr, "eth0");
+	priv->dev_info.site_id = bts->ip_access.site_id;
+	priv->dev_info.bts_id = bts->ip_access.bts_id;
+	priv->dev_info.unit_name = priv->model_name;
 	if (bts->description)
-		bts_dev_info.unit_name = bts->description;
-	bts_dev_info.location2 = priv->model_name;
+		priv->dev_info.unit_name = bts->description;
+	priv->dev_info.location2 = priv->model_name;
 
-	line = e1inp_line_find(0);
+	line = e1inp_line_find(bts->nr);
 	if (!line)
-		line = e1inp_line_create(0, "ipa");
+		line = e1inp_line_create(bts->nr, "ipa");
 	if (!line) {
 		osmo_fsm_inst_state_chg(fi, ABIS_LINK_ST_FAILED, 0, 0);
 		return;
 	}
 	/* Line always comes already with a "ctor" reference, enough to keep it alive forever. */
 
-	e1inp_line_bind_ops(line, &line_ops);
+	e1inp_line_bind_ops(line, &priv->line_ops);
 	/* This will open the OML connection now */
 	if (e1inp_line_update(line) < 0) {
 		osmo_fsm_inst_state_chg(fi, ABIS_LINK_ST_FAILED, 0, 0);
@@ -219,7 +225,9 @@ static void abis_link_connecting(struct osmo_fsm_inst *fi, uint32_t event, void
 
 static void abis_link_connected_onenter(struct osmo_fsm_inst *fi, uint32_t prev_state)
 {
-	bts_link_estab(g_bts);
+	struct abis_link_fsm_priv *priv = fi->priv;
+
+	bts_link_estab(priv->bts);
 }
 
 static void abis_link_connected(struct osmo_fsm_inst *fi, uint32_t event, void *data)
@@ -239,6 +247,7 @@ static void abis_link_connected(struct osmo_fsm_inst *fi, uint32_t event, void *
 			 * to avoid a callback triggering this same code path. */
 			struct e1inp_sign_link *link = trx->bb_transc.rsl.link;
 			trx->bb_transc.rsl.link = NULL;
+			abis_tx_queue_drop(&trx->bb_transc.rsl.tx_queue);
 			e1inp_sign_link_destroy(link);
 			if (trx == trx->bts->c0)
 				load_timer_stop(trx->bts);
@@ -247,7 +256,7 @@ static void abis_link_connected(struct osmo_fsm_inst *fi, uint32_t event, void *
 			 * layers are still establishing the socket (TCP, IPA).
 			 * Let's tell it to stop connection establishment since
 			 * we are shutting down. */
-			struct e1inp_line *line = e1inp_line_find(0);
+			struct e1inp_line *line = e1inp_line_find(bts->nr);
 			if (line)
 				e1inp_ipa_bts_rsl_close_n(line, trx->nr);
 		}
@@ -362,7 +371,7 @@ int abis_oml_sendmsg(struct msgb *msg)
 	/* osmo-bts uses msg->trx internally, but libosmo-abis uses
 	 * the signalling link at msg->dst */
 	msg->dst = bts->oml_link;
-	return abis_sendmsg(msg);
+	return abis_tx_queue_send(&bts->oml_tx_queue, msg);
 }
 
 int abis_bts_rsl_sendmsg(struct msgb *msg)
@@ -377,7 +386,7 @@ int abis_bts_rsl_sendmsg(struct msgb *msg)
 	/* osmo-bts uses msg->trx internally, but libosmo-abis uses
 	 * the signalling link at msg->dst */
 	msg->dst = msg->trx->bb_transc.rsl.link;
-	return abis_sendmsg(msg);
+	return abis_tx_queue_send(&msg->trx->bb_transc.rsl.tx_queue, msg);
 }
 
 static struct e1inp_sign_link *sign_link_up(void *unit, struct e1inp_line *line,
@@ -385,22 +394,29 @@ static struct e1inp_sign_link *sign_link_up(void *unit, struct e1inp_line *line,
 {
 	struct e1inp_ts *sign_ts;
 	struct gsm_bts_trx *trx;
+	struct gsm_bts *bts;
 	int trx_nr;
 
+	bts = gsm_bts_num(g_bts_sm, line->num);
+	if (!bts) {
+		LOGPIL(line, DABIS, LOGL_ERROR, "Signalling link up on line without BTS\n");
+		return NULL;
+	}
+
 	switch (type) {
 	case E1INP_SIGN_OML:
 		sign_ts = e1inp_line_ipa_oml_ts(line);
 		LOGP(DABIS, LOGL_INFO, "OML Signalling link up\n");
 		e1inp_ts_config_sign(sign_ts, line);
-		g_bts->oml_link = e1inp_sign_link_create(sign_ts, E1INP_SIGN_OML,
-							g_bts->c0, IPAC_PROTO_OML, 0);
-		if (clock_gettime(CLOCK_MONOTONIC, &g_bts->oml_conn_established_timestamp) != 0)
-			memset(&g_bts->oml_conn_established_timestamp, 0,
-			       sizeof(g_bts->oml_conn_established_timestamp));
-		g_bts->osmo_link = e1inp_sign_link_create(sign_ts, E1INP_SIGN_OSMO,
-							  g_bts->c0, IPAC_PROTO_OSMO, 0);
-		osmo_fsm_inst_dispatch(g_bts->abis_link_fi, ABIS_LINK_EV_SIGN_LINK_OML_UP, NULL);
-		return g_bts->oml_link;
+		bts->oml_link = e1inp_sign_link_create(sign_ts, E1INP_SIGN_OML,
+						      bts->c0, IPAC_PROTO_OML, 0);
+		if (clock_gettime(CLOCK_MONOTONIC, &bts->oml_conn_established_timestamp) != 0)
+			memset(&bts->oml_conn_established_timestamp, 0,
+			       sizeof(bts->oml_conn_established_timestamp));
+		bts->osmo_link = e1inp_sign_link_create(sign_ts, E1INP_SIGN_OSMO,
+						       bts->c0, IPAC_PROTO_OSMO, 0);
+		osmo_fsm_inst_dispatch(bts->abis_link_fi, ABIS_LINK_EV_SIGN_LINK_OML_UP, NULL);
+		return bts->oml_link;
 
 	case E1INP_SIGN_RSL:
 		/* fall through to default to catch TRXn having type = E1INP_SIGN_RSL + n  */
@@ -409,7 +425,7 @@ static struct e1inp_sign_link *sign_link_up(void *unit, struct e1inp_line *line,
 		sign_ts = e1inp_line_ipa_rsl_ts(line, trx_nr);
 		LOGP(DABIS, LOGL_INFO, "RSL Signalling link for TRX%d up\n",
 			trx_nr);
-		trx = gsm_bts_trx_num(g_bts, trx_nr);
+		trx = gsm_bts_trx_num(bts, trx_nr);
 		if (!trx) {
 			LOGP(DABIS, LOGL_ERROR, "TRX%d does not exist!\n",
 				trx_nr);
@@ -426,8 +442,11 @@ static struct e1inp_sign_link *sign_link_up(void *unit, struct e1inp_line *line,
 
 static void sign_link_down(struct e1inp_line *line)
 {
+	struct gsm_bts *bts = gsm_bts_num(g_bts_sm, line->num);
+
 	LOGPIL(line, DABIS, LOGL_ERROR, "Signalling link down\n");
-	osmo_fsm_inst_dispatch(g_bts->abis_link_fi, ABIS_LINK_EV_SIGN_LINK_DOWN, NULL);
+	if (bts)
+		osmo_fsm_inst_dispatch(bts->abis_link_fi, ABIS_LINK_EV_SIGN_LINK_DOWN, NULL);
 }
 
 
@@ -498,6 +517,7 @@ static int inp_s_cbfn(unsigned int subsys, unsigned int signal,
 }
 
 
+/* templates, copied for each BTS in abis_open() */
 static struct ipaccess_unit bts_dev_info = {
 	.unit_name	= "osmo-bts",
 	.equipvers	= "",	/* FIXME: read this from hw */
@@ -521,8 +541,6 @@ static struct e1inp_line_ops line_ops = {
 
 void abis_init(struct gsm_bts *bts)
 {
-	g_bts = bts;
-
 	oml_init();
 	libosmo_abis_init(tall_bts_ctx);
 
@@ -545,6 +563,9 @@ int abis_open(struct gsm_bts *bts, char *model_name)
 	OSMO_ASSERT(abis_link_fsm_priv);
 	abis_link_fsm_priv->bts = bts;
 	abis_link_fsm_priv->model_name = model_name;
+	abis_link_fsm_priv->dev_info = bts_dev_info;
+	abis_link_fsm_priv->line_ops = line_ops;
+	abis_link_fsm_priv->line_ops.cfg.ipa.dev = &abis_link_fsm_priv->dev_info;
 	bts->abis_link_fi->priv = abis_link_fsm_priv;
 
 	osmo_fsm_inst_state_chg(bts->abis_link_fi, ABIS_LINK_ST_CONNECTING, 0, 0);
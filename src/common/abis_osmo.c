@@ -58,7 +58,7 @@ int abis_osmo_sendmsg(struct gsm_bts *bts, struct msgb *msg)
 {
 	msg->dst = bts->osmo_link;
 	msg->l2h = msg->data;
-	return abis_sendmsg(msg);
+	return abis_tx_queue_send(&bts->oml_tx_queue, msg);
 }
 
 
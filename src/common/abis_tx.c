@@ -0,0 +1,300 @@
+/* Coalesced transmission of Abis signalling messages */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/ipa.h>
+#include <osmocom/gsm/protocol/ipaccess.h>
+#include <osmocom/abis/abis.h>
+#include <osmocom/abis/e1_input.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/abis_tx.h>
+
+/* queues which took over the osmo_fd of their connection */
+static LLIST_HEAD(ofd_owners);
+
+/* see get_signlink_remote_ip() */
+static int sign_link_fd(const struct e1inp_sign_link *link)
+{
+	return link->ts->driver.ipaccess.fd.fd;
+}
+
+/* Messages which were queued by libosmo-abis before the output stage had
+ * any message (or by another link on the same connection) must go first */
+static bool sign_ts_tx_idle(const struct e1inp_ts *ts)
+{
+	const struct e1inp_sign_link *link;
+
+	llist_for_each_entry(link, &ts->sign.sign_links, list) {
+		if (!llist_empty(&link->tx_list))
+			return false;
+	}
+
+	return true;
+}
+
+static struct abis_tx_queue *abis_tx_queue_by_ofd(const struct osmo_fd *ofd)
+{
+	struct abis_tx_queue *q;
+
+	llist_for_each_entry(q, &ofd_owners, ofd_entry) {
+		if (q->ofd == ofd)
+			return q;
+	}
+
+	return NULL;
+}
+
+static int abis_tx_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct abis_tx_queue *q = abis_tx_queue_by_ofd(ofd);
+	int (*cb)(struct osmo_fd *ofd, unsigned int what);
+
+	OSMO_ASSERT(q != NULL);
+	cb = q->ofd_cb;
+
+	if (what & OSMO_FD_WRITE)
+		abis_tx_queue_flush(q);
+
+	/* an IPA CCM answer of libosmo-abis must not cut through a message */
+	if ((what & OSMO_FD_READ) && !q->partial)
+		return cb(ofd, OSMO_FD_READ);
+	return 0;
+}
+
+/* Take over the osmo_fd of libosmo-abis until all queued messages are written.
+ * The queue is flushed on write readiness.  While a message is only written
+ * partially, the socket is not read either, as libosmo-abis answers an IPA CCM
+ * PING or ID GET right away with a write of its own.  Whatever libosmo-abis
+ * queues meanwhile is written once the fd is released. */
+static void abis_tx_fd_own(struct abis_tx_queue *q, struct osmo_fd *ofd)
+{
+	if (q->ofd == NULL) {
+		q->ofd = ofd;
+		q->ofd_cb = ofd->cb;
+		ofd->cb = abis_tx_fd_cb;
+		llist_add_tail(&q->ofd_entry, &ofd_owners);
+	}
+
+	osmo_fd_write_enable(ofd);
+	if (q->partial)
+		osmo_fd_read_disable(ofd);
+	else
+		osmo_fd_read_enable(ofd);
+}
+
+static void abis_tx_fd_release(struct abis_tx_queue *q)
+{
+	struct osmo_fd *ofd = q->ofd;
+	struct e1inp_ts *ts;
+
+	if (ofd == NULL)
+		return;
+	llist_del(&q->ofd_entry);
+	q->ofd = NULL;
+
+	/* set up anew by libosmo-abis meanwhile */
+	if (ofd->cb != abis_tx_fd_cb)
+		return;
+	ofd->cb = q->ofd_cb;
+	if (ofd->fd < 0)
+		return;
+
+	ts = container_of(ofd, struct e1inp_ts, driver.ipaccess.fd);
+	osmo_fd_read_enable(ofd);
+	if (sign_ts_tx_idle(ts))
+		osmo_fd_write_disable(ofd);
+	else
+		osmo_fd_write_enable(ofd);
+}
+
+/* libosmo-abis has messages of its own to write, which must go first: leave
+ * the queued ones to it as well */
+static void abis_tx_queue_hand_over(struct abis_tx_queue *q)
+{
+	struct msgb *msg;
+
+	abis_tx_fd_release(q);
+	while ((msg = msgb_dequeue(&q->msgs))) {
+		/* libosmo-abis prepends the IPA header itself */
+		msgb_pull(msg, sizeof(struct ipaccess_head));
+		abis_sendmsg(msg);
+	}
+	q->num_msgs = 0;
+}
+
+static void abis_tx_queue_timer_cb(void *data)
+{
+	abis_tx_queue_flush(data);
+}
+
+/*! Initialize the output stage of an IPA connection.
+ *  \param[in] q queue to initialize
+ *  \param[in] bts BTS for the configuration and counters
+ *  \param[in] link location of the link owning the connection */
+void abis_tx_queue_init(struct abis_tx_queue *q, struct gsm_bts *bts,
+			struct e1inp_sign_link **link)
+{
+	q->bts = bts;
+	q->link = link;
+	INIT_LLIST_HEAD(&q->msgs);
+	q->num_msgs = 0;
+	q->partial = false;
+	q->ofd = NULL;
+	osmo_timer_setup(&q->flush_timer, abis_tx_queue_timer_cb, q);
+}
+
+/*! Send a message on the signalling link at msg->dst, which must belong to
+ *  the connection of the queue.  Unless coalescing is disabled, the message
+ *  is only queued.  Takes ownership of msg.
+ *  \returns 0 on success; negative on error */
+int abis_tx_queue_send(struct abis_tx_queue *q, struct msgb *msg)
+{
+	struct e1inp_sign_link *link = msg->dst;
+	int budget_ms = q->bts->abis_tx_coalesce_ms;
+
+	/* coalescing is disabled, or the connection is not (yet) up.  If
+	 * it was disabled meanwhile, keep the order of the queued ones.  The
+	 * same if libosmo-abis still has messages to write. */
+	if (link == NULL || sign_link_fd(link) < 0
+	    || (q->num_msgs == 0 && (budget_ms < 0 || !sign_ts_tx_idle(link->ts))))
+		return abis_sendmsg(msg);
+
+	/* like libosmo-abis does before writing */
+	msg->l2h = msg->data;
+	ipa_prepend_header(msg, link->tei);
+
+	if (q->num_msgs == 0) {
+		osmo_clock_gettime(CLOCK_MONOTONIC, &q->first_queued);
+		osmo_timer_schedule(&q->flush_timer, 0, OSMO_MAX(budget_ms, 0) * 1000);
+	}
+	msgb_enqueue(&q->msgs, msg);
+	q->num_msgs++;
+
+	/* unless waiting for the socket anyway */
+	if (q->num_msgs >= ABIS_TX_BATCH_MAX && q->ofd == NULL)
+		abis_tx_queue_flush(q);
+
+	return 0;
+}
+
+/*! Write the queued messages with a single writev(), without waiting for
+ *  the latency budget to expire.  Whatever the socket does not take is
+ *  written on write readiness, before anything else. */
+void abis_tx_queue_flush(struct abis_tx_queue *q)
+{
+	struct e1inp_sign_link *link = *q->link;
+	struct rate_ctr_group *ctrs = q->bts->ctrs;
+	struct iovec iov[ABIS_TX_BATCH_MAX];
+	unsigned int num = 0, num_done = 0;
+	struct msgb *msg, *msg2;
+	struct timespec now;
+	ssize_t written;
+	int fd;
+
+	osmo_timer_del(&q->flush_timer);
+	if (q->num_msgs == 0)
+		return;
+
+	if (link == NULL || (fd = sign_link_fd(link)) < 0) {
+		abis_tx_queue_drop(q);
+		return;
+	}
+	if (!q->partial && !sign_ts_tx_idle(link->ts)) {
+		abis_tx_queue_hand_over(q);
+		return;
+	}
+
+	llist_for_each_entry(msg, &q->msgs, list) {
+		iov[num++] = (struct iovec) {
+			.iov_base = msgb_data(msg),
+			.iov_len = msgb_length(msg),
+		};
+		if (num == ARRAY_SIZE(iov))
+			break;
+	}
+
+	written = writev(fd, iov, num);
+	if (written < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			goto wait;
+		/* libosmo-abis will notice the broken connection soon */
+		LOGP(DABIS, LOGL_ERROR, "Failed to write %u Abis messages: %s\n",
+		     q->num_msgs, strerror(errno));
+		abis_tx_queue_drop(q);
+		return;
+	}
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	rate_ctr_inc2(ctrs, BTS_CTR_ABIS_TX_BATCH);
+	rate_ctr_add2(ctrs, BTS_CTR_ABIS_TX_BATCH_DELAY,
+		      (now.tv_sec - q->first_queued.tv_sec) * 1000000
+		      + (now.tv_nsec - q->first_queued.tv_nsec) / 1000);
+
+	q->partial = false;
+	llist_for_each_entry_safe(msg, msg2, &q->msgs, list) {
+		if (written < msgb_length(msg)) {
+			/* keep the IPA stream intact: the rest goes first next time */
+			if (written > 0) {
+				msgb_pull(msg, written);
+				q->partial = true;
+			}
+			break;
+		}
+		written -= msgb_length(msg);
+		llist_del(&msg->list);
+		msgb_free(msg);
+		q->num_msgs--;
+		num_done++;
+	}
+	rate_ctr_add2(ctrs, BTS_CTR_ABIS_TX_BATCH_MSGS, num_done);
+
+	if (q->num_msgs == 0) {
+		abis_tx_fd_release(q);
+		return;
+	}
+	q->first_queued = now;
+
+wait:
+	abis_tx_fd_own(q, &link->ts->driver.ipaccess.fd);
+}
+
+/*! Drop all queued messages, e.g. because the link went down */
+void abis_tx_queue_drop(struct abis_tx_queue *q)
+{
+	struct msgb *msg;
+
+	osmo_timer_del(&q->flush_timer);
+	abis_tx_fd_release(q);
+	while ((msg = msgb_dequeue(&q->msgs)))
+		msgb_free(msg);
+	q->num_msgs = 0;
+	q->partial = false;
+}
@@ -83,6 +83,7 @@ static int bts_signal_cbfn(unsigned int subsys, unsigned int signal,
 		struct gsm_bts *bts = signal_data;
 
 		bts_update_agch_max_queue_length(bts);
+		bts_sysinfo_sched_update(bts);
 	}
 	return 0;
 }
@@ -113,6 +114,17 @@ static const struct rate_ctr_desc bts_ctr_desc[] = {
 	[BTS_CTR_RTP_RX_DROP_V110_DEC] = {"rtp:rx:drop:v110_dec", "Total number of received RTP packets dropped during V.110 decode"},
 	[BTS_CTR_RTP_TX_TOTAL] =	{"rtp:tx:total", "Total number of transmitted RTP packets"},
 	[BTS_CTR_RTP_TX_MARKER] =	{"rtp:tx:marker", "Number of transmitted RTP packets with marker bit set"},
+	[BTS_CTR_GSMTAP_DROP] =		{"gsmtap:drop", "GSMTAP frames dropped (tap ring full or send error)"},
+	[BTS_CTR_ABIS_TX_BATCH] =	{"abis:tx_batch", "writev() calls writing coalesced Abis messages"},
+	[BTS_CTR_ABIS_TX_BATCH_MSGS] =	{"abis:tx_batch_msgs", "Abis messages written by coalesced writes"},
+	[BTS_CTR_ABIS_TX_BATCH_DELAY] =	{"abis:tx_batch_delay", "Time the oldest message of each batch was held back (us)"},
+	[BTS_CTR_DYN_TS_SWITCH] =	{"dyn_ts:switch", "Completed dynamic timeslot switches"},
+	[BTS_CTR_DYN_TS_SWITCH_TIME] =	{"dyn_ts:switch_time", "Time from the switch request until its ACK (us)"},
+	[BTS_CTR_DYN_TS_SWITCH_LT_2MS] = {"dyn_ts:switch_lt_2ms", "Dynamic timeslot switches taking less than 2 ms"},
+	[BTS_CTR_DYN_TS_SWITCH_LT_10MS] = {"dyn_ts:switch_lt_10ms", "Dynamic timeslot switches taking 2 to 10 ms"},
+	[BTS_CTR_DYN_TS_SWITCH_LT_50MS] = {"dyn_ts:switch_lt_50ms", "Dynamic timeslot switches taking 10 to 50 ms"},
+	[BTS_CTR_DYN_TS_SWITCH_LT_200MS] = {"dyn_ts:switch_lt_200ms", "Dynamic timeslot switches taking 50 to 200 ms"},
+	[BTS_CTR_DYN_TS_SWITCH_GE_200MS] = {"dyn_ts:switch_ge_200ms", "Dynamic timeslot switches taking 200 ms or more"},
 };
 static const struct rate_ctr_group_desc bts_ctrg_desc = {
 	"bts",
@@ -183,6 +195,13 @@ static const struct gprs_rlc_cfg rlc_cfg_default = {
 	.initial_mcs = 6,
 };
 
+/* Number of messages each AGCH queue class may send in a row */
+static const uint8_t bts_agch_class_weight[_NUM_BTS_AGCH_CLASS] = {
+	[BTS_AGCH_CLASS_CS] = 4,
+	[BTS_AGCH_CLASS_PS] = 2,
+	[BTS_AGCH_CLASS_REJ] = 1,
+};
+
 const struct value_string osmo_bts_variant_names[_NUM_BTS_VARIANT + 1] = {
 	{ BTS_UNKNOWN,		"unknown" },
 	{ BTS_OSMO_LITECELL15,	"osmo-bts-lc15" },
@@ -217,6 +236,7 @@ const struct value_string bts_impl_flag_desc[] = {
 	{ BTS_INTERNAL_FLAG_MEAS_PAYLOAD_COMB,	"Measurement and Payload data combined" },
 	{ BTS_INTERNAL_FLAG_NM_RCHANNEL_DEPENDS_RCARRIER, "OML RadioChannel MO depends on RadioCarrier MO" },
 	{ BTS_INTERNAL_FLAG_INTERF_MEAS,	"Uplink interference measurements" },
+	{ BTS_INTERNAL_FLAG_WARM_START,		"Warm start from OML snapshot" },
 	{ 0, NULL }
 };
 
@@ -235,6 +255,11 @@ static int gsm_bts_talloc_destructor(struct gsm_bts *bts)
 	}
 
 	bts_osmux_release(bts);
+	abis_tx_queue_drop(&bts->oml_tx_queue);
+	oml_snapshot_free(bts);
+
+	if (bts_tdef_groups[0].tdefs == bts->T_defs)
+		bts_tdef_groups[0].tdefs = bts_T_defs;
 
 	llist_del(&bts->list);
 	g_bts_sm->num_bts--;
@@ -259,10 +284,20 @@ struct gsm_bts *gsm_bts_alloc(struct gsm_bts_sm *bts_sm, uint8_t bts_num)
 	bts->num_trx = 0;
 	INIT_LLIST_HEAD(&bts->trx_list);
 	bts->ms_max_power = 15;	/* dBm */
-
-	bts->T_defs = bts_T_defs;
+	bts->abis_tx_coalesce_ms = -1;
+	abis_tx_queue_init(&bts->oml_tx_queue, bts, &bts->oml_link);
+	oml_snapshot_init(bts);
+
+	/* each co-located BTS has its own timers, 'timer bts' on the config
+	 * node refers to those of BTS 0 */
+	bts->T_defs = talloc_memdup(bts, bts_T_defs, sizeof(bts_T_defs));
+	if (!bts->T_defs) {
+		talloc_free(bts);
+		return NULL;
+	}
 	osmo_tdefs_reset(bts->T_defs);
-	osmo_tdefs_reset(abis_T_defs);
+	if (bts_num == 0)
+		bts_tdef_groups[0].tdefs = bts->T_defs;
 	bts->shutdown_fi = osmo_fsm_inst_alloc(&bts_shutdown_fsm, bts, bts,
 					       LOGL_INFO, NULL);
 	osmo_fsm_inst_update_id_f(bts->shutdown_fi, "bts%d", bts->nr);
@@ -320,8 +355,11 @@ int bts_init(struct gsm_bts *bts)
 
 	bts->band = GSM_BAND_1800;
 
-	INIT_LLIST_HEAD(&bts->agch_queue.queue);
+	for (i = 0; i < ARRAY_SIZE(bts->agch_queue.queue); i++)
+		INIT_LLIST_HEAD(&bts->agch_queue.queue[i]);
 	bts->agch_queue.length = 0;
+	bts->agch_queue.wrr_class = BTS_AGCH_CLASS_CS;
+	bts->agch_queue.wrr_credit = bts_agch_class_weight[BTS_AGCH_CLASS_CS];
 
 	bts->ctrs = rate_ctr_group_alloc(bts, &bts_ctrg_desc, bts->nr);
 	if (!bts->ctrs)
@@ -376,9 +414,11 @@ int bts_init(struct gsm_bts *bts)
 	oml_mo_state_init(&bts->gprs.cell.mo, NM_OPSTATE_DISABLED, NM_AVSTATE_NOT_INSTALLED);
 
 	/* allocate a talloc pool for ORTP to ensure it doesn't have to go back
-	 * to the libc malloc all the time */
-	tall_rtp_ctx = talloc_pool(tall_bts_ctx, 262144);
-	osmo_rtp_init(tall_rtp_ctx);
+	 * to the libc malloc all the time, shared by all BTS of the process */
+	if (!initialized) {
+		tall_rtp_ctx = talloc_pool(tall_bts_ctx, 262144);
+		osmo_rtp_init(tall_rtp_ctx);
+	}
 
 	/* Osmux */
 	rc = bts_osmux_init(bts);
@@ -411,10 +451,10 @@ int bts_init(struct gsm_bts *bts)
 	}
 
 	INIT_LLIST_HEAD(&bts->smscb_basic.queue);
-	bts->smscb_basic.ctrs = rate_ctr_group_alloc(bts, &cbch_ctrg_desc, 0);
+	bts->smscb_basic.ctrs = rate_ctr_group_alloc(bts, &cbch_ctrg_desc, 2 * bts->nr);
 	OSMO_ASSERT(bts->smscb_basic.ctrs);
 	INIT_LLIST_HEAD(&bts->smscb_extended.queue);
-	bts->smscb_extended.ctrs = rate_ctr_group_alloc(bts, &cbch_ctrg_desc, 1);
+	bts->smscb_extended.ctrs = rate_ctr_group_alloc(bts, &cbch_ctrg_desc, 2 * bts->nr + 1);
 	OSMO_ASSERT(bts->smscb_extended.ctrs);
 	bts->smscb_queue_max_len = 15;
 	bts->smscb_queue_tgt_len = 2;
@@ -423,6 +463,8 @@ int bts_init(struct gsm_bts *bts)
 	bts->asci.pos_nch = -ENOTSUP;
 	INIT_LLIST_HEAD(&bts->asci.notifications);
 
+	bts_sysinfo_sched_update(bts);
+
 	INIT_LLIST_HEAD(&bts->bsc_oml_hosts);
 
 	/* register DTX DL FSM */
@@ -639,60 +681,80 @@ static int try_merge_imm_ass_rej(struct gsm48_imm_ass_rej *old_rej,
 	return 0;
 }
 
-int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg)
+static enum bts_agch_class bts_agch_msg_class(struct msgb *msg)
 {
-	int hard_limit = 100;
-	struct gsm48_imm_ass_rej *imm_ass_cmd = msgb_l3(msg);
-
-	if (bts->agch_queue.length > hard_limit) {
-		LOGP(DRR, LOGL_ERROR,
-		     "AGCH: too many messages in queue, "
-		     "refusing message type %s, length = %d/%d\n",
-		     gsm48_rr_msg_name(((struct gsm48_imm_ass *)msgb_l3(msg))->msg_type),
-		     bts->agch_queue.length, bts->agch_queue.max_length);
-
-		bts->agch_queue.rejected_msgs++;
-		return -ENOMEM;
-	}
-
-	if (bts->agch_queue.length > 0) {
-		struct msgb *last_msg =
-			llist_entry(bts->agch_queue.queue.prev, struct msgb, list);
-		struct gsm48_imm_ass_rej *last_imm_ass_rej = msgb_l3(last_msg);
-
-		if (try_merge_imm_ass_rej(last_imm_ass_rej, imm_ass_cmd)) {
-			bts->agch_queue.merged_msgs++;
-			msgb_free(msg);
-			return 0;
-		}
-	}
+	const struct gsm48_imm_ass *imm_ass = msgb_l3(msg);
+	const struct bts_agch_msg_cb *msg_cb = (struct bts_agch_msg_cb *) msg->cb;
+
+	if (imm_ass->msg_type == GSM48_MT_RR_IMM_ASS_REJ)
+		return BTS_AGCH_CLASS_REJ;
+	if (msg_cb->is_ps)
+		return BTS_AGCH_CLASS_PS;
+	return BTS_AGCH_CLASS_CS;
+}
 
-	msgb_enqueue(&bts->agch_queue.queue, msg);
-	bts->agch_queue.length++;
+static bool imm_ass_rej_has_room(struct gsm48_imm_ass_rej *rej)
+{
+	struct gsm48_req_ref req_refs[REQ_REFS_PER_IMM_ASS_REJ];
+	uint8_t wait_inds[REQ_REFS_PER_IMM_ASS_REJ];
 
-	return 0;
+	return extract_imm_ass_rej_refs(rej, req_refs, wait_inds) < REQ_REFS_PER_IMM_ASS_REJ;
 }
 
-static struct msgb *bts_agch_dequeue(struct gsm_bts *bts)
+static struct msgb *bts_agch_dequeue_class(struct gsm_bts *bts, enum bts_agch_class agch_class)
 {
-	struct msgb *msg = msgb_dequeue(&bts->agch_queue.queue);
+	struct msgb *msg = msgb_dequeue(&bts->agch_queue.queue[agch_class]);
 	if (!msg)
 		return NULL;
 
 	bts->agch_queue.length--;
+	if (msg == bts->agch_queue.rej_open)
+		bts->agch_queue.rej_open = NULL;
 	return msg;
 }
 
+/* Drop the oldest message, no matter which class it is in. Each class keeps a
+ * share of the queue proportional to its arrivals, in particular the rejects,
+ * whose wait indication damps a RACH storm. */
+static void bts_agch_drop(struct gsm_bts *bts)
+{
+	const struct bts_agch_msg_cb *msg_cb, *oldest_cb = NULL;
+	struct msgb *msg;
+	int c, oldest = -1;
+
+	for (c = 0; c < _NUM_BTS_AGCH_CLASS; c++) {
+		if (llist_empty(&bts->agch_queue.queue[c]))
+			continue;
+		msg = llist_first_entry(&bts->agch_queue.queue[c], struct msgb, list);
+		msg_cb = (const struct bts_agch_msg_cb *) msg->cb;
+		if (!oldest_cb || (int32_t)(msg_cb->seq - oldest_cb->seq) < 0) {
+			oldest_cb = msg_cb;
+			oldest = c;
+		}
+	}
+	if (oldest < 0)
+		return;
+	msg = bts_agch_dequeue_class(bts, oldest);
+
+	rsl_tx_delete_ind(bts, msgb_l3(msg), msgb_l3len(msg));
+	rate_ctr_inc2(bts->ctrs, BTS_CTR_AGCH_DELETED);
+	msgb_free(msg);
+
+	bts->agch_queue.dropped_msgs++;
+}
+
 /*
- * Remove lower prio messages if the queue has grown too long.
+ * Remove the oldest messages if the queue has grown too long.
  *
- * \return 0 if the number of messages in the queue would fit into the AGCH
- *         reserved part of the CCCH.
+ * Above the threshold, the drop probability grows linearly from the low to the
+ * high water mark. Instead of rolling the dice for each queued message, the
+ * drop probability is accumulated on every CCCH block and a message is dropped
+ * whenever the sum exceeds 1. Where the probability reaches 1, messages are
+ * dropped until the queue is back below that level.
  */
-static void compact_agch_queue(struct gsm_bts *bts)
+static void bts_agch_red(struct gsm_bts *bts)
 {
-	struct msgb *msg, *msg2;
-	int max_len, slope, offs;
+	int max_len, slope, offs, p_drop;
 	int level_low = bts->agch_queue.low_level;
 	int level_high = bts->agch_queue.high_level;
 	int level_thres = bts->agch_queue.thresh_level;
@@ -702,8 +764,10 @@ static void compact_agch_queue(struct gsm_bts *bts)
 	if (max_len == 0)
 		max_len = 1;
 
-	if (bts->agch_queue.length < max_len * level_thres / 100)
+	if (bts->agch_queue.length < max_len * level_thres / 100) {
+		bts->agch_queue.drop_credit = 0;
 		return;
+	}
 
 	/* p^
 	 * 1+      /'''''
@@ -719,24 +783,98 @@ static void compact_agch_queue(struct gsm_bts *bts)
 	else
 		slope = 0x10000 * max_len; /* p_drop >= 1 if len > offs */
 
-	llist_for_each_entry_safe(msg, msg2, &bts->agch_queue.queue, list) {
-		struct gsm48_imm_ass *imm_ass_cmd = msgb_l3(msg);
-		int p_drop;
-
+	while (bts->agch_queue.length > 0) {
 		p_drop = (bts->agch_queue.length - offs) * slope / max_len;
 
-		if ((random() & 0xffff) >= p_drop)
+		if (p_drop < 0x10000) {
+			if (p_drop > 0)
+				bts->agch_queue.drop_credit += p_drop;
+			if (bts->agch_queue.drop_credit >= 0x10000) {
+				bts->agch_queue.drop_credit -= 0x10000;
+				bts_agch_drop(bts);
+			}
 			return;
+		}
 
-		llist_del(&msg->list);
-		bts->agch_queue.length--;
-		rsl_tx_delete_ind(bts, (uint8_t *)imm_ass_cmd, msgb_l3len(msg));
-		rate_ctr_inc2(bts->ctrs, BTS_CTR_AGCH_DELETED);
-		msgb_free(msg);
+		bts_agch_drop(bts);
+	}
+}
 
-		bts->agch_queue.dropped_msgs++;
+int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg)
+{
+	int hard_limit = 100;
+	struct gsm48_imm_ass_rej *imm_ass_cmd = msgb_l3(msg);
+	struct bts_agch_msg_cb *msg_cb = (struct bts_agch_msg_cb *) msg->cb;
+	enum bts_agch_class agch_class;
+
+	agch_class = bts_agch_msg_class(msg);
+
+	/* Merge rejects into the pending reject that still has free slots, no matter
+	 * where in the queue it is. Rejects to be confirmed towards the PCU are kept
+	 * as they are, the confirmation refers to the message as a whole. This does
+	 * not grow the queue, so it is done even if the queue is full. */
+	if (agch_class == BTS_AGCH_CLASS_REJ && !msg_cb->confirm) {
+		struct msgb *open_msg = bts->agch_queue.rej_open;
+
+		if (open_msg) {
+			if (try_merge_imm_ass_rej(msgb_l3(open_msg), imm_ass_cmd)) {
+				if (!imm_ass_rej_has_room(msgb_l3(open_msg)))
+					bts->agch_queue.rej_open = NULL;
+				bts->agch_queue.merged_msgs++;
+				msgb_free(msg);
+				return 0;
+			}
+			/* the pending reject is full now, msg holds the remainder */
+			bts->agch_queue.rej_open = NULL;
+		}
 	}
-	return;
+
+	if (bts->agch_queue.length > hard_limit) {
+		LOGP(DRR, LOGL_ERROR,
+		     "AGCH: too many messages in queue, "
+		     "refusing message type %s, length = %d/%d\n",
+		     gsm48_rr_msg_name(((struct gsm48_imm_ass *)msgb_l3(msg))->msg_type),
+		     bts->agch_queue.length, bts->agch_queue.max_length);
+
+		bts->agch_queue.rejected_msgs++;
+		return -ENOMEM;
+	}
+
+	if (agch_class == BTS_AGCH_CLASS_REJ && !msg_cb->confirm && imm_ass_rej_has_room(imm_ass_cmd))
+		bts->agch_queue.rej_open = msg;
+
+	msg_cb->seq = bts->agch_queue.seq++;
+	msgb_enqueue(&bts->agch_queue.queue[agch_class], msg);
+	bts->agch_queue.length++;
+
+	return 0;
+}
+
+/* Weighted round robin: each class sends up to its weight of messages in a row
+ * before the next non-empty class gets its turn, so that a steady stream of
+ * assignments cannot starve the rejects. */
+static struct msgb *bts_agch_dequeue(struct gsm_bts *bts)
+{
+	struct msgb *msg;
+	int i;
+
+	if (bts->agch_queue.length == 0)
+		return NULL;
+
+	/* at least one class is not empty, it is found within one round */
+	for (i = 0; i <= _NUM_BTS_AGCH_CLASS; i++) {
+		if (bts->agch_queue.wrr_credit > 0) {
+			msg = bts_agch_dequeue_class(bts, bts->agch_queue.wrr_class);
+			if (msg) {
+				bts->agch_queue.wrr_credit--;
+				return msg;
+			}
+		}
+		bts->agch_queue.wrr_class = (bts->agch_queue.wrr_class + 1) % _NUM_BTS_AGCH_CLASS;
+		bts->agch_queue.wrr_credit = bts_agch_class_weight[bts->agch_queue.wrr_class];
+	}
+
+	return NULL;
 }
 
 int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt, enum ccch_msgt ccch)
@@ -751,7 +889,7 @@ int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt
 	 * the queue max length is calculated based on the CCCH block rate and
 	 * PCH messages also reduce the drain of the AGCH queue.
 	 */
-	compact_agch_queue(bts);
+	bts_agch_red(bts);
 
 	switch (ccch) {
 	case CCCH_MSGT_NCH:
@@ -778,7 +916,7 @@ int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt
 	/* Confirm sending of the AGCH message towards the PCU */
 	msg_cb = (struct bts_agch_msg_cb *) msg->cb;
 	if (msg_cb->confirm)
-		pcu_tx_data_cnf(msg_cb->msg_id, PCU_IF_SAPI_AGCH_2);
+		pcu_tx_data_cnf(bts, msg_cb->msg_id, PCU_IF_SAPI_AGCH_2);
 
 	/* Copy AGCH message */
 	memcpy(out_buf, msgb_l3(msg), msgb_l3len(msg));
@@ -34,8 +34,6 @@
 #include <osmo-bts/oml.h>
 #include <osmo-bts/bts.h>
 
-static struct gsm_bts *g_bts;
-
 CTRL_CMD_DEFINE(therm_att, "thermal-attenuation");
 static int get_therm_att(struct ctrl_cmd *cmd, void *data)
 {
@@ -73,11 +71,35 @@ static int verify_therm_att(struct ctrl_cmd *cmd, const char *value, void *data)
 	return 0;
 }
 
+CTRL_CMD_DEFINE_RO(interf_hist, "interference-histogram");
+static int get_interf_hist(struct ctrl_cmd *cmd, void *data)
+{
+	const struct gsm_bts_trx *trx = cmd->node;
+	unsigned int tn;
+
+	cmd->reply = talloc_strdup(cmd, "");
+	for (tn = 0; tn < ARRAY_SIZE(trx->ts) && cmd->reply; tn++) {
+		const uint32_t *hist = trx->ts[tn].interf_band_hist_last;
+
+		cmd->reply = talloc_asprintf_append(cmd->reply, "%s%u,%u,%u,%u,%u",
+						    tn ? ";" : "", hist[0], hist[1],
+						    hist[2], hist[3], hist[4]);
+	}
+	if (!cmd->reply) {
+		cmd->reply = "OOM";
+		return CTRL_CMD_ERROR;
+	}
+
+	return CTRL_CMD_REPLY;
+}
+
 CTRL_CMD_DEFINE_WO_NOVRF(oml_alert, "oml-alert");
 static int set_oml_alert(struct ctrl_cmd *cmd, void *data)
 {
+	struct gsm_bts *bts = cmd->node;
+
 	/* Note: we expect signal dispatch to be synchronous */
-	oml_tx_failure_event_rep(&g_bts->mo, NM_SEVER_INDETERMINATE, OSMO_EVT_EXT_ALARM, cmd->value);
+	oml_tx_failure_event_rep(&bts->mo, NM_SEVER_INDETERMINATE, OSMO_EVT_EXT_ALARM, cmd->value);
 
 	cmd->reply = "OK";
 
@@ -98,7 +120,9 @@ static int verify_max_ber10k_rach(struct ctrl_cmd *cmd, const char *value, void
 
 static int get_max_ber10k_rach(struct ctrl_cmd *cmd, void *data)
 {
-	cmd->reply = talloc_asprintf(cmd, "%u", g_bts->max_ber10k_rach);
+	const struct gsm_bts *bts = cmd->node;
+
+	cmd->reply = talloc_asprintf(cmd, "%u", bts->max_ber10k_rach);
 	if (!cmd->reply) {
 		cmd->reply = "OOM";
 		return CTRL_CMD_ERROR;
@@ -109,7 +133,9 @@ static int get_max_ber10k_rach(struct ctrl_cmd *cmd, void *data)
 
 static int set_max_ber10k_rach(struct ctrl_cmd *cmd, void *data)
 {
-	g_bts->max_ber10k_rach = atoi(cmd->value);
+	struct gsm_bts *bts = cmd->node;
+
+	bts->max_ber10k_rach = atoi(cmd->value);
 	cmd->reply = "OK";
 	return CTRL_CMD_REPLY;
 }
@@ -121,9 +147,12 @@ int bts_ctrl_cmds_install(struct gsm_bts *bts)
 	int rc = 0;
 
 	rc |= ctrl_cmd_install(CTRL_NODE_TRX, &cmd_therm_att);
+	rc |= ctrl_cmd_install(CTRL_NODE_TRX, &cmd_interf_hist);
+	/* on the root node, these refer to the BTS the interface was set up for */
 	rc |= ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_oml_alert);
 	rc |= ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_max_ber10k_rach);
-	g_bts = bts;
+	rc |= ctrl_cmd_install(CTRL_NODE_BTS, &cmd_oml_alert);
+	rc |= ctrl_cmd_install(CTRL_NODE_BTS, &cmd_max_ber10k_rach);
 
 	return rc;
 }
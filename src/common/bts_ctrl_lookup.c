@@ -29,6 +29,7 @@
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/control_if.h>
 #include <osmo-bts/bts_trx.h>
+#include <osmo-bts/bts_sm.h>
 
 extern vector ctrl_node_vec;
 
@@ -51,8 +52,20 @@ static int bts_ctrl_node_lookup(void *data, vector vline, int *node_type,
 	/* TODO: We need to make sure that the following chars are digits
 	 * and/or use strtol to check if number conversion was successful
 	 * Right now something like net.bts_stats will not work */
-	if (!strcmp(token, "trx")) {
-		if (*node_type != CTRL_NODE_ROOT || !*node_data)
+	if (!strcmp(token, "bts")) {
+		if (*node_type != CTRL_NODE_ROOT)
+			goto err_missing;
+		(*i)++;
+		if (!ctrl_parse_get_num(vline, *i, &num))
+			goto err_index;
+
+		bts = gsm_bts_num(g_bts_sm, num);
+		if (!bts)
+			goto err_missing;
+		*node_data = bts;
+		*node_type = CTRL_NODE_BTS;
+	} else if (!strcmp(token, "trx")) {
+		if ((*node_type != CTRL_NODE_ROOT && *node_type != CTRL_NODE_BTS) || !*node_data)
 			goto err_missing;
 		bts = *node_data;
 		(*i)++;
@@ -164,13 +164,24 @@ static void st_wait_trx_closed(struct osmo_fsm_inst *fi, uint32_t event, void *d
 static void st_exit_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_state)
 {
 	struct gsm_bts *bts = (struct gsm_bts *)fi->priv;
+	struct gsm_bts *other;
 
 	osmo_fsm_inst_dispatch(bts->site_mgr->mo.fi, NM_EV_SHUTDOWN_FINISH, NULL);
 
 	if (bts->shutdown_fi_exit_proc) {
+		/* co-located BTS share the process, the last one to finish exits */
+		llist_for_each_entry(other, &bts->site_mgr->bts_list, list) {
+			if (other != bts && bts_shutdown_in_progress(other)) {
+				other->shutdown_fi_exit_proc = true;
+				LOGPFSML(fi, LOGL_NOTICE, "Shutdown process completed, waiting for bts%u\n",
+					 other->nr);
+				goto done;
+			}
+		}
 		LOGPFSML(fi, LOGL_NOTICE, "Shutdown process completed successfully, exiting process\n");
 		exit(0);
 	}
+done:
 	bts_shutdown_fsm_state_chg(fi, BTS_SHUTDOWN_ST_NONE);
 }
 
@@ -63,6 +63,7 @@ struct gsm_bts_sm *gsm_bts_sm_alloc(void *talloc_ctx)
 	talloc_set_destructor(bts_sm, gsm_bts_sm_talloc_destructor);
 
 	INIT_LLIST_HEAD(&bts_sm->bts_list);
+	osmo_tdefs_reset(abis_T_defs);
 
 	/* NM SITE_MGR */
 	bts_sm->mo.fi = osmo_fsm_inst_alloc(&nm_bts_sm_fsm, bts_sm, bts_sm,
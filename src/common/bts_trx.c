@@ -28,6 +28,7 @@
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/rsl.h>
 #include <osmo-bts/phy_link.h>
+#include <osmo-bts/power_control.h>
 #include <osmo-bts/nm_common_fsm.h>
 
 static int gsm_bts_trx_talloc_destructor(struct gsm_bts_trx *trx)
@@ -49,6 +50,7 @@ static int gsm_bts_trx_talloc_destructor(struct gsm_bts_trx *trx)
 			ts->mo.fi = NULL;
 		}
 	}
+	abis_tx_queue_drop(&trx->bb_transc.rsl.tx_queue);
 	return 0;
 }
 
@@ -165,6 +167,7 @@ struct gsm_bts_trx *gsm_bts_trx_alloc(struct gsm_bts *bts)
 	osmo_fsm_inst_update_id_f(trx->bb_transc.mo.fi, "bts%d-trx%d", bts->nr, trx->nr);
 	gsm_mo_init(&trx->bb_transc.mo, bts, NM_OC_BASEB_TRANSC, bts->nr, trx->nr, 0xff);
 	oml_mo_state_init(&trx->bb_transc.mo, NM_OPSTATE_DISABLED, NM_AVSTATE_NOT_INSTALLED);
+	abis_tx_queue_init(&trx->bb_transc.rsl.tx_queue, bts, &trx->bb_transc.rsl.link);
 
 	gsm_bts_trx_init_ts(trx);
 
@@ -179,6 +182,7 @@ struct gsm_bts_trx *gsm_bts_trx_alloc(struct gsm_bts *bts)
 	/* Default (fall-back) Dynamic Power Control parameters */
 	trx->bs_dpc_params = &bts->bs_dpc_params;
 	trx->ms_dpc_params = &bts->ms_dpc_params;
+	trx->ctrl_batch = lchan_ctrl_batch_alloc(trx);
 
 	/* IF BTS model doesn't DSP/HW support MS Power Control Loop, enable osmo algo by default: */
 	if (!bts_internal_flag_get(trx->bts, BTS_INTERNAL_FLAG_MS_PWR_CTRL_DSP))
@@ -243,6 +247,7 @@ int trx_link_estab(struct gsm_bts_trx *trx)
 			oml_tx_failure_event_rep(&trx->bb_transc.mo, NM_SEVER_MAJOR, OSMO_EVT_MAJ_RSL_FAIL,
 						 "Failed to establish RSL link (%d)", rc);
 	}
+	oml_snapshot_rsl_up(trx);
 	if (trx == trx->bts->c0)
 		load_timer_start(trx->bts);
 
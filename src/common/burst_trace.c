@@ -0,0 +1,182 @@
+/* Binary trace of per-burst scheduler events */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <osmocom/core/talloc.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/scheduler.h>
+#include <osmo-bts/scheduler_backend.h>
+#include <osmo-bts/burst_trace.h>
+
+osmo_static_assert(_TRX_CHAN_MAX <= BURST_TRACE_CHAN_MAX, burst_trace_chan_max);
+
+/* Rendered by osmo-bts-burst-trace, the arguments are always int32_t.
+ * Keep the text in sync with the corresponding log messages. */
+static const char *burst_trace_event_fmts[_BURST_TRACE_EV_MAX] = {
+	[BURST_TRACE_EV_TRXD_RX]	= "Rx UL burst: rssi=%d toa256=%d C/I=%d cB flags=0x%02x",
+	[BURST_TRACE_EV_TRXD_NOPE]	= "Rx NOPE.ind: rssi=%d toa256=%d C/I=%d cB flags=0x%02x",
+	[BURST_TRACE_EV_UL_DATA]	= "Received Data, bid=%u",
+	[BURST_TRACE_EV_UL_TCHF]	= "Received TCH/F, bid=%u",
+	[BURST_TRACE_EV_UL_TCHH]	= "Received TCH/H, bid=%u",
+	[BURST_TRACE_EV_UL_PDTCH]	= "Received PDTCH bid=%u",
+	[BURST_TRACE_EV_UL_RACH]	= "Received RACH (synch_seq=%d): rssi=%d toa256=%d C/I=%d cB",
+	[BURST_TRACE_EV_UL_MASK]	= "UL burst buffer is not filled up: mask=0x%02x",
+	[BURST_TRACE_EV_UL_AMR_DTX]	= "Received AMR DTX frame (rc=%d, BER %d/%d): type=%d",
+	[BURST_TRACE_EV_DL_BURST]	= "Transmitting burst=%u.",
+	[BURST_TRACE_EV_DL_FCCH]	= "Transmitting FCCH",
+	[BURST_TRACE_EV_DL_SCH]		= "Transmitting SCH",
+};
+
+struct burst_trace g_burst_trace;
+
+/*! Start writing trace records into a ring buffer file.
+ *  \param[in] path file to create (or truncate)
+ *  \param[in] num_recs size of the ring, rounded up to a power of two
+ *  \returns 0 on success; negative errno on error */
+int burst_trace_start(const char *path, unsigned int num_recs)
+{
+	struct burst_trace_hdr *hdr;
+	unsigned int i;
+	size_t map_len;
+	void *map;
+	int fd;
+
+	burst_trace_stop();
+
+	num_recs = OSMO_MAX(num_recs, BURST_TRACE_RECS_MIN);
+	num_recs = OSMO_MIN(num_recs, BURST_TRACE_RECS_MAX);
+	/* the position of a record in the ring is derived from its seq */
+	while (num_recs & (num_recs - 1))
+		num_recs += num_recs & -num_recs;
+	map_len = BURST_TRACE_HDR_SIZE + num_recs * sizeof(struct burst_trace_rec);
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0640);
+	if (fd < 0)
+		return -errno;
+	if (ftruncate(fd, map_len) < 0) {
+		close(fd);
+		return -errno;
+	}
+	map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	hdr = map;
+	hdr->rec_size = sizeof(struct burst_trace_rec);
+	hdr->num_recs = num_recs;
+	hdr->head = 0;
+	for (i = 0; i < _TRX_CHAN_MAX; i++)
+		OSMO_STRLCPY_ARRAY(hdr->chan_names[i], trx_chan_desc[i].name);
+	for (i = 0; i < _BURST_TRACE_EV_MAX; i++)
+		OSMO_STRLCPY_ARRAY(hdr->event_fmts[i], burst_trace_event_fmts[i]);
+	/* the decoder refuses files without a magic */
+	memcpy(hdr->magic, BURST_TRACE_MAGIC, sizeof(hdr->magic));
+
+	g_burst_trace.recs = (struct burst_trace_rec *) ((uint8_t *) map + BURST_TRACE_HDR_SIZE);
+	g_burst_trace.num_recs = num_recs;
+	g_burst_trace.map_len = map_len;
+	g_burst_trace.path = talloc_strdup(NULL, path);
+	__atomic_store_n(&g_burst_trace.hdr, hdr, __ATOMIC_SEQ_CST);
+
+	LOGP(DL1C, LOGL_NOTICE, "Burst trace started: %s (%u records)\n", path, num_recs);
+	return 0;
+}
+
+/*! Stop tracing, the file is kept for the decoder.
+ *  Must be called from the main thread (like burst_trace_start()), other
+ *  threads may still be writing records: these are waited for before the
+ *  file is unmapped. */
+void burst_trace_stop(void)
+{
+	struct burst_trace_hdr *hdr = g_burst_trace.hdr;
+
+	if (hdr == NULL)
+		return;
+
+	/* writers that saw hdr registered themselves before, see _burst_trace_put() */
+	__atomic_store_n(&g_burst_trace.hdr, NULL, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&g_burst_trace.num_writers, __ATOMIC_SEQ_CST) != 0)
+		sched_yield();
+
+	LOGP(DL1C, LOGL_NOTICE, "Burst trace stopped: %s (%" PRIu64 " records written)\n",
+	     g_burst_trace.path, hdr->head);
+
+	munmap(hdr, g_burst_trace.map_len);
+	talloc_free(g_burst_trace.path);
+	/* not num_writers: late writers still leave _burst_trace_put() */
+	g_burst_trace.recs = NULL;
+	g_burst_trace.num_recs = 0;
+	g_burst_trace.map_len = 0;
+	g_burst_trace.path = NULL;
+}
+
+/* Lock-free: each writer claims its own slot, so it can be called from any thread */
+void _burst_trace_put(uint8_t trx, uint8_t tn, uint8_t chan, uint32_t fn,
+		      enum burst_trace_event event, int32_t a0, int32_t a1, int32_t a2, int32_t a3)
+{
+	struct burst_trace_hdr *hdr;
+	struct burst_trace_rec *rec;
+	struct timespec ts;
+	uint64_t idx;
+
+	/* keeps burst_trace_stop() from unmapping hdr until we are done with it */
+	__atomic_fetch_add(&g_burst_trace.num_writers, 1, __ATOMIC_SEQ_CST);
+	hdr = __atomic_load_n(&g_burst_trace.hdr, __ATOMIC_SEQ_CST);
+	if (hdr == NULL)
+		goto out;
+
+	/* g_burst_trace is reset by burst_trace_stop(), only rely on the mapping */
+	idx = __atomic_fetch_add(&hdr->head, 1, __ATOMIC_RELAXED);
+	rec = (struct burst_trace_rec *) ((uint8_t *) hdr + BURST_TRACE_HDR_SIZE);
+	rec += idx & (hdr->num_recs - 1);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	/* invalidate the slot while it is being written */
+	__atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	rec->fn = fn;
+	rec->time_us = ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	rec->trx = trx;
+	rec->tn = tn;
+	rec->chan = chan;
+	rec->event = event;
+	rec->arg[0] = a0;
+	rec->arg[1] = a1;
+	rec->arg[2] = a2;
+	rec->arg[3] = a3;
+	__atomic_store_n(&rec->seq, (uint32_t) (idx + 1), __ATOMIC_RELEASE);
+
+out:
+	__atomic_fetch_sub(&g_burst_trace.num_writers, 1, __ATOMIC_RELEASE);
+}
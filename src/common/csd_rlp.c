@@ -40,6 +40,7 @@
 #include <osmo-bts/lchan.h>
 #include <osmo-bts/bts.h>
 #include <osmo-bts/csd_rlp.h>
+#include <osmo-bts/gsmtap_tap.h>
 
 /* In the case of TCH/F4.8 NT, each 240-bit RLP frame is split between
  * two channel-coding blocks of 120 bits each.  We need to know which
@@ -211,9 +212,9 @@ void gsmtap_csd_rlp_process(struct gsm_lchan *lchan, bool is_uplink,
 	if (is_uplink)
 		arfcn |= GSMTAP_ARFCN_F_UPLINK;
 
-	gsmtap_send_ex(inst, GSMTAP_TYPE_GSM_RLP, arfcn, lchan->ts->nr,
-		       lchan->type == GSM_LCHAN_TCH_H ? GSMTAP_CHANNEL_VOICE_H : GSMTAP_CHANNEL_VOICE_F,
-		       lchan->nr, tch_ind->fn, tch_ind->rssi, 0, rlp_buf, byte_len);
+	bts_gsmtap_send(trx->bts, GSMTAP_TYPE_GSM_RLP, arfcn, lchan->ts->nr,
+			lchan->type == GSM_LCHAN_TCH_H ? GSMTAP_CHANNEL_VOICE_H : GSMTAP_CHANNEL_VOICE_F,
+			lchan->nr, tch_ind->fn, tch_ind->rssi, 0, rlp_buf, byte_len);
 
 }
 
@@ -21,6 +21,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <errno.h>
 
 #include <osmocom/core/bits.h>
@@ -79,12 +80,105 @@ static const uint8_t e1e2e3_map[_LCHAN_CSD_M_NUM][3] = {
 #endif
 };
 
+/* ITU-T V.110, Table 5: octet 0 of a frame is all zeros, octets 1..9 start
+ * with a 1 followed by seven bits.  Octet 5 carries E1..E7, the others six
+ * D-bits and an S-/X-bit.  The radio frames carry all of these bits in the
+ * same order, except for the alignment pattern and E1..E3, and 36-bit frames
+ * carry each D-bit once for the two (repeated) ones of a V.110 frame.
+ *
+ * Rather than converting bit by bit through intermediate ubit_t arrays, the
+ * V.110 frames are assembled as octets and RA2 is a table lookup per octet. */
+#define V110_FRAME_OCTETS	10
+#define V110_MAX_FRAMES		4
+#define V110_OCTET_E		5
+
+/* RA2: one V.110 octet to 8 or 4 octets at 64 kbit/s, bit positions not used are 1 */
+static uint8_t ra2_8k_tbl[256][8];
+static uint8_t ra2_16k_tbl[256][4];
+/* the seven bits following the leading 1 of a V.110 octet, unpacked */
+static ubit_t v110_unpack7_tbl[128][7];
+
+static __attribute__((constructor)) void csd_v110_tables_init(void)
+{
+	unsigned int v, i;
+
+	for (v = 0; v < 256; v++) {
+		for (i = 0; i < 8; i++)
+			ra2_8k_tbl[v][i] = 0x7f | (((v >> (7 - i)) & 0x01) << 7);
+		for (i = 0; i < 4; i++)
+			ra2_16k_tbl[v][i] = 0x3f | (((v >> (6 - i * 2)) & 0x03) << 6);
+	}
+
+	for (v = 0; v < 128; v++) {
+		for (i = 0; i < 7; i++)
+			v110_unpack7_tbl[v][i] = (v >> (6 - i)) & 0x01;
+	}
+}
+
+static inline uint8_t pack_bits(const ubit_t *bits, unsigned int num)
+{
+	uint8_t v = 0;
+
+	for (unsigned int i = 0; i < num; i++)
+		v = (v << 1) | bits[i];
+	return v;
+}
+
+/* RA1'/RA1: assemble a V.110 frame from a 60-/36-bit radio frame and E1..E3 */
+static void v110_frame_encode(uint8_t *fr, const ubit_t *bits,
+			      unsigned int num_frame_bits, uint8_t e1e2e3)
+{
+	unsigned int o;
+	uint8_t d;
+
+	fr[0] = 0x00;
+	for (o = 1; o < V110_FRAME_OCTETS; o++) {
+		if (o == V110_OCTET_E) {
+			fr[o] = 0x80 | (e1e2e3 << 4) | pack_bits(bits, 4);
+			bits += 4;
+		} else if (num_frame_bits == 60) {
+			fr[o] = 0x80 | pack_bits(bits, 7);
+			bits += 7;
+		} else { /* num_frame_bits == 36: D-bits are repeated */
+			d = (bits[0] << 1 | bits[0]) << 4 |
+			    (bits[1] << 1 | bits[1]) << 2 |
+			    (bits[2] << 1 | bits[2]);
+			fr[o] = 0x80 | (d << 1) | bits[3];
+			bits += 4;
+		}
+	}
+}
+
+/* RA1'/RA1: extract a 60-/36-bit radio frame from a V.110 frame */
+static void v110_frame_decode(ubit_t *bits, const uint8_t *fr, unsigned int num_frame_bits)
+{
+	const ubit_t *u;
+	unsigned int o;
+
+	for (o = 1; o < V110_FRAME_OCTETS; o++) {
+		u = v110_unpack7_tbl[fr[o] & 0x7f];
+		if (o == V110_OCTET_E) {
+			memcpy(bits, &u[3], 4);
+			bits += 4;
+		} else if (num_frame_bits == 60) {
+			memcpy(bits, &u[0], 7);
+			bits += 7;
+		} else { /* num_frame_bits == 36: take the first of each repeated D-bit */
+			bits[0] = u[0];
+			bits[1] = u[2];
+			bits[2] = u[4];
+			bits[3] = u[6];
+			bits += 4;
+		}
+	}
+}
+
 int csd_v110_rtp_encode(const struct gsm_lchan *lchan, uint8_t *rtp,
 			const uint8_t *data, size_t data_len,
 			uint8_t nt48_half_num)
 {
 	const struct csd_v110_lchan_desc *desc;
-	ubit_t ra_bits[80 * 4];
+	uint8_t fr[V110_MAX_FRAMES * V110_FRAME_OCTETS];
 
 	OSMO_ASSERT(lchan->tch_mode < ARRAY_SIZE(csd_v110_lchan_desc));
 	desc = &csd_v110_lchan_desc[lchan->tch_mode];
@@ -97,6 +191,7 @@ int csd_v110_rtp_encode(const struct gsm_lchan *lchan, uint8_t *rtp,
 		 * 3GPP TS 48.020, chapter 11 "THE RAA' FUNCTION" */
 		const ubit_t *m_bits = &data[0]; /* M-bits */
 		const ubit_t *d_bits = &data[2]; /* D-bits */
+		ubit_t ra_bits[80 * 4];
 		ubit_t c4, c5;
 
 		/* 3GPP TS 48.020, Table 3
@@ -114,79 +209,78 @@ int csd_v110_rtp_encode(const struct gsm_lchan *lchan, uint8_t *rtp,
 		OSMO_ASSERT(data_len == CSD_V110_NUM_BITS(desc));
 
 		osmo_csd144_to_atrau_bits(&ra_bits[0], m_bits, d_bits, c4, c5);
-		goto ra1_ra2;
+
+		/* RA1/RA2: convert from an intermediate rate to 64 kbit/s */
+		osmo_csd_ra2_16k_pack(&rtp[0], &ra_bits[0], RFC4040_RTP_PLEN);
+		return RFC4040_RTP_PLEN;
 	}
 
 	/* handle empty/incomplete Uplink frames gracefully */
 	if (OSMO_UNLIKELY(data_len < CSD_V110_NUM_BITS(desc))) {
 		/* encode N idle frames as per 3GPP TS 44.021, section 8.1.6 */
-		memset(&ra_bits[0], 0x01, sizeof(ra_bits));
+		memset(&fr[0], 0xff, sizeof(fr));
 		for (unsigned int i = 0; i < desc->num_frames; i++)
-			memset(&ra_bits[i * 80], 0x00, 8); /* alignment pattern */
+			fr[i * V110_FRAME_OCTETS] = 0x00; /* alignment pattern */
 		goto ra1_ra2;
 	}
 
 	/* RA1'/RA1: convert from radio rate to an intermediate data rate */
 	for (unsigned int i = 0; i < desc->num_frames; i++) {
-		struct osmo_v110_decoded_frame df;
-
-		/* convert a V.110 36-/60-bit frame to a V.110 80-bit frame */
-		if (desc->num_frame_bits == 60)
-			osmo_csd_12k_6k_decode_frame(&df, &data[i * 60], 60);
-		else /* desc->num_frame_bits == 36 */
-			osmo_csd_3k6_decode_frame(&df, &data[i * 36], 36);
+		uint8_t e1e2e3;
 
 		/* E1 .. E3 must set by out-of-band knowledge */
 		if (lchan->csd_mode == LCHAN_CSD_M_NT) {
 			/* non-transparent: as per 3GPP TS 48.020, Table 7 */
 			/* E1: as per 15.1.2, shall be set to 0 (for BSS-MSC) */
-			df.e_bits[0] = 0;
+			e1e2e3 = 0 << 2;
 			/* E2: 0 for Q1/Q2, 1 for Q3/Q4 */
 			if (desc->num_frames == 4)
-				df.e_bits[1] = (i >> 1) & 0x01;
+				e1e2e3 |= ((i >> 1) & 0x01) << 1;
 			else
-				df.e_bits[1] = nt48_half_num;
+				e1e2e3 |= (nt48_half_num & 0x01) << 1;
 			/* E3: 0 for Q1/Q3, 1 for Q2/Q4 */
-			df.e_bits[2] = (i >> 0) & 0x01;
+			e1e2e3 |= (i >> 0) & 0x01;
 		} else {
 			/* transparent: as per 3GPP TS 44.021, Figure 4 */
-			df.e_bits[0] = e1e2e3_map[lchan->csd_mode][0]; /* E1 */
-			df.e_bits[1] = e1e2e3_map[lchan->csd_mode][1]; /* E2 */
-			df.e_bits[2] = e1e2e3_map[lchan->csd_mode][2]; /* E3 */
+			e1e2e3 = e1e2e3_map[lchan->csd_mode][0] << 2 | /* E1 */
+				 e1e2e3_map[lchan->csd_mode][1] << 1 | /* E2 */
+				 e1e2e3_map[lchan->csd_mode][2] << 0;  /* E3 */
 		}
 
-		osmo_v110_encode_frame(&ra_bits[i * 80], 80, &df);
+		v110_frame_encode(&fr[i * V110_FRAME_OCTETS],
+				  &data[i * desc->num_frame_bits],
+				  desc->num_frame_bits, e1e2e3);
 	}
 
 ra1_ra2:
 	/* RA1/RA2: convert from an intermediate rate to 64 kbit/s */
-	if (desc->ra2_ir == 16)
-		osmo_csd_ra2_16k_pack(&rtp[0], &ra_bits[0], RFC4040_RTP_PLEN);
-	else /* desc->ra2_ir == 8 */
-		osmo_csd_ra2_8k_pack(&rtp[0], &ra_bits[0], RFC4040_RTP_PLEN);
+	if (desc->ra2_ir == 16) {
+		for (unsigned int i = 0; i < RFC4040_RTP_PLEN / 4; i++)
+			memcpy(&rtp[i * 4], ra2_16k_tbl[fr[i]], 4);
+	} else { /* desc->ra2_ir == 8 */
+		for (unsigned int i = 0; i < RFC4040_RTP_PLEN / 8; i++)
+			memcpy(&rtp[i * 8], ra2_8k_tbl[fr[i]], 8);
+	}
 
 	return RFC4040_RTP_PLEN;
 }
 
-static bool check_v110_align(const ubit_t *ra_bits)
+static bool check_v110_align(const uint8_t *fr)
 {
+	uint8_t bit1 = 0x80;
 	int i;
-	ubit_t bit0 = 0, bit1 = 1;
-
-	/* The weird code structure is for performance optimization,
-	 * to avoid conditionals inside loops. */
-	for (i = 0; i < 8; i++)
-		bit0 |= ra_bits[i];
-	for (i = 1; i < 10; i++)
-		bit1 &= ra_bits[i * 8];
-	return (bit0 == 0) && (bit1 == 1);
+
+	/* all zeros in octet 0, a leading 1 in octets 1..9 */
+	for (i = 1; i < V110_FRAME_OCTETS; i++)
+		bit1 &= fr[i];
+	return (fr[0] == 0x00) && (bit1 == 0x80);
 }
 
 int csd_v110_rtp_decode(const struct gsm_lchan *lchan, uint8_t *data,
 			uint8_t *align_bits, const uint8_t *rtp, size_t rtp_len)
 {
 	const struct csd_v110_lchan_desc *desc;
-	ubit_t ra_bits[80 * 4];
+	uint8_t fr[V110_MAX_FRAMES * V110_FRAME_OCTETS];
 	uint8_t align_accum = 0;
 
 	OSMO_ASSERT(lchan->tch_mode < ARRAY_SIZE(csd_v110_lchan_desc));
@@ -197,43 +291,53 @@ int csd_v110_rtp_decode(const struct gsm_lchan *lchan, uint8_t *data,
 	if (OSMO_UNLIKELY(rtp_len != RFC4040_RTP_PLEN))
 		return -EINVAL;
 
-	/* RA1/RA2: convert from 64 kbit/s to an intermediate rate */
-	if (desc->ra2_ir == 16)
-		osmo_csd_ra2_16k_unpack(&ra_bits[0], &rtp[0], RFC4040_RTP_PLEN);
-	else /* desc->ra2_ir == 8 */
-		osmo_csd_ra2_8k_unpack(&ra_bits[0], &rtp[0], RFC4040_RTP_PLEN);
-
 	/* TCH/F14.4 is special: RAA' function is employed */
 	if (lchan->tch_mode == GSM48_CMODE_DATA_14k5) {
 		/* 3GPP TS 44.021, section 10.3 "TCH/F14.4 channel coding"
 		 * 3GPP TS 48.020, chapter 11 "THE RAA' FUNCTION" */
 		ubit_t *m_bits = &data[0]; /* M-bits */
 		ubit_t *d_bits = &data[2]; /* D-bits */
+		ubit_t ra_bits[80 * 4];
 		int rc;
 
+		/* RA1/RA2: convert from 64 kbit/s to an intermediate rate */
+		osmo_csd_ra2_16k_unpack(&ra_bits[0], &rtp[0], RFC4040_RTP_PLEN);
+
 		rc = osmo_csd144_from_atrau_bits(m_bits, d_bits, NULL, NULL, &ra_bits[0]);
 		return rc == 0 ? CSD_V110_NUM_BITS(desc) : rc;
 	}
 
+	/* RA1/RA2: convert from 64 kbit/s to an intermediate rate */
+	if (desc->ra2_ir == 16) {
+		for (unsigned int i = 0; i < RFC4040_RTP_PLEN / 4; i++) {
+			const uint8_t *p = &rtp[i * 4];
+			fr[i] = (p[0] & 0xc0) | (p[1] & 0xc0) >> 2 |
+				(p[2] & 0xc0) >> 4 | (p[3] & 0xc0) >> 6;
+		}
+	} else { /* desc->ra2_ir == 8 */
+		for (unsigned int i = 0; i < RFC4040_RTP_PLEN / 8; i++) {
+			const uint8_t *p = &rtp[i * 8];
+			fr[i] = (p[0] & 0x80) | (p[1] & 0x80) >> 1 |
+				(p[2] & 0x80) >> 2 | (p[3] & 0x80) >> 3 |
+				(p[4] & 0x80) >> 4 | (p[5] & 0x80) >> 5 |
+				(p[6] & 0x80) >> 6 | (p[7] & 0x80) >> 7;
+		}
+	}
+
 	/* RA1'/RA1: convert from an intermediate rate to radio rate */
 	for (unsigned int i = 0; i < desc->num_frames; i++) {
-		struct osmo_v110_decoded_frame df;
+		const uint8_t *v110 = &fr[i * V110_FRAME_OCTETS];
 
 		/* We require our RTP input to consist of aligned V.110
 		 * frames.  If we get misaligned input, let's catch it
 		 * explicitly, rather than send garbage downstream. */
-		if (!check_v110_align(&ra_bits[i * 80]))
+		if (!check_v110_align(v110))
 			return -EINVAL;
 		/* convert a V.110 80-bit frame to a V.110 36-/60-bit frame */
-		osmo_v110_decode_frame(&df, &ra_bits[i * 80], 80);
-		if (desc->num_frame_bits == 60)
-			osmo_csd_12k_6k_encode_frame(&data[i * 60], 60, &df);
-		else /* desc->num_frame_bits == 36 */
-			osmo_csd_3k6_encode_frame(&data[i * 36], 36, &df);
+		v110_frame_decode(&data[i * desc->num_frame_bits], v110, desc->num_frame_bits);
 		/* save bits E2 & E3 that may be needed for RLP alignment */
 		align_accum <<= 2;
-		align_accum |= df.e_bits[1] << 1;
-		align_accum |= df.e_bits[2] << 0;
+		align_accum |= (v110[V110_OCTET_E] >> 4) & 0x03;
 	}
 
 	if (align_bits)
@@ -456,6 +456,119 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 	},
 };
 
+/* The actions above as a table, see dtx_dl_amr_fsm_next().  Keep in sync. */
+const struct dtx_dl_amr_trans dtx_dl_amr_fsm_trans[_ST_DTX_DL_AMR_NUM] = {
+	[ST_VOICE] = {
+		.in_event_mask = X(E_SID_F) | X(E_SID_U) | X(E_VOICE) | X(E_FACCH) | X(E_INHIB),
+		.next_state = {
+			[E_VOICE] = ST_VOICE,
+			[E_FACCH] = ST_VOICE,
+			[E_SID_F] = ST_SID_F1,
+			[E_SID_U] = ST_U_NOINH,
+			[E_INHIB] = ST_F1_INH_V,
+		},
+	},
+	[ST_SID_F1] = {
+		.in_event_mask = X(E_SID_F) | X(E_SID_U) | X(E_FACCH) | X(E_FIRST) | X(E_ONSET),
+		.next_state = {
+			[E_SID_F] = ST_SID_F1,
+			[E_SID_U] = ST_U_NOINH,
+			/* dtx_fsm_sid_f1() asks for ST_F1_INH_F, which is
+			 * not in .out_state_mask, so the state is kept */
+			[E_FACCH] = ST_SID_F1,
+			[E_FIRST] = ST_SID_F2,
+			[E_ONSET] = ST_ONSET_V,
+		},
+	},
+	[ST_SID_F2] = {
+		.in_event_mask = X(E_COMPL) | X(E_FACCH) | X(E_ONSET),
+		.next_state = {
+			[E_COMPL] = ST_U_NOINH,
+			[E_FACCH] = ST_ONSET_F,
+			[E_ONSET] = ST_ONSET_V,
+		},
+	},
+	[ST_F1_INH_V] = {
+		.in_event_mask = X(E_COMPL),
+		.next_state = { [E_COMPL] = ST_F1_INH_V_REC },
+	},
+	[ST_F1_INH_F] = {
+		.in_event_mask = X(E_COMPL),
+		.next_state = { [E_COMPL] = ST_F1_INH_F_REC },
+	},
+	[ST_U_INH_V] = {
+		.in_event_mask = X(E_COMPL),
+		.next_state = { [E_COMPL] = ST_U_INH_V_REC },
+	},
+	[ST_U_INH_F] = {
+		.in_event_mask = X(E_COMPL),
+		.next_state = { [E_COMPL] = ST_U_INH_F_REC },
+	},
+	[ST_U_NOINH] = {
+		.in_event_mask = X(E_FACCH) | X(E_VOICE) | X(E_COMPL) | X(E_SID_U) | X(E_SID_F) | X(E_ONSET),
+		.next_state = {
+			[E_FACCH] = ST_ONSET_F,
+			[E_VOICE] = ST_VOICE,
+			[E_COMPL] = ST_SID_U,
+			[E_SID_U] = ST_U_NOINH,
+			[E_SID_F] = ST_U_NOINH,
+			[E_ONSET] = ST_ONSET_V,
+		},
+	},
+	[ST_F1_INH_V_REC] = {
+		.in_event_mask = X(E_COMPL) | X(E_VOICE),
+		.next_state = { [E_COMPL] = ST_VOICE, [E_VOICE] = ST_VOICE },
+	},
+	[ST_F1_INH_F_REC] = {
+		.in_event_mask = X(E_COMPL) | X(E_FACCH),
+		.next_state = { [E_COMPL] = ST_FACCH, [E_FACCH] = ST_FACCH },
+	},
+	[ST_U_INH_V_REC] = {
+		.in_event_mask = X(E_COMPL) | X(E_VOICE),
+		.next_state = { [E_COMPL] = ST_VOICE, [E_VOICE] = ST_VOICE },
+	},
+	[ST_U_INH_F_REC] = {
+		.in_event_mask = X(E_COMPL) | X(E_FACCH),
+		.next_state = { [E_COMPL] = ST_FACCH, [E_FACCH] = ST_FACCH },
+	},
+	[ST_SID_U] = {
+		.in_event_mask = X(E_FACCH) | X(E_VOICE) | X(E_INHIB) | X(E_SID_U) | X(E_SID_F),
+		.next_state = {
+			[E_FACCH] = ST_U_INH_F,
+			[E_VOICE] = ST_VOICE,
+			[E_INHIB] = ST_U_INH_V,
+			[E_SID_U] = ST_U_NOINH,
+			[E_SID_F] = ST_U_NOINH,
+		},
+	},
+	[ST_ONSET_V] = {
+		.in_event_mask = X(E_COMPL),
+		.next_state = { [E_COMPL] = ST_ONSET_V_REC },
+	},
+	[ST_ONSET_F] = {
+		.in_event_mask = X(E_COMPL),
+		.next_state = { [E_COMPL] = ST_ONSET_F_REC },
+	},
+	[ST_ONSET_V_REC] = {
+		.in_event_mask = X(E_COMPL),
+		.next_state = { [E_COMPL] = ST_VOICE },
+	},
+	[ST_ONSET_F_REC] = {
+		.in_event_mask = X(E_COMPL),
+		.next_state = { [E_COMPL] = ST_FACCH },
+	},
+	[ST_FACCH] = {
+		.in_event_mask = X(E_FACCH) | X(E_VOICE) | X(E_COMPL) | X(E_SID_U) | X(E_SID_F),
+		.next_state = {
+			[E_SID_U] = ST_FACCH,
+			[E_SID_F] = ST_FACCH,
+			[E_FACCH] = ST_FACCH,
+			[E_VOICE] = ST_VOICE,
+			[E_COMPL] = ST_SID_F1,
+		},
+	},
+};
+
 const struct value_string dtx_dl_amr_fsm_event_names[] = {
 	{ E_VOICE,	"Voice" },
 	{ E_ONSET,	"ONSET" },
@@ -468,6 +581,8 @@ const struct value_string dtx_dl_amr_fsm_event_names[] = {
 	{ 0, 		NULL }
 };
 
+/* Only instantiated to mirror lchan->tch.dtx.dl_amr_state while DL1C is
+ * logged at DEBUG level, see dtx_dl_amr_dispatch() */
 struct osmo_fsm dtx_dl_amr_fsm = {
 	.name = "DTX_DL_AMR_FSM",
 	.states = dtx_dl_amr_fsm_states,
@@ -41,6 +41,7 @@
 #include <osmo-bts/logging.h>
 
 struct osmo_tdef_group bts_tdef_groups[] = {
+	/* .tdefs of "bts" is pointed at the copy of BTS 0 by gsm_bts_alloc() */
 	{ .name = "bts", .tdefs = bts_T_defs, .desc = "BTS process timers" },
 	{ .name = "abis", .tdefs = abis_T_defs, .desc = "Abis (RSL) related timers" },
 	{}
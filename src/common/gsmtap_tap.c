@@ -0,0 +1,254 @@
+/* gsmtap_tap.c: Asynchronous GSMTAP output, decoupled from the RT path */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
+
+#include <osmo-bts/bts.h>
+#include <osmo-bts/gsmtap_tap.h>
+
+static unsigned int gsmtap_tap_fill(const struct gsmtap_tap *tap, uint32_t tail, unsigned int num,
+				    struct gsmtap_hdr *hdr, struct iovec (*iov)[2], struct mmsghdr *mmsg)
+{
+	const struct gsmtap_tap_entry *e;
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		e = &tap->ring[(tail + i) & (tap->size - 1)];
+		hdr[i] = (struct gsmtap_hdr) {
+			.version = GSMTAP_VERSION,
+			.hdr_len = sizeof(struct gsmtap_hdr) / 4,
+			.type = e->type,
+			.timeslot = e->ts,
+			.arfcn = htons(e->arfcn),
+			.signal_dbm = e->signal_dbm,
+			.snr_db = e->snr,
+			.frame_number = htonl(e->fn),
+			.sub_type = e->chan_type,
+			.sub_slot = e->ss,
+		};
+		iov[i][0] = (struct iovec) { .iov_base = &hdr[i], .iov_len = sizeof(hdr[i]) };
+		iov[i][1] = (struct iovec) { .iov_base = (void *) e->data, .iov_len = e->len };
+		mmsg[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_iov = iov[i],
+				.msg_iovlen = 2,
+			},
+		};
+	}
+
+	return num;
+}
+
+static void *gsmtap_tap_thread(void *data)
+{
+	struct gsmtap_tap *tap = data;
+	struct gsmtap_hdr hdr[GSMTAP_TAP_BATCH_MAX];
+	struct iovec iov[GSMTAP_TAP_BATCH_MAX][2];
+	struct mmsghdr mmsg[GSMTAP_TAP_BATCH_MAX];
+	uint32_t head, tail = tap->tail;
+	unsigned int num;
+	uint64_t val;
+	int rc;
+
+	while (1) {
+		head = __atomic_load_n(&tap->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			if (__atomic_load_n(&tap->stop, __ATOMIC_ACQUIRE))
+				break;
+			/* announce that we are going to sleep, then check once more
+			 * so that a frame queued meanwhile is not left behind */
+			__atomic_store_n(&tap->sleeping, true, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&tap->head, __ATOMIC_SEQ_CST) == tail &&
+			    !__atomic_load_n(&tap->stop, __ATOMIC_SEQ_CST)) {
+				if (read(tap->efd, &val, sizeof(val)) < 0 && errno != EINTR)
+					break;
+			}
+			__atomic_store_n(&tap->sleeping, false, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		num = gsmtap_tap_fill(tap, tail, OSMO_MIN(head - tail, GSMTAP_TAP_BATCH_MAX), hdr, iov, mmsg);
+		rc = sendmmsg(tap->fd, mmsg, num, 0);
+		if (rc < 0)
+			rc = 0;
+		__atomic_add_fetch(&tap->sent, rc, __ATOMIC_RELAXED);
+		if (rc < num)
+			__atomic_add_fetch(&tap->send_err, num - rc, __ATOMIC_RELAXED);
+
+		/* the entries may be reused by the producer from now on */
+		tail += num;
+		__atomic_store_n(&tap->tail, tail, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+static int gsmtap_tap_talloc_destructor(struct gsmtap_tap *tap)
+{
+	uint64_t val = 1;
+
+	if (tap->running) {
+		/* the writer checks the flag before it goes to sleep, wake it up
+		 * in case it is asleep already */
+		__atomic_store_n(&tap->stop, true, __ATOMIC_SEQ_CST);
+		while (write(tap->efd, &val, sizeof(val)) < 0) {
+			if (errno == EINTR)
+				continue;
+			/* it would never wake up, and must not outlive the ring */
+			LOGP(DLGLOBAL, LOGL_ERROR, "Failed to wake up the GSMTAP writer (%s), cancelling it\n",
+			     strerror(errno));
+			pthread_cancel(tap->thread);
+			break;
+		}
+		pthread_join(tap->thread, NULL);
+		tap->running = false;
+	}
+	close(tap->efd);
+	return 0;
+}
+
+/*! Allocate a GSMTAP tap sending on an already connected socket.
+ *  \param[in] ctx talloc context
+ *  \param[in] fd connected GSMTAP socket, e.g. gsmtap_inst_fd2()
+ *  \param[in] size number of ring entries, power of two
+ *  \returns tap on success; NULL on error. Frames are queued, but only
+ *  sent once gsmtap_tap_start() was called. */
+struct gsmtap_tap *gsmtap_tap_alloc(void *ctx, int fd, uint32_t size)
+{
+	struct gsmtap_tap *tap;
+
+	if (size == 0 || (size & (size - 1)))
+		return NULL;
+
+	tap = talloc_zero(ctx, struct gsmtap_tap);
+	if (!tap)
+		return NULL;
+
+	tap->fd = fd;
+	tap->size = size;
+	tap->ring = talloc_array(tap, struct gsmtap_tap_entry, size);
+	tap->efd = eventfd(0, EFD_CLOEXEC);
+	if (!tap->ring || tap->efd < 0) {
+		talloc_free(tap);
+		return NULL;
+	}
+	talloc_set_destructor(tap, gsmtap_tap_talloc_destructor);
+
+	return tap;
+}
+
+/*! Start the writer thread of a tap.
+ *  \returns 0 on success; negative errno on error */
+int gsmtap_tap_start(struct gsmtap_tap *tap)
+{
+	int rc;
+
+	rc = pthread_create(&tap->thread, NULL, gsmtap_tap_thread, tap);
+	if (rc != 0)
+		return -rc;
+	pthread_setname_np(tap->thread, "gsmtap_tap");
+	tap->running = true;
+
+	return 0;
+}
+
+/*! Stop the writer thread after it sent all queued frames, and free the tap */
+void gsmtap_tap_free(struct gsmtap_tap *tap)
+{
+	talloc_free(tap);
+}
+
+/*! Queue a frame for the writer thread, never blocks.
+ *  \returns 0 on success; -ENOBUFS if the ring is full; -EMSGSIZE if the frame is too big */
+int gsmtap_tap_send(struct gsmtap_tap *tap, uint8_t type, uint16_t arfcn, uint8_t ts,
+		    uint8_t chan_type, uint8_t ss, uint32_t fn, int8_t signal_dbm,
+		    uint8_t snr, const uint8_t *data, unsigned int len)
+{
+	struct gsmtap_tap_entry *e;
+	uint32_t head = tap->head;
+	uint64_t val = 1;
+
+	if (len > GSMTAP_TAP_DATA_MAX)
+		return -EMSGSIZE;
+	if (head - __atomic_load_n(&tap->tail, __ATOMIC_ACQUIRE) >= tap->size)
+		return -ENOBUFS;
+
+	e = &tap->ring[head & (tap->size - 1)];
+	e->fn = fn;
+	e->arfcn = arfcn;
+	e->len = len;
+	e->type = type;
+	e->ts = ts;
+	e->chan_type = chan_type;
+	e->ss = ss;
+	e->signal_dbm = signal_dbm;
+	e->snr = snr;
+	memcpy(e->data, data, len);
+
+	__atomic_store_n(&tap->head, head + 1, __ATOMIC_SEQ_CST);
+
+	/* only wake up the writer if it went to sleep, i.e. at most once per batch */
+	if (__atomic_exchange_n(&tap->sleeping, false, __ATOMIC_SEQ_CST)) {
+		if (write(tap->efd, &val, sizeof(val)) < 0)
+			return -errno;
+	}
+
+	return 0;
+}
+
+/*! Send a frame via GSMTAP of a BTS, through its tap if there is one.
+ *  Frames the tap can not take or failed to send are counted, not waited for. */
+int bts_gsmtap_send(struct gsm_bts *bts, uint8_t type, uint16_t arfcn, uint8_t ts,
+		    uint8_t chan_type, uint8_t ss, uint32_t fn, int8_t signal_dbm,
+		    uint8_t snr, const uint8_t *data, unsigned int len)
+{
+	struct gsmtap_tap *tap = bts->gsmtap.tap;
+	uint64_t send_err;
+	int rc;
+
+	if (!tap)
+		return gsmtap_send_ex(bts->gsmtap.inst, type, arfcn, ts, chan_type, ss, fn,
+				      signal_dbm, snr, data, len);
+
+	if (__atomic_load_n(&tap->send_err, __ATOMIC_RELAXED)) {
+		send_err = __atomic_exchange_n(&tap->send_err, 0, __ATOMIC_RELAXED);
+		rate_ctr_add2(bts->ctrs, BTS_CTR_GSMTAP_DROP, send_err);
+	}
+
+	rc = gsmtap_tap_send(tap, type, arfcn, ts, chan_type, ss, fn, signal_dbm, snr, data, len);
+	if (rc < 0)
+		rate_ctr_inc2(bts->ctrs, BTS_CTR_GSMTAP_DROP);
+
+	return rc;
+}
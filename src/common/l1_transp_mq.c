@@ -0,0 +1,246 @@
+/* l1_transp_mq.c: Message queue transport towards the DSP of sysmoBTS,
+ * Litecell 1.5 and OC-2G */
+
+/* (C) 2011 by Harald Welte <laforge@gnumonks.org>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/uio.h>
+
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/l1_transp_mq.h>
+
+static struct msgb *l1_mq_rx_msgb_alloc(const struct l1_mq_rx *rx)
+{
+	struct msgb *msg = msgb_alloc_headroom(rx->prim_size + 128, 128, "l1_mq_rx");
+
+	if (msg)
+		msg->l1h = msg->data;
+	return msg;
+}
+
+/* Read as many primitives as the current batch size permits. The receive
+ * buffers are kept across calls, only those handed to the rx_cb are replaced. */
+static int l1_mq_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct l1_mq_rx *rx = container_of(ofd, struct l1_mq_rx, ofd);
+	struct iovec iov[L1_MQ_RX_BATCH_MAX];
+	unsigned int i, num, count;
+	struct msgb *msg;
+	ssize_t rc;
+
+	for (num = 0; num < rx->batch; num++) {
+		if (!rx->msg[num]) {
+			rx->msg[num] = l1_mq_rx_msgb_alloc(rx);
+			if (!rx->msg[num])
+				break;
+		}
+		iov[num].iov_base = rx->msg[num]->l1h;
+		iov[num].iov_len = rx->prim_size;
+	}
+	if (num == 0)
+		return -ENOMEM;
+
+	rc = readv(ofd->fd, iov, num);
+	if (rc < 0) {
+		if (errno != EAGAIN)
+			LOGP(DL1C, LOGL_ERROR, "failed to read from fd: %s\n", strerror(errno));
+		return 0;
+	}
+	count = rc / rx->prim_size;
+
+	/* Grow the batch while the queue fills it, shrink it again once
+	 * the queue runs dry, so that idle reads do not prepare idle buffers. */
+	if (count == num && rx->batch < L1_MQ_RX_BATCH_MAX)
+		rx->batch++;
+	else if (count <= rx->batch / 2 && rx->batch > L1_MQ_RX_BATCH_MIN)
+		rx->batch--;
+
+	for (i = 0; i < count; i++) {
+		msg = rx->msg[i];
+		rx->msg[i] = NULL;
+		msgb_put(msg, rx->prim_size);
+		rx->rx_cb(ofd->data, msg, ofd->priv_nr);
+	}
+
+	return 0;
+}
+
+/* Write all queued primitives (up to L1_MQ_TX_BATCH_MAX) with a single writev(),
+ * primitives may differ in length, e.g. when forwarded by the l1fwd-proxy. */
+static int l1_mq_write_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct osmo_wqueue *queue = container_of(ofd, struct osmo_wqueue, bfd);
+	struct iovec iov[L1_MQ_TX_BATCH_MAX];
+	struct msgb *msg, *tmp;
+	unsigned int count = 0;
+	ssize_t written;
+	size_t len;
+
+	if (!(what & OSMO_FD_WRITE))
+		return 0;
+
+	osmo_fd_write_disable(ofd);
+
+	llist_for_each_entry(msg, &queue->msg_queue, list) {
+		if (count >= ARRAY_SIZE(iov))
+			break;
+		iov[count].iov_base = msg->l1h;
+		iov[count].iov_len = msgb_l1len(msg);
+		count++;
+	}
+
+	/* Nothing scheduled? This should not happen. */
+	if (count == 0)
+		return 0;
+
+	written = writev(ofd->fd, iov, count);
+	if (written < 0) {
+		if (errno != EAGAIN)
+			LOGP(DL1C, LOGL_ERROR, "error writing to L1 msg_queue: %s\n", strerror(errno));
+		osmo_fd_write_enable(ofd);
+		return 0;
+	}
+
+	/* now delete the written entries */
+	llist_for_each_entry_safe(msg, tmp, &queue->msg_queue, list) {
+		if (written == 0)
+			break;
+
+		len = msgb_l1len(msg);
+		if ((size_t) written < len) {
+			/* the message queue is record based, the remainder can not be resent */
+			LOGP(DL1C, LOGL_ERROR, "short write to L1 msg_queue: %zd < %zu\n", written, len);
+			written = 0;
+		} else {
+			written -= len;
+		}
+
+		queue->current_length--;
+		llist_del(&msg->list);
+		msgb_free(msg);
+	}
+
+	if (!llist_empty(&queue->msg_queue))
+		osmo_fd_write_enable(ofd);
+
+	return 0;
+}
+
+/*! Set up the transport on already opened file descriptors.
+ *  \param[in] rx read side of the message queue
+ *  \param[in] wq write queue of the message queue
+ *  \param[in] queue queue number, passed to rx_cb
+ *  \param[in] rd_fd file descriptor to read primitives from
+ *  \param[in] wr_fd file descriptor to write primitives to
+ *  \param[in] wq_len maximum number of queued primitives
+ *  \param[in] prim_size size of the primitives read from rd_fd
+ *  \param[in] rx_cb called for each primitive read
+ *  \param[in] data opaque pointer passed to rx_cb
+ *  \returns 0 on success; negative on error */
+int l1_mq_setup(struct l1_mq_rx *rx, struct osmo_wqueue *wq, int queue,
+		int rd_fd, int wr_fd, unsigned int wq_len,
+		uint32_t prim_size, l1_mq_rx_cb_t *rx_cb, void *data)
+{
+	int rc;
+
+	memset(rx, 0, sizeof(*rx));
+	rx->prim_size = prim_size;
+	rx->batch = L1_MQ_RX_BATCH_INIT;
+	rx->rx_cb = rx_cb;
+
+	osmo_fd_setup(&rx->ofd, rd_fd, OSMO_FD_READ, l1_mq_read_cb, data, queue);
+	rc = osmo_fd_register(&rx->ofd);
+	if (rc < 0)
+		return rc;
+
+	osmo_wqueue_init(wq, wq_len);
+	osmo_fd_setup(&wq->bfd, wr_fd, OSMO_FD_WRITE, l1_mq_write_cb, data, queue);
+	rc = osmo_fd_register(&wq->bfd);
+	if (rc < 0) {
+		osmo_fd_unregister(&rx->ofd);
+		return rc;
+	}
+
+	return 0;
+}
+
+/*! Open the DSP message queue devices and set up the transport on them.
+ *  \returns 0 on success; negative on error */
+int l1_mq_open(struct l1_mq_rx *rx, struct osmo_wqueue *wq, int queue,
+	       const char *rd_path, const char *wr_path,
+	       uint32_t prim_size, l1_mq_rx_cb_t *rx_cb, void *data)
+{
+	int rd_fd, wr_fd, rc;
+
+	rd_fd = open(rd_path, O_RDONLY);
+	if (rd_fd < 0) {
+		LOGP(DL1C, LOGL_FATAL, "[%d] unable to open %s for reading: %s\n",
+		     queue, rd_path, strerror(errno));
+		return rd_fd;
+	}
+
+	wr_fd = open(wr_path, O_WRONLY);
+	if (wr_fd < 0) {
+		LOGP(DL1C, LOGL_FATAL, "[%d] unable to open %s for writing: %s\n",
+		     queue, wr_path, strerror(errno));
+		close(rd_fd);
+		return wr_fd;
+	}
+
+	rc = l1_mq_setup(rx, wq, queue, rd_fd, wr_fd, 10, prim_size, rx_cb, data);
+	if (rc < 0) {
+		close(rd_fd);
+		close(wr_fd);
+		rx->ofd.fd = -1;
+		wq->bfd.fd = -1;
+		return rc;
+	}
+
+	return 0;
+}
+
+/*! Close both directions of the message queue and release all buffers */
+void l1_mq_close(struct l1_mq_rx *rx, struct osmo_wqueue *wq)
+{
+	unsigned int i;
+
+	osmo_fd_unregister(&rx->ofd);
+	close(rx->ofd.fd);
+	rx->ofd.fd = -1;
+
+	for (i = 0; i < ARRAY_SIZE(rx->msg); i++) {
+		if (!rx->msg[i])
+			continue;
+		msgb_free(rx->msg[i]);
+		rx->msg[i] = NULL;
+	}
+
+	osmo_fd_unregister(&wq->bfd);
+	close(wq->bfd.fd);
+	wq->bfd.fd = -1;
+
+	osmo_wqueue_clear(wq);
+}
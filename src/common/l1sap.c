@@ -62,6 +62,7 @@
 #include <osmo-bts/asci.h>
 #include <osmo-bts/csd_rlp.h>
 #include <osmo-bts/csd_v110.h>
+#include <osmo-bts/gsmtap_tap.h>
 
 /* determine the CCCH block number based on the frame number */
 unsigned int l1sap_fn2ccch_block(uint32_t fn)
@@ -512,8 +513,8 @@ static int to_gsmtap(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 	if (is_fill_frame(chan_type, data, len))
 		return 0;
 
-	gsmtap_send(inst, trx->arfcn | uplink, tn, chan_type, ss, fn,
-		    signal_dbm, 0 /* TODO: SNR */, data, len);
+	bts_gsmtap_send(trx->bts, GSMTAP_TYPE_UM, trx->arfcn | uplink, tn, chan_type, ss, fn,
+			signal_dbm, 0 /* TODO: SNR */, data, len);
 
 	return 0;
 }
@@ -558,13 +559,24 @@ static unsigned int calc_exprd_rach_frames(struct gsm_bts *bts, uint32_t fn)
 	return rach_frames_expired;
 }
 
-static void l1sap_interf_meas_calc_avg(struct gsm_bts_trx *trx)
+/* Unchanged interference levels are not reported again, except every this many Intave periods */
+#define INTERF_REPORT_REFRESH	8
+
+/* Flags returned by l1sap_interf_meas_calc_avg() */
+#define INTERF_CHG_RSL		(1 << 0)	/* band of any lchan */
+#define INTERF_CHG_PCU		(1 << 1)	/* level of any PDCH */
+
+static unsigned int l1sap_interf_meas_calc_avg(struct gsm_bts_trx *trx)
 {
-	unsigned int tn, ln;
+	unsigned int tn, ln, chg = 0;
 
 	for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
 		struct gsm_bts_trx_ts *ts = &trx->ts[tn];
 
+		memcpy(ts->interf_band_hist_last, ts->interf_band_hist,
+		       sizeof(ts->interf_band_hist_last));
+		memset(ts->interf_band_hist, 0, sizeof(ts->interf_band_hist));
+
 		if (ts->mo.nm_state.operational != NM_OPSTATE_ENABLED)
 			continue;
 		if (ts->mo.nm_state.availability != NM_AVSTATE_OK)
@@ -572,24 +584,34 @@ static void l1sap_interf_meas_calc_avg(struct gsm_bts_trx *trx)
 
 		for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
 			struct gsm_lchan *lchan = &ts->lchan[ln];
+			const int16_t avg_dbm = lchan->meas.interf_meas_avg_dbm;
+			const uint8_t band = lchan->meas.interf_band;
 
 			lchan->meas.interf_meas_avg_dbm = 0;
 			lchan->meas.interf_band = 0;
 
-			/* There must be at least one sample */
-			if (lchan->meas.interf_meas_num == 0)
-				continue;
-
-			/* Average all collected samples */
-			gsm_lchan_interf_meas_calc_avg(lchan);
+			/* Average all collected samples, if any */
+			if (lchan->meas.interf_meas_num > 0)
+				gsm_lchan_interf_meas_calc_avg(lchan);
+
+			if (lchan->meas.interf_band != band ||
+			    (lchan->meas.interf_meas_avg_dbm == 0) != (avg_dbm == 0))
+				chg |= INTERF_CHG_RSL;
+			/* PCUIF carries the level of the first lchan of PDCHs only */
+			if (ln == 0 && ts_pchan(ts) == GSM_PCHAN_PDCH &&
+			    lchan->meas.interf_meas_avg_dbm != avg_dbm)
+				chg |= INTERF_CHG_PCU;
 		}
 	}
+
+	return chg;
 }
 
 static void l1sap_interf_meas_report(struct gsm_bts *bts)
 {
 	const uint32_t period = bts->interference.intave * 104;
 	struct gsm_bts_trx *trx;
+	unsigned int chg;
 
 	if (bts->interference.intave == 0)
 		return;
@@ -601,11 +623,18 @@ static void l1sap_interf_meas_report(struct gsm_bts *bts)
 		    trx->bb_transc.mo.nm_state.operational != NM_OPSTATE_ENABLED)
 			continue;
 		/* Calculate the average of all received samples */
-		l1sap_interf_meas_calc_avg(trx);
+		chg = l1sap_interf_meas_calc_avg(trx);
+
 		/* Report to the BSC over the A-bis/RSL */
-		rsl_tx_rf_res(trx);
+		if (chg & INTERF_CHG_RSL || ++trx->interf_report.rsl_age >= INTERF_REPORT_REFRESH) {
+			rsl_tx_rf_res(trx);
+			trx->interf_report.rsl_age = 0;
+		}
 		/* Report to the PCU over the PCUIF */
-		pcu_tx_interf_ind(trx, bts->gsm_time.fn);
+		if (chg & INTERF_CHG_PCU || ++trx->interf_report.pcu_age >= INTERF_REPORT_REFRESH) {
+			pcu_tx_interf_ind(trx, bts->gsm_time.fn);
+			trx->interf_report.pcu_age = 0;
+		}
 	}
 }
 
@@ -632,7 +661,7 @@ static int l1sap_info_time_ind(struct gsm_bts *bts,
 	gsm_fn2gsmtime(&bts->gsm_time, info_time_ind->fn);
 
 	/* Update time on PCU interface */
-	pcu_tx_time_ind(info_time_ind->fn);
+	pcu_tx_time_ind(bts, info_time_ind->fn);
 
 	/* increment number of RACH slots that have passed by since the
 	 * last time indication */
@@ -907,28 +936,14 @@ static int lchan_pdtch_ph_rts_ind_loop(struct gsm_lchan *lchan,
 }
 
 /* Check if given CCCH frame number is for a NCH, PCH or for an AGCH (this function is
- * only used internally, it is public to call it from unit-tests) */
+ * only used internally, it is public to call it from unit-tests), see bts_sysinfo_sched_update() */
 enum ccch_msgt get_ccch_msgt(struct gsm_bts_trx *trx, uint32_t fn)
 {
-	uint8_t block, first_block, num_blocks;
-	int rc;
-
-	block = l1sap_fn2ccch_block(fn);
-
-	/* If there is an NCH, check if the block number matches. It has priority over PCH/AGCH. */
-	if (trx->bts->asci.pos_nch >= 0) {
-		rc = osmo_gsm48_si1ro_nch_pos_decode(trx->bts->asci.pos_nch, &num_blocks, &first_block);
-		if (rc >= 0 && block >= first_block && block < first_block + num_blocks)
-			return CCCH_MSGT_NCH;
-	}
+	int8_t msgt = trx->bts->si.ccch_msgt[fn % 51];
 
-	/* Note: The number of available access grant channels is set by the
-	 * parameter BS_AG_BLKS_RES via system information type 3. This SI is
-	 * transferred to osmo-bts via RSL */
-	if (l1sap_fn2ccch_block(fn) < num_agch(trx, "PH-RTS-IND"))
-		return CCCH_MSGT_AGCH;
-
-	return CCCH_MSGT_PCH;
+	/* if FN is not a CCCH block, we were called for something that's not CCCH! */
+	OSMO_ASSERT(msgt >= 0);
+	return msgt;
 }
 
 
@@ -1133,6 +1148,8 @@ static int l1sap_ph_rts_ind(struct gsm_bts_trx *trx,
 			lchan->pending_rel_ind_msg = NULL;
 		}
 		if (L1SAP_IS_LINK_SACCH(link_id)) {
+			/* make sure that the control loops have caught up with the last UL SACCH */
+			lchan_ctrl_batch_flush(trx);
 			p = msgb_put(msg, GSM_MACBLOCK_LEN);
 			/* L1-header, if not set/modified by layer 1 */
 			p[0] = lchan->ms_power_ctrl.current;
@@ -2042,7 +2059,7 @@ static int l1sap_ph_data_ind(struct gsm_bts_trx *trx,
 		}
 
 		/* Trigger the measurement reporting/processing logic */
-		lchan_meas_handle_sacch(lchan, msg);
+		lchan_meas_handle_sacch(lchan, msg, fn);
 	}
 
 	if (L1SAP_IS_LINK_SACCH(link_id))
@@ -2778,6 +2795,12 @@ int l1sap_chan_act(struct gsm_bts_trx *trx, uint8_t chan_nr)
 
 	/* Init DTX DL FSM if necessary */
 	if (trx->bts->dtxd && lchan_is_tch(lchan)) {
+		lchan->tch.dtx.dl_amr_active = true;
+		lchan->tch.dtx.dl_amr_state = ST_VOICE;
+
+		/* the osmo_fsm instance only mirrors the state for logging */
+		if (!log_check_level(DL1C, LOGL_DEBUG))
+			return 0;
 		lchan->tch.dtx.dl_amr_fsm = osmo_fsm_inst_alloc(&dtx_dl_amr_fsm,
 								tall_bts_ctx,
 								lchan,
@@ -2811,6 +2834,7 @@ int l1sap_chan_rel(struct gsm_bts_trx *trx, uint8_t chan_nr)
 	LOGPLCHAN(lchan, DL1C, LOGL_INFO, "Deactivating channel %s\n",
 		  rsl_chan_nr_str(chan_nr));
 
+	lchan->tch.dtx.dl_amr_active = false;
 	if (lchan->tch.dtx.dl_amr_fsm) {
 		osmo_fsm_inst_free(lchan->tch.dtx.dl_amr_fsm);
 		lchan->tch.dtx.dl_amr_fsm = NULL;
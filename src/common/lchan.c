@@ -452,39 +452,10 @@ uint8_t gsm_lchan_as_pchan2chan_nr(const struct gsm_lchan *lchan,
 	return gsm_pchan2chan_nr(as_pchan, lchan->ts->nr, lchan->nr);
 }
 
-/* Called by the model specific code every 104 TDMA frames (SACCH period) */
-void gsm_lchan_interf_meas_push(struct gsm_lchan *lchan, int dbm)
-{
-	const uint8_t meas_num = lchan->meas.interf_meas_num;
-
-	if (meas_num >= ARRAY_SIZE(lchan->meas.interf_meas_dbm)) {
-		LOGPLCHAN(lchan, DL1C, LOGL_ERROR, "Not enough room "
-			  "to store interference report (%ddBm)\n", dbm);
-		return;
-	}
-
-	lchan->meas.interf_meas_dbm[meas_num] = dbm;
-	lchan->meas.interf_meas_num++;
-}
-
-/* Called by the higher layers every Intave * 104 TDMA frames */
-void gsm_lchan_interf_meas_calc_avg(struct gsm_lchan *lchan)
+/* Map an interference level to one of the 5 bands of 3GPP TS 48.008 */
+static uint8_t bts_interf_band(const struct gsm_bts *bts, int dbm)
 {
-	const uint8_t meas_num = lchan->meas.interf_meas_num;
-	const struct gsm_bts *bts = lchan->ts->trx->bts;
-	int b, meas_avg, meas_sum = 0;
-
-	/* There must be at least one sample */
-	OSMO_ASSERT(meas_num > 0);
-
-	/* Calculate the sum of all collected samples (in -x dBm) */
-	while (lchan->meas.interf_meas_num) {
-		uint8_t i = --lchan->meas.interf_meas_num;
-		meas_sum += lchan->meas.interf_meas_dbm[i];
-	}
-
-	/* Calculate the average of all collected samples */
-	meas_avg = meas_sum / (int) meas_num;
+	int b;
 
 	/* 3GPP TS 48.008 defines 5 interference bands, and 6 interference level
 	 * boundaries (0, X1, ... X5).  It's not clear how to handle values
@@ -493,17 +464,59 @@ void gsm_lchan_interf_meas_calc_avg(struct gsm_lchan *lchan)
 	if (bts->interference.boundary[0] < bts->interference.boundary[5]) {
 		/* Ascending order (band=1 indicates lowest interference) */
 		for (b = 1; b < ARRAY_SIZE(bts->interference.boundary) - 1; b++) {
-			if (meas_avg < bts->interference.boundary[b])
+			if (dbm < bts->interference.boundary[b])
 				break; /* Current 'b' is the band value */
 		}
 	} else {
 		/* Descending order (band=1 indicates highest interference) */
 		for (b = 1; b < ARRAY_SIZE(bts->interference.boundary) - 1; b++) {
-			if (meas_avg >= bts->interference.boundary[b])
+			if (dbm >= bts->interference.boundary[b])
 				break; /* Current 'b' is the band value */
 		}
 	}
 
+	return b;
+}
+
+/* Called by the model specific code for each interference sample, e.g. for
+ * each burst received on an idle channel */
+void gsm_lchan_interf_meas_push(struct gsm_lchan *lchan, int dbm)
+{
+	struct gsm_bts_trx_ts *ts = lchan->ts;
+
+	/* We're not interested in active CS channels */
+	if (lchan->state == LCHAN_S_ACTIVE && lchan->type != GSM_LCHAN_PDTCH)
+		return;
+
+	/* Samples are only consumed while the timeslot is reported, keep
+	 * the sum bounded (but the average intact) for all the others. */
+	if (lchan->meas.interf_meas_num == UINT16_MAX) {
+		lchan->meas.interf_meas_sum /= 2;
+		lchan->meas.interf_meas_num /= 2;
+	}
+
+	lchan->meas.interf_meas_sum += dbm;
+	lchan->meas.interf_meas_num++;
+
+	ts->interf_band_hist[bts_interf_band(ts->trx->bts, dbm) - 1]++;
+}
+
+/* Called by the higher layers every Intave * 104 TDMA frames */
+void gsm_lchan_interf_meas_calc_avg(struct gsm_lchan *lchan)
+{
+	const unsigned int meas_num = lchan->meas.interf_meas_num;
+	int b, meas_avg;
+
+	/* There must be at least one sample */
+	OSMO_ASSERT(meas_num > 0);
+
+	/* Calculate the average of all collected samples (in -x dBm) */
+	meas_avg = lchan->meas.interf_meas_sum / (int) meas_num;
+	lchan->meas.interf_meas_sum = 0;
+	lchan->meas.interf_meas_num = 0;
+
+	b = bts_interf_band(lchan->ts->trx->bts, meas_avg);
+
 	LOGPLCHAN(lchan, DL1C, LOGL_DEBUG,
 		  "Interference AVG: %ddBm (band %d, samples %u)\n",
 		  meas_avg, b, meas_num);
@@ -55,6 +55,7 @@
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/pcu_if.h>
 #include <osmo-bts/control_if.h>
+#include <osmo-bts/gsmtap_tap.h>
 #include <osmocom/ctrl/control_if.h>
 #include <osmocom/ctrl/ports.h>
 #include <osmocom/ctrl/control_vty.h>
@@ -220,21 +221,25 @@ static void handle_options(int argc, char **argv)
 	}
 }
 
-/* FIXME: remove this once we add multi-BTS support */
+/* BTS 0, further co-located BTS are allocated while reading the config file */
 struct gsm_bts *g_bts = NULL;
 
 static void signal_handler(int signum)
 {
+	struct gsm_bts *bts;
+
 	fprintf(stderr, "signal %u received\n", signum);
 
 	switch (signum) {
 	case SIGINT:
 	case SIGTERM:
 		if (!quit) {
-			oml_tx_failure_event_rep(&g_bts->mo,
-						 NM_SEVER_CRITICAL, OSMO_EVT_CRIT_PROC_STOP,
-						 "BTS: SIGINT received -> shutdown");
-			bts_shutdown_ext(g_bts, "SIGINT", true, false);
+			llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+				oml_tx_failure_event_rep(&bts->mo,
+							 NM_SEVER_CRITICAL, OSMO_EVT_CRIT_PROC_STOP,
+							 "BTS: SIGINT received -> shutdown");
+				bts_shutdown_ext(bts, "SIGINT", true, false);
+			}
 		}
 		quit++;
 		break;
@@ -260,6 +265,7 @@ static void signal_handler(int signum)
 
 int bts_main(int argc, char **argv)
 {
+	struct gsm_bts *bts;
 	struct gsm_bts_trx *trx;
 	int rc;
 
@@ -338,38 +344,49 @@ int bts_main(int argc, char **argv)
 		exit(1);
 	}
 
-	llist_for_each_entry(trx, &g_bts->trx_list, list) {
-		if (!trx->pinst) {
-			fprintf(stderr, "TRX %u has no associated PHY instance\n",
-				trx->nr);
-			exit(1);
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+		llist_for_each_entry(trx, &bts->trx_list, list) {
+			if (!trx->pinst) {
+				fprintf(stderr, "BTS %u TRX %u has no associated PHY instance\n",
+					bts->nr, trx->nr);
+				exit(1);
+			}
 		}
-	}
 
-	/* Accept a GSMTAP host from VTY config, but a commandline option overrides that. */
-	if (gsmtap_ip != NULL) {
-		if (g_bts->gsmtap.remote_host != NULL) {
-			LOGP(DLGLOBAL, LOGL_NOTICE,
-			     "Command line argument '-i %s' overrides "
-			     "'gsmtap-remote-host %s' from the config file\n",
-			     gsmtap_ip, g_bts->gsmtap.remote_host);
-			talloc_free(g_bts->gsmtap.remote_host);
+		/* Accept a GSMTAP host from VTY config, but a commandline option overrides that. */
+		if (gsmtap_ip != NULL) {
+			if (bts->gsmtap.remote_host != NULL) {
+				LOGP(DLGLOBAL, LOGL_NOTICE,
+				     "Command line argument '-i %s' overrides "
+				     "'gsmtap-remote-host %s' from the config file\n",
+				     gsmtap_ip, bts->gsmtap.remote_host);
+				talloc_free(bts->gsmtap.remote_host);
+			}
+			bts->gsmtap.remote_host = talloc_strdup(bts, gsmtap_ip);
 		}
-		g_bts->gsmtap.remote_host = talloc_strdup(g_bts, gsmtap_ip);
-	}
 
-	/* TODO: move this to gsm_bts_alloc() */
-	if (g_bts->gsmtap.remote_host != NULL) {
-		LOGP(DLGLOBAL, LOGL_NOTICE,
-		     "Setting up GSMTAP Um forwarding '%s'->'%s:%u'\n",
-		     g_bts->gsmtap.local_host, g_bts->gsmtap.remote_host, GSMTAP_UDP_PORT);
-		g_bts->gsmtap.inst = gsmtap_source_init2(g_bts->gsmtap.local_host, 0,
-							 g_bts->gsmtap.remote_host, GSMTAP_UDP_PORT, 1);
-		if (g_bts->gsmtap.inst == NULL) {
-			fprintf(stderr, "Failed during gsmtap_source_init2()\n");
-			exit(1);
+		/* TODO: move this to gsm_bts_alloc() */
+		if (bts->gsmtap.remote_host != NULL) {
+			LOGP(DLGLOBAL, LOGL_NOTICE,
+			     "Setting up GSMTAP Um forwarding '%s'->'%s:%u'\n",
+			     bts->gsmtap.local_host, bts->gsmtap.remote_host, GSMTAP_UDP_PORT);
+			bts->gsmtap.inst = gsmtap_source_init2(bts->gsmtap.local_host, 0,
+							       bts->gsmtap.remote_host, GSMTAP_UDP_PORT, 1);
+			if (bts->gsmtap.inst == NULL) {
+				fprintf(stderr, "Failed during gsmtap_source_init2()\n");
+				exit(1);
+			}
+			gsmtap_source_add_sink(bts->gsmtap.inst);
+
+			/* format and send in a separate thread, off the RT path */
+			bts->gsmtap.tap = gsmtap_tap_alloc(bts, gsmtap_inst_fd2(bts->gsmtap.inst),
+							   GSMTAP_TAP_RING_SIZE_DEFAULT);
+			if (!bts->gsmtap.tap || gsmtap_tap_start(bts->gsmtap.tap) < 0) {
+				LOGP(DLGLOBAL, LOGL_NOTICE, "Failed to start the GSMTAP writer thread, "
+				     "sending GSMTAP synchronously\n");
+				TALLOC_FREE(bts->gsmtap.tap);
+			}
 		}
-		gsmtap_source_add_sink(g_bts->gsmtap.inst);
 	}
 
 	bts_controlif_setup(g_bts, OSMO_CTRL_PORT_BTS);
@@ -392,9 +409,11 @@ int bts_main(int argc, char **argv)
 	signal(SIGUSR2, &signal_handler);
 	osmo_init_ignore_signals();
 
-	if (bts_osmux_open(g_bts) < 0) {
-		fprintf(stderr, "Osmux setup failed\n");
-		exit(1);
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+		if (bts_osmux_open(bts) < 0) {
+			fprintf(stderr, "Osmux setup failed\n");
+			exit(1);
+		}
 	}
 
 	if (vty_test_mode) {
@@ -407,8 +426,10 @@ int bts_main(int argc, char **argv)
 		return EXIT_SUCCESS;
 	}
 
-	if (abis_open(g_bts, "osmo-bts") != 0)
-		exit(1);
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+		if (abis_open(bts, "osmo-bts") != 0)
+			exit(1);
+	}
 
 	rc = phy_links_open();
 	if (rc < 0) {
@@ -416,6 +437,10 @@ int bts_main(int argc, char **argv)
 		exit(2);
 	}
 
+	/* provision the PHY from the snapshot while Abis is coming up */
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list)
+		oml_snapshot_warm_start(bts);
+
 	if (daemonize) {
 		rc = osmo_daemonize();
 		if (rc < 0) {
@@ -37,6 +37,15 @@ static const uint8_t ts45008_dtx_tchh_data_fn_map[104] = {
 	[79] = 1, /* block {79, 81, 83, 85, 87, 89} */
 };
 
+/* TCH/F: there is only one *complete* block in the subset, starting at FN=52 */
+static const uint8_t ts45008_dtx_tchf_fn_map[104] = {
+	[52] = 1,
+};
+
+/* No DTX allowed (SUB=FULL), or no fixed SUB frames at all */
+static const uint8_t ts45008_sub_fn_map_all[104] = { [0 ... 103] = 1 };
+static const uint8_t ts45008_sub_fn_map_none[104] = { 0 };
+
 /* In cases where we less measurements than we expect we must assume that we
  * just did not receive the block because it was lost due to bad channel
  * conditions. We set up a dummy measurement result here that reflects the
@@ -52,18 +61,16 @@ static const struct bts_ul_meas measurement_dummy = {
 	.inv_rssi = MEASUREMENT_DUMMY_IRSSI
 };
 
-/* Decide if a given frame number is part of the "-SUB" measurements (true) or not (false)
- * (this function is only used internally, it is public to call it from unit-tests) */
-bool ts45008_83_is_sub(struct gsm_lchan *lchan, uint32_t fn)
+/* Determine which frame numbers are part of the "-SUB" measurements for the current
+ * channel type and mode of the lchan, returns a map indexed by FN % 104 */
+static const uint8_t *ts45008_83_sub_map(struct gsm_lchan *lchan, uint32_t fn)
 {
-	uint32_t fn104 = fn % 104;
-
 	/* See TS 45.008 Sections 8.3 and 8.4 for a detailed descriptions of the rules
 	 * implemented here. We implement the logic for both speech and data (CSD). */
 
 	/* AMR is special, SID frames may be scheduled dynamically at any time */
 	if (lchan->tch_mode == GSM48_CMODE_SPEECH_AMR)
-		return false;
+		return ts45008_sub_fn_map_none;
 
 	switch (lchan->type) {
 	case GSM_LCHAN_TCH_F:
@@ -77,9 +84,7 @@ bool ts45008_83_is_sub(struct gsm_lchan *lchan, uint32_t fn)
 			 * There is only one *complete* block in this subset starting at FN=52.
 			 * Incomplete blocks {... 52, 53, 54, 55} and {56, 57, 58, 59 ...}
 			 * contain only 50% of the useful bits (partial SID) and thus ~50% BER. */
-			if (fn104 == 52)
-				return true;
-			break;
+			return ts45008_dtx_tchf_fn_map;
 		case GSM48_CMODE_DATA_12k0: /* TCH/F9.6 */
 		case GSM48_CMODE_DATA_6k0: /* TCH/F4.8 */
 			/* FIXME: The RXQUAL_SUB (not RXLEV!) report shall include measurements on
@@ -87,7 +92,7 @@ bool ts45008_83_is_sub(struct gsm_lchan *lchan, uint32_t fn)
 			 * have been received as FACCH/F frames at the corresponding frame positions. */
 		default:
 			if (lchan->rsl_cmode == RSL_CMOD_SPD_DATA)
-				return fn104 == 52;
+				return ts45008_dtx_tchf_fn_map;
 			LOGPLCFN(lchan, fn, DMEAS, LOGL_ERROR, "Unsupported lchan->tch_mode %u\n", lchan->tch_mode);
 			break;
 		}
@@ -96,13 +101,11 @@ bool ts45008_83_is_sub(struct gsm_lchan *lchan, uint32_t fn)
 		switch (lchan->tch_mode) {
 		case GSM48_CMODE_SPEECH_V1:
 		case GSM48_CMODE_SPEECH_V1_VAMOS:
-			if (ts45008_dtx_tchh_speech_fn_map[fn104])
-				return true;
-			break;
+			return ts45008_dtx_tchh_speech_fn_map;
 		case GSM48_CMODE_SIGN:
 			/* No DTX allowed; SUB=FULL, therefore measurements at all frame numbers are
 			 * SUB */
-			return true;
+			return ts45008_sub_fn_map_all;
 		case GSM48_CMODE_DATA_6k0: /* TCH/H4.8 */
 		case GSM48_CMODE_DATA_3k6: /* TCH/H2.4 */
 			/* FIXME: The RXQUAL_SUB (not RXLEV!) report shall include measurements on
@@ -110,18 +113,25 @@ bool ts45008_83_is_sub(struct gsm_lchan *lchan, uint32_t fn)
 			 * have been received as FACCH/H frames at the corresponding frame positions. */
 		default:
 			if (lchan->rsl_cmode == RSL_CMOD_SPD_DATA)
-				return ts45008_dtx_tchh_data_fn_map[fn104] == 1;
+				return ts45008_dtx_tchh_data_fn_map;
 			LOGPLCFN(lchan, fn, DMEAS, LOGL_ERROR, "Unsupported lchan->tch_mode %u\n", lchan->tch_mode);
 			break;
 		}
 		break;
 	case GSM_LCHAN_SDCCH:
 		/* No DTX allowed; SUB=FULL, therefore measurements at all frame numbers are SUB */
-		return true;
+		return ts45008_sub_fn_map_all;
 	default:
 		break;
 	}
-	return false;
+	return ts45008_sub_fn_map_none;
+}
+
+/* Decide if a given frame number is part of the "-SUB" measurements (true) or not (false)
+ * (this function is only used internally, it is public to call it from unit-tests) */
+bool ts45008_83_is_sub(struct gsm_lchan *lchan, uint32_t fn)
+{
+	return ts45008_83_sub_map(lchan, fn)[fn % 104];
 }
 
 /* Measurement reporting period and mapping of SACCH message block for TCHF
@@ -317,6 +327,36 @@ static uint8_t modulus_by_lchan(struct gsm_lchan *lchan)
 	}
 }
 
+/* add a measurement to (sign=1) or remove it from (sign=-1) the running sums */
+static void ul_meas_acc_update(struct bts_ul_meas_acc *acc, const struct bts_ul_meas *m, int sign)
+{
+	acc->ber10k_sum += sign * m->ber10k;
+	acc->inv_rssi_sum += sign * m->inv_rssi;
+	acc->ci_cb_sum += sign * m->ci_cb;
+	acc->toa256_sum += sign * m->ta_offs_256bits;
+	acc->toa256_sq_sum += sign * (int64_t)((int32_t)m->ta_offs_256bits * m->ta_offs_256bits);
+	if (m->is_sub) {
+		acc->ber10k_sub_sum += sign * m->ber10k;
+		acc->inv_rssi_sub_sum += sign * m->inv_rssi;
+		acc->ci_cb_sub_sum += sign * m->ci_cb;
+		acc->num_sub += sign;
+	}
+}
+
+/* the SUB frame map only depends on the channel type and mode, look it up again
+ * only when one of them changed */
+static const uint8_t *lchan_sub_map(struct gsm_lchan *lchan, uint32_t fn)
+{
+	uint32_t key = (1 << 24) | (lchan->rsl_cmode << 16) | (lchan->tch_mode << 8) | lchan->type;
+
+	if (lchan->meas.sub_map_key != key) {
+		lchan->meas.sub_map = ts45008_83_sub_map(lchan, fn);
+		lchan->meas.sub_map_key = key;
+	}
+
+	return lchan->meas.sub_map;
+}
+
 /* receive a L1 uplink measurement from L1 (this function is only used
  * internally, it is public to call it from unit-tests)  */
 int lchan_new_ul_meas(struct gsm_lchan *lchan,
@@ -324,6 +364,7 @@ int lchan_new_ul_meas(struct gsm_lchan *lchan,
 		      uint32_t fn)
 {
 	uint32_t fn_mod = fn % modulus_by_lchan(lchan);
+	struct bts_ul_meas_acc *acc = &lchan->meas.ul_acc;
 	struct bts_ul_meas *dest;
 
 	if (lchan->state != LCHAN_S_ACTIVE) {
@@ -332,20 +373,35 @@ int lchan_new_ul_meas(struct gsm_lchan *lchan,
 			 gsm_lchans_name(lchan->state), lchan->meas.num_ul_meas, fn_mod);
 	}
 
-	if (lchan->meas.num_ul_meas >= ARRAY_SIZE(lchan->meas.uplink)) {
+	if (lchan->meas.num_ul_meas >= MAX_NUM_UL_MEAS) {
 		LOGPLCFN(lchan, fn, DMEAS, LOGL_NOTICE,
 			 "no space for uplink measurement, num_ul_meas=%d, fn_mod=%u\n", lchan->meas.num_ul_meas,
 			 fn_mod);
 		return -ENOSPC;
 	}
 
-	dest = &lchan->meas.uplink[lchan->meas.num_ul_meas++];
+	/* no period has more measurements than the window holds, the oldest
+	 * one is an excess measurement and will not be taken into account */
+	dest = &lchan->meas.uplink[lchan->meas.num_ul_meas % MAX_UL_MEAS_WINDOW];
+	if (lchan->meas.num_ul_meas >= MAX_UL_MEAS_WINDOW) {
+		ul_meas_acc_update(acc, dest, -1);
+		acc->minmax_stale = true;
+	}
+
 	memcpy(dest, ulm, sizeof(*ulm));
 
 	/* We expect the lower layers to mark AMR SID_UPDATE frames already as such.
 	 * In this function, we only deal with the common logic as per the TS 45.008 tables */
 	if (!ulm->is_sub)
-		dest->is_sub = ts45008_83_is_sub(lchan, fn);
+		dest->is_sub = lchan_sub_map(lchan, fn)[fn % 104];
+
+	ul_meas_acc_update(acc, dest, 1);
+	if (lchan->meas.num_ul_meas == 0 || dest->ta_offs_256bits < acc->toa256_min)
+		acc->toa256_min = dest->ta_offs_256bits;
+	if (lchan->meas.num_ul_meas == 0 || dest->ta_offs_256bits > acc->toa256_max)
+		acc->toa256_max = dest->ta_offs_256bits;
+
+	lchan->meas.num_ul_meas++;
 
 	LOGPLCFN(lchan, fn, DMEAS, LOGL_DEBUG,
 		 "adding a %s measurement (ber10k=%u, ta_offs=%d, ci_cB=%d, rssi=-%u), num_ul_meas=%d, fn_mod=%u\n",
@@ -496,17 +552,18 @@ static int lchan_meas_sub_num_expected(const struct gsm_lchan *lchan)
 /* compute Osmocom extended measurements for the given lchan */
 static void lchan_meas_compute_extended(struct gsm_lchan *lchan)
 {
+	const struct bts_ul_meas_acc *acc = &lchan->meas.ul_acc;
 	unsigned int num_ul_meas;
 	unsigned int num_ul_meas_excess = 0;
-        unsigned int num_ul_meas_expect;
+	unsigned int num_ul_meas_expect;
 
 	/* we assume that lchan_meas_check_compute() has already computed the mean value
 	 * and we can compute the min/max/variance/stddev from this */
 	int i;
 
-	/* each measurement is an int32_t, so the squared difference value must fit in 32bits */
 	/* the sum of the squared values (each up to 32bit) can very easily exceed 32 bits */
-	uint64_t sq_diff_sum = 0;
+	int64_t mean;
+	int64_t sq_diff_sum;
 
 	/* In case we do not have any measurement values collected there is no
 	 * computation possible. We just skip the whole computation here, the
@@ -518,10 +575,6 @@ static void lchan_meas_compute_extended(struct gsm_lchan *lchan)
 	if (!lchan->meas.num_ul_meas)
 		return;
 
-	/* initialize min/max values with their counterpart */
-	lchan->meas.ext.toa256_min = INT16_MAX;
-	lchan->meas.ext.toa256_max = INT16_MIN;
-
 	/* Determine the number of measurement values we need to take into the
 	 * computation. In this case we only compute over the measurements we
 	 * have indeed received. Since this computation is about timing
@@ -529,7 +582,7 @@ static void lchan_meas_compute_extended(struct gsm_lchan *lchan)
 	 * samples the TOA with 0. This would bend the average towards 0. What
 	 * counts is the average TOA of the properly received blocks so that
 	 * the TA logic can make a proper decision. */
-        num_ul_meas_expect = lchan_meas_num_expected(lchan);
+	num_ul_meas_expect = lchan_meas_num_expected(lchan);
 	if (lchan->meas.num_ul_meas > num_ul_meas_expect) {
 		num_ul_meas = num_ul_meas_expect;
 		num_ul_meas_excess = lchan->meas.num_ul_meas - num_ul_meas_expect;
@@ -541,28 +594,31 @@ static void lchan_meas_compute_extended(struct gsm_lchan *lchan)
 	 * beginning of its slot. This is of course excluding the TA value that the MS has already
 	 * compensated/pre-empted its transmission */
 
-	/* step 1: compute the sum of the squared difference of each value to mean */
-	for (i = 0; i < num_ul_meas; i++) {
-		const struct bts_ul_meas *m;
-
-		OSMO_ASSERT(i < lchan->meas.num_ul_meas);
-		m = &lchan->meas.uplink[i+num_ul_meas_excess];
-
-		int32_t diff = (int32_t)m->ta_offs_256bits - (int32_t)lchan->meas.ms_toa256;
-		/* diff can now be any value of +65535 to -65535, so we can safely square it,
-		 * but only in unsigned math.  As squaring looses the sign, we can simply drop
-		 * it before squaring, too. */
-		uint32_t diff_abs = labs(diff);
-		uint32_t diff_squared = diff_abs * diff_abs;
-		sq_diff_sum += diff_squared;
-
-		/* also use this loop iteration to compute min/max values */
-		if (m->ta_offs_256bits > lchan->meas.ext.toa256_max)
-			lchan->meas.ext.toa256_max = m->ta_offs_256bits;
-		if (m->ta_offs_256bits < lchan->meas.ext.toa256_min)
-			lchan->meas.ext.toa256_min = m->ta_offs_256bits;
+	/* step 1: compute the sum of the squared difference of each value to mean,
+	 * sum((x - mean)^2) = sum(x^2) - 2 * mean * sum(x) + n * mean^2 */
+	mean = lchan->meas.ms_toa256;
+	sq_diff_sum = (int64_t)acc->toa256_sq_sum - 2 * mean * acc->toa256_sum + num_ul_meas * mean * mean;
+
+	/* min/max only need to be searched again if a sample holding them was removed */
+	if (!acc->minmax_stale) {
+		lchan->meas.ext.toa256_min = acc->toa256_min;
+		lchan->meas.ext.toa256_max = acc->toa256_max;
+	} else {
+		lchan->meas.ext.toa256_min = INT16_MAX;
+		lchan->meas.ext.toa256_max = INT16_MIN;
+		for (i = 0; i < num_ul_meas; i++) {
+			const struct bts_ul_meas *m;
+
+			m = &lchan->meas.uplink[(i + num_ul_meas_excess) % MAX_UL_MEAS_WINDOW];
+			if (m->ta_offs_256bits > lchan->meas.ext.toa256_max)
+				lchan->meas.ext.toa256_max = m->ta_offs_256bits;
+			if (m->ta_offs_256bits < lchan->meas.ext.toa256_min)
+				lchan->meas.ext.toa256_min = m->ta_offs_256bits;
+		}
 	}
+
 	/* step 2: compute the variance (mean of sum of squared differences) */
+	OSMO_ASSERT(sq_diff_sum >= 0);
 	sq_diff_sum = sq_diff_sum / num_ul_meas;
 	/* as the individual summed values can each not exceed 2^32, and we're
 	 * dividing by the number of summands, the resulting value can also not exceed 2^32 */
@@ -575,23 +631,25 @@ static void lchan_meas_compute_extended(struct gsm_lchan *lchan)
 int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 {
 	struct gsm_meas_rep_unidir *mru;
-	uint32_t ber_full_sum = 0;
-	uint32_t irssi_full_sum = 0;
-	int32_t ci_full_sum = 0;
-	uint32_t ber_sub_sum = 0;
-	uint32_t irssi_sub_sum = 0;
-	int32_t ci_sub_sum = 0;
-	int32_t ta256b_sum = 0;
-	unsigned int num_meas_sub = 0;
-	unsigned int num_meas_sub_actual = 0;
+	struct bts_ul_meas_acc *acc = &lchan->meas.ul_acc;
+	uint32_t ber_full_sum;
+	uint32_t irssi_full_sum;
+	int32_t ci_full_sum;
+	uint32_t ber_sub_sum;
+	uint32_t irssi_sub_sum;
+	int32_t ci_sub_sum;
+	int32_t ta256b_sum;
+	unsigned int num_meas_sub;
+	unsigned int num_meas_sub_actual;
 	unsigned int num_meas_sub_subst = 0;
 	int num_meas_sub_expect;
 	unsigned int num_ul_meas;
-	unsigned int num_ul_meas_actual = 0;
-	unsigned int num_ul_meas_subst = 0;
+	unsigned int num_ul_meas_actual;
+	unsigned int num_ul_meas_subst;
 	unsigned int num_ul_meas_expect;
 	unsigned int num_ul_meas_excess = 0;
-	int i;
+	unsigned int num_ul_meas_window;
+	unsigned int i;
 
 	/* if measurement period is not complete, abort */
 	if (!is_meas_complete(lchan, fn))
@@ -617,58 +675,47 @@ int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 		LOGPLCHAN(lchan, DMEAS, LOGL_DEBUG, "Received %u excess UL measurements\n",
 			  num_ul_meas_excess);
 
-	/* Measurement computation step 1: add up */
-	for (i = 0; i < num_ul_meas; i++) {
-		const struct bts_ul_meas *m;
-		bool is_sub = false;
-
-		/* Note: We will always compute over a full measurement,
-		 * interval even when not enough measurement samples are in
-		 * the buffer. As soon as we run out of measurement values
-		 * we continue the calculation using dummy values. This works
-		 * well for the BER, since there we can safely assume 100%
-		 * since a missing measurement means that the data (block)
-		 * is lost as well (some phys do not give us measurement
-		 * reports for lost blocks or blocks that are spaced out for
-		 * DTX). However, for RSSI and TA this does not work since
-		 * there we would distort the calculation if we would replace
-		 * them with a made up number. This means for those values we
-		 * only compute over the data we have actually received. */
-
-		if (i < lchan->meas.num_ul_meas) {
-			m = &lchan->meas.uplink[i + num_ul_meas_excess];
-			if (m->is_sub) {
-				irssi_sub_sum += m->inv_rssi;
-				ci_sub_sum += m->ci_cb;
-				num_meas_sub_actual++;
-				is_sub = true;
-			}
-			irssi_full_sum += m->inv_rssi;
-			ta256b_sum += m->ta_offs_256bits;
-			ci_full_sum += m->ci_cb;
-
-			num_ul_meas_actual++;
-		} else {
-			m = &measurement_dummy;
-
-			/* only if we know the exact number of SUB measurements */
-			if (num_meas_sub_expect >= 0) {
-				if (num_meas_sub < num_meas_sub_expect) {
-					num_meas_sub_subst++;
-					is_sub = true;
-				}
-			}
-
-			num_ul_meas_subst++;
-		}
-
-		ber_full_sum += m->ber10k;
-		if (is_sub) {
-			num_meas_sub++;
-			ber_sub_sum += m->ber10k;
-		}
+	/* Measurement computation step 1: add up
+	 *
+	 * The sums were already built by lchan_new_ul_meas() over the most recent
+	 * measurements in the window. No period expects more measurements than the
+	 * window holds, so only the oldest (excess) ones have to be removed here. */
+	num_ul_meas_window = OSMO_MIN(lchan->meas.num_ul_meas, MAX_UL_MEAS_WINDOW);
+	num_ul_meas_actual = lchan->meas.num_ul_meas - num_ul_meas_excess;
+	OSMO_ASSERT(num_ul_meas_actual <= num_ul_meas_window);
+	for (i = lchan->meas.num_ul_meas - num_ul_meas_window; i < num_ul_meas_excess; i++) {
+		ul_meas_acc_update(acc, &lchan->meas.uplink[i % MAX_UL_MEAS_WINDOW], -1);
+		acc->minmax_stale = true;
 	}
 
+	/* Note: We will always compute over a full measurement,
+	 * interval even when not enough measurement samples are in
+	 * the buffer. As soon as we run out of measurement values
+	 * we continue the calculation using dummy values. This works
+	 * well for the BER, since there we can safely assume 100%
+	 * since a missing measurement means that the data (block)
+	 * is lost as well (some phys do not give us measurement
+	 * reports for lost blocks or blocks that are spaced out for
+	 * DTX). However, for RSSI and TA this does not work since
+	 * there we would distort the calculation if we would replace
+	 * them with a made up number. This means for those values we
+	 * only compute over the data we have actually received. */
+	num_ul_meas_subst = num_ul_meas - num_ul_meas_actual;
+	num_meas_sub_actual = acc->num_sub;
+
+	/* only if we know the exact number of SUB measurements */
+	if (num_meas_sub_expect > 0 && num_meas_sub_actual < num_meas_sub_expect)
+		num_meas_sub_subst = OSMO_MIN(num_ul_meas_subst, num_meas_sub_expect - num_meas_sub_actual);
+	num_meas_sub = num_meas_sub_actual + num_meas_sub_subst;
+
+	ber_full_sum = acc->ber10k_sum + num_ul_meas_subst * measurement_dummy.ber10k;
+	ber_sub_sum = acc->ber10k_sub_sum + num_meas_sub_subst * measurement_dummy.ber10k;
+	irssi_full_sum = acc->inv_rssi_sum;
+	irssi_sub_sum = acc->inv_rssi_sub_sum;
+	ci_full_sum = acc->ci_cb_sum;
+	ci_sub_sum = acc->ci_cb_sub_sum;
+	ta256b_sum = acc->toa256_sum;
+
 	LOGPLCHAN(lchan, DMEAS, LOGL_DEBUG, "Replaced %u measurements with dummy values, "
 		  "from which %u were SUB measurements\n", num_ul_meas_subst, num_meas_sub_subst);
 
@@ -757,6 +804,7 @@ int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 	lchan_meas_compute_extended(lchan);
 
 	lchan->meas.num_ul_meas = 0;
+	memset(acc, 0, sizeof(*acc));
 
 	/* return 1 to indicate that the computation has been done and the next
 	 * interval begins. */
@@ -782,6 +830,7 @@ void lchan_meas_reset(struct gsm_lchan *lchan)
 {
 	memset(&lchan->meas, 0, sizeof(lchan->meas));
 	lchan->meas.last_fn = LCHAN_FN_DUMMY;
+	lchan_ctrl_batch_cancel(lchan);
 }
 
 static inline uint8_t ms_to2rsl(const struct gsm_lchan *lchan, uint8_t ta)
@@ -925,7 +974,7 @@ static bool data_is_rr_meas_rep(const uint8_t *data)
 }
 
 /* Called every time a SACCH block is received from lower layers */
-void lchan_meas_handle_sacch(struct gsm_lchan *lchan, struct msgb *msg)
+void lchan_meas_handle_sacch(struct gsm_lchan *lchan, struct msgb *msg, uint32_t fn)
 {
 	const struct gsm48_meas_res *mr = NULL;
 	const struct gsm48_hdr *gh = NULL;
@@ -995,12 +1044,12 @@ void lchan_meas_handle_sacch(struct gsm_lchan *lchan, struct msgb *msg)
 		ul_rssi = rxlev2dbm(lchan->meas.ul_res.full.rx_lev);
 		ul_ci_cb = lchan->meas.ul_ci_cb_full;
 	}
-	lchan_ms_ta_ctrl(lchan, ms_ta, lchan->meas.ms_toa256);
-	lchan_ms_pwr_ctrl(lchan, ms_pwr, ul_rssi, ul_ci_cb);
-	if (mr && gsm48_meas_res_is_valid(mr)) {
-		lchan_bs_pwr_ctrl(lchan, mr);
+	if (mr && !gsm48_meas_res_is_valid(mr))
+		mr = NULL;
+	/* The loops themselves run for all lchans with a SACCH block in this frame at once */
+	lchan_ctrl_batch_add(lchan, fn, ms_ta, lchan->meas.ms_toa256, ms_pwr, ul_rssi, ul_ci_cb, mr);
+	if (mr)
 		acch_overpower_active_decision(lchan, mr);
-	}
 
 	repeated_dl_facch_active_decision(lchan, mr);
 
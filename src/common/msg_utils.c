@@ -99,8 +99,8 @@ static inline bool dtx_is_update(const struct gsm_lchan *lchan)
 {
 	if (!dtx_dl_amr_enabled(lchan))
 		return false;
-	if (lchan->tch.dtx.dl_amr_fsm->state == ST_SID_U ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_U_NOINH)
+	if (lchan->tch.dtx.dl_amr_state == ST_SID_U ||
+	    lchan->tch.dtx.dl_amr_state == ST_U_NOINH)
 		return true;
 	return false;
 }
@@ -111,7 +111,7 @@ bool dtx_is_first_p1(const struct gsm_lchan *lchan)
 	if (!dtx_dl_amr_enabled(lchan))
 		return false;
 	if ((lchan->type == GSM_LCHAN_TCH_H &&
-	     lchan->tch.dtx.dl_amr_fsm->state == ST_SID_F1))
+	     lchan->tch.dtx.dl_amr_state == ST_SID_F1))
 		return true;
 	return false;
 }
@@ -181,7 +181,7 @@ int dtx_dl_amr_fsm_step(struct gsm_lchan *lchan, const uint8_t *rtp_pl,
 		if (lchan->type == GSM_LCHAN_TCH_H && !rtp_pl) {
 			/* we're called by gen_empty_tch_msg() to handle states
 			   specific to AMR HR DTX */
-			switch (lchan->tch.dtx.dl_amr_fsm->state) {
+			switch (lchan->tch.dtx.dl_amr_state) {
 			case ST_SID_F2:
 				*len = 3; /* SID-FIRST P1 -> P2 completion */
 				memcpy(l1_payload, lchan->tch.dtx.cache, 2);
@@ -231,47 +231,38 @@ int dtx_dl_amr_fsm_step(struct gsm_lchan *lchan, const uint8_t *rtp_pl,
 
 	if (osmo_amr_is_speech(ft)) {
 		/* AMR HR - SID-FIRST_P1 Inhibition */
-		if (marker && lchan->tch.dtx.dl_amr_fsm->state == ST_VOICE)
-			return osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-						      E_INHIB, (void *)lchan);
+		if (marker && lchan->tch.dtx.dl_amr_state == ST_VOICE)
+			return dtx_dl_amr_dispatch(lchan, E_INHIB);
 
 		/* AMR HR - SID-UPDATE Inhibition */
 		if (marker && lchan->type == GSM_LCHAN_TCH_H &&
-		    lchan->tch.dtx.dl_amr_fsm->state == ST_SID_U)
-			return osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-						      E_INHIB, (void *)lchan);
+		    lchan->tch.dtx.dl_amr_state == ST_SID_U)
+			return dtx_dl_amr_dispatch(lchan, E_INHIB);
 
 		/* AMR FR & HR - generic */
-		if (marker && (lchan->tch.dtx.dl_amr_fsm->state == ST_SID_F1 ||
-			       lchan->tch.dtx.dl_amr_fsm->state == ST_SID_F2 ||
-			       lchan->tch.dtx.dl_amr_fsm->state == ST_U_NOINH))
-			return osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-						      E_ONSET, (void *)lchan);
+		if (marker && (lchan->tch.dtx.dl_amr_state == ST_SID_F1 ||
+			       lchan->tch.dtx.dl_amr_state == ST_SID_F2 ||
+			       lchan->tch.dtx.dl_amr_state == ST_U_NOINH))
+			return dtx_dl_amr_dispatch(lchan, E_ONSET);
 
-		if (lchan->tch.dtx.dl_amr_fsm->state != ST_VOICE)
-			return osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-						      E_VOICE, (void *)lchan);
+		if (lchan->tch.dtx.dl_amr_state != ST_VOICE)
+			return dtx_dl_amr_dispatch(lchan, E_VOICE);
 
 		return 0;
 	}
 
 	if (ft == AMR_SID) {
-		if (lchan->tch.dtx.dl_amr_fsm->state == ST_VOICE) {
+		if (lchan->tch.dtx.dl_amr_state == ST_VOICE) {
 			/* SID FIRST/UPDATE scheduling logic relies on SID FIRST
 			   being sent first hence we have to force caching of SID
 			   as FIRST regardless of actually decoded type */
 			dtx_cache_payload(lchan, rtp_pl, rtp_pl_len, fn, false);
-			return osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-						      sti ? E_SID_U : E_SID_F,
-						      (void *)lchan);
-		} else if (lchan->tch.dtx.dl_amr_fsm->state != ST_FACCH)
+			return dtx_dl_amr_dispatch(lchan, sti ? E_SID_U : E_SID_F);
+		} else if (lchan->tch.dtx.dl_amr_state != ST_FACCH)
 			dtx_cache_payload(lchan, rtp_pl, rtp_pl_len, fn, sti);
-		if (lchan->tch.dtx.dl_amr_fsm->state == ST_SID_F2)
-			return osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-						      E_COMPL, (void *)lchan);
-		return osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-					      sti ? E_SID_U : E_SID_F,
-					      (void *)lchan);
+		if (lchan->tch.dtx.dl_amr_state == ST_SID_F2)
+			return dtx_dl_amr_dispatch(lchan, E_COMPL);
+		return dtx_dl_amr_dispatch(lchan, sti ? E_SID_U : E_SID_F);
 	}
 
 	if (ft != AMR_NO_DATA) {
@@ -280,8 +271,7 @@ int dtx_dl_amr_fsm_step(struct gsm_lchan *lchan, const uint8_t *rtp_pl,
 	}
 
 	if (marker)
-		osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm, E_VOICE,
-				       (void *)lchan);
+		dtx_dl_amr_dispatch(lchan, E_VOICE);
 	*len = 0;
 	return 0;
 }
@@ -313,7 +303,7 @@ static inline bool dtx_amr_sid_optional(struct gsm_lchan *lchan, uint32_t fn)
 	uint32_t dx26 = 120 * (fn - lchan->tch.dtx.fn);
 
 	/* We're resuming after FACCH interruption */
-	if (lchan->tch.dtx.dl_amr_fsm->state == ST_FACCH) {
+	if (lchan->tch.dtx.dl_amr_state == ST_FACCH) {
 		/* force STI bit to 0 so cache is treated as SID FIRST */
 		dtx_sti_unset(lchan);
 		lchan->tch.dtx.is_update = false;
@@ -344,7 +334,7 @@ static inline bool dtx_amr_sid_optional(struct gsm_lchan *lchan, uint32_t fn)
 		return true;
 	}
 
-	if (lchan->tch.dtx.dl_amr_fsm->state == ST_VOICE)
+	if (lchan->tch.dtx.dl_amr_state == ST_VOICE)
 		return true;
 
 	/* according to 3GPP TS 26.093 A.5.1.1:
@@ -403,7 +393,7 @@ static inline bool dtx_sched_optional(struct gsm_lchan *lchan, uint32_t fn)
 bool dtx_dl_amr_enabled(const struct gsm_lchan *lchan)
 {
 	if (lchan->ts->trx->bts->dtxd &&
-	    lchan->tch.dtx.dl_amr_fsm &&
+	    lchan->tch.dtx.dl_amr_active &&
 	    lchan->tch_mode == GSM48_CMODE_SPEECH_AMR)
 		return true;
 	return false;
@@ -419,23 +409,54 @@ bool dtx_recursion(const struct gsm_lchan *lchan)
 	if (!dtx_dl_amr_enabled(lchan))
 		return false;
 
-	if (lchan->tch.dtx.dl_amr_fsm->state == ST_U_INH_V ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_U_INH_F ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_U_INH_V_REC ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_U_INH_F_REC ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_F1_INH_V ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_F1_INH_F ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_F1_INH_V_REC ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_F1_INH_F_REC ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_ONSET_F ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_ONSET_V ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_ONSET_F_REC ||
-	    lchan->tch.dtx.dl_amr_fsm->state == ST_ONSET_V_REC)
+	if (lchan->tch.dtx.dl_amr_state == ST_U_INH_V ||
+	    lchan->tch.dtx.dl_amr_state == ST_U_INH_F ||
+	    lchan->tch.dtx.dl_amr_state == ST_U_INH_V_REC ||
+	    lchan->tch.dtx.dl_amr_state == ST_U_INH_F_REC ||
+	    lchan->tch.dtx.dl_amr_state == ST_F1_INH_V ||
+	    lchan->tch.dtx.dl_amr_state == ST_F1_INH_F ||
+	    lchan->tch.dtx.dl_amr_state == ST_F1_INH_V_REC ||
+	    lchan->tch.dtx.dl_amr_state == ST_F1_INH_F_REC ||
+	    lchan->tch.dtx.dl_amr_state == ST_ONSET_F ||
+	    lchan->tch.dtx.dl_amr_state == ST_ONSET_V ||
+	    lchan->tch.dtx.dl_amr_state == ST_ONSET_F_REC ||
+	    lchan->tch.dtx.dl_amr_state == ST_ONSET_V_REC)
 		return true;
 
 	return false;
 }
 
+/*! \brief Dispatch an event to the DTX DL AMR FSM of a lchan: the state is
+ *         looked up in dtx_dl_amr_fsm_trans, the osmo_fsm instance (if
+ *         any) only mirrors it for logging.
+ *  \param[in] lchan Logical channel on which we check scheduling
+ *  \param[in] e DTX DL AMR FSM Event
+ *  \returns 0 in case of success; negative if the event is not permitted
+ */
+int dtx_dl_amr_dispatch(struct gsm_lchan *lchan, enum dtx_dl_amr_fsm_events e)
+{
+	struct osmo_fsm_inst *fi = lchan->tch.dtx.dl_amr_fsm;
+	int state;
+
+	state = dtx_dl_amr_fsm_next(lchan->tch.dtx.dl_amr_state, e);
+	if (OSMO_UNLIKELY(state < 0)) {
+		LOGPLCHAN(lchan, DL1C, LOGL_ERROR, "DTX DL AMR: event %s not permitted in state %s\n",
+			  get_value_string(dtx_dl_amr_fsm_event_names, e),
+			  osmo_fsm_state_name(&dtx_dl_amr_fsm, lchan->tch.dtx.dl_amr_state));
+		return -1;
+	}
+	lchan->tch.dtx.dl_amr_state = state;
+
+	if (fi != NULL) {
+		osmo_fsm_inst_dispatch(fi, e, (void *)lchan);
+		if (fi->state != state)
+			LOGPFSML(fi, LOGL_ERROR, "Mirror diverged, expected state %s\n",
+				 osmo_fsm_state_name(&dtx_dl_amr_fsm, state));
+	}
+
+	return 0;
+}
+
 /*! \brief Send signal to FSM: with proper check if DIX is enabled for this lchan
  *  \param[in] lchan Logical channel on which we check scheduling
  *  \param[in] e DTX DL AMR FSM Event
@@ -443,8 +464,7 @@ bool dtx_recursion(const struct gsm_lchan *lchan)
 void dtx_dispatch(struct gsm_lchan *lchan, enum dtx_dl_amr_fsm_events e)
 {
 	if (dtx_dl_amr_enabled(lchan))
-		osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm, e,
-				       (void *)lchan);
+		dtx_dl_amr_dispatch(lchan, e);
 }
 
 /*! \brief Send internal signal to FSM: check that DTX is enabled for this chan,
@@ -480,24 +500,21 @@ uint8_t repeat_last_sid(struct gsm_lchan *lchan, uint8_t *dst, uint32_t fn)
 	if (lchan->tch.dtx.len) {
 		if (dtx_dl_amr_enabled(lchan)) {
 			if ((lchan->type == GSM_LCHAN_TCH_H &&
-			     lchan->tch.dtx.dl_amr_fsm->state == ST_SID_F2) ||
+			     lchan->tch.dtx.dl_amr_state == ST_SID_F2) ||
 			    (lchan->type == GSM_LCHAN_TCH_F &&
-			     lchan->tch.dtx.dl_amr_fsm->state == ST_SID_F1)) {
+			     lchan->tch.dtx.dl_amr_state == ST_SID_F1)) {
 				/* advance FSM in case we've just sent SID FIRST
 				   to restore silence after FACCH interruption */
-				osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-						       E_SID_U, (void *)lchan);
+				dtx_dl_amr_dispatch(lchan, E_SID_U);
 				dtx_sti_unset(lchan);
 			} else if (dtx_is_update(lchan)) {
 				/* enforce SID UPDATE for next repetition: it
 				   might have been altered by FACCH handling */
 				dtx_sti_set(lchan);
 				if (lchan->type == GSM_LCHAN_TCH_H &&
-				    lchan->tch.dtx.dl_amr_fsm->state ==
+				    lchan->tch.dtx.dl_amr_state ==
 				    ST_U_NOINH)
-					osmo_fsm_inst_dispatch(lchan->tch.dtx.dl_amr_fsm,
-							       E_COMPL,
-							       (void *)lchan);
+					dtx_dl_amr_dispatch(lchan, E_COMPL);
 				lchan->tch.dtx.is_update = true;
 			}
 		}
@@ -48,6 +48,7 @@
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/bts.h>
 #include <osmo-bts/bts_sm.h>
+#include <osmo-bts/oml_snapshot.h>
 #include <osmo-bts/signal.h>
 #include <osmo-bts/phy_link.h>
 #include <osmo-bts/nm_common_fsm.h>
@@ -63,11 +64,16 @@ static struct tlv_definition abis_nm_att_tlvdef_ipa_local = {};
  * support
  */
 
-static int oml_tlv_parse(struct tlv_parsed *tp, const uint8_t *buf, int len)
+int oml_tlv_parse(struct tlv_parsed *tp, const uint8_t *buf, int len)
 {
 	return tlv_parse(tp, &abis_nm_att_tlvdef_ipa_local, buf, len, 0, 0);
 }
 
+int oml_tlv_encode(struct msgb *msg, const struct tlv_parsed *tp)
+{
+	return tlv_encode(msg, &abis_nm_att_tlvdef_ipa_local, tp);
+}
+
 struct msgb *oml_msgb_alloc(void)
 {
 	return msgb_alloc_headroom(1024, 128, "OML");
@@ -1099,6 +1105,8 @@ static int oml_rx_set_bts_attr(struct gsm_bts *bts, struct msgb *msg)
 		}
 	}
 
+	oml_snapshot_rx_attr(&bts->mo, &tp);
+
 	ev_data = (struct nm_fsm_ev_setattr_data){
 		.msg = msg,
 	};
@@ -1195,6 +1203,8 @@ static int oml_rx_set_radio_attr(struct gsm_bts_trx *trx, struct msgb *msg)
 	}
 #endif
 
+	oml_snapshot_rx_attr(&trx->mo, &tp);
+
 	ev_data = (struct nm_fsm_ev_setattr_data){
 		.msg = msg,
 	};
@@ -1206,7 +1216,7 @@ static int oml_rx_set_radio_attr(struct gsm_bts_trx *trx, struct msgb *msg)
 
 }
 
-static int handle_chan_comb(struct gsm_bts_trx_ts *ts, const uint8_t comb)
+int handle_chan_comb(struct gsm_bts_trx_ts *ts, const uint8_t comb)
 {
 	enum gsm_phys_chan_config pchan;
 
@@ -1408,6 +1418,8 @@ static int oml_rx_set_chan_attr(struct gsm_bts_trx_ts *ts, struct msgb *msg)
 		      ts->hopping.hsn, ts->hopping.maio, ts->hopping.arfcn_num);
 	LOGPC(DOML, LOGL_INFO, ")\n");
 
+	oml_snapshot_rx_attr(&ts->mo, &tp);
+
 	ev_data = (struct nm_fsm_ev_setattr_data){
 		.msg = msg,
 	};
@@ -1492,7 +1504,9 @@ static int oml_rx_chg_adm_state(struct gsm_bts *bts, struct msgb *msg)
 		get_value_string(abis_nm_adm_state_names, adm_state));
 
 	/* Step 3: Ask BTS driver to apply the state chg */
-	return bts_model_chg_adm_state(bts, mo, obj, adm_state);
+	rc = bts_model_chg_adm_state(bts, mo, obj, adm_state);
+	oml_snapshot_changed(bts);
+	return rc;
 }
 
 /* Check and report if the BTS number received via OML is incorrect:
@@ -0,0 +1,941 @@
+/* Persisted OML/SI configuration snapshot for a fast warm restart */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/bit16gen.h>
+#include <osmocom/core/signal.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/protocol/gsm_12_21.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/gsm/gsm48_rest_octets.h>
+#include <osmocom/gsm/rsl.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/oml.h>
+#include <osmo-bts/rsl.h>
+#include <osmo-bts/signal.h>
+#include <osmo-bts/oml_snapshot.h>
+
+/* File format: magic, version, then a sequence of records, the last one
+ * being SNAP_REC_END.  A record consists of a type, two type specific
+ * octets (TRX and TS number, SI type and index) and a 16 bit length,
+ * followed by the value: OML attributes as TLV, or the SI as sent in
+ * RSL BCCH INFO. */
+#define SNAP_MAGIC		"OBTSSNAP"
+#define SNAP_VERSION		1
+#define SNAP_HDR_LEN		(sizeof(SNAP_MAGIC) - 1 + 1)
+#define SNAP_REC_HDR_LEN	5
+#define SNAP_MAX_SIZE		32768
+
+enum snap_rec_type {
+	SNAP_REC_END		= 0x00,
+	SNAP_REC_BTS_ATTR	= 0x01,
+	SNAP_REC_TRX_ATTR	= 0x02,	/* a: TRX number */
+	SNAP_REC_TS_ATTR	= 0x03,	/* a: TRX number, b: TS number */
+	SNAP_REC_TRX_ADM	= 0x04,	/* a: TRX number */
+	SNAP_REC_SI		= 0x05,	/* a: osmo_sysinfo_type, b: SI2quater index */
+};
+
+/* Attributes which determine the PHY configuration applied from the
+ * snapshot.  If the BSC sends anything else for them, the snapshot is
+ * discarded, and the BTS is restarted cold. */
+static const uint8_t snap_phy_attrs[] = {
+	NM_ATT_BSIC,
+	NM_ATT_BCCH_ARFCN,
+	NM_ATT_ARFCN_LIST,
+	NM_ATT_CHAN_COMB,
+	NM_ATT_TSC,
+	NM_ATT_HSN,
+	NM_ATT_MAIO,
+};
+
+struct snap_rec {
+	uint8_t type;
+	uint8_t a;
+	uint8_t b;
+	uint16_t len;
+	const uint8_t *val;
+};
+
+/* Fetch the record at *offset and advance it.
+ * \returns 1 if a record was fetched; 0 at SNAP_REC_END; negative on error */
+static int snap_rec_next(const uint8_t *data, size_t data_len, size_t *offset,
+			 struct snap_rec *rec)
+{
+	const uint8_t *cur = data + *offset;
+
+	if (*offset + SNAP_REC_HDR_LEN > data_len)
+		return -EINVAL;
+
+	rec->type = cur[0];
+	rec->a = cur[1];
+	rec->b = cur[2];
+	rec->len = osmo_load16be(&cur[3]);
+	rec->val = cur + SNAP_REC_HDR_LEN;
+
+	if (*offset + SNAP_REC_HDR_LEN + rec->len > data_len)
+		return -EINVAL;
+	*offset += SNAP_REC_HDR_LEN + rec->len;
+
+	return rec->type != SNAP_REC_END;
+}
+
+static int snap_rec_find(const struct oml_snapshot *snap, uint8_t type,
+			 uint8_t a, uint8_t b, struct snap_rec *rec)
+{
+	size_t offset = SNAP_HDR_LEN;
+
+	while (snap_rec_next(snap->data, snap->data_len, &offset, rec) > 0) {
+		if (rec->type == type && rec->a == a && rec->b == b)
+			return 0;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * writing
+ */
+
+static uint8_t *snap_rec_put_hdr(struct msgb *msg, uint8_t type, uint8_t a, uint8_t b)
+{
+	uint8_t *hdr = msgb_put(msg, SNAP_REC_HDR_LEN);
+
+	hdr[0] = type;
+	hdr[1] = a;
+	hdr[2] = b;
+	return hdr;
+}
+
+static void snap_rec_put_len(struct msgb *msg, uint8_t *hdr)
+{
+	osmo_store16be(msg->tail - hdr - SNAP_REC_HDR_LEN, &hdr[3]);
+}
+
+static int snap_rec_put(struct msgb *msg, uint8_t type, uint8_t a, uint8_t b,
+			const uint8_t *val, uint16_t len)
+{
+	uint8_t *hdr;
+
+	if (msgb_tailroom(msg) < SNAP_REC_HDR_LEN + len)
+		return -ENOSPC;
+
+	hdr = snap_rec_put_hdr(msg, type, a, b);
+	if (len > 0)
+		memcpy(msgb_put(msg, len), val, len);
+	snap_rec_put_len(msg, hdr);
+	return 0;
+}
+
+static int snap_rec_put_attr(struct msgb *msg, uint8_t type, uint8_t a, uint8_t b,
+			     const struct tlv_parsed *tp)
+{
+	unsigned int i, len = 0;
+	uint8_t *hdr;
+
+	if (tp == NULL)
+		return 0;
+
+	/* tag and (at most) 16 bit length for each attribute */
+	for (i = 0; i < ARRAY_SIZE(tp->lv); i++) {
+		if (TLVP_PRESENT(tp, i))
+			len += 3 + TLVP_LEN(tp, i);
+	}
+	if (msgb_tailroom(msg) < SNAP_REC_HDR_LEN + len)
+		return -ENOSPC;
+
+	hdr = snap_rec_put_hdr(msg, type, a, b);
+	if (oml_tlv_encode(msg, tp) < 0)
+		return -EINVAL;
+	snap_rec_put_len(msg, hdr);
+	return 0;
+}
+
+/* The SI3/SI4 in si_buf may have the GPRS indicator patched out while no PCU
+ * is connected, persist them with the Rest Octets as sent by the BSC. */
+static void snap_si_orig(const struct gsm_bts *bts, enum osmo_sysinfo_type osmo_si,
+			 uint8_t *buf)
+{
+	int offset;
+
+	switch (osmo_si) {
+	case SYSINFO_TYPE_3:
+		if (!bts->si3_ro_decoded.gprs_ind.present)
+			break;
+		offset = offsetof(struct gsm48_system_information_type_3, rest_octets);
+		osmo_gsm48_rest_octets_si3_encode(buf + offset, &bts->si3_ro_decoded);
+		break;
+	case SYSINFO_TYPE_4:
+		if (!bts->si4_ro_decoded.gprs_ind.present)
+			break;
+		offset = get_si4_ro_offset(buf);
+		if (offset > 0)
+			osmo_gsm48_rest_octets_si4_encode(buf + offset, &bts->si4_ro_decoded,
+							  GSM_MACBLOCK_LEN - offset);
+		break;
+	default:
+		break;
+	}
+}
+
+static int snap_put_si(struct msgb *msg, const struct gsm_bts *bts)
+{
+	sysinfo_buf_t buf;
+	unsigned int i, n;
+	int rc;
+
+	for (i = 0; i < _MAX_SYSINFO_TYPE; i++) {
+		if (!GSM_BTS_HAS_SI(bts, i))
+			continue;
+
+		/* only what is sent on the BCCH, the SACCH filling is per TRX */
+		switch (i) {
+		case SYSINFO_TYPE_5:
+		case SYSINFO_TYPE_5bis:
+		case SYSINFO_TYPE_5ter:
+		case SYSINFO_TYPE_6:
+		case SYSINFO_TYPE_10:
+		case SYSINFO_TYPE_EMO:
+		case SYSINFO_TYPE_MEASINFO:
+			continue;
+		default:
+			break;
+		}
+
+		for (n = 0; n <= (i == SYSINFO_TYPE_2quater ? bts->si2q_count : 0); n++) {
+			memcpy(buf, bts->si_buf[i][n], sizeof(buf));
+			snap_si_orig(bts, i, buf);
+			rc = snap_rec_put(msg, SNAP_REC_SI, i, n, buf, sizeof(buf));
+			if (rc < 0)
+				return rc;
+		}
+	}
+
+	return 0;
+}
+
+static struct msgb *snap_encode(const struct gsm_bts *bts)
+{
+	const struct gsm_bts_trx *trx;
+	struct msgb *msg;
+	unsigned int tn;
+	int rc;
+
+	msg = msgb_alloc(SNAP_MAX_SIZE, "OML snapshot");
+	if (!msg)
+		return NULL;
+
+	memcpy(msgb_put(msg, sizeof(SNAP_MAGIC) - 1), SNAP_MAGIC, sizeof(SNAP_MAGIC) - 1);
+	msgb_put_u8(msg, SNAP_VERSION);
+
+	rc = snap_rec_put_attr(msg, SNAP_REC_BTS_ATTR, 0, 0, bts->mo.nm_attr);
+	if (rc < 0)
+		goto err;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		uint8_t adm = trx->mo.nm_state.administrative;
+
+		rc = snap_rec_put_attr(msg, SNAP_REC_TRX_ATTR, trx->nr, 0, trx->mo.nm_attr);
+		if (rc < 0)
+			goto err;
+		rc = snap_rec_put(msg, SNAP_REC_TRX_ADM, trx->nr, 0, &adm, 1);
+		if (rc < 0)
+			goto err;
+
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			rc = snap_rec_put_attr(msg, SNAP_REC_TS_ATTR, trx->nr, tn,
+					       trx->ts[tn].mo.nm_attr);
+			if (rc < 0)
+				goto err;
+		}
+	}
+
+	rc = snap_put_si(msg, bts);
+	if (rc < 0)
+		goto err;
+
+	rc = snap_rec_put(msg, SNAP_REC_END, 0, 0, NULL, 0);
+	if (rc < 0)
+		goto err;
+
+	return msg;
+
+err:
+	msgb_free(msg);
+	return NULL;
+}
+
+/* fsync() the directory containing path, so that a rename() within it is
+ * persisted as well.  This runs on the writer thread. */
+static int snap_fsync_dir(const char *path)
+{
+	char dir_path[PATH_MAX];
+	const char *slash;
+	int fd, rc = 0;
+
+	slash = strrchr(path, '/');
+	if (!slash)
+		OSMO_STRLCPY_ARRAY(dir_path, ".");
+	else if (slash == path)
+		OSMO_STRLCPY_ARRAY(dir_path, "/");
+	else if (slash - path < (int)sizeof(dir_path))
+		osmo_strlcpy(dir_path, path, slash - path + 1);
+	else
+		return -ENAMETOOLONG;
+
+	fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fsync(fd) < 0)
+		rc = -errno;
+	close(fd);
+	return rc;
+}
+
+/* Write an encoded snapshot to a file.  This runs on the writer thread,
+ * so it must neither log nor touch the BTS. */
+static int snap_write_file(const char *path, const struct msgb *msg)
+{
+	char tmp_path[PATH_MAX];
+	ssize_t written;
+	int fd, rc;
+
+	/* write to a temporary file first, so that there is either the old or
+	 * the new snapshot after a crash, but never a partial one */
+	rc = snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	if (rc < 0 || rc >= (int)sizeof(tmp_path))
+		return -ENAMETOOLONG;
+
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -errno;
+
+	written = write(fd, msgb_data(msg), msgb_length(msg));
+	if (written != msgb_length(msg)) {
+		rc = written < 0 ? -errno : -EIO;
+		goto err_fd;
+	}
+	if (fsync(fd) < 0) {
+		rc = -errno;
+		goto err_fd;
+	}
+	close(fd);
+
+	if (rename(tmp_path, path) < 0) {
+		rc = -errno;
+		unlink(tmp_path);
+		return rc;
+	}
+
+	/* make sure the new directory entry survives a power loss */
+	return snap_fsync_dir(path);
+
+err_fd:
+	close(fd);
+	unlink(tmp_path);
+	return rc;
+}
+
+static void *snap_writer_thread(void *data)
+{
+	struct oml_snapshot *snap = data;
+	uint64_t val = 1;
+	ssize_t rc;
+
+	snap->writer.rc = snap_write_file(snap->writer.path, snap->writer.msg);
+	__atomic_store_n(&snap->writer.done, true, __ATOMIC_RELEASE);
+
+	/* hand over to snap_writer_fd_cb() on the main thread.  Should this
+	 * fail, snap_write_timer_cb() picks up the result from 'done'. */
+	do {
+		rc = write(snap->writer.ofd.fd, &val, sizeof(val));
+	} while (rc < 0 && errno == EINTR);
+
+	return NULL;
+}
+
+/* Wait for the writer thread to complete, and clean up after it */
+static void snap_writer_join(struct oml_snapshot *snap)
+{
+	pthread_join(snap->writer.thread, NULL);
+	osmo_fd_unregister(&snap->writer.ofd);
+	close(snap->writer.ofd.fd);
+	msgb_free(snap->writer.msg);
+	snap->writer.msg = NULL;
+	TALLOC_FREE(snap->writer.path);
+	snap->writer.running = false;
+}
+
+static int snap_writer_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct gsm_bts *bts = ofd->data;
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+
+	if (snap->writer.rc < 0) {
+		LOGP(DOML, LOGL_ERROR, "Failed to write OML snapshot to '%s': %s\n",
+		     snap->writer.path, strerror(-snap->writer.rc));
+	} else {
+		LOGP(DOML, LOGL_INFO, "Wrote OML snapshot to '%s' (%u bytes)\n",
+		     snap->writer.path, msgb_length(snap->writer.msg));
+	}
+	snap_writer_join(snap);
+
+	if (snap->writer.again) {
+		snap->writer.again = false;
+		oml_snapshot_changed(bts);
+	}
+
+	return 0;
+}
+
+/* Encode the snapshot, and write it on a separate thread: the fsync() may
+ * block for a long time on flash storage, while the PHY is running. */
+static int snap_write(struct gsm_bts *bts)
+{
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+	struct msgb *msg;
+	int fd, rc;
+
+	msg = snap_encode(bts);
+	if (!msg) {
+		LOGP(DOML, LOGL_ERROR, "Configuration does not fit into the OML snapshot\n");
+		return -ENOSPC;
+	}
+
+	fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0) {
+		rc = -errno;
+		goto err_msg;
+	}
+	osmo_fd_setup(&snap->writer.ofd, fd, OSMO_FD_READ, snap_writer_fd_cb, bts, 0);
+	if (osmo_fd_register(&snap->writer.ofd) < 0) {
+		rc = -EIO;
+		goto err_fd;
+	}
+
+	snap->writer.msg = msg;
+	snap->writer.path = talloc_strdup(bts, snap->path);
+	if (!snap->writer.path) {
+		rc = -ENOMEM;
+		goto err_reg;
+	}
+
+	snap->writer.done = false;
+	rc = pthread_create(&snap->writer.thread, NULL, snap_writer_thread, snap);
+	if (rc != 0) {
+		rc = -rc;
+		TALLOC_FREE(snap->writer.path);
+		goto err_reg;
+	}
+	pthread_setname_np(snap->writer.thread, "oml_snapshot");
+	snap->writer.running = true;
+
+	return 0;
+
+err_reg:
+	osmo_fd_unregister(&snap->writer.ofd);
+err_fd:
+	close(fd);
+err_msg:
+	LOGP(DOML, LOGL_ERROR, "Failed to write OML snapshot to '%s': %s\n",
+	     snap->path, strerror(-rc));
+	msgb_free(msg);
+	snap->writer.msg = NULL;
+	return rc;
+}
+
+static void snap_write_timer_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+
+	if (snap->path == NULL || snap->warm)
+		return;
+	/* only persist a configuration the BCCH could be transmitted with */
+	if (bts->c0->ts[0].mo.nm_state.operational != NM_OPSTATE_ENABLED)
+		return;
+	/* the writer thread completed without signalling the eventfd */
+	if (snap->writer.running && __atomic_load_n(&snap->writer.done, __ATOMIC_ACQUIRE)) {
+		snap->writer.again = false;
+		snap_writer_fd_cb(&snap->writer.ofd, OSMO_FD_READ);
+	}
+	/* written once more when the ongoing write completed */
+	if (snap->writer.running) {
+		snap->writer.again = true;
+		return;
+	}
+
+	snap_write(bts);
+}
+
+/*! Schedule writing the snapshot, after the configuration was changed */
+void oml_snapshot_changed(struct gsm_bts *bts)
+{
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+
+	if (snap->path == NULL || snap->warm)
+		return;
+	/* collect all the changes of a (re-)configuration into one write */
+	if (osmo_timer_pending(&snap->write_timer))
+		return;
+
+	osmo_timer_schedule(&snap->write_timer, OML_SNAPSHOT_WRITE_DELAY, 0);
+}
+
+/*
+ * warm start
+ */
+
+static int snap_load(struct gsm_bts *bts)
+{
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+	struct snap_rec rec;
+	size_t offset = SNAP_HDR_LEN;
+	struct stat st;
+	ssize_t len;
+	uint8_t *data;
+	int fd, rc;
+
+	fd = open(snap->path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) < 0) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+	if (st.st_size < SNAP_HDR_LEN + SNAP_REC_HDR_LEN || st.st_size > SNAP_MAX_SIZE) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	data = talloc_size(bts, st.st_size);
+	if (!data) {
+		close(fd);
+		return -ENOMEM;
+	}
+
+	len = read(fd, data, st.st_size);
+	rc = len < 0 ? -errno : 0;
+	close(fd);
+	if (len != st.st_size) {
+		talloc_free(data);
+		return rc < 0 ? rc : -EIO;
+	}
+
+	if (memcmp(data, SNAP_MAGIC, sizeof(SNAP_MAGIC) - 1) != 0 ||
+	    data[sizeof(SNAP_MAGIC) - 1] != SNAP_VERSION) {
+		talloc_free(data);
+		return -EINVAL;
+	}
+
+	/* make sure all the records are complete up to the end marker */
+	while ((rc = snap_rec_next(data, len, &offset, &rec)) > 0)
+		;
+	if (rc < 0) {
+		talloc_free(data);
+		return -EINVAL;
+	}
+
+	snap->data = data;
+	snap->data_len = len;
+	return 0;
+}
+
+static void snap_release(struct oml_snapshot *snap)
+{
+	osmo_timer_del(&snap->reconcile_timer);
+	osmo_timer_del(&snap->bsc_timer);
+	TALLOC_FREE(snap->data);
+	snap->data_len = 0;
+	snap->warm = false;
+	snap->si_stale = 0;
+}
+
+static int snap_apply_bts(struct gsm_bts *bts, const struct snap_rec *rec)
+{
+	struct tlv_parsed tp;
+	uint16_t arfcn;
+
+	if (oml_tlv_parse(&tp, rec->val, rec->len) < 0)
+		return -EINVAL;
+	if (!TLVP_PRES_LEN(&tp, NM_ATT_BSIC, 1) || !TLVP_PRES_LEN(&tp, NM_ATT_BCCH_ARFCN, 2))
+		return -EINVAL;
+
+	arfcn = osmo_load16be(TLVP_VAL(&tp, NM_ATT_BCCH_ARFCN));
+	if (arfcn >= 1024)
+		return -EINVAL;
+
+	bts->c0->arfcn = arfcn;
+	bts->bsic = *TLVP_VAL(&tp, NM_ATT_BSIC);
+	bts->bsic_configured = true;
+	return 0;
+}
+
+static int snap_apply_trx(struct gsm_bts_trx *trx, const struct snap_rec *rec)
+{
+	struct tlv_parsed tp;
+	uint16_t arfcn;
+
+	if (oml_tlv_parse(&tp, rec->val, rec->len) < 0)
+		return -EINVAL;
+
+	if (TLVP_PRES_LEN(&tp, NM_ATT_RF_MAXPOWR_R, 1))
+		trx->max_power_red = *TLVP_VAL(&tp, NM_ATT_RF_MAXPOWR_R) * 2;
+
+	if (trx != trx->bts->c0 && TLVP_PRES_LEN(&tp, NM_ATT_ARFCN_LIST, 2)) {
+		arfcn = osmo_load16be(TLVP_VAL(&tp, NM_ATT_ARFCN_LIST));
+		if (arfcn >= 1024)
+			return -EINVAL;
+		trx->arfcn = arfcn;
+	}
+
+	return 0;
+}
+
+static int snap_apply_ts(struct gsm_bts_trx_ts *ts, const struct snap_rec *rec)
+{
+	struct tlv_parsed tp;
+
+	if (oml_tlv_parse(&tp, rec->val, rec->len) < 0)
+		return -EINVAL;
+
+	/* hopping timeslots are left to the regular configuration by the BSC */
+	if (TLVP_PRESENT(&tp, NM_ATT_HSN) || !TLVP_PRES_LEN(&tp, NM_ATT_CHAN_COMB, 1))
+		return 0;
+
+	if (handle_chan_comb(ts, *TLVP_VAL(&tp, NM_ATT_CHAN_COMB)) != 0)
+		return -EINVAL;
+
+	if (TLVP_PRES_LEN(&tp, NM_ATT_TSC, 1)) {
+		ts->tsc_oml = *TLVP_VAL(&tp, NM_ATT_TSC);
+		ts->tsc_oml_configured = true;
+	}
+
+	return 0;
+}
+
+/* Feed a SI from the snapshot through the regular RSL BCCH INFO handling */
+static int snap_apply_si(struct gsm_bts *bts, const struct snap_rec *rec)
+{
+	struct abis_rsl_cchan_hdr *cch;
+	struct msgb *msg;
+
+	if (rec->a >= _MAX_SYSINFO_TYPE || rec->len > sizeof(sysinfo_buf_t))
+		return -EINVAL;
+
+	msg = msgb_alloc_headroom(128, 0, "RSL BCCH INFO (snapshot)");
+	if (!msg)
+		return -ENOMEM;
+
+	cch = (struct abis_rsl_cchan_hdr *) msgb_put(msg, sizeof(*cch));
+	rsl_init_cchan_hdr(cch, RSL_MT_BCCH_INFO);
+	cch->chan_nr = RSL_CHAN_BCCH;
+	msgb_tv_put(msg, RSL_IE_SYSINFO_TYPE, osmo_sitype2rsl(rec->a));
+	msgb_tlv_put(msg, RSL_IE_FULL_BCCH_INFO, rec->len, rec->val);
+	msg->l2h = msg->data;
+
+	return down_rsl(bts->c0, msg);
+}
+
+static int snap_apply(struct gsm_bts *bts)
+{
+	const struct oml_snapshot *snap = &bts->oml_snapshot;
+	struct gsm_bts_trx *trx;
+	struct snap_rec rec;
+	size_t offset = SNAP_HDR_LEN;
+	unsigned int tn;
+	int rc;
+
+	if (snap_rec_find(snap, SNAP_REC_BTS_ATTR, 0, 0, &rec) < 0)
+		return -ENOENT;
+	rc = snap_apply_bts(bts, &rec);
+	if (rc < 0)
+		return rc;
+
+	while (snap_rec_next(snap->data, snap->data_len, &offset, &rec) > 0) {
+		rc = 0;
+		switch (rec.type) {
+		case SNAP_REC_TRX_ATTR:
+			if ((trx = gsm_bts_trx_num(bts, rec.a)) == NULL)
+				return -ENODEV;
+			rc = snap_apply_trx(trx, &rec);
+			break;
+		case SNAP_REC_TRX_ADM:
+			if ((trx = gsm_bts_trx_num(bts, rec.a)) == NULL || rec.len != 1)
+				return -EINVAL;
+			trx->mo.nm_state.administrative = rec.val[0];
+			break;
+		case SNAP_REC_TS_ATTR:
+			if ((trx = gsm_bts_trx_num(bts, rec.a)) == NULL || rec.b >= TRX_NR_TS)
+				return -ENODEV;
+			rc = snap_apply_ts(&trx->ts[rec.b], &rec);
+			break;
+		default:
+			break;
+		}
+		if (rc < 0)
+			return rc;
+	}
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++)
+			gsm_ts_apply_configured_tsc(&trx->ts[tn]);
+	}
+
+	/* the BCCH INFO handling needs the CCCH to be configured above */
+	offset = SNAP_HDR_LEN;
+	while (snap_rec_next(snap->data, snap->data_len, &offset, &rec) > 0) {
+		if (rec.type != SNAP_REC_SI)
+			continue;
+		rc = snap_apply_si(bts, &rec);
+		if (rc < 0)
+			return rc;
+	}
+
+	return 0;
+}
+
+/*! Configure the BTS and its PHY from the snapshot, before Abis is up.
+ *  \returns 0 if the BTS was warm started; negative otherwise */
+int oml_snapshot_warm_start(struct gsm_bts *bts)
+{
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+	int rc;
+
+	if (snap->path == NULL)
+		return -ENOENT;
+
+	if (!bts_internal_flag_get(bts, BTS_INTERNAL_FLAG_WARM_START)) {
+		LOGP(DOML, LOGL_NOTICE, "This BTS model does not support a warm start "
+		     "from the OML snapshot, starting cold\n");
+		return -ENOTSUP;
+	}
+
+	rc = snap_load(bts);
+	if (rc < 0) {
+		LOGP(DOML, rc == -ENOENT ? LOGL_INFO : LOGL_ERROR,
+		     "Cannot load OML snapshot from '%s' (%s), starting cold\n",
+		     snap->path, strerror(-rc));
+		return rc;
+	}
+
+	snap->warm = true;
+	rc = snap_apply(bts);
+	if (rc < 0) {
+		LOGP(DOML, LOGL_ERROR, "Invalid OML snapshot in '%s' (%s), starting cold\n",
+		     snap->path, strerror(-rc));
+		goto err;
+	}
+
+	rc = bts_model_warm_start(bts);
+	if (rc < 0) {
+		LOGP(DOML, LOGL_ERROR, "Failed to warm start the PHY (%d), starting cold\n", rc);
+		goto err;
+	}
+
+	/* all SI are from the snapshot for now, see oml_snapshot_rsl_up() */
+	snap->si_stale = bts->si_valid;
+	/* do not stay on air with a configuration nobody confirms */
+	osmo_timer_schedule(&snap->bsc_timer, OML_SNAPSHOT_BSC_TIMEOUT, 0);
+
+	LOGP(DOML, LOGL_NOTICE, "Warm start from OML snapshot '%s' (ARFCN %u, BSIC %u)\n",
+	     snap->path, bts->c0->arfcn, bts->bsic);
+	return 0;
+
+err:
+	/* whatever was applied is overwritten once the BSC configures us */
+	snap_release(snap);
+	return rc;
+}
+
+/*
+ * reconciling with the BSC
+ */
+
+static int snap_mo_rec(const struct gsm_abis_mo *mo, struct snap_rec *rec)
+{
+	const struct oml_snapshot *snap = &mo->bts->oml_snapshot;
+
+	switch (mo->obj_class) {
+	case NM_OC_BTS:
+		return snap_rec_find(snap, SNAP_REC_BTS_ATTR, 0, 0, rec);
+	case NM_OC_RADIO_CARRIER:
+		return snap_rec_find(snap, SNAP_REC_TRX_ATTR, mo->obj_inst.trx_nr, 0, rec);
+	case NM_OC_CHANNEL:
+		return snap_rec_find(snap, SNAP_REC_TS_ATTR, mo->obj_inst.trx_nr,
+				     mo->obj_inst.ts_nr, rec);
+	default:
+		return -ENOTSUP;
+	}
+}
+
+/* Remove the snapshot the BTS was warm started from, and restart cold */
+static void snap_discard(struct gsm_bts *bts, const char *reason)
+{
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+
+	if (unlink(snap->path) < 0 && errno != ENOENT)
+		LOGP(DOML, LOGL_ERROR, "Failed to remove OML snapshot '%s': %s\n",
+		     snap->path, strerror(errno));
+	snap_release(snap);
+
+	bts_shutdown(bts, reason);
+}
+
+/*! Compare attributes set by the BSC with the snapshot, if running from it.
+ *  \param[in] mo managed object the attributes were set for
+ *  \param[in] tp attributes as received from the BSC */
+void oml_snapshot_rx_attr(const struct gsm_abis_mo *mo, const struct tlv_parsed *tp)
+{
+	struct gsm_bts *bts = mo->bts;
+	struct tlv_parsed tp_snap;
+	struct snap_rec rec;
+	unsigned int i;
+	uint8_t attr;
+
+	if (!bts->oml_snapshot.warm) {
+		oml_snapshot_changed(bts);
+		return;
+	}
+
+	if (snap_mo_rec(mo, &rec) < 0)
+		memset(&tp_snap, 0, sizeof(tp_snap));
+	else if (oml_tlv_parse(&tp_snap, rec.val, rec.len) < 0)
+		memset(&tp_snap, 0, sizeof(tp_snap));
+
+	for (i = 0; i < ARRAY_SIZE(snap_phy_attrs); i++) {
+		attr = snap_phy_attrs[i];
+		if (!TLVP_PRESENT(tp, attr))
+			continue;
+		if (TLVP_PRESENT(&tp_snap, attr) &&
+		    TLVP_LEN(&tp_snap, attr) == TLVP_LEN(tp, attr) &&
+		    memcmp(TLVP_VAL(&tp_snap, attr), TLVP_VAL(tp, attr), TLVP_LEN(tp, attr)) == 0)
+			continue;
+
+		LOGP(DOML, LOGL_NOTICE, "%s: %s differs from the OML snapshot, "
+		     "discarding it and restarting cold\n", mo->name,
+		     get_value_string(abis_nm_att_names, attr));
+		snap_discard(bts, "OML differs from snapshot");
+		return;
+	}
+}
+
+/*! A SI was (re-)sent by the BSC */
+void oml_snapshot_si_refreshed(struct gsm_bts *bts, enum osmo_sysinfo_type osmo_si)
+{
+	bts->oml_snapshot.si_stale &= ~(1 << osmo_si);
+	oml_snapshot_changed(bts);
+}
+
+static void snap_reconcile_timer_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+
+	/* the BSC did not send these SI again, they must not be broadcast */
+	if (snap->si_stale) {
+		LOGP(DOML, LOGL_NOTICE, "Dropping SI not confirmed by the BSC (mask 0x%08x)\n",
+		     snap->si_stale);
+		bts->si_valid &= ~snap->si_stale;
+		osmo_signal_dispatch(SS_GLOBAL, S_NEW_SYSINFO, bts);
+	}
+
+	snap_release(snap);
+	LOGP(DOML, LOGL_NOTICE, "Warm start completed, configuration confirmed by the BSC\n");
+
+	oml_snapshot_changed(bts);
+}
+
+/*! The RSL link of a TRX came up.  Once the BSC had the chance to send all
+ *  the SI on C0, the SI it did not send again are dropped. */
+void oml_snapshot_rsl_up(struct gsm_bts_trx *trx)
+{
+	struct oml_snapshot *snap = &trx->bts->oml_snapshot;
+
+	if (!snap->warm || trx != trx->bts->c0)
+		return;
+
+	osmo_timer_del(&snap->bsc_timer);
+	osmo_timer_schedule(&snap->reconcile_timer, OML_SNAPSHOT_SI_GRACE, 0);
+}
+
+static void snap_bsc_timer_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+
+	LOGP(DOML, LOGL_NOTICE, "RSL of C0 not up %u s after the warm start, "
+	     "discarding the OML snapshot and restarting cold\n", OML_SNAPSHOT_BSC_TIMEOUT);
+	snap_discard(bts, "No BSC after warm start");
+}
+
+/*
+ * setup
+ */
+
+void oml_snapshot_init(struct gsm_bts *bts)
+{
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+
+	osmo_timer_setup(&snap->write_timer, snap_write_timer_cb, bts);
+	osmo_timer_setup(&snap->reconcile_timer, snap_reconcile_timer_cb, bts);
+	osmo_timer_setup(&snap->bsc_timer, snap_bsc_timer_cb, bts);
+}
+
+void oml_snapshot_free(struct gsm_bts *bts)
+{
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+
+	osmo_timer_del(&snap->write_timer);
+	if (snap->writer.running)
+		snap_writer_join(snap);
+	snap_release(snap);
+}
+
+/*! Set the file to persist the configuration to, NULL to disable */
+int oml_snapshot_set_path(struct gsm_bts *bts, const char *path)
+{
+	struct oml_snapshot *snap = &bts->oml_snapshot;
+
+	osmo_timer_del(&snap->write_timer);
+	osmo_talloc_replace_string(bts, &snap->path, path);
+	if (path != NULL && snap->path == NULL)
+		return -ENOMEM;
+
+	oml_snapshot_changed(bts);
+	return 0;
+}
@@ -40,26 +40,24 @@
 #include <osmo-bts/msg_utils.h>
 #include <osmo-bts/l1sap.h>
 
-/* Bitmask containing Allocated Osmux circuit ID. +7 to round up to 8 bit boundary. */
-static uint8_t osmux_cid_bitmap[OSMO_BYTES_FOR_BITS(OSMUX_CID_MAX + 1)];
-
 /*! Find and reserve a free OSMUX cid. Keep state of last allocated CID to
  *  rotate allocated CIDs over time. This helps in letting CIDs unused for some
  *  time after last use.
+ *  \param[in] bts BTS owning the Osmux socket to allocate the cid on
  *  \returns OSMUX cid */
-static int osmux_get_local_cid(void)
+static int osmux_get_local_cid(struct gsm_bts *bts)
 {
-	static uint8_t next_free_osmux_cid_lookup = 0;
+	uint8_t *cid_bitmap = bts->osmux.cid_bitmap;
 	uint8_t start_i, start_j;
 	uint8_t i, j, cid;
 
 	/* i = octet index, j = bit index inside ith octet */
-	start_i = next_free_osmux_cid_lookup >> 3;
-	start_j = next_free_osmux_cid_lookup & 0x07;
+	start_i = bts->osmux.next_free_cid_lookup >> 3;
+	start_j = bts->osmux.next_free_cid_lookup & 0x07;
 
-	for (i = start_i; i < sizeof(osmux_cid_bitmap); i++) {
+	for (i = start_i; i < sizeof(bts->osmux.cid_bitmap); i++) {
 		for (j = start_j; j < 8; j++) {
-			if (osmux_cid_bitmap[i] & (1 << j))
+			if (cid_bitmap[i] & (1 << j))
 				continue;
 			goto found;
 		}
@@ -67,7 +65,7 @@ static int osmux_get_local_cid(void)
 
 	for (i = 0; i <= start_i; i++) {
 		for (j = 0; j < start_j; j++) {
-			if (osmux_cid_bitmap[i] & (1 << j))
+			if (cid_bitmap[i] & (1 << j))
 				continue;
 			goto found;
 		}
@@ -77,20 +75,21 @@ static int osmux_get_local_cid(void)
 	return -1;
 
 found:
-	osmux_cid_bitmap[i] |= (1 << j);
+	cid_bitmap[i] |= (1 << j);
 	cid = (i << 3) | j;
-	next_free_osmux_cid_lookup = (cid + 1) & 0xff;
+	bts->osmux.next_free_cid_lookup = (cid + 1) & 0xff;
 	LOGP(DOSMUX, LOGL_DEBUG,
 		"Allocating Osmux CID %u from pool\n", cid);
 	return cid;
 }
 
 /*! put back a no longer used OSMUX cid.
+ *  \param[in] bts BTS owning the Osmux socket the cid was allocated on
  *  \param[in] osmux_cid OSMUX cid */
-void osmux_put_local_cid(uint8_t osmux_cid)
+static void osmux_put_local_cid(struct gsm_bts *bts, uint8_t osmux_cid)
 {
 	LOGP(DOSMUX, LOGL_DEBUG, "Osmux CID %u is back to the pool\n", osmux_cid);
-	osmux_cid_bitmap[osmux_cid / 8] &= ~(1 << (osmux_cid % 8));
+	bts->osmux.cid_bitmap[osmux_cid / 8] &= ~(1 << (osmux_cid % 8));
 }
 
 /* Deliver OSMUX batch to the remote end */
@@ -416,7 +415,7 @@ static void scheduled_from_osmux_tx_rtp_cb(struct msgb *msg, void *data)
 int lchan_osmux_init(struct gsm_lchan *lchan, uint8_t rtp_payload)
 {
 	struct gsm_bts_trx *trx = lchan->ts->trx;
-	int local_cid = osmux_get_local_cid();
+	int local_cid = osmux_get_local_cid(trx->bts);
 	struct in_addr ia;
 
 	if (local_cid < 0)
@@ -450,7 +449,7 @@ void lchan_osmux_release(struct gsm_lchan *lchan)
 	msgb_queue_free(&lchan->dl_tch_queue);
 	lchan->dl_tch_queue_len = 0;
 
-	osmux_put_local_cid(lchan->abis_ip.osmux.local_cid);
+	osmux_put_local_cid(bts, lchan->abis_ip.osmux.local_cid);
 
 	/* Now the remote / tx part, if ever set (connected): */
 	if (lchan->abis_ip.osmux.in) {
@@ -0,0 +1,231 @@
+/* packet_ring.c: PACKET_MMAP RX/TX rings for raw Ethernet PHY links */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/packet_ring.h>
+
+#define PKT_RING_RX_MAP_LEN	(PKT_RING_BLOCK_SIZE * PKT_RING_RX_BLOCK_NR)
+#define PKT_RING_TX_MAP_LEN	(PKT_RING_BLOCK_SIZE * PKT_RING_TX_BLOCK_NR)
+#define PKT_RING_TX_FRAME_NR	(PKT_RING_TX_MAP_LEN / PKT_RING_FRAME_SIZE)
+/* without PACKET_TX_HAS_OFF the kernel expects the payload right behind the header */
+#define PKT_RING_TX_DATA_OFF	TPACKET_ALIGN(sizeof(struct tpacket2_hdr))
+
+static int pkt_ring_rx_open(struct pkt_ring *ring, uint16_t proto, int ifindex)
+{
+	int version = TPACKET_V3;
+	struct tpacket_req3 req = {
+		.tp_block_size = PKT_RING_BLOCK_SIZE,
+		.tp_block_nr = PKT_RING_RX_BLOCK_NR,
+		.tp_frame_size = PKT_RING_FRAME_SIZE,
+		.tp_frame_nr = PKT_RING_RX_MAP_LEN / PKT_RING_FRAME_SIZE,
+		.tp_retire_blk_tov = PKT_RING_RX_RETIRE_MS,
+	};
+	struct sockaddr_ll sa = {
+		.sll_family = AF_PACKET,
+		.sll_protocol = htons(proto),
+		.sll_ifindex = ifindex,
+	};
+
+	/* bind only after the ring exists, so that no frame ends up in the socket queue */
+	ring->rx_fd = socket(AF_PACKET, SOCK_DGRAM, 0);
+	if (ring->rx_fd < 0)
+		return -errno;
+	if (setsockopt(ring->rx_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+		return -errno;
+	if (setsockopt(ring->rx_fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+		return -errno;
+
+	ring->rx_map = mmap(NULL, PKT_RING_RX_MAP_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, ring->rx_fd, 0);
+	if (ring->rx_map == MAP_FAILED) {
+		ring->rx_map = NULL;
+		return -errno;
+	}
+
+	if (bind(ring->rx_fd, (struct sockaddr *) &sa, sizeof(sa)) < 0)
+		return -errno;
+
+	return 0;
+}
+
+static int pkt_ring_tx_open(struct pkt_ring *ring)
+{
+	int version = TPACKET_V2;
+	struct tpacket_req req = {
+		.tp_block_size = PKT_RING_BLOCK_SIZE,
+		.tp_block_nr = PKT_RING_TX_BLOCK_NR,
+		.tp_frame_size = PKT_RING_FRAME_SIZE,
+		.tp_frame_nr = PKT_RING_TX_FRAME_NR,
+	};
+
+	/* protocol 0: this socket never receives, the destination is given on flush */
+	ring->tx_fd = socket(AF_PACKET, SOCK_DGRAM, 0);
+	if (ring->tx_fd < 0)
+		return -errno;
+	if (setsockopt(ring->tx_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+		return -errno;
+	if (setsockopt(ring->tx_fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0)
+		return -errno;
+
+	ring->tx_map = mmap(NULL, PKT_RING_TX_MAP_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, ring->tx_fd, 0);
+	if (ring->tx_map == MAP_FAILED) {
+		ring->tx_map = NULL;
+		return -errno;
+	}
+
+	return 0;
+}
+
+/*! Set up the RX and TX rings for a packet link.
+ *  \param[out] ring the rings to set up
+ *  \param[in] proto link-layer protocol in host byte order
+ *  \param[in] ifindex interface to receive from
+ *  \returns 0 on success; negative errno on error, ring is closed then.
+ *  The caller waits for OSMO_FD_READ on ring->rx_fd and calls pkt_ring_rx(). */
+int pkt_ring_open(struct pkt_ring *ring, uint16_t proto, int ifindex)
+{
+	int rc;
+
+	memset(ring, 0, sizeof(*ring));
+	ring->rx_fd = ring->tx_fd = -1;
+
+	rc = pkt_ring_rx_open(ring, proto, ifindex);
+	if (rc < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to set up TPACKET_V3 RX ring: %s\n", strerror(-rc));
+		goto err;
+	}
+
+	rc = pkt_ring_tx_open(ring);
+	if (rc < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to set up TPACKET_V2 TX ring: %s\n", strerror(-rc));
+		goto err;
+	}
+
+	return 0;
+err:
+	pkt_ring_close(ring);
+	return rc;
+}
+
+void pkt_ring_close(struct pkt_ring *ring)
+{
+	if (ring->rx_map)
+		munmap(ring->rx_map, PKT_RING_RX_MAP_LEN);
+	if (ring->rx_fd >= 0)
+		close(ring->rx_fd);
+	if (ring->tx_map)
+		munmap(ring->tx_map, PKT_RING_TX_MAP_LEN);
+	if (ring->tx_fd >= 0)
+		close(ring->tx_fd);
+
+	memset(ring, 0, sizeof(*ring));
+	ring->rx_fd = ring->tx_fd = -1;
+}
+
+/*! Process all frames of all RX blocks the kernel has handed over.
+ *  \returns number of frames passed to rx_cb */
+int pkt_ring_rx(struct pkt_ring *ring, pkt_ring_rx_cb_t *rx_cb, void *data)
+{
+	struct tpacket_block_desc *bd;
+	struct tpacket3_hdr *ppd;
+	struct sockaddr_ll *sll;
+	unsigned int i, num_pkts;
+	int count = 0;
+
+	while (1) {
+		bd = (struct tpacket_block_desc *) (ring->rx_map + ring->rx_block_cur * PKT_RING_BLOCK_SIZE);
+		if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+			break;
+
+		num_pkts = bd->hdr.bh1.num_pkts;
+		ppd = (struct tpacket3_hdr *) ((uint8_t *) bd + bd->hdr.bh1.offset_to_first_pkt);
+		for (i = 0; i < num_pkts; i++) {
+			sll = (struct sockaddr_ll *) ((uint8_t *) ppd + TPACKET_ALIGN(sizeof(*ppd)));
+			/* frames sent through our own TX ring socket are looped back to us */
+			if (sll->sll_pkttype != PACKET_OUTGOING) {
+				/* SOCK_DGRAM: the link-layer header is already stripped */
+				rx_cb(data, (uint8_t *) ppd + ppd->tp_mac, ppd->tp_snaplen);
+				count++;
+			}
+			ppd = (struct tpacket3_hdr *) ((uint8_t *) ppd + ppd->tp_next_offset);
+		}
+
+		/* hand the block back to the kernel */
+		__atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+		ring->rx_block_cur = (ring->rx_block_cur + 1) % PKT_RING_RX_BLOCK_NR;
+	}
+
+	return count;
+}
+
+/*! Copy a frame into the next free slot of the TX ring, it is sent by pkt_ring_tx_flush().
+ *  \returns 0 on success; -ENOSPC if the ring is full; -EMSGSIZE if the frame is too big */
+int pkt_ring_tx_put(struct pkt_ring *ring, const uint8_t *buf, size_t len)
+{
+	struct tpacket2_hdr *hdr;
+
+	if (len > PKT_RING_FRAME_SIZE - PKT_RING_TX_DATA_OFF)
+		return -EMSGSIZE;
+
+	hdr = (struct tpacket2_hdr *) (ring->tx_map + ring->tx_frame_cur * PKT_RING_FRAME_SIZE);
+	switch (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE)) {
+	case TP_STATUS_AVAILABLE:
+		break;
+	case TP_STATUS_WRONG_FORMAT:
+		LOGP(DL1C, LOGL_ERROR, "Kernel rejected frame in TX ring\n");
+		break;
+	default:
+		/* still owned by the kernel */
+		return -ENOSPC;
+	}
+
+	memcpy((uint8_t *) hdr + PKT_RING_TX_DATA_OFF, buf, len);
+	hdr->tp_len = len;
+	__atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+	ring->tx_frame_cur = (ring->tx_frame_cur + 1) % PKT_RING_TX_FRAME_NR;
+	ring->tx_pending++;
+	return 0;
+}
+
+/*! Let the kernel send all frames put into the TX ring with a single syscall.
+ *  \returns number of bytes sent; negative errno on error */
+int pkt_ring_tx_flush(struct pkt_ring *ring, const struct sockaddr_ll *dst)
+{
+	ssize_t rc;
+
+	if (ring->tx_pending == 0)
+		return 0;
+
+	rc = sendto(ring->tx_fd, NULL, 0, MSG_DONTWAIT, (const struct sockaddr *) dst, sizeof(*dst));
+	if (rc < 0)
+		return -errno;
+
+	ring->tx_pending = 0;
+	return rc;
+}
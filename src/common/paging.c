@@ -32,10 +32,12 @@
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/core/timer.h>
 
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 #include <osmocom/gsm/gsm0502.h>
 #include <osmocom/gsm/gsm48.h>
+#include <osmocom/gsm/protocol/gsm_12_21.h>
 
 #include <osmo-bts/bts.h>
 #include <osmo-bts/rsl.h>
@@ -44,9 +46,15 @@
 #include <osmo-bts/signal.h>
 #include <osmo-bts/pcu_if.h>
 #include <osmo-bts/notification.h>
+#include <osmo-bts/oml.h>
 
 #define MAX_PAGING_BLOCKS_CCCH	9
 #define MAX_BS_PA_MFRMS		9
+#define PAGING_BATCH_MAX	64
+#define PAGING_DEFERRED_MAX	64
+/* The TBF timing and TFI of a deferred IMMEDIATE ASSIGNMENT from the PCU go
+ * stale quickly, the PCU does not wait for the MS forever. */
+#define PAGING_DEFERRED_LIFETIME	5 /* seconds */
 
 enum paging_record_type {
 	PAGING_RECORD_NORMAL,
@@ -66,6 +74,8 @@ struct paging_record {
 			uint8_t msg[GSM_MACBLOCK_LEN];
 			bool confirm;
 			uint32_t msg_id; /* used as identifier for confirmation */
+			uint16_t paging_group;
+			time_t expiration_time; /* only while deferred, CLOCK_MONOTONIC */
 		} macblock;
 	} u;
 };
@@ -75,6 +85,8 @@ struct paging_state {
 
 	/* parameters taken / interpreted from BCCH/CCCH configuration */
 	struct gsm48_control_channel_descr chan_desc;
+	/* paging sub-channel by position in BS_PA_MFRMS 51-multiframes, see paging_sched_update() */
+	int8_t pag_subch[MAX_BS_PA_MFRMS][51];
 
 	/* configured otherwise */
 	unsigned int paging_lifetime; /* in seconds */
@@ -87,16 +99,28 @@ struct paging_state {
 	/* prioritization of cs pagings will automatically become
 	 * active on congestions (queue almost full) */
 	bool cs_priority_active;
+
+	/* PS MAC blocks held back while cs_priority_active, see paging_add_macblocks() */
+	struct llist_head deferred;
+	unsigned int num_deferred;
+
+	/* identities pending batched admission, see paging_enqueue_identity() */
+	struct paging_identity pending[PAGING_BATCH_MAX];
+	unsigned int num_pending;
+	struct osmo_timer_list pending_timer;
 };
 
 /* The prioritization of cs pagings is controlled by a hysteresis. When the
  * fill state of the paging queue exceeds the upper fill level
  * THRESHOLD_CONGESTED [%], then PS pagings (immediate assignments and pagings
- * from the PCU) will be dropped until fill state of the paging queue drops
- * under the lower fill level THRESHOLD_CLEAR [%]. */
+ * from the PCU) will be deferred until fill state of the paging queue drops
+ * under the lower fill level THRESHOLD_CLEAR [%]. Beyond PAGING_DEFERRED_MAX
+ * of them, or after PAGING_DEFERRED_LIFETIME, they are dropped. */
 #define THRESHOLD_CONGESTED 66 /* (percent of num_paging_max) */
 #define THRESHOLD_CLEAR 50 /* (percent of num_paging_max) */
 
+static void paging_admit_deferred(struct paging_state *ps);
+
 /* Check the queue fill status and decide if prioritization of CS pagings
  * must be turned on to flatten the negative effects of the congestion
  * situation on the CS domain. */
@@ -110,8 +134,10 @@ static void check_congestion(struct paging_state *ps)
 	if (pag_queue_len > treshold_upper && ps->cs_priority_active == false) {
 		ps->cs_priority_active = true;
 		rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_CONG);
-	} else if (pag_queue_len < treshold_lower)
+	} else if (pag_queue_len < treshold_lower) {
 		ps->cs_priority_active = false;
+		paging_admit_deferred(ps);
+	}
 }
 
 unsigned int paging_get_lifetime(struct paging_state *ps)
@@ -166,10 +192,10 @@ static const uint8_t block_by_tdma51[51] = {
 	255,			/* empty */
 };
 
-/* get the paging block number _within_ current 51 multiframe */
-static int get_pag_idx_n(struct paging_state *ps, struct gsm_time *gt)
+/* get the paging block number _within_ a 51 multiframe */
+static int get_pag_idx_n(struct paging_state *ps, unsigned int t3)
 {
-	int blk_n = block_by_tdma51[gt->t3];
+	int blk_n = block_by_tdma51[t3];
 	int blk_idx;
 
 	if (blk_n == 255)
@@ -182,19 +208,27 @@ static int get_pag_idx_n(struct paging_state *ps, struct gsm_time *gt)
 	return blk_idx;
 }
 
-/* get paging block index over multiple 51 multiframes */
-static int get_pag_subch_nr(struct paging_state *ps, struct gsm_time *gt)
+/* resolve the paging block index over multiple 51 multiframes for each TDMA frame */
+static void paging_sched_update(struct paging_state *ps)
 {
-	int pag_idx = get_pag_idx_n(ps, gt);
 	unsigned int n_pag_blks_51 = gsm0502_get_n_pag_blocks(&ps->chan_desc);
-	unsigned int mfrm_part;
+	unsigned int mfrm, t3;
+	int pag_idx;
 
-	if (pag_idx < 0)
-		return pag_idx;
+	for (mfrm = 0; mfrm < ARRAY_SIZE(ps->pag_subch); mfrm++) {
+		for (t3 = 0; t3 < ARRAY_SIZE(ps->pag_subch[mfrm]); t3++) {
+			pag_idx = get_pag_idx_n(ps, t3);
+			ps->pag_subch[mfrm][t3] = pag_idx < 0 ? -1 : pag_idx + mfrm * n_pag_blks_51;
+		}
+	}
+}
 
-	mfrm_part = ((gt->fn / 51) % (ps->chan_desc.bs_pa_mfrms+2)) * n_pag_blks_51;
+/* get paging block index over multiple 51 multiframes */
+static int get_pag_subch_nr(struct paging_state *ps, struct gsm_time *gt)
+{
+	int8_t group = ps->pag_subch[(gt->fn / 51) % (ps->chan_desc.bs_pa_mfrms+2)][gt->t3];
 
-	return pag_idx + mfrm_part;
+	return group < 0 ? -EINVAL : group;
 }
 
 int paging_buffer_space(struct paging_state *ps)
@@ -205,31 +239,23 @@ int paging_buffer_space(struct paging_state *ps)
 		return ps->num_paging_max - ps->num_paging;
 }
 
-/* Add an identity to the paging queue */
-int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
-			const uint8_t *identity_lv, uint8_t chan_needed)
+/* Insert an identity into the queue of its paging group. Admission control
+ * (congestion check, rate counters) is up to the caller. */
+static int _paging_add_identity(struct paging_state *ps, uint8_t paging_group,
+				const uint8_t *identity_lv, uint8_t chan_needed)
 {
 	struct llist_head *group_q = &ps->paging_queue[paging_group];
 	int blocks = gsm48_number_of_paging_subchannels(&ps->chan_desc);
 	struct paging_record *pr;
 
-	check_congestion(ps);
-
-	rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_RCVD);
-
 	if (paging_group >= blocks) {
 		LOGP(DPAG, LOGL_ERROR, "BSC Send PAGING for group %u, but number of paging "
 			"sub-channels is only %u\n", paging_group, blocks);
-		rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_DROP);
 		return -EINVAL;
 	}
 
-	if (ps->num_paging >= ps->num_paging_max) {
-		LOGP(DPAG, LOGL_NOTICE, "Dropping paging, queue full (%u)\n",
-			ps->num_paging);
-		rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_DROP);
+	if (ps->num_paging >= ps->num_paging_max)
 		return -ENOSPC;
-	}
 
 	/* Check if we already have this identity */
 	llist_for_each_entry(pr, group_q, list) {
@@ -270,6 +296,126 @@ int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
 	return 0;
 }
 
+/* Add an identity to the paging queue */
+int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
+			const uint8_t *identity_lv, uint8_t chan_needed)
+{
+	int rc;
+
+	check_congestion(ps);
+
+	rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_RCVD);
+
+	rc = _paging_add_identity(ps, paging_group, identity_lv, chan_needed);
+	switch (rc) {
+	case -ENOSPC:
+		LOGP(DPAG, LOGL_NOTICE, "Dropping paging, queue full (%u)\n",
+			ps->num_paging);
+		/* fall through */
+	case -EINVAL:
+		rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_DROP);
+		break;
+	}
+
+	return rc;
+}
+
+/* Add a batch of identities to the paging queue. The congestion check and the
+ * rate counter updates are done once for the whole batch. When the queue runs
+ * full, the remainder of the batch is dropped and counted in *num_full. */
+static unsigned int _paging_add_identities(struct paging_state *ps, const struct paging_identity *ids,
+					   unsigned int num_ids, unsigned int *num_full)
+{
+	unsigned int i, num_added = 0, num_invalid = 0;
+	int rc;
+
+	*num_full = 0;
+	if (num_ids == 0)
+		return 0;
+
+	check_congestion(ps);
+
+	rate_ctr_add2(ps->bts->ctrs, BTS_CTR_PAGING_RCVD, num_ids);
+
+	for (i = 0; i < num_ids; i++) {
+		rc = _paging_add_identity(ps, ids[i].paging_group, ids[i].identity_lv, ids[i].chan_needed);
+		if (rc == -ENOSPC) {
+			*num_full = num_ids - i;
+			break;
+		}
+		if (rc == 0)
+			num_added++;
+		else if (rc == -EINVAL)
+			num_invalid++;
+	}
+
+	if (*num_full > 0) {
+		LOGP(DPAG, LOGL_NOTICE, "Dropping %u of %u pagings, queue full (%u)\n",
+			*num_full, num_ids, ps->num_paging);
+	}
+	if (num_invalid + *num_full > 0)
+		rate_ctr_add2(ps->bts->ctrs, BTS_CTR_PAGING_DROP, num_invalid + *num_full);
+
+	return num_added;
+}
+
+int paging_add_identities(struct paging_state *ps, const struct paging_identity *ids, unsigned int num_ids)
+{
+	unsigned int num_full;
+
+	return _paging_add_identities(ps, ids, num_ids, &num_full);
+}
+
+/* Queue an identity for batched admission. All identities queued during one
+ * main loop iteration (e.g. from several RSL PAGING COMMANDs read in one go)
+ * are admitted to the paging queue together by paging_flush_identities(). */
+int paging_enqueue_identity(struct paging_state *ps, uint8_t paging_group,
+			    const uint8_t *identity_lv, uint8_t chan_needed)
+{
+	struct paging_identity *id;
+
+	if (*identity_lv + 1 > sizeof(id->identity_lv))
+		return -E2BIG;
+
+	if (ps->num_pending >= ARRAY_SIZE(ps->pending))
+		paging_flush_identities(ps);
+
+	id = &ps->pending[ps->num_pending++];
+	id->paging_group = paging_group;
+	id->chan_needed = chan_needed;
+	memcpy(id->identity_lv, identity_lv, identity_lv[0]+1);
+
+	/* flush at the end of the current main loop iteration */
+	if (!osmo_timer_pending(&ps->pending_timer))
+		osmo_timer_schedule(&ps->pending_timer, 0, 0);
+
+	return 0;
+}
+
+void paging_flush_identities(struct paging_state *ps)
+{
+	unsigned int num_pending = ps->num_pending;
+	unsigned int num_full;
+
+	osmo_timer_del(&ps->pending_timer);
+	if (num_pending == 0)
+		return;
+	ps->num_pending = 0;
+
+	_paging_add_identities(ps, ps->pending, num_pending, &num_full);
+	if (num_full > 0) {
+		oml_tx_failure_event_rep(&ps->bts->mo, NM_SEVER_WARNING,
+					 OSMO_EVT_MIN_PAG_TAB_FULL, "BTS paging table is full");
+	}
+}
+
+static void paging_pending_timer_cb(void *data)
+{
+	struct paging_state *ps = data;
+
+	paging_flush_identities(ps);
+}
+
 /* Convert the last three digits of a given IMSI string to their decimal representation. In case the given IMSI string
  * is shorter than three or zero digits, it will be assumed as "000" */
 static uint16_t convert_imsi_to_decimal(const char *imsi)
@@ -291,43 +437,133 @@ static uint16_t convert_imsi_to_decimal(const char *imsi)
 	return _imsi;
 }
 
-/* Add a ready formatted MAC block message to the paging queue, this can be an IMMEDIATE ASSIGNMENT, or a
- * PAGING COMMAND (from the PCU) */
-int paging_add_macblock(struct paging_state *ps, uint32_t msg_id, const char *imsi, bool confirm, const uint8_t *macblock)
+static struct paging_record *paging_macblock_alloc(struct paging_state *ps, uint32_t msg_id, const char *imsi,
+						    bool confirm, const uint8_t *macblock)
 {
-	struct llist_head *group_q;
 	struct paging_record *pr;
-	uint16_t paging_group;
 	uint16_t _imsi;
 
-	check_congestion(ps);
-
-	if (ps->cs_priority_active) {
-		LOGP(DPAG, LOGL_NOTICE, "Dropping paging for PS, queue congested (%u)\n",
-			ps->num_paging);
-		rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_DROP_PS);
-		return -ENOSPC;
-	}
-
-	_imsi = convert_imsi_to_decimal(imsi);
-	paging_group = gsm0502_calc_paging_group(&ps->chan_desc, _imsi);
-	group_q = &ps->paging_queue[paging_group];
-
 	pr = talloc_zero(ps, struct paging_record);
 	if (!pr)
-		return -ENOMEM;
+		return NULL;
 	pr->type = PAGING_RECORD_MACBLOCK;
 
-	LOGP(DPAG, LOGL_INFO, "Add MAC block to paging queue (group=%u)\n",
-		paging_group);
+	_imsi = convert_imsi_to_decimal(imsi);
 	memcpy(pr->u.macblock.msg, macblock, GSM_MACBLOCK_LEN);
 	pr->u.macblock.confirm = confirm;
 	pr->u.macblock.msg_id = msg_id;
+	pr->u.macblock.paging_group = gsm0502_calc_paging_group(&ps->chan_desc, _imsi);
+
+	return pr;
+}
+
+static void paging_macblock_enqueue(struct paging_state *ps, struct paging_record *pr)
+{
+	LOGP(DPAG, LOGL_INFO, "Add MAC block to paging queue (group=%u)\n",
+		pr->u.macblock.paging_group);
 
 	/* enqueue the new message to the HEAD of the queue */
-	llist_add(&pr->list, group_q);
+	llist_add(&pr->list, &ps->paging_queue[pr->u.macblock.paging_group]);
+}
 
-	return 0;
+static time_t paging_monotonic_time(void)
+{
+	struct timespec now;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
+/* The congestion is over, admit the deferred MAC blocks in the order they were received */
+static void paging_admit_deferred(struct paging_state *ps)
+{
+	struct paging_record *pr, *pr2;
+	unsigned int num_expired = 0;
+	time_t now;
+
+	if (ps->num_deferred == 0)
+		return;
+
+	now = paging_monotonic_time();
+	llist_for_each_entry_safe(pr, pr2, &ps->deferred, list) {
+		llist_del(&pr->list);
+		if (pr->u.macblock.expiration_time <= now) {
+			talloc_free(pr);
+			num_expired++;
+			continue;
+		}
+		paging_macblock_enqueue(ps, pr);
+	}
+
+	LOGP(DPAG, LOGL_INFO, "Admitting %u deferred pagings for PS, %u expired\n",
+		ps->num_deferred - num_expired, num_expired);
+	if (num_expired > 0)
+		rate_ctr_add2(ps->bts->ctrs, BTS_CTR_PAGING_DROP_PS, num_expired);
+	ps->num_deferred = 0;
+}
+
+/* Add a ready formatted MAC block message to the paging queue, this can be an IMMEDIATE ASSIGNMENT, or a
+ * PAGING COMMAND (from the PCU). Like a batch of one, see paging_add_macblocks(). */
+int paging_add_macblock(struct paging_state *ps, uint32_t msg_id, const char *imsi, bool confirm, const uint8_t *macblock)
+{
+	const struct paging_macblock mb = {
+		.msg_id = msg_id,
+		.imsi = imsi,
+		.confirm = confirm,
+		.macblock = macblock,
+	};
+	int rc;
+
+	rc = paging_add_macblocks(ps, &mb, 1);
+	if (rc < 0)
+		return rc;
+	return rc == 1 ? 0 : -ENOMEM;
+}
+
+/* Add a batch of ready formatted MAC blocks to the paging queue. The congestion
+ * check is done once for the whole batch. While CS pagings are prioritized, the
+ * MAC blocks are deferred until the congestion is over, and only dropped once
+ * PAGING_DEFERRED_MAX of them are waiting, or when they expired meanwhile. */
+int paging_add_macblocks(struct paging_state *ps, const struct paging_macblock *mbs, unsigned int num_mbs)
+{
+	struct paging_record *pr;
+	unsigned int i, num_added = 0, num_deferred = 0;
+
+	if (num_mbs == 0)
+		return 0;
+
+	check_congestion(ps);
+
+	for (i = 0; i < num_mbs; i++) {
+		if (ps->cs_priority_active && ps->num_deferred >= PAGING_DEFERRED_MAX)
+			break;
+		pr = paging_macblock_alloc(ps, mbs[i].msg_id, mbs[i].imsi, mbs[i].confirm, mbs[i].macblock);
+		if (!pr)
+			continue;
+		if (ps->cs_priority_active) {
+			pr->u.macblock.expiration_time = paging_monotonic_time() + PAGING_DEFERRED_LIFETIME;
+			llist_add_tail(&pr->list, &ps->deferred);
+			ps->num_deferred++;
+			num_deferred++;
+		} else {
+			paging_macblock_enqueue(ps, pr);
+		}
+		num_added++;
+	}
+
+	if (num_deferred > 0) {
+		LOGP(DPAG, LOGL_NOTICE, "Deferring %u pagings for PS, queue congested (%u)\n",
+			num_deferred, ps->num_paging);
+	}
+	if (i < num_mbs) {
+		LOGP(DPAG, LOGL_NOTICE, "Dropping %u pagings for PS, queue congested (%u), %u deferred\n",
+			num_mbs - i, ps->num_paging, ps->num_deferred);
+		rate_ctr_add2(ps->bts->ctrs, BTS_CTR_PAGING_DROP_PS, num_mbs - i);
+		if (num_added == 0)
+			return -ENOSPC;
+	}
+
+	return num_added;
 }
 
 #define L2_PLEN(len)	(((len - 1) << 2) | 0x01)
@@ -734,7 +970,7 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 							GSM_MACBLOCK_LEN);
 			/* send a confirmation back (if required) */
 			if (pr[num_pr]->u.macblock.confirm)
-				pcu_tx_data_cnf(pr[num_pr]->u.macblock.msg_id, PCU_IF_SAPI_PCH_2);
+				pcu_tx_data_cnf(bts, pr[num_pr]->u.macblock.msg_id, PCU_IF_SAPI_PCH_2);
 			talloc_free(pr[num_pr]);
 			return GSM_MACBLOCK_LEN;
 		}
@@ -837,6 +1073,7 @@ int paging_si_update(struct paging_state *ps, struct gsm48_control_channel_descr
 	LOGP(DPAG, LOGL_INFO, "Paging SI update\n");
 
 	ps->chan_desc = *chan_desc;
+	paging_sched_update(ps);
 
 	/* FIXME: do we need to re-sort the old paging_records? */
 
@@ -876,6 +1113,10 @@ struct paging_state *paging_init(struct gsm_bts *bts,
 
 	for (i = 0; i < ARRAY_SIZE(ps->paging_queue); i++)
 		INIT_LLIST_HEAD(&ps->paging_queue[i]);
+	INIT_LLIST_HEAD(&ps->deferred);
+
+	osmo_timer_setup(&ps->pending_timer, paging_pending_timer_cb, ps);
+	paging_sched_update(ps);
 
 	if (!initialized) {
 		osmo_signal_register_handler(SS_GLOBAL, paging_signal_cbfn, NULL);
@@ -894,11 +1135,20 @@ void paging_config(struct paging_state *ps,
 
 void paging_reset(struct paging_state *ps)
 {
+	struct paging_record *pr, *pr2;
 	int i;
 
+	osmo_timer_del(&ps->pending_timer);
+	ps->num_pending = 0;
+
+	llist_for_each_entry_safe(pr, pr2, &ps->deferred, list) {
+		llist_del(&pr->list);
+		talloc_free(pr);
+	}
+	ps->num_deferred = 0;
+
 	for (i = 0; i < ARRAY_SIZE(ps->paging_queue); i++) {
 		struct llist_head *queue = &ps->paging_queue[i];
-		struct paging_record *pr, *pr2;
 		llist_for_each_entry_safe(pr, pr2, queue, list) {
 			llist_del(&pr->list);
 			talloc_free(pr);
@@ -926,3 +1176,11 @@ int paging_queue_length(struct paging_state *ps)
 {
 	return ps->num_paging;
 }
+
+/**
+ * \brief Helper for the unit tests
+ */
+int paging_deferred_length(struct paging_state *ps)
+{
+	return ps->num_deferred;
+}
@@ -0,0 +1,234 @@
+/* pcu_shm.c: Shared memory rings towards the PCU */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/pcu_if.h>
+#include <osmo-bts/pcu_shm.h>
+
+/* one slot holds any primitive, rounded up to a full cache line */
+#define PCU_SHM_SLOT_SIZE \
+	((sizeof(struct gsm_pcu_if_shm_slot) + sizeof(struct gsm_pcu_if) + PCU_IF_SHM_CACHELINE - 1) \
+	 / PCU_IF_SHM_CACHELINE * PCU_IF_SHM_CACHELINE)
+
+static size_t ring_size(uint32_t num_slots)
+{
+	return sizeof(struct gsm_pcu_if_shm_ring) + num_slots * PCU_SHM_SLOT_SIZE;
+}
+
+static void ring_init(struct gsm_pcu_if_shm_ring *ring, uint32_t num_slots)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->num_slots = num_slots;
+	ring->slot_size = PCU_SHM_SLOT_SIZE;
+}
+
+/* the layout in the shared memory may be overwritten by the PCU, only trust our own copy */
+static struct gsm_pcu_if_shm_slot *ring_slot(const struct pcu_shm *shm, struct gsm_pcu_if_shm_ring *ring,
+					     uint32_t idx)
+{
+	return (struct gsm_pcu_if_shm_slot *) &ring->slots[(idx & (shm->num_slots - 1)) * PCU_SHM_SLOT_SIZE];
+}
+
+/* Create the shared memory with both rings and the eventfds for notification */
+struct pcu_shm *pcu_shm_alloc(void *ctx, uint32_t num_slots)
+{
+	struct pcu_shm *shm;
+	uint32_t n;
+
+	if (num_slots == 0)
+		num_slots = PCU_SHM_NUM_SLOTS_DEFAULT;
+	num_slots = OSMO_MIN(num_slots, PCU_SHM_NUM_SLOTS_MAX);
+	/* round up to a power of two, so that free running indexes can be masked */
+	for (n = 1; n < num_slots; n <<= 1);
+	num_slots = n;
+
+	shm = talloc_zero(ctx, struct pcu_shm);
+	if (!shm)
+		return NULL;
+	shm->mem_fd = shm->tx_efd = shm->rx_efd = -1;
+	shm->mem = MAP_FAILED;
+	shm->num_slots = num_slots;
+	shm->size = 2 * ring_size(num_slots);
+
+	shm->mem_fd = memfd_create("osmo-bts-pcu", MFD_CLOEXEC);
+	if (shm->mem_fd < 0) {
+		LOGP(DPCU, LOGL_ERROR, "Failed to create shared memory: %s\n", strerror(errno));
+		goto error;
+	}
+	if (ftruncate(shm->mem_fd, shm->size) < 0) {
+		LOGP(DPCU, LOGL_ERROR, "Failed to size shared memory to %zu bytes: %s\n",
+		     shm->size, strerror(errno));
+		goto error;
+	}
+	shm->mem = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->mem_fd, 0);
+	if (shm->mem == MAP_FAILED) {
+		LOGP(DPCU, LOGL_ERROR, "Failed to map shared memory: %s\n", strerror(errno));
+		goto error;
+	}
+
+	shm->tx_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	shm->rx_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (shm->tx_efd < 0 || shm->rx_efd < 0) {
+		LOGP(DPCU, LOGL_ERROR, "Failed to create eventfd: %s\n", strerror(errno));
+		goto error;
+	}
+
+	shm->tx = (struct gsm_pcu_if_shm_ring *) shm->mem;
+	shm->rx = (struct gsm_pcu_if_shm_ring *) (shm->mem + ring_size(num_slots));
+	ring_init(shm->tx, num_slots);
+	ring_init(shm->rx, num_slots);
+
+	return shm;
+
+error:
+	pcu_shm_free(shm);
+	return NULL;
+}
+
+void pcu_shm_free(struct pcu_shm *shm)
+{
+	if (!shm)
+		return;
+	if (shm->mem != MAP_FAILED)
+		munmap(shm->mem, shm->size);
+	if (shm->mem_fd >= 0)
+		close(shm->mem_fd);
+	if (shm->tx_efd >= 0)
+		close(shm->tx_efd);
+	if (shm->rx_efd >= 0)
+		close(shm->rx_efd);
+	talloc_free(shm);
+}
+
+/* Describe the layout of the shared memory in a PCU_IF_MSG_SHM_CNF */
+void pcu_shm_fill_cnf(const struct pcu_shm *shm, struct gsm_pcu_if_shm *cnf)
+{
+	memset(cnf, 0, sizeof(*cnf));
+	cnf->version = PCU_IF_SHM_VERSION;
+	cnf->num_slots = shm->num_slots;
+	cnf->slot_size = PCU_SHM_SLOT_SIZE;
+	cnf->size = shm->size;
+	cnf->ring_offset[0] = (uint8_t *) shm->tx - shm->mem;
+	cnf->ring_offset[1] = (uint8_t *) shm->rx - shm->mem;
+}
+
+/* Return the next free slot of the TX ring, so that a primitive can be encoded
+ * in place, NULL if the PCU did not consume enough of the ring yet. The slot
+ * holds any primitive. It is handed to the PCU by pcu_shm_commit(), nothing
+ * else may be pushed in between. */
+struct gsm_pcu_if *pcu_shm_reserve(struct pcu_shm *shm)
+{
+	struct gsm_pcu_if_shm_ring *ring = shm->tx;
+
+	if (shm->tx_head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= shm->num_slots)
+		return NULL;
+
+	return (struct gsm_pcu_if *) ring_slot(shm, ring, shm->tx_head)->prim;
+}
+
+/* Publish the slot returned by pcu_shm_reserve(), holding len bytes */
+void pcu_shm_commit(struct pcu_shm *shm, size_t len)
+{
+	struct gsm_pcu_if_shm_slot *slot = ring_slot(shm, shm->tx, shm->tx_head);
+
+	OSMO_ASSERT(len <= PCU_SHM_SLOT_SIZE - sizeof(*slot));
+	slot->len = len;
+
+	shm->tx_head++;
+	__atomic_store_n(&shm->tx->head, shm->tx_head, __ATOMIC_RELEASE);
+}
+
+/* Copy a primitive into the next free slot of the TX ring. Returns -ENOSPC if
+ * the PCU did not consume enough of the ring yet. */
+int pcu_shm_push(struct pcu_shm *shm, const struct gsm_pcu_if *pcu_prim, size_t len)
+{
+	struct gsm_pcu_if *slot_prim;
+
+	if (len > PCU_SHM_SLOT_SIZE - sizeof(struct gsm_pcu_if_shm_slot))
+		return -EMSGSIZE;
+	slot_prim = pcu_shm_reserve(shm);
+	if (!slot_prim)
+		return -ENOSPC;
+
+	memcpy(slot_prim, pcu_prim, len);
+	pcu_shm_commit(shm, len);
+	return 0;
+}
+
+/* Return the oldest primitive of the RX ring in place, NULL if the ring is
+ * empty. The slot stays owned by the BTS until pcu_shm_pop() is called. */
+struct gsm_pcu_if *pcu_shm_peek(struct pcu_shm *shm, size_t *len)
+{
+	struct gsm_pcu_if_shm_ring *ring = shm->rx;
+	struct gsm_pcu_if_shm_slot *slot;
+	uint16_t slot_len;
+
+	while (shm->rx_tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+		slot = ring_slot(shm, ring, shm->rx_tail);
+		slot_len = slot->len;
+		if (slot_len >= PCUIF_HDR_SIZE && slot_len <= PCU_SHM_SLOT_SIZE - sizeof(*slot)) {
+			*len = slot_len;
+			return (struct gsm_pcu_if *) slot->prim;
+		}
+		LOGP(DPCU, LOGL_ERROR, "Received primitive of %u bytes on PCU shared memory, discarding\n",
+		     slot_len);
+		pcu_shm_pop(shm);
+	}
+
+	return NULL;
+}
+
+void pcu_shm_pop(struct pcu_shm *shm)
+{
+	shm->rx_tail++;
+	__atomic_store_n(&shm->rx->tail, shm->rx_tail, __ATOMIC_RELEASE);
+}
+
+/* Tell the PCU that the BTS produced into or consumed from the rings */
+int pcu_shm_signal(const struct pcu_shm *shm)
+{
+	uint64_t val = 1;
+
+	if (write(shm->tx_efd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		return -errno;
+	return 0;
+}
+
+/* Reset the eventfd signalled by the PCU before draining the rings */
+int pcu_shm_ack(const struct pcu_shm *shm)
+{
+	uint64_t val;
+
+	if (read(shm->rx_efd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		return -errno;
+	return 0;
+}
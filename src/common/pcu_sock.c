@@ -32,12 +32,15 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/socket.h>
 #include <osmocom/core/write_queue.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/bit16gen.h>
 #include <osmocom/gsm/gsm23003.h>
 #include <osmocom/gsm/abis_nm.h>
 #include <osmo-bts/logging.h>
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/pcu_if.h>
 #include <osmo-bts/pcuif_proto.h>
+#include <osmo-bts/pcu_shm.h>
 #include <osmo-bts/bts.h>
 #include <osmo-bts/bts_sm.h>
 #include <osmo-bts/rsl.h>
@@ -49,7 +52,8 @@
 uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx);
 
 int pcu_direct = 0;
-static int avail_lai = 0, avail_nse = 0, avail_cell = 0, avail_nsvc[2] = {0, 0};
+/* NSE and NSVCs are shared by all BTS of the site, LAI and cell are in bts->pcu */
+static int avail_nse = 0, avail_nsvc[2] = {0, 0};
 
 static const char *sapi_string[] = {
 	[PCU_IF_SAPI_RACH] =	"RACH",
@@ -81,6 +85,9 @@ struct msgb *pcu_msgb_alloc(uint8_t msg_type, uint8_t bts_nr)
 	return msg;
 }
 
+static struct gsm_pcu_if *pcu_prim_alloc(uint8_t msg_type, uint8_t bts_nr, size_t len, struct msgb **msg);
+static int pcu_prim_send(struct gsm_pcu_if *pcu_prim, struct msgb *msg, size_t len);
+
 static bool ts_should_be_pdch(const struct gsm_bts_trx_ts *ts)
 {
 	switch (ts->pchan) {
@@ -249,22 +256,24 @@ static enum gsm_pcuif_bts_model bts_model_from_variant(enum gsm_bts_type_variant
 	}
 }
 
-int pcu_tx_info_ind(void)
+static bool pcu_bts_avail(const struct gsm_bts *bts)
+{
+	return bts->pcu.avail_lai && avail_nse && bts->pcu.avail_cell && avail_nsvc[0];
+}
+
+static int pcu_tx_info_ind_bts(struct gsm_bts *bts)
 {
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
 	struct gsm_pcu_if_info_ind *info_ind;
-	struct gsm_bts *bts;
 	struct gprs_rlc_cfg *rlcc;
 	struct gsm_bts_trx *trx;
 	int i;
 	struct gsm_gprs_nse *nse;
 
-	LOGP(DPCU, LOGL_INFO, "Sending info\n");
+	LOGP(DPCU, LOGL_INFO, "Sending info for BTS %u\n", bts->nr);
 
 	nse = &g_bts_sm->gprs.nse;
-	/* FIXME: allow multiple BTS */
-	bts = llist_entry(g_bts_sm->bts_list.next, struct gsm_bts, list);
 	rlcc = &bts->gprs.cell.rlc_cfg;
 
 	msg = pcu_msgb_alloc(PCU_IF_MSG_INFO_IND, bts->nr);
@@ -274,14 +283,17 @@ int pcu_tx_info_ind(void)
 	info_ind = &pcu_prim->u.info_ind;
 	info_ind->version = PCU_IF_VERSION;
 
-	if (avail_lai && avail_nse && avail_cell && avail_nsvc[0]) {
+	if (pcu_bts_avail(bts)) {
 		info_ind->flags |= PCU_IF_FLAG_ACTIVE;
-		LOGP(DPCU, LOGL_INFO, "BTS is up\n");
+		LOGP(DPCU, LOGL_INFO, "BTS %u is up\n", bts->nr);
 	} else
-		LOGP(DPCU, LOGL_INFO, "BTS is down\n");
+		LOGP(DPCU, LOGL_INFO, "BTS %u is down\n", bts->nr);
 
 	if (pcu_direct)
 		info_ind->flags |= PCU_IF_FLAG_DIRECT_PHY;
+	info_ind->flags |= PCU_IF_FLAG_PCH_BATCH;
+	info_ind->flags |= PCU_IF_FLAG_BATCH;
+	info_ind->flags |= PCU_IF_FLAG_SHM;
 
 	info_ind->bsic = bts->bsic;
 	/* RAI */
@@ -382,6 +394,20 @@ int pcu_tx_info_ind(void)
 	return pcu_sock_send(msg);
 }
 
+/* Send an INFO.ind for each BTS, the PCU tells them apart by bts_nr */
+int pcu_tx_info_ind(void)
+{
+	struct gsm_bts *bts;
+	int rc = 0;
+
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+		if (pcu_tx_info_ind_bts(bts) < 0)
+			rc = -EIO;
+	}
+
+	return rc;
+}
+
 static int pcu_if_signal_cb(unsigned int subsys, unsigned int signal,
 	void *hdlr_data, void *signal_data)
 {
@@ -403,15 +429,16 @@ static int pcu_if_signal_cb(unsigned int subsys, unsigned int signal,
 		osmo_plmn_from_bcd(si3->lai.digits, &g_bts_sm->plmn);
 		bts->location_area_code = ntohs(si3->lai.lac);
 		bts->cell_identity = ntohs(si3->cell_identity);
-		avail_lai = 1;
+		bts->pcu.avail_lai = true;
 		break;
 	case S_NEW_NSE_ATTR:
-		bts = signal_data;
 		avail_nse = 1;
+		/* the NSE is shared, all BTS may have become available */
+		bts = NULL;
 		break;
 	case S_NEW_CELL_ATTR:
 		bts = signal_data;
-		avail_cell = 1;
+		bts->pcu.avail_cell = true;
 		break;
 	case S_NEW_NSVC_ATTR:
 		nsvc = signal_data;
@@ -419,8 +446,10 @@ static int pcu_if_signal_cb(unsigned int subsys, unsigned int signal,
 		if (id < 0 || id > 1)
 			return -EINVAL;
 		avail_nsvc[id] = 1;
+		bts = NULL;
 		break;
 	case S_NEW_OP_STATE:
+		bts = NULL;
 		break;
 	default:
 		return -EINVAL;
@@ -432,8 +461,15 @@ static int pcu_if_signal_cb(unsigned int subsys, unsigned int signal,
 
 	/* If all infos have been received, of if one info is updated after
 	 * all infos have been received, transmit info update. */
-	if (avail_lai && avail_nse && avail_cell && avail_nsvc[0])
-		pcu_tx_info_ind();
+	if (bts) {
+		if (pcu_bts_avail(bts))
+			pcu_tx_info_ind_bts(bts);
+		return 0;
+	}
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+		if (pcu_bts_avail(bts))
+			pcu_tx_info_ind_bts(bts);
+	}
 	return 0;
 }
 
@@ -470,10 +506,10 @@ int pcu_tx_rts_req(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 	LOGP(DPCU, LOGL_DEBUG, "Sending rts request: is_ptcch=%d arfcn=%d "
 		"block=%d\n", is_ptcch, arfcn, block_nr);
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_RTS_REQ, bts->nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_RTS_REQ, bts->nr,
+				  PCUIF_HDR_SIZE + sizeof(pcu_prim->u.rts_req), &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	rts_req = &pcu_prim->u.rts_req;
 
 	rts_req->sapi = (is_ptcch) ? PCU_IF_SAPI_PTCCH : PCU_IF_SAPI_PDTCH;
@@ -483,7 +519,7 @@ int pcu_tx_rts_req(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 	rts_req->ts_nr = ts->nr;
 	rts_req->block_nr = block_nr;
 
-	return pcu_sock_send(msg);
+	return pcu_prim_send(pcu_prim, msg, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.rts_req));
 }
 
 int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t sapi, uint32_t fn,
@@ -498,10 +534,10 @@ int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t sapi, uint32_t fn,
 	LOGP(DPCU, LOGL_DEBUG, "Sending data indication: sapi=%s arfcn=%d block=%d data=%s\n",
 	     sapi_string[sapi], arfcn, block_nr, osmo_hexdump(data, len));
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_DATA_IND, bts->nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_DATA_IND, bts->nr,
+				  PCUIF_HDR_SIZE + sizeof(pcu_prim->u.data_ind), &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	data_ind = &pcu_prim->u.data_ind;
 
 	data_ind->sapi = sapi;
@@ -518,7 +554,7 @@ int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t sapi, uint32_t fn,
 		memcpy(data_ind->data, data, len);
 	data_ind->len = len;
 
-	return pcu_sock_send(msg);
+	return pcu_prim_send(pcu_prim, msg, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.data_ind));
 }
 
 int pcu_tx_rach_ind(uint8_t bts_nr, uint8_t trx_nr, uint8_t ts_nr,
@@ -532,10 +568,10 @@ int pcu_tx_rach_ind(uint8_t bts_nr, uint8_t trx_nr, uint8_t ts_nr,
 	LOGP(DPCU, LOGL_INFO, "Sending RACH indication: qta=%d, ra=%d, "
 		"fn=%d\n", qta, ra, fn);
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_RACH_IND, bts_nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_RACH_IND, bts_nr,
+				  PCUIF_HDR_SIZE + sizeof(pcu_prim->u.rach_ind), &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	rach_ind = &pcu_prim->u.rach_ind;
 
 	rach_ind->sapi = sapi;
@@ -547,10 +583,10 @@ int pcu_tx_rach_ind(uint8_t bts_nr, uint8_t trx_nr, uint8_t ts_nr,
 	rach_ind->trx_nr = trx_nr;
 	rach_ind->ts_nr = ts_nr;
 
-	return pcu_sock_send(msg);
+	return pcu_prim_send(pcu_prim, msg, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.rach_ind));
 }
 
-int pcu_tx_time_ind(uint32_t fn)
+int pcu_tx_time_ind(const struct gsm_bts *bts, uint32_t fn)
 {
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
@@ -561,15 +597,15 @@ int pcu_tx_time_ind(uint32_t fn)
 	if (fn13 != 0 && fn13 != 4 && fn13 != 8)
 		return 0;
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_TIME_IND, 0);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_TIME_IND, bts->nr,
+				  PCUIF_HDR_SIZE + sizeof(pcu_prim->u.time_ind), &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	time_ind = &pcu_prim->u.time_ind;
 
 	time_ind->fn = fn;
 
-	return pcu_sock_send(msg);
+	return pcu_prim_send(pcu_prim, msg, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.time_ind));
 }
 
 int pcu_tx_interf_ind(const struct gsm_bts_trx *trx, uint32_t fn)
@@ -579,10 +615,10 @@ int pcu_tx_interf_ind(const struct gsm_bts_trx *trx, uint32_t fn)
 	struct msgb *msg;
 	unsigned int tn;
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_INTERF_IND, trx->bts->nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_INTERF_IND, trx->bts->nr,
+				  PCUIF_HDR_SIZE + sizeof(pcu_prim->u.interf_ind), &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	interf_ind = &pcu_prim->u.interf_ind;
 
 	interf_ind->trx_nr = trx->nr;
@@ -602,10 +638,10 @@ int pcu_tx_interf_ind(const struct gsm_bts_trx *trx, uint32_t fn)
 		interf_ind->interf[tn] = -1 * lchan->meas.interf_meas_avg_dbm;
 	}
 
-	return pcu_sock_send(msg);
+	return pcu_prim_send(pcu_prim, msg, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.interf_ind));
 }
 
-int pcu_tx_pag_req(const uint8_t *identity_lv, uint8_t chan_needed)
+int pcu_tx_pag_req(const struct gsm_bts *bts, const uint8_t *identity_lv, uint8_t chan_needed)
 {
 	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
 	struct msgb *msg;
@@ -626,7 +662,7 @@ int pcu_tx_pag_req(const uint8_t *identity_lv, uint8_t chan_needed)
 		return 0;
 	}
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_PAG_REQ, 0);
+	msg = pcu_msgb_alloc(PCU_IF_MSG_PAG_REQ, bts->nr);
 	if (!msg)
 		return -ENOMEM;
 	pcu_prim = (struct gsm_pcu_if *) msg->data;
@@ -638,28 +674,24 @@ int pcu_tx_pag_req(const uint8_t *identity_lv, uint8_t chan_needed)
 	return pcu_sock_send(msg);
 }
 
-int pcu_tx_data_cnf(uint32_t msg_id, uint8_t sapi)
+int pcu_tx_data_cnf(const struct gsm_bts *bts, uint32_t msg_id, uint8_t sapi)
 {
-	struct gsm_bts *bts;
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
 
-	/* FIXME: allow multiple BTS */
-	bts = llist_entry(g_bts_sm->bts_list.next, struct gsm_bts, list);
-
 	LOGP(DPCU, LOGL_DEBUG, "Sending DATA.cnf: sapi=%s msg_id=%08x\n",
 	     sapi_string[sapi], msg_id);
 
-	msg = pcu_msgb_alloc(PCU_IF_MSG_DATA_CNF_2, bts->nr);
-	if (!msg)
+	pcu_prim = pcu_prim_alloc(PCU_IF_MSG_DATA_CNF_2, bts->nr,
+				  PCUIF_HDR_SIZE + sizeof(pcu_prim->u.data_cnf2), &msg);
+	if (!pcu_prim)
 		return -ENOMEM;
-	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	pcu_prim->u.data_cnf2 = (struct gsm_pcu_if_data_cnf) {
 		.sapi = sapi,
 		.msg_id = msg_id,
 	};
 
-	return pcu_sock_send(msg);
+	return pcu_prim_send(pcu_prim, msg, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.data_cnf2));
 }
 
 /* forward data from a RR GPRS SUSPEND REQ towards PCU */
@@ -727,6 +759,7 @@ static int pcu_rx_data_req(struct gsm_bts *bts, uint8_t msg_type,
 		msg_cb = (struct bts_agch_msg_cb *) msg->cb;
 		msg_cb->confirm = gsm_pcu_if_agch->confirm;
 		msg_cb->msg_id = gsm_pcu_if_agch->msg_id;
+		msg_cb->is_ps = true;
 		if (bts_agch_enqueue(bts, msg) < 0) {
 			msgb_free(msg);
 			rc = -EIO;
@@ -792,6 +825,29 @@ static int pcu_rx_pag_req(struct gsm_bts *bts, uint8_t msg_type,
 	return rc;
 }
 
+static int pcu_rx_pch_batch(struct gsm_bts *bts, const struct gsm_pcu_if_pch_batch *batch)
+{
+	struct paging_macblock mbs[PCU_IF_PCH_BATCH_MAX];
+	unsigned int i;
+	int rc;
+
+	LOGP(DPCU, LOGL_DEBUG, "PCH batch received: num_pch=%u\n", batch->num_pch);
+
+	for (i = 0; i < batch->num_pch; i++) {
+		const struct gsm_pcu_if_pch *pch = &batch->pch[i];
+
+		mbs[i] = (struct paging_macblock) {
+			.msg_id = pch->msg_id,
+			.imsi = pch->imsi,
+			.confirm = pch->confirm,
+			.macblock = pch->data,
+		};
+	}
+
+	rc = paging_add_macblocks(bts->paging_state, mbs, batch->num_pch);
+	return rc < 0 ? rc : 0;
+}
+
 int pcu_tx_si(const struct gsm_bts *bts, enum osmo_sysinfo_type si_type,
 	      bool enable)
 {
@@ -874,6 +930,8 @@ static int pcu_rx_txt_ind(struct gsm_bts *bts,
 			/* patch SI to advertise GPRS, *if* the SI sent by BSC said so */
 			regenerate_si3_restoctets(bts);
 			regenerate_si4_restoctets(bts);
+			/* SI13 is only scheduled while a PCU is connected */
+			bts_sysinfo_sched_update(bts);
 
 			if (pcu_tx_si_all(bts) < 0)
 				rc = -EINVAL;
@@ -934,6 +992,63 @@ static int pcu_rx_act_req(struct gsm_bts *bts,
 	return 0;
 }
 
+static int pcu_rx(uint8_t msg_type, struct gsm_pcu_if *pcu_prim, size_t prim_len);
+static void pcu_sock_batch_enable(uint8_t version);
+static int pcu_sock_shm_setup(const struct gsm_pcu_if_shm *req);
+
+static int pcu_rx_batch(struct gsm_pcu_if_batch *batch, size_t batch_len)
+{
+	size_t data_len = osmo_load16be(&batch->length);
+	uint8_t *cur = batch->data;
+	unsigned int i;
+	int rc = 0;
+
+	if (batch->version != PCU_IF_BATCH_VERSION) {
+		LOGP(DPCU, LOGL_ERROR, "Received batch with unsupported version %u (expected %u), discarding\n",
+		     batch->version, PCU_IF_BATCH_VERSION);
+		return -EINVAL;
+	}
+	if (sizeof(*batch) + data_len > batch_len) {
+		LOGP(DPCU, LOGL_ERROR, "Received %zu bytes of batch, but batch size is %zu, discarding\n",
+		     batch_len, sizeof(*batch) + data_len);
+		return -EINVAL;
+	}
+
+	/* The PCU supports batching, coalesce the primitives towards it from now on */
+	pcu_sock_batch_enable(batch->version);
+
+	for (i = 0; i < batch->num_prims; i++) {
+		struct gsm_pcu_if *pcu_prim;
+		size_t prim_len;
+
+		if (data_len < sizeof(uint16_t))
+			goto malformed;
+		prim_len = osmo_load16be(cur);
+		cur += sizeof(uint16_t);
+		data_len -= sizeof(uint16_t);
+		if (prim_len < PCUIF_HDR_SIZE || prim_len > data_len)
+			goto malformed;
+
+		pcu_prim = (struct gsm_pcu_if *) cur;
+		if (pcu_prim->msg_type == PCU_IF_MSG_BATCH) {
+			LOGP(DPCU, LOGL_ERROR, "Received nested batch, discarding\n");
+			rc = -EINVAL;
+		} else if (pcu_rx(pcu_prim->msg_type, pcu_prim, prim_len) < 0) {
+			rc = -EINVAL;
+		}
+
+		cur += prim_len;
+		data_len -= prim_len;
+	}
+
+	return rc;
+
+malformed:
+	LOGP(DPCU, LOGL_ERROR, "Received malformed batch (primitive %u of %u), discarding remainder\n",
+	     i, batch->num_prims);
+	return -EINVAL;
+}
+
 #define CHECK_IF_MSG_SIZE(prim_len, prim_msg) \
 	do { \
 		size_t _len = PCUIF_HDR_SIZE + sizeof(prim_msg); \
@@ -969,6 +1084,32 @@ static int pcu_rx(uint8_t msg_type, struct gsm_pcu_if *pcu_prim, size_t prim_len
 		ENSURE_BTS_OBJECT(bts);
 		rc = pcu_rx_pag_req(bts, msg_type, &pcu_prim->u.pag_req);
 		break;
+	case PCU_IF_MSG_BATCH:
+		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.batch);
+		rc = pcu_rx_batch(&pcu_prim->u.batch, prim_len - PCUIF_HDR_SIZE);
+		break;
+	case PCU_IF_MSG_SHM_REQ:
+		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.shm);
+		rc = pcu_sock_shm_setup(&pcu_prim->u.shm);
+		break;
+	case PCU_IF_MSG_PCH_BATCH:
+		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.pch_batch);
+		ENSURE_BTS_OBJECT(bts);
+		/* ^ check if we can access batch fields, v check with number of entries */
+		if (pcu_prim->u.pch_batch.num_pch > PCU_IF_PCH_BATCH_MAX) {
+			LOGP(DPCU, LOGL_ERROR, "Received PCH batch with %u entries (max %u), discarding\n",
+			     pcu_prim->u.pch_batch.num_pch, PCU_IF_PCH_BATCH_MAX);
+			return -EINVAL;
+		}
+		exp_len = PCUIF_HDR_SIZE + sizeof(pcu_prim->u.pch_batch)
+			  + pcu_prim->u.pch_batch.num_pch * sizeof(pcu_prim->u.pch_batch.pch[0]);
+		if (prim_len < exp_len) {
+			LOGP(DPCU, LOGL_ERROR, "Received %zu bytes on PCU Socket, but primitive "
+			     "PCH batch size is %zu, discarding\n", prim_len, exp_len);
+			return -EINVAL;
+		}
+		rc = pcu_rx_pch_batch(bts, &pcu_prim->u.pch_batch);
+		break;
 	case PCU_IF_MSG_ACT_REQ:
 		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.act_req);
 		ENSURE_BTS_OBJECT(bts);
@@ -1011,19 +1152,405 @@ static int pcu_rx(uint8_t msg_type, struct gsm_pcu_if *pcu_prim, size_t prim_len
  * PCU socket interface
  */
 
+/* maximum size of a PCU_IF_MSG_BATCH message */
+#define PCU_IF_BATCH_MAX_LEN	8192
+
 struct pcu_sock_state {
 	struct osmo_fd listen_bfd;	/* fd for listen socket */
 	struct osmo_wqueue upqueue;	/* For sending messages; has fd for conn. to PCU */
+
+	/* PCU_IF_MSG_BATCH, enabled once the PCU sent a batch itself */
+	bool batch_enabled;
+	struct msgb *batch_msg;		/* batch being filled, NULL if none */
+	struct osmo_timer_list batch_timer; /* flushes batch_msg at the latest at the end of the main loop iteration */
+
+	/* shared memory transport, requested by the PCU and active once the CNF was sent */
+	struct pcu_shm *shm;
+	bool shm_active;
+	struct osmo_fd shm_bfd;		/* eventfd signalled by the PCU */
+	struct llist_head shm_backlog;	/* primitives that did not fit into the TX ring */
+	unsigned int shm_backlog_len;
+	unsigned int shm_dropped;	/* dropped since the backlog overflowed */
+	struct osmo_timer_list shm_timer; /* signals the PCU at the end of the main loop iteration */
 };
 
 static void pcu_sock_close(struct pcu_sock_state *state);
 
+static int pcu_sock_enqueue(struct pcu_sock_state *state, struct msgb *msg)
+{
+	int rc;
+
+	rc = osmo_wqueue_enqueue(&state->upqueue, msg);
+	if (rc < 0) {
+		if (rc == -ENOSPC)
+			LOGP(DPCU, LOGL_NOTICE, "PCU not reacting (more than %u messages waiting). Closing connection\n",
+			     state->upqueue.max_length);
+		pcu_sock_close(state);
+		msgb_free(msg);
+		return rc;
+	}
+	return 0;
+}
+
+/* Size of a primitive without the unused trailing part of the union */
+static size_t pcu_prim_len(const struct gsm_pcu_if *pcu_prim, size_t len)
+{
+	switch (pcu_prim->msg_type) {
+	case PCU_IF_MSG_TIME_IND:
+		return PCUIF_HDR_SIZE + sizeof(pcu_prim->u.time_ind);
+	case PCU_IF_MSG_RTS_REQ:
+		return PCUIF_HDR_SIZE + sizeof(pcu_prim->u.rts_req);
+	case PCU_IF_MSG_DATA_IND:
+		return PCUIF_HDR_SIZE + sizeof(pcu_prim->u.data_ind);
+	case PCU_IF_MSG_DATA_CNF_2:
+		return PCUIF_HDR_SIZE + sizeof(pcu_prim->u.data_cnf2);
+	case PCU_IF_MSG_RACH_IND:
+		return PCUIF_HDR_SIZE + sizeof(pcu_prim->u.rach_ind);
+	case PCU_IF_MSG_INTERF_IND:
+		return PCUIF_HDR_SIZE + sizeof(pcu_prim->u.interf_ind);
+	default:
+		return len;
+	}
+}
+
+static void pcu_sock_batch_flush(struct pcu_sock_state *state)
+{
+	struct msgb *msg = state->batch_msg;
+	struct gsm_pcu_if *pcu_prim;
+
+	osmo_timer_del(&state->batch_timer);
+	if (!msg)
+		return;
+	state->batch_msg = NULL;
+
+	pcu_prim = (struct gsm_pcu_if *) msg->data;
+	osmo_store16be(msgb_length(msg) - PCUIF_HDR_SIZE - sizeof(pcu_prim->u.batch),
+		       &pcu_prim->u.batch.length);
+
+	pcu_sock_enqueue(state, msg);
+}
+
+static void pcu_sock_batch_timer_cb(void *data)
+{
+	struct pcu_sock_state *state = data;
+
+	pcu_sock_batch_flush(state);
+}
+
+static void pcu_sock_batch_enable(uint8_t version)
+{
+	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
+
+	/* primitives on the shared memory rings are never batched */
+	if (!state || state->batch_enabled || state->shm)
+		return;
+
+	LOGP(DPCU, LOGL_INFO, "PCU supports batched primitives (v%u), enabling\n", version);
+	state->batch_enabled = true;
+}
+
+/* Append a primitive to the batch of the current TDMA frame.  A TIME.ind opens
+ * the batch of its frame, so that the primitives of consecutive frames handled
+ * in one main loop iteration (e.g. osmo-bts-trx catching up) are not merged.
+ * batch_timer sends the batch at the end of the main loop iteration at the
+ * latest, so nothing waits for the next TIME.ind. */
+static int pcu_sock_batch_append(struct pcu_sock_state *state, struct msgb *msg)
+{
+	const struct gsm_pcu_if *pcu_prim = (struct gsm_pcu_if *) msg->data;
+	size_t len = pcu_prim_len(pcu_prim, msgb_length(msg));
+	struct gsm_pcu_if *batch_prim;
+
+	/* primitives that will never fit are sent as they are, preserving the order */
+	if (PCUIF_HDR_SIZE + sizeof(batch_prim->u.batch) + sizeof(uint16_t) + len > PCU_IF_BATCH_MAX_LEN) {
+		pcu_sock_batch_flush(state);
+		return pcu_sock_enqueue(state, msg);
+	}
+
+	if (state->batch_msg) {
+		batch_prim = (struct gsm_pcu_if *) state->batch_msg->data;
+		if (pcu_prim->msg_type == PCU_IF_MSG_TIME_IND ||
+		    msgb_tailroom(state->batch_msg) < sizeof(uint16_t) + len ||
+		    batch_prim->u.batch.num_prims == UINT8_MAX)
+			pcu_sock_batch_flush(state);
+	}
+
+	/* flushing may have closed the connection */
+	if (state->upqueue.bfd.fd < 0) {
+		msgb_free(msg);
+		return -EIO;
+	}
+
+	if (!state->batch_msg) {
+		state->batch_msg = msgb_alloc(PCU_IF_BATCH_MAX_LEN, "pcu_sock_tx_batch");
+		if (!state->batch_msg) {
+			msgb_free(msg);
+			return -ENOMEM;
+		}
+		batch_prim = (struct gsm_pcu_if *) msgb_put(state->batch_msg,
+							    PCUIF_HDR_SIZE + sizeof(batch_prim->u.batch));
+		memset(batch_prim, 0, PCUIF_HDR_SIZE + sizeof(batch_prim->u.batch));
+		batch_prim->msg_type = PCU_IF_MSG_BATCH;
+		batch_prim->u.batch.version = PCU_IF_BATCH_VERSION;
+		osmo_timer_schedule(&state->batch_timer, 0, 0);
+	}
+
+	batch_prim = (struct gsm_pcu_if *) state->batch_msg->data;
+	osmo_store16be(len, msgb_put(state->batch_msg, sizeof(uint16_t)));
+	memcpy(msgb_put(state->batch_msg, len), pcu_prim, len);
+	batch_prim->u.batch.num_prims++;
+
+	msgb_free(msg);
+	return 0;
+}
+
+static void pcu_sock_shm_kick(struct pcu_sock_state *state)
+{
+	if (!osmo_timer_pending(&state->shm_timer))
+		osmo_timer_schedule(&state->shm_timer, 0, 0);
+}
+
+static void pcu_sock_shm_timer_cb(void *data)
+{
+	struct pcu_sock_state *state = data;
+	int rc;
+
+	rc = pcu_shm_signal(state->shm);
+	if (rc < 0)
+		LOGP(DPCU, LOGL_ERROR, "Failed to signal PCU shared memory: %s\n", strerror(-rc));
+}
+
+/* Move as much of the backlog into the TX ring as the PCU made room for */
+static void pcu_sock_shm_drain(struct pcu_sock_state *state)
+{
+	struct msgb *msg;
+	unsigned int num = 0;
+
+	while (!llist_empty(&state->shm_backlog)) {
+		msg = llist_first_entry(&state->shm_backlog, struct msgb, list);
+		if (pcu_shm_push(state->shm, (struct gsm_pcu_if *) msg->data, msgb_length(msg)) == -ENOSPC)
+			break;
+		llist_del(&msg->list);
+		state->shm_backlog_len--;
+		msgb_free(msg);
+		num++;
+	}
+
+	if (num)
+		pcu_sock_shm_kick(state);
+	if (state->shm_dropped && llist_empty(&state->shm_backlog)) {
+		LOGP(DPCU, LOGL_NOTICE, "PCU is consuming the shared memory ring again, %u messages were dropped\n",
+		     state->shm_dropped);
+		state->shm_dropped = 0;
+	}
+}
+
+static int pcu_sock_shm_send(struct pcu_sock_state *state, struct msgb *msg)
+{
+	struct gsm_pcu_if *pcu_prim = (struct gsm_pcu_if *) msg->data;
+	size_t len = pcu_prim_len(pcu_prim, msgb_length(msg));
+	int rc;
+
+	/* store the primitive truncated, the backlog is pushed as it is */
+	msgb_trim(msg, len);
+
+	if (llist_empty(&state->shm_backlog)) {
+		rc = pcu_shm_push(state->shm, pcu_prim, len);
+		if (rc != -ENOSPC) {
+			/* can't happen: a slot holds any primitive, and batches
+			 * are never sent through the rings */
+			if (rc < 0)
+				LOGP(DPCU, LOGL_ERROR, "Cannot send primitive 0x%02x (%zu bytes) through PCU shared "
+				     "memory, dropping\n", pcu_prim->msg_type, len);
+			else
+				pcu_sock_shm_kick(state);
+			msgb_free(msg);
+			return rc;
+		}
+	}
+
+	/* The PCU is lagging behind, keep the primitive until it consumed the ring
+	 * instead of closing the connection. Drop it if the PCU does not catch up. */
+	if (state->shm_backlog_len >= state->upqueue.max_length) {
+		if (state->shm_dropped++ == 0)
+			LOGP(DPCU, LOGL_NOTICE, "PCU not consuming the shared memory ring (more than %u messages "
+			     "waiting), dropping messages\n", state->upqueue.max_length);
+		msgb_free(msg);
+		return -ENOSPC;
+	}
+	msgb_enqueue(&state->shm_backlog, msg);
+	state->shm_backlog_len++;
+	return 0;
+}
+
+/* Start a primitive of len bytes: in place in the next slot of the shared memory
+ * TX ring if possible, in a msgb (returned in *msg) otherwise. Hand it over with
+ * pcu_prim_send(), nothing else may be sent in between. */
+static struct gsm_pcu_if *pcu_prim_alloc(uint8_t msg_type, uint8_t bts_nr, size_t len, struct msgb **msg)
+{
+	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
+	struct gsm_pcu_if *pcu_prim = NULL;
+
+	*msg = NULL;
+	/* the backlog goes first, see pcu_sock_shm_drain() */
+	if (state && state->shm_active && llist_empty(&state->shm_backlog))
+		pcu_prim = pcu_shm_reserve(state->shm);
+	if (!pcu_prim) {
+		*msg = pcu_msgb_alloc(msg_type, bts_nr);
+		if (!*msg)
+			return NULL;
+		pcu_prim = (struct gsm_pcu_if *) (*msg)->data;
+	}
+
+	memset(pcu_prim, 0, len);
+	pcu_prim->msg_type = msg_type;
+	pcu_prim->bts_nr = bts_nr;
+	return pcu_prim;
+}
+
+static int pcu_prim_send(struct gsm_pcu_if *pcu_prim, struct msgb *msg, size_t len)
+{
+	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
+
+	if (msg)
+		return pcu_sock_send(msg);
+
+	pcu_shm_commit(state->shm, len);
+	pcu_sock_shm_kick(state);
+	return 0;
+}
+
+/* The PCU produced into or consumed from the rings */
+static int pcu_sock_shm_read(struct osmo_fd *bfd, unsigned int flags)
+{
+	struct pcu_sock_state *state = bfd->data;
+	struct gsm_pcu_if *pcu_prim;
+	size_t len;
+	unsigned int num = 0;
+	int rc;
+
+	rc = pcu_shm_ack(state->shm);
+	if (rc < 0) {
+		LOGP(DPCU, LOGL_ERROR, "Failed to read PCU shared memory eventfd: %s\n", strerror(-rc));
+		pcu_sock_close(state);
+		return -1;
+	}
+
+	/* process the primitives in place, the slot is released afterwards */
+	while ((pcu_prim = pcu_shm_peek(state->shm, &len))) {
+		pcu_rx(pcu_prim->msg_type, pcu_prim, len);
+		/* processing may have closed the connection */
+		if (!state->shm_active)
+			return 0;
+		pcu_shm_pop(state->shm);
+		num++;
+	}
+
+	if (num)
+		pcu_sock_shm_kick(state);
+	pcu_sock_shm_drain(state);
+
+	return 0;
+}
+
+static int pcu_sock_shm_setup(const struct gsm_pcu_if_shm *req)
+{
+	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
+	struct gsm_pcu_if *pcu_prim;
+	struct msgb *msg;
+
+	if (!state)
+		return -EINVAL;
+	if (state->shm) {
+		LOGP(DPCU, LOGL_ERROR, "PCU requests shared memory, but it is already set up, ignoring\n");
+		return -EALREADY;
+	}
+
+	msg = pcu_msgb_alloc(PCU_IF_MSG_SHM_CNF, 0);
+	if (!msg)
+		return -ENOMEM;
+	pcu_prim = (struct gsm_pcu_if *) msg->data;
+	msgb_trim(msg, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.shm));
+	memset(&pcu_prim->u.shm, 0, sizeof(pcu_prim->u.shm));
+
+	if (req->version != PCU_IF_SHM_VERSION) {
+		LOGP(DPCU, LOGL_NOTICE, "PCU requests shared memory v%u, but only v%u is supported, rejecting\n",
+		     req->version, PCU_IF_SHM_VERSION);
+	} else {
+		state->shm = pcu_shm_alloc(state, req->num_slots);
+		if (state->shm)
+			pcu_shm_fill_cnf(state->shm, &pcu_prim->u.shm);
+	}
+
+	/* the CNF is queued behind everything sent so far, the transport is
+	 * switched once it is actually written to the socket.  Primitives
+	 * following the CNF are queued one by one until then, so that
+	 * pcu_sock_shm_handover() can move each of them into a slot. */
+	pcu_sock_batch_flush(state);
+	if (state->shm)
+		state->batch_enabled = false;
+	return pcu_sock_enqueue(state, msg);
+}
+
+/* Send the CNF along with the file descriptors and switch to the rings */
+static int pcu_sock_shm_handover(struct pcu_sock_state *state, int fd, struct msgb *msg)
+{
+	struct pcu_shm *shm = state->shm;
+	int fds[3] = { shm->mem_fd, shm->tx_efd, shm->rx_efd };
+	union {
+		char buf[CMSG_SPACE(sizeof(fds))];
+		struct cmsghdr align;
+	} ctrl;
+	struct iovec iov = {
+		.iov_base = msgb_data(msg),
+		.iov_len = msgb_length(msg),
+	};
+	struct msghdr mh = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = ctrl.buf,
+		.msg_controllen = sizeof(ctrl.buf),
+	};
+	struct cmsghdr *cmsg;
+	struct msgb *pending;
+	int rc;
+
+	memset(&ctrl, 0, sizeof(ctrl));
+	cmsg = CMSG_FIRSTHDR(&mh);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	rc = sendmsg(fd, &mh, 0);
+	if (rc <= 0)
+		return rc;
+
+	osmo_fd_setup(&state->shm_bfd, shm->rx_efd, OSMO_FD_READ, pcu_sock_shm_read, state, 0);
+	if (osmo_fd_register(&state->shm_bfd) != 0) {
+		LOGP(DPCU, LOGL_ERROR, "Failed to register PCU shared memory eventfd\n");
+		pcu_sock_close(state);
+		return -1;
+	}
+	state->shm_active = true;
+
+	LOGP(DPCU, LOGL_INFO, "PCU uses shared memory (%u slots per ring)\n", shm->num_slots);
+
+	/* what was queued after the CNF goes through the rings now, in order.
+	 * Batching was disabled when the CNF was queued, see pcu_sock_shm_setup(). */
+	OSMO_ASSERT(state->batch_msg == NULL);
+	while ((pending = msgb_dequeue(&state->upqueue.msg_queue))) {
+		state->upqueue.current_length--;
+		pcu_sock_shm_send(state, pending);
+	}
+
+	return rc;
+}
+
 int pcu_sock_send(struct msgb *msg)
 {
 	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
 	struct osmo_fd *conn_bfd;
 	struct gsm_pcu_if *pcu_prim = (struct gsm_pcu_if *) msg->data;
-	int rc;
 
 	if (!state) {
 		if (pcu_prim->msg_type != PCU_IF_MSG_TIME_IND &&
@@ -1043,44 +1570,29 @@ int pcu_sock_send(struct msgb *msg)
 		return -EIO;
 	}
 
-	rc = osmo_wqueue_enqueue(&state->upqueue, msg);
-	if (rc < 0) {
-		if (rc == -ENOSPC)
-			LOGP(DPCU, LOGL_NOTICE, "PCU not reacting (more than %u messages waiting). Closing connection\n",
-			     state->upqueue.max_length);
-		pcu_sock_close(state);
-		msgb_free(msg);
-		return rc;
-	}
-	return 0;
+	if (state->shm_active)
+		return pcu_sock_shm_send(state, msg);
+	if (state->batch_enabled)
+		return pcu_sock_batch_append(state, msg);
+
+	return pcu_sock_enqueue(state, msg);
 }
 
-static void pcu_sock_close(struct pcu_sock_state *state)
+/* Tear down GPRS on the given BTS after the PCU went away */
+static void pcu_sock_close_bts(struct gsm_bts *bts)
 {
-	struct osmo_fd *bfd = &state->upqueue.bfd;
-	struct gsm_bts *bts;
 	struct gsm_bts_trx *trx;
 	unsigned int tn;
 
-	/* FIXME: allow multiple BTS */
-	bts = llist_entry(g_bts_sm->bts_list.next, struct gsm_bts, list);
-
-	LOGP(DPCU, LOGL_NOTICE, "PCU socket has LOST connection\n");
 	oml_tx_failure_event_rep(&bts->gprs.cell.mo, NM_SEVER_MAJOR, OSMO_EVT_PCU_VERS,
 				 "PCU socket has LOST connection");
 
 	bts->pcu_version[0] = '\0';
 
-	osmo_fd_unregister(bfd);
-	close(bfd->fd);
-	bfd->fd = -1;
-
 	/* patch SI3 to remove GPRS indicator */
 	regenerate_si3_restoctets(bts);
 	regenerate_si4_restoctets(bts);
-
-	/* re-enable the generation of ACCEPT for new connections */
-	osmo_fd_read_enable(&state->listen_bfd);
+	bts_sysinfo_sched_update(bts);
 
 #if 0
 	/* remove si13, ... */
@@ -1102,8 +1614,46 @@ static void pcu_sock_close(struct pcu_sock_state *state)
 			l1sap_chan_rel(trx, gsm_lchan2chan_nr(&ts->lchan[0]));
 		}
 	}
+}
+
+static void pcu_sock_close(struct pcu_sock_state *state)
+{
+	struct osmo_fd *bfd = &state->upqueue.bfd;
+	struct gsm_bts *bts;
+	struct msgb *msg;
+
+	LOGP(DPCU, LOGL_NOTICE, "PCU socket has LOST connection\n");
+
+	osmo_fd_unregister(bfd);
+	close(bfd->fd);
+	bfd->fd = -1;
+
+	/* re-enable the generation of ACCEPT for new connections */
+	osmo_fd_read_enable(&state->listen_bfd);
+
+	/* one PCU serves all BTS of the site */
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list)
+		pcu_sock_close_bts(bts);
 
 	osmo_wqueue_clear(&state->upqueue);
+
+	/* discard what was not sent yet, the next PCU has to negotiate batching again */
+	osmo_timer_del(&state->batch_timer);
+	msgb_free(state->batch_msg);
+	state->batch_msg = NULL;
+	state->batch_enabled = false;
+
+	/* tear down the shared memory transport, the next PCU has to request it again */
+	if (state->shm_active)
+		osmo_fd_unregister(&state->shm_bfd);
+	state->shm_active = false;
+	osmo_timer_del(&state->shm_timer);
+	while ((msg = msgb_dequeue(&state->shm_backlog)))
+		msgb_free(msg);
+	state->shm_backlog_len = 0;
+	state->shm_dropped = 0;
+	pcu_shm_free(state->shm);
+	state->shm = NULL;
 }
 
 static int pcu_sock_read(struct osmo_fd *bfd)
@@ -1113,7 +1663,7 @@ static int pcu_sock_read(struct osmo_fd *bfd)
 	struct msgb *msg;
 	int rc;
 
-	msg = msgb_alloc(sizeof(*pcu_prim) + 1000, "pcu_sock_rx");
+	msg = msgb_alloc(OSMO_MAX(sizeof(*pcu_prim) + 1000, PCU_IF_BATCH_MAX_LEN), "pcu_sock_rx");
 	if (!msg)
 		return -ENOMEM;
 
@@ -1155,12 +1705,16 @@ close:
 static int pcu_sock_write(struct osmo_fd *bfd, struct msgb *msg)
 {
 	struct pcu_sock_state *state = bfd->data;
+	const struct gsm_pcu_if *pcu_prim = (const struct gsm_pcu_if *) msg->data;
 	int rc;
 
 	/* bug hunter 8-): maybe someone forgot msgb_put(...) ? */
 	OSMO_ASSERT(msgb_length(msg) > 0);
 	/* try to send it over the socket */
-	rc = write(bfd->fd, msgb_data(msg), msgb_length(msg));
+	if (OSMO_UNLIKELY(pcu_prim->msg_type == PCU_IF_MSG_SHM_CNF && state->shm && !state->shm_active))
+		rc = pcu_sock_shm_handover(state, bfd->fd, msg);
+	else
+		rc = write(bfd->fd, msgb_data(msg), msgb_length(msg));
 	if (OSMO_UNLIKELY(rc == 0))
 		goto close;
 	if (OSMO_UNLIKELY(rc < 0)) {
@@ -1230,6 +1784,10 @@ int pcu_sock_init(const char *path, int qlength_max)
 	state->upqueue.read_cb = pcu_sock_read;
 	state->upqueue.write_cb = pcu_sock_write;
 	state->upqueue.bfd.fd = -1;
+	osmo_timer_setup(&state->batch_timer, pcu_sock_batch_timer_cb, state);
+	INIT_LLIST_HEAD(&state->shm_backlog);
+	state->shm_bfd.fd = -1;
+	osmo_timer_setup(&state->shm_timer, pcu_sock_shm_timer_cb, state);
 
 	bfd = &state->listen_bfd;
 
@@ -99,6 +99,13 @@ struct phy_instance *phy_instance_by_num(const struct phy_link *plink, int num)
 	return NULL;
 }
 
+/* A PHY link may serve the TRX of several BTS; the BTS whose C0 is served by
+ * a given instance follows the clock of that instance's PHY link. */
+bool phy_instance_is_c0(const struct phy_instance *pinst)
+{
+	return pinst->trx && pinst->trx == pinst->trx->bts->c0;
+}
+
 struct phy_instance *phy_instance_create(struct phy_link *plink, int num)
 {
 	struct phy_instance *pinst;
@@ -33,6 +33,7 @@
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/l1sap.h>
 #include <osmo-bts/power_control.h>
+#include <osmo-bts/ta_control.h>
 
 /* We don't want to deal with floating point, so we scale up */
 #define EWMA_SCALE_FACTOR 100
@@ -111,6 +112,49 @@ static int do_avg_algo(const struct gsm_power_ctrl_meas_params *mp,
 	}
 	return val_avg;
 }
+
+/* Prepare entry i of a batch for pwr_ctrl_avg_batch_run(), mp=NULL leaves it untouched */
+static void pwr_ctrl_avg_batch_gather(struct pwr_ctrl_avg_batch *b, unsigned int i,
+				      const struct gsm_power_ctrl_meas_params *mp,
+				      const struct gsm_power_ctrl_meas_proc_state *mps,
+				      const int val)
+{
+	b->ewma[i] = mp != NULL && mp->algo == GSM_PWR_CTRL_MEAS_AVG_ALGO_OSMO_EWMA;
+	b->alpha[i] = b->ewma[i] ? mp->ewma.alpha : 0;
+	b->first[i] = mps->meas_num == 0;
+	b->Avg100[i] = mps->ewma.Avg100;
+	b->val[i] = val;
+}
+
+/* do_avg_algo() for all entries of a batch, written without branches so that
+ * the compiler can vectorize it */
+static void pwr_ctrl_avg_batch_run(struct pwr_ctrl_avg_batch *b, unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		int Avg100, avg;
+
+		Avg100 = b->Avg100[i] + b->alpha[i] * (b->val[i] - (b->Avg100[i] + EWMA_ROUND_FACTOR) / EWMA_SCALE_FACTOR);
+		Avg100 = b->first[i] ? b->val[i] * EWMA_SCALE_FACTOR : Avg100;
+		avg = b->first[i] ? b->val[i] : (Avg100 + EWMA_ROUND_FACTOR) / EWMA_SCALE_FACTOR;
+
+		b->Avg100[i] = b->ewma[i] ? Avg100 : b->Avg100[i];
+		b->avg[i] = b->ewma[i] ? avg : b->val[i];
+	}
+}
+
+/* Store the pre-processing state of entry i back, returns its average */
+static int pwr_ctrl_avg_batch_scatter(const struct pwr_ctrl_avg_batch *b, unsigned int i,
+				      struct gsm_power_ctrl_meas_proc_state *mps)
+{
+	if (b->ewma[i]) {
+		mps->meas_num++;
+		mps->ewma.Avg100 = b->Avg100[i];
+	}
+	return b->avg[i];
+}
+
 /* Calculate a 'delta' value (for the given MS/BS power control parameters)
  * to be applied to the current Tx power level to approach the target level. */
 static int calc_delta_rxlev(const struct gsm_power_ctrl_params *params, const uint8_t rxlev)
@@ -178,62 +222,65 @@ static const struct gsm_power_ctrl_meas_params *lchan_get_ci_thresholds(const st
 	}
 }
 
-/*! compute the new MS POWER LEVEL communicated to the MS and store it in lchan.
- *  \param lchan logical channel for which to compute (and in which to store) new power value.
- *  \param[in] ms_power_lvl MS Power Level received from Uplink L1 SACCH Header in SACCH block.
- *  \param[in] ul_rssi_dbm Signal level of the received SACCH block, in dBm.
- *  \param[in] ul_lqual_cb C/I of the received SACCH block, in dB.
- */
-int lchan_ms_pwr_ctrl(struct gsm_lchan *lchan,
-		      const uint8_t ms_power_lvl,
-		      const int8_t ul_rssi_dbm,
-		      const int16_t ul_lqual_cb)
+/* Shall the MS power loop run for the current SACCH block? */
+static bool ms_pwr_ctrl_due(struct gsm_lchan *lchan, const uint8_t ms_power_lvl)
 {
 	struct lchan_power_ctrl_state *state = &lchan->ms_power_ctrl;
 	const struct gsm_power_ctrl_params *params = state->dpc_params;
 	struct gsm_bts_trx *trx = lchan->ts->trx;
-	struct gsm_bts *bts = trx->bts;
-	enum gsm_band band = bts->band;
-	int8_t new_power_lvl; /* TS 05.05 power level */
-	int8_t ms_dbm, new_dbm, current_dbm, bsc_max_dbm;
-	uint8_t rxlev_avg;
-	int16_t ul_lqual_cb_avg;
-	const struct gsm_power_ctrl_meas_params *ci_meas;
-	bool ignore, ci_on;
+	enum gsm_band band = trx->bts->band;
 
 	if (!trx_ms_pwr_ctrl_is_osmo(trx))
-		return 0;
+		return false;
 	if (params == NULL)
-		return 0;
+		return false;
 
 	/* Shall we skip current block based on configured interval? */
 	if (ctrl_interval_skip_block(params, state))
-		return 0;
+		return false;
 
-	ms_dbm = ms_pwr_dbm(band, ms_power_lvl);
-	if (ms_dbm < 0) {
+	if (ms_pwr_dbm(band, ms_power_lvl) < 0) {
 		LOGPLCHAN(lchan, DLOOP, LOGL_NOTICE,
 			  "Failed to calculate dBm for power ctl level %" PRIu8 " on band %s\n",
 			  ms_power_lvl, gsm_band_name(band));
-		return 0;
+		return false;
 	}
-	bsc_max_dbm = ms_pwr_dbm(band, state->max);
-	if (bsc_max_dbm < 0) {
+	if (ms_pwr_dbm(band, state->max) < 0) {
 		LOGPLCHAN(lchan, DLOOP, LOGL_NOTICE,
 			  "Failed to calculate dBm for power ctl level %" PRIu8 " on band %s\n",
 			  state->max, gsm_band_name(band));
-		return 0;
+		return false;
 	}
 
+	return true;
+}
+
+/* Decide on the new MS power level based on the averaged measurements */
+static int ms_pwr_ctrl_apply(struct gsm_lchan *lchan,
+			     const uint8_t ms_power_lvl,
+			     const int8_t ul_rssi_dbm,
+			     const int16_t ul_lqual_cb,
+			     const uint8_t rxlev_avg,
+			     const int16_t ul_lqual_cb_avg)
+{
+	struct lchan_power_ctrl_state *state = &lchan->ms_power_ctrl;
+	const struct gsm_power_ctrl_params *params = state->dpc_params;
+	enum gsm_band band = lchan->ts->trx->bts->band;
+	int8_t new_power_lvl; /* TS 05.05 power level */
+	int8_t ms_dbm, new_dbm, current_dbm, bsc_max_dbm;
+	const struct gsm_power_ctrl_meas_params *ci_meas;
+	bool ignore, ci_on;
+
+	/* both have been checked by ms_pwr_ctrl_due() */
+	ms_dbm = ms_pwr_dbm(band, ms_power_lvl);
+	bsc_max_dbm = ms_pwr_dbm(band, state->max);
+
 	ci_meas = lchan_get_ci_thresholds(lchan);
 
 	/* Is C/I based algo enabled by config?
 	* FIXME: this can later be generalized when properly implementing P & N counting. */
 	ci_on = ci_meas->lower_cmp_n && ci_meas->upper_cmp_n;
 
-	ul_lqual_cb_avg = do_avg_algo(ci_meas, &state->ci_meas_proc, ul_lqual_cb);
-	rxlev_avg = do_avg_algo(&params->rxlev_meas, &state->rxlev_meas_proc, dbm2rxlev(ul_rssi_dbm));
-
 	/* If computed C/I is enabled and out of acceptable thresholds: */
 	if (ci_on && ul_lqual_cb_avg < ci_meas->lower_thresh * 10) {
 		new_dbm = ms_dbm + params->inc_step_size_db;
@@ -309,46 +356,79 @@ int lchan_ms_pwr_ctrl(struct gsm_lchan *lchan,
 	return 1;
 }
 
-/*! compute the new Downlink attenuation value for the given logical channel.
+/*! compute the new MS POWER LEVEL communicated to the MS and store it in lchan.
  *  \param lchan logical channel for which to compute (and in which to store) new power value.
- *  \param[in] mr pointer to a *valid* Measurement Report.
+ *  \param[in] ms_power_lvl MS Power Level received from Uplink L1 SACCH Header in SACCH block.
+ *  \param[in] ul_rssi_dbm Signal level of the received SACCH block, in dBm.
+ *  \param[in] ul_lqual_cb C/I of the received SACCH block, in dB.
  */
-int lchan_bs_pwr_ctrl(struct gsm_lchan *lchan,
-		      const struct gsm48_meas_res *mr)
+int lchan_ms_pwr_ctrl(struct gsm_lchan *lchan,
+		      const uint8_t ms_power_lvl,
+		      const int8_t ul_rssi_dbm,
+		      const int16_t ul_lqual_cb)
+{
+	struct lchan_power_ctrl_state *state = &lchan->ms_power_ctrl;
+	const struct gsm_power_ctrl_params *params = state->dpc_params;
+	uint8_t rxlev_avg;
+	int16_t ul_lqual_cb_avg;
+
+	if (!ms_pwr_ctrl_due(lchan, ms_power_lvl))
+		return 0;
+
+	ul_lqual_cb_avg = do_avg_algo(lchan_get_ci_thresholds(lchan), &state->ci_meas_proc, ul_lqual_cb);
+	rxlev_avg = do_avg_algo(&params->rxlev_meas, &state->rxlev_meas_proc, dbm2rxlev(ul_rssi_dbm));
+
+	return ms_pwr_ctrl_apply(lchan, ms_power_lvl, ul_rssi_dbm, ul_lqual_cb, rxlev_avg, ul_lqual_cb_avg);
+}
+
+/* Shall the BS power loop run for the current DL measurement report?
+ * If so, select the RxLev/RxQual values to be used. */
+static bool bs_pwr_ctrl_due(struct gsm_lchan *lchan, bool dl_dtx,
+			    uint8_t rxlev_full, uint8_t rxqual_full,
+			    uint8_t rxlev_sub, uint8_t rxqual_sub,
+			    uint8_t *rxlev, uint8_t *rxqual)
 {
 	struct lchan_power_ctrl_state *state = &lchan->bs_power_ctrl;
 	const struct gsm_power_ctrl_params *params = state->dpc_params;
-	uint8_t rxqual, rxqual_avg, rxlev, rxlev_avg;
-	int new_att;
 
 	/* Check if dynamic BS Power Control is enabled */
 	if (params == NULL)
-		return 0;
+		return false;
 
 	LOGPLCHAN(lchan, DLOOP, LOGL_DEBUG, "Rx DL Measurement Report: "
 		  "RXLEV-FULL(%02u), RXQUAL-FULL(%u), "
 		  "RXLEV-SUB(%02u), RXQUAL-SUB(%u), "
 		  "DTx is %s => using %s\n",
-		  mr->rxlev_full, mr->rxqual_full,
-		  mr->rxlev_sub, mr->rxqual_sub,
-		  lchan->tch.dtx.dl_active ? "enabled" : "disabled",
-		  lchan->tch.dtx.dl_active ? "SUB" : "FULL");
+		  rxlev_full, rxqual_full,
+		  rxlev_sub, rxqual_sub,
+		  dl_dtx ? "enabled" : "disabled",
+		  dl_dtx ? "SUB" : "FULL");
 
 	/* Shall we skip current block based on configured interval? */
 	if (ctrl_interval_skip_block(params, state))
-		return 0;
+		return false;
 
 	/* If DTx is active on Downlink, use the '-SUB' */
-	if (lchan->tch.dtx.dl_active) {
-		rxqual = mr->rxqual_sub;
-		rxlev = mr->rxlev_sub;
+	if (dl_dtx) {
+		*rxqual = rxqual_sub;
+		*rxlev = rxlev_sub;
 	} else { /* ... otherwise use the '-FULL' */
-		rxqual = mr->rxqual_full;
-		rxlev = mr->rxlev_full;
+		*rxqual = rxqual_full;
+		*rxlev = rxlev_full;
 	}
 
-	rxlev_avg = do_avg_algo(&params->rxlev_meas, &state->rxlev_meas_proc, rxlev);
-	rxqual_avg = do_avg_algo(&params->rxqual_meas, &state->rxqual_meas_proc, rxqual);
+	return true;
+}
+
+/* Decide on the new DL attenuation based on the averaged measurements */
+static int bs_pwr_ctrl_apply(struct gsm_lchan *lchan,
+			     const uint8_t rxlev, const uint8_t rxqual,
+			     const uint8_t rxlev_avg, const uint8_t rxqual_avg)
+{
+	struct lchan_power_ctrl_state *state = &lchan->bs_power_ctrl;
+	const struct gsm_power_ctrl_params *params = state->dpc_params;
+	int new_att;
+
 	/* If RxQual > L_RXQUAL_XX_P, try to increase Tx power */
 	if (rxqual_avg > params->rxqual_meas.lower_thresh) {
 		/* Increase Tx power by reducing Tx attenuation */
@@ -402,6 +482,29 @@ int lchan_bs_pwr_ctrl(struct gsm_lchan *lchan,
 	return 1;
 }
 
+/*! compute the new Downlink attenuation value for the given logical channel.
+ *  \param lchan logical channel for which to compute (and in which to store) new power value.
+ *  \param[in] mr pointer to a *valid* Measurement Report.
+ */
+int lchan_bs_pwr_ctrl(struct gsm_lchan *lchan,
+		      const struct gsm48_meas_res *mr)
+{
+	struct lchan_power_ctrl_state *state = &lchan->bs_power_ctrl;
+	const struct gsm_power_ctrl_params *params = state->dpc_params;
+	uint8_t rxqual, rxqual_avg, rxlev, rxlev_avg;
+
+	if (!bs_pwr_ctrl_due(lchan, lchan->tch.dtx.dl_active,
+			     mr->rxlev_full, mr->rxqual_full,
+			     mr->rxlev_sub, mr->rxqual_sub,
+			     &rxlev, &rxqual))
+		return 0;
+
+	rxlev_avg = do_avg_algo(&params->rxlev_meas, &state->rxlev_meas_proc, rxlev);
+	rxqual_avg = do_avg_algo(&params->rxqual_meas, &state->rxqual_meas_proc, rxqual);
+
+	return bs_pwr_ctrl_apply(lchan, rxlev, rxqual, rxlev_avg, rxqual_avg);
+}
+
 /* Default MS/BS Power Control parameters (see 3GPP TS 45.008, table A.1) */
 const struct gsm_power_ctrl_params power_ctrl_params_def = {
 	/* Power increasing/reducing step size (optimal defaults) */
@@ -573,3 +676,156 @@ void power_ctrl_params_def_reset(struct gsm_power_ctrl_params *params, bool is_b
 	else
 		params->ctrl_interval = 1; /* N=2 (0.960) */
 }
+
+struct lchan_ctrl_batch *lchan_ctrl_batch_alloc(void *ctx)
+{
+	return talloc_zero(ctx, struct lchan_ctrl_batch);
+}
+
+/*! Queue the control loop inputs of a received SACCH block, they are processed by
+ *  lchan_ctrl_batch_flush() together with those of the other lchans on the TRX
+ *  whose SACCH block ended in the same TDMA frame.
+ *  \param lchan logical channel the SACCH block was received on.
+ *  \param[in] fn TDMA frame number of the SACCH block.
+ *  \param[in] ms_tx_ta The TA used by the MS and reported in L1SACCH.
+ *  \param[in] toa256 Time of Arrival (in 1/256th bits) computed at Rx side.
+ *  \param[in] ms_power_lvl MS Power Level received from Uplink L1 SACCH Header in SACCH block.
+ *  \param[in] ul_rssi_dbm Signal level of the received SACCH block, in dBm.
+ *  \param[in] ul_lqual_cb C/I of the received SACCH block, in dB.
+ *  \param[in] mr pointer to a *valid* Measurement Report, or NULL.
+ */
+void lchan_ctrl_batch_add(struct gsm_lchan *lchan, uint32_t fn,
+			  uint8_t ms_tx_ta, int16_t toa256,
+			  uint8_t ms_power_lvl, int8_t ul_rssi_dbm, int16_t ul_lqual_cb,
+			  const struct gsm48_meas_res *mr)
+{
+	struct gsm_bts_trx *trx = lchan->ts->trx;
+	struct lchan_ctrl_batch *b = trx->ctrl_batch;
+	unsigned int i;
+
+	if (b->num > 0 && (b->fn != fn || b->num == LCHAN_CTRL_BATCH_MAX))
+		lchan_ctrl_batch_flush(trx);
+
+	i = b->num++;
+	b->fn = fn;
+	b->lchan[i] = lchan;
+	b->ms_ta[i] = ms_tx_ta;
+	b->toa256[i] = toa256;
+	b->ms_pwr[i] = ms_power_lvl;
+	b->ul_rssi_dbm[i] = ul_rssi_dbm;
+	b->ul_ci_cb[i] = ul_lqual_cb;
+	b->mr_valid[i] = mr != NULL;
+	if (mr != NULL) {
+		b->dl_dtx[i] = lchan->tch.dtx.dl_active;
+		b->rxlev_full[i] = mr->rxlev_full;
+		b->rxqual_full[i] = mr->rxqual_full;
+		b->rxlev_sub[i] = mr->rxlev_sub;
+		b->rxqual_sub[i] = mr->rxqual_sub;
+	}
+}
+
+/*! Run the TA, MS and BS power control loops for all queued SACCH blocks of a TRX.
+ *  The result is the same as calling lchan_ms_ta_ctrl(), lchan_ms_pwr_ctrl() and
+ *  lchan_bs_pwr_ctrl() for each of them, but the averaging and the TA computation
+ *  run over plain arrays instead of chasing the lchan of each block. */
+void lchan_ctrl_batch_flush(struct gsm_bts_trx *trx)
+{
+	struct lchan_ctrl_batch *b = trx->ctrl_batch;
+	struct lchan_power_ctrl_state *state;
+	struct gsm_lchan *lchan;
+	uint8_t rxlev, rxqual;
+	unsigned int i;
+
+	if (b->num == 0)
+		return;
+
+	/* step 1: find out which loops are due and gather their state */
+	for (i = 0; i < b->num; i++) {
+		lchan = b->lchan[i];
+
+		/* cancelled, or released in the meantime */
+		if (lchan == NULL || lchan->state != LCHAN_S_ACTIVE) {
+			b->lchan[i] = NULL;
+			b->ta_upd[i] = b->ms_upd[i] = b->bs_upd[i] = false;
+			b->ms_rxlev.ewma[i] = b->ms_ci.ewma[i] = false;
+			b->bs_rxlev.ewma[i] = b->bs_rxqual.ewma[i] = false;
+			continue;
+		}
+
+		b->ta_upd[i] = lchan_ms_ta_ctrl_due(lchan);
+
+		state = &lchan->ms_power_ctrl;
+		b->ms_upd[i] = ms_pwr_ctrl_due(lchan, b->ms_pwr[i]);
+		pwr_ctrl_avg_batch_gather(&b->ms_ci, i,
+					  b->ms_upd[i] ? lchan_get_ci_thresholds(lchan) : NULL,
+					  &state->ci_meas_proc, b->ul_ci_cb[i]);
+		pwr_ctrl_avg_batch_gather(&b->ms_rxlev, i,
+					  b->ms_upd[i] ? &state->dpc_params->rxlev_meas : NULL,
+					  &state->rxlev_meas_proc, dbm2rxlev(b->ul_rssi_dbm[i]));
+
+		rxlev = rxqual = 0;
+		state = &lchan->bs_power_ctrl;
+		b->bs_upd[i] = b->mr_valid[i] && bs_pwr_ctrl_due(lchan, b->dl_dtx[i],
+								 b->rxlev_full[i], b->rxqual_full[i],
+								 b->rxlev_sub[i], b->rxqual_sub[i],
+								 &rxlev, &rxqual);
+		pwr_ctrl_avg_batch_gather(&b->bs_rxlev, i,
+					  b->bs_upd[i] ? &state->dpc_params->rxlev_meas : NULL,
+					  &state->rxlev_meas_proc, rxlev);
+		pwr_ctrl_avg_batch_gather(&b->bs_rxqual, i,
+					  b->bs_upd[i] ? &state->dpc_params->rxqual_meas : NULL,
+					  &state->rxqual_meas_proc, rxqual);
+	}
+
+	/* step 2: the arithmetic, over all entries at once */
+	ta_ctrl_calc(b->ms_ta, b->toa256, b->new_ta, b->num);
+	pwr_ctrl_avg_batch_run(&b->ms_ci, b->num);
+	pwr_ctrl_avg_batch_run(&b->ms_rxlev, b->num);
+	pwr_ctrl_avg_batch_run(&b->bs_rxlev, b->num);
+	pwr_ctrl_avg_batch_run(&b->bs_rxqual, b->num);
+
+	/* step 3: store the state and decide on the new TA and power levels */
+	for (i = 0; i < b->num; i++) {
+		lchan = b->lchan[i];
+		if (lchan == NULL)
+			continue;
+
+		if (b->ta_upd[i])
+			lchan_ms_ta_ctrl_apply(lchan, b->new_ta[i], b->toa256[i]);
+
+		if (b->ms_upd[i]) {
+			int16_t ul_lqual_cb_avg;
+			uint8_t rxlev_avg;
+
+			state = &lchan->ms_power_ctrl;
+			ul_lqual_cb_avg = pwr_ctrl_avg_batch_scatter(&b->ms_ci, i, &state->ci_meas_proc);
+			rxlev_avg = pwr_ctrl_avg_batch_scatter(&b->ms_rxlev, i, &state->rxlev_meas_proc);
+			ms_pwr_ctrl_apply(lchan, b->ms_pwr[i], b->ul_rssi_dbm[i], b->ul_ci_cb[i],
+					  rxlev_avg, ul_lqual_cb_avg);
+		}
+
+		if (b->bs_upd[i]) {
+			uint8_t rxlev_avg, rxqual_avg;
+
+			state = &lchan->bs_power_ctrl;
+			rxlev_avg = pwr_ctrl_avg_batch_scatter(&b->bs_rxlev, i, &state->rxlev_meas_proc);
+			rxqual_avg = pwr_ctrl_avg_batch_scatter(&b->bs_rxqual, i, &state->rxqual_meas_proc);
+			bs_pwr_ctrl_apply(lchan, b->bs_rxlev.val[i], b->bs_rxqual.val[i],
+					  rxlev_avg, rxqual_avg);
+		}
+	}
+
+	b->num = 0;
+}
+
+/*! Drop the queued SACCH block of an lchan, e.g. when it is (re)activated. */
+void lchan_ctrl_batch_cancel(struct gsm_lchan *lchan)
+{
+	struct lchan_ctrl_batch *b = lchan->ts->trx->ctrl_batch;
+	unsigned int i;
+
+	for (i = 0; i < b->num; i++) {
+		if (b->lchan[i] == lchan)
+			b->lchan[i] = NULL;
+	}
+}
@@ -0,0 +1,166 @@
+/* Detection of the synch. sequence of Access Bursts */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/rach_synch_seq.h>
+
+const struct value_string rach_synch_seq_names[] = {
+	{ RACH_SYNCH_SEQ_UNKNOWN,	"UNKNOWN" },
+	{ RACH_SYNCH_SEQ_TS0,		"TS0: GSM, GMSK" },
+	{ RACH_SYNCH_SEQ_TS1,		"TS1: EGPRS, 8-PSK" },
+	{ RACH_SYNCH_SEQ_TS2,		"TS2: EGPRS, GMSK" },
+	{ 0, NULL },
+};
+
+/* 3GPP TS 05.02, section 5.2.7 "Access burst (AB)", synch. sequence bits,
+ * as multipliers for soft-bits: a logical 1 is a negative soft-bit. */
+#define B0	1
+#define B1	-1
+static const int16_t synch_seq_ref[RACH_SYNCH_SEQ_NUM][RACH_SYNCH_SEQ_PAD_LEN]
+	__attribute__((aligned(16))) = {
+	/* 01001011011111111001100110101010001111000 */
+	[RACH_SYNCH_SEQ_TS0] = {
+		B0, B1, B0, B0, B1, B0, B1, B1, B0, B1, B1, B1, B1, B1, B1, B1,
+		B1, B0, B0, B1, B1, B0, B0, B1, B1, B0, B1, B0, B1, B0, B1, B0,
+		B0, B0, B1, B1, B1, B1, B0, B0, B0,
+	},
+	/* 01010100111110001000011000101111001001101 */
+	[RACH_SYNCH_SEQ_TS1] = {
+		B0, B1, B0, B1, B0, B1, B0, B0, B1, B1, B1, B1, B1, B0, B0, B0,
+		B1, B0, B0, B0, B0, B1, B1, B0, B0, B0, B1, B0, B1, B1, B1, B1,
+		B0, B0, B1, B0, B0, B1, B1, B0, B1,
+	},
+	/* 11101111001001110101011000001101101110111 */
+	[RACH_SYNCH_SEQ_TS2] = {
+		B1, B1, B1, B0, B1, B1, B1, B1, B0, B0, B1, B0, B0, B1, B1, B1,
+		B0, B1, B0, B1, B0, B1, B1, B0, B0, B0, B0, B0, B1, B1, B0, B1,
+		B1, B0, B1, B1, B1, B0, B1, B1, B1,
+	},
+};
+#undef B0
+#undef B1
+
+#if defined(__GNUC__) && (defined(__clang__) || __GNUC__ >= 9)
+/* Eight lanes of 16 bit map onto SSE2 / NEON registers, the compiler
+ * emits scalar code on targets without a vector unit.  A lane sums at
+ * most RACH_SYNCH_SEQ_PAD_LEN / 8 products of 127, so it cannot overflow. */
+typedef int8_t rach_v8s8 __attribute__((vector_size(8)));
+typedef int16_t rach_v8s16 __attribute__((vector_size(16)));
+
+#define RACH_V_LANES	8
+#define RACH_V_NUM	(RACH_SYNCH_SEQ_PAD_LEN / RACH_V_LANES)
+
+static void synch_seq_score(const sbit_t *bits, int *score)
+{
+	const rach_v8s16 *ref = (const rach_v8s16 *) synch_seq_ref;
+	rach_v8s16 x[RACH_V_NUM], acc;
+	rach_v8s8 b;
+	int i, j, k;
+
+	/* widen the soft-bits once, they are correlated with every sequence */
+	for (j = 0; j < RACH_V_NUM; j++) {
+		memcpy(&b, bits + j * RACH_V_LANES, sizeof(b));
+		x[j] = __builtin_convertvector(b, rach_v8s16);
+	}
+
+	for (i = 0; i < RACH_SYNCH_SEQ_NUM; i++) {
+		acc = x[0] * ref[i * RACH_V_NUM];
+		for (j = 1; j < RACH_V_NUM; j++)
+			acc += x[j] * ref[i * RACH_V_NUM + j];
+
+		score[i] = 0;
+		for (k = 0; k < RACH_V_LANES; k++)
+			score[i] += acc[k];
+	}
+}
+#else
+static void synch_seq_score(const sbit_t *bits, int *score)
+{
+	int i, j;
+
+	for (i = 0; i < RACH_SYNCH_SEQ_NUM; i++) {
+		score[i] = 0;
+		for (j = 0; j < RACH_SYNCH_SEQ_PAD_LEN; j++)
+			score[i] += synch_seq_ref[i][j] * bits[j];
+	}
+}
+#endif
+
+/*! Correlate the synch. sequence of a number of Access Bursts with the
+ *  known ones.  Since we deal with soft-bits (-127...127), the score is the
+ *  sum of the absolute values of the matching bits minus the sum of the
+ *  absolute values of the different ones.
+ *  \param[in] bursts Access Bursts, each of at least RACH_EXT_TAIL_LEN +
+ *		      RACH_SYNCH_SEQ_PAD_LEN soft-bits
+ *  \param[in] num number of bursts, at most RACH_SYNCH_SEQ_BATCH_MAX
+ *  \param[out] seq detected synch. sequence of each burst
+ *  \param[out] best_score score of the best match of each burst (optional) */
+void rach_synch_seq_detect_batch(const sbit_t * const *bursts, unsigned int num,
+				 enum rach_synch_seq_t *seq, int *best_score)
+{
+	int score[RACH_SYNCH_SEQ_BATCH_MAX][RACH_SYNCH_SEQ_NUM];
+	int max_score;
+	unsigned int n;
+	int i;
+
+	OSMO_ASSERT(num <= RACH_SYNCH_SEQ_BATCH_MAX);
+
+	for (n = 0; n < num; n++)
+		synch_seq_score(bursts[n] + RACH_EXT_TAIL_LEN, score[n]);
+
+	for (n = 0; n < num; n++) {
+		/* the first one wins on a tie */
+		max_score = INT_MIN;
+		seq[n] = RACH_SYNCH_SEQ_TS0;
+		for (i = 0; i < RACH_SYNCH_SEQ_NUM; i++) {
+			if (score[n][i] > max_score) {
+				max_score = score[n][i];
+				seq[n] = i;
+			}
+		}
+
+		/* Calculate an approximate level of our confidence */
+		if (best_score != NULL)
+			best_score[n] = max_score;
+
+		/* At least 1/3 of a synch. sequence shall match */
+		if (max_score < (127 * RACH_SYNCH_SEQ_LEN / 3))
+			seq[n] = RACH_SYNCH_SEQ_UNKNOWN;
+	}
+}
+
+/*! Correlate the synch. sequence of a single Access Burst with the known ones.
+ *  \param[in] burst Access Burst, see rach_synch_seq_detect_batch()
+ *  \param[out] best_score score of the best match (optional)
+ *  \returns the detected synch. sequence, RACH_SYNCH_SEQ_UNKNOWN if none matches */
+enum rach_synch_seq_t rach_synch_seq_detect(const sbit_t *burst, int *best_score)
+{
+	enum rach_synch_seq_t seq;
+
+	rach_synch_seq_detect_batch(&burst, 1, &seq, best_score);
+	return seq;
+}
@@ -734,6 +734,7 @@ static int rsl_rx_bcch_info(struct gsm_bts_trx *trx, struct msgb *msg)
 			break;
 		}
 	}
+	oml_snapshot_si_refreshed(bts, osmo_si);
 	osmo_signal_dispatch(SS_GLOBAL, S_NEW_SYSINFO, bts);
 
 	return 0;
@@ -816,16 +817,16 @@ static int rsl_rx_paging_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 	if (TLVP_PRES_LEN(&tp, RSL_IE_CHAN_NEEDED, 1))
 		chan_needed = *TLVP_VAL(&tp, RSL_IE_CHAN_NEEDED);
 
-	rc = paging_add_identity(bts->paging_state, paging_group, identity_lv, chan_needed);
+	/* The identity is admitted to the paging queue together with all other PAGING COMMANDs
+	 * received during this main loop iteration. A full paging table is reported to the BSC
+	 * from paging_flush_identities(). */
+	rc = paging_enqueue_identity(bts->paging_state, paging_group, identity_lv, chan_needed);
 	if (rc < 0) {
 		/* FIXME: notfiy the BSC on other errors? */
-		if (rc == -ENOSPC) {
-			oml_tx_failure_event_rep(&trx->bts->mo, NM_SEVER_WARNING,
-						 OSMO_EVT_MIN_PAG_TAB_FULL, "BTS paging table is full");
-		}
+		LOGPTRX(trx, DRSL, LOGL_ERROR, "Failed to queue PAGING COMMAND: %d\n", rc);
 	}
 
-	pcu_tx_pag_req(identity_lv, chan_needed);
+	pcu_tx_pag_req(bts, identity_lv, chan_needed);
 
 	return 0;
 }
@@ -1770,6 +1771,47 @@ static void clear_lchan_for_pdch_activ(struct gsm_lchan *lchan)
 	memset(&lchan->tch, 0, sizeof(lchan->tch));
 }
 
+/* Measure the time a dynamic timeslot switch takes, from the request until
+ * the timeslot is usable in its new mode (and the ACK goes out) */
+static void dyn_ts_switch_start(struct gsm_bts_trx_ts *ts)
+{
+	osmo_clock_gettime(CLOCK_MONOTONIC, &ts->dyn.switch_start);
+	ts->dyn.switching = true;
+}
+
+static void dyn_ts_switch_done(struct gsm_bts_trx_ts *ts, int rc)
+{
+	struct rate_ctr_group *ctrs = ts->trx->bts->ctrs;
+	struct timespec now;
+	int64_t us;
+
+	if (!ts->dyn.switching)
+		return;
+	ts->dyn.switching = false;
+	if (rc != 0)
+		return;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	us = (now.tv_sec - ts->dyn.switch_start.tv_sec) * 1000000
+	     + (now.tv_nsec - ts->dyn.switch_start.tv_nsec) / 1000;
+
+	rate_ctr_inc2(ctrs, BTS_CTR_DYN_TS_SWITCH);
+	rate_ctr_add2(ctrs, BTS_CTR_DYN_TS_SWITCH_TIME, us);
+	if (us < 2000)
+		rate_ctr_inc2(ctrs, BTS_CTR_DYN_TS_SWITCH_LT_2MS);
+	else if (us < 10000)
+		rate_ctr_inc2(ctrs, BTS_CTR_DYN_TS_SWITCH_LT_10MS);
+	else if (us < 50000)
+		rate_ctr_inc2(ctrs, BTS_CTR_DYN_TS_SWITCH_LT_50MS);
+	else if (us < 200000)
+		rate_ctr_inc2(ctrs, BTS_CTR_DYN_TS_SWITCH_LT_200MS);
+	else
+		rate_ctr_inc2(ctrs, BTS_CTR_DYN_TS_SWITCH_GE_200MS);
+
+	LOGP(DRSL, LOGL_DEBUG, "%s switched in %" PRId64 " us\n",
+	     gsm_ts_and_pchan_name(ts), us);
+}
+
 /*!
  * Store the CHAN_ACTIV msg, connect the L1 timeslot in the proper type and
  * then invoke rsl_rx_chan_activ() with msg.
@@ -1797,6 +1839,7 @@ static int dyn_ts_l1_reconnect(struct gsm_bts_trx_ts *ts)
 
 	/* Disconnect, continue connecting from cb_ts_disconnected(). */
 	DEBUGP(DRSL, "%s Disconnect\n", gsm_ts_and_pchan_name(ts));
+	dyn_ts_switch_start(ts);
 	return bts_model_ts_disconnect(ts);
 }
 
@@ -1976,12 +2019,15 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 			 * mode than this activation needs it to be.
 			 * Re-connect, then come back to rsl_rx_chan_activ().
 			 */
-			rc = dyn_ts_l1_reconnect(ts);
-			if (rc)
-				return rsl_tx_chan_act_nack(lchan, RSL_ERR_NORMAL_UNSPEC);
-			/* will be fed back to rsl_rx_chan_activ() later */
+			/* will be fed back to rsl_rx_chan_activ() later, or
+			 * right away if the bts model connects synchronously */
 			OSMO_ASSERT(lchan->pending_chan_activ == NULL);
 			lchan->pending_chan_activ = msg;
+			rc = dyn_ts_l1_reconnect(ts);
+			if (rc) {
+				lchan->pending_chan_activ = NULL;
+				return rsl_tx_chan_act_nack(lchan, RSL_ERR_NORMAL_UNSPEC);
+			}
 			/* indicate that the msgb should not be freed. */
 			return 1;
 		}
@@ -3360,6 +3406,8 @@ static void rsl_rx_dyn_pdch(struct msgb *msg, bool pdch_act)
 		return;
 	}
 
+	dyn_ts_switch_start(ts);
+
 	if (pdch_act) {
 		/* Clear TCH state. Only first lchan matters for PDCH */
 		clear_lchan_for_pdch_activ(ts->lchan);
@@ -3508,12 +3556,14 @@ static void osmo_dyn_ts_connected(struct gsm_bts_trx_ts *ts, int rc)
 
 	if (rc) {
 		LOGPLCHAN(ts->lchan, DRSL, LOGL_NOTICE, "PDCH ACT OSMO operation failed (%d) in bts model\n", rc);
+		dyn_ts_switch_done(ts, rc);
 		ipacc_dyn_pdch_complete(ts, rc);
 		return;
 	}
 
 	ts->dyn.pchan_is = ts->dyn.pchan_want;
 	DEBUGP(DRSL, "%s Connected\n", gsm_ts_and_pchan_name(ts));
+	dyn_ts_switch_done(ts, 0);
 
 	/* Handle postponed RSL CHANnel ACTIVation messages (if any) */
 	for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
@@ -3558,6 +3608,7 @@ void ipacc_dyn_pdch_complete(struct gsm_bts_trx_ts *ts, int rc)
 	}
 
 	ts->flags &= ~TS_F_PDCH_PENDING_MASK;
+	dyn_ts_switch_done(ts, rc);
 
 	if (rc != 0) {
 		LOGP(DRSL, LOGL_ERROR,
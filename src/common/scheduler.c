@@ -574,14 +574,13 @@ const struct trx_chan_desc trx_chan_desc[_TRX_CHAN_MAX] = {
 	},
 };
 
-enum {
-	L1SCHED_TS_CTR_DL_LATE,
-	L1SCHED_TS_CTR_DL_NOT_FOUND,
-};
-
 static const struct rate_ctr_desc l1sched_ts_ctr_desc[] = {
 	[L1SCHED_TS_CTR_DL_LATE] =	{"l1sched_ts:dl_late", "Downlink frames arrived too late to submit to lower layers"},
 	[L1SCHED_TS_CTR_DL_NOT_FOUND] =	{"l1sched_ts:dl_not_found", "Downlink frames not found while scheduling"},
+	[L1SCHED_TS_CTR_DL_XCCH_CACHE_HIT] = {"l1sched_ts:dl_xcch_cache_hit", "Downlink xCCH blocks taken from the encoder cache"},
+	[L1SCHED_TS_CTR_DL_XCCH_CACHE_MISS] = {"l1sched_ts:dl_xcch_cache_miss", "Downlink xCCH blocks run through the encoder"},
+	[L1SCHED_TS_CTR_UL_PDTCH_DEC_FALLBACK] = {"l1sched_ts:ul_pdtch_dec_fallback", "Uplink PDTCH blocks run through both the EGPRS and the GPRS decoder"},
+	[L1SCHED_TS_CTR_UL_PDTCH_HINT_MISMATCH] = {"l1sched_ts:ul_pdtch_hint_mismatch", "Uplink PDTCH blocks not using the expected (E)GPRS coding scheme family"},
 };
 static const struct rate_ctr_group_desc l1sched_ts_ctrg_desc = {
 	"l1sched_ts",
@@ -1072,8 +1071,10 @@ static void _trx_sched_set_lchan(struct gsm_lchan *lchan,
 		  trx_chan_desc[chan].name);
 
 	if (active) {
-		/* Clean up everything */
+		/* Clean up everything, but keep counting the activations */
+		uint32_t gen = chan_state->gen;
 		memset(chan_state, 0, sizeof(*chan_state));
+		chan_state->gen = gen + 1;
 
 		/* Bind to generic 'struct gsm_lchan' */
 		chan_state->lchan = lchan;
@@ -1531,28 +1532,29 @@ static int trx_sched_calc_frame_loss(struct l1sched_ts *l1ts,
 }
 
 /* Process a single noise measurement for an inactive timeslot. */
-static void trx_sched_noise_meas(struct l1sched_chan_state *l1cs,
+static void trx_sched_noise_meas(struct l1sched_ts *l1ts,
 				 const struct trx_ul_burst_ind *bi)
 {
-	int *Avg = &l1cs->meas.interf_avg;
-
-	/* EWMA (Exponentially Weighted Moving Average):
-	*
-	*   Avg[n] = a * Val[n] + (1 - a) * Avg[n - 1]
-	*
-	* Implemented using the '+=' operator:
-	*
-	*   Avg += a * Val - a * Avg
-	*   Avg += a * (Val - Avg)
-	*
-	* We use constant 'a' = 0.5, what is equal to:
-	*
-	*   Avg += (Val - Avg) / 2
-	*
-	* We don't really need precisity here, so no scaling.
-	*/
-
-	*Avg += (bi->rssi - *Avg) / 2;
+	struct gsm_bts_trx_ts *ts = l1ts->ts;
+	struct gsm_lchan *lchan;
+
+	if (!bts_internal_flag_get(ts->trx->bts, BTS_INTERNAL_FLAG_INTERF_MEAS))
+		return;
+	/* Interference is reported for the primary timeslots only */
+	if (ts->vamos.is_shadow)
+		return;
+
+	if (bi->chan == TRXC_IDLE) {
+		/* The idle frames of a PDCH are the only ones measuring it.  Those
+		 * of TCH/F and SDCCH/8 multiframes belong to no particular lchan. */
+		if (ts_pchan(ts) != GSM_PCHAN_PDCH)
+			return;
+		lchan = &ts->lchan[0];
+	} else {
+		lchan = &ts->lchan[l1sap_chan2ss(trx_chan_desc[bi->chan].chan_nr)];
+	}
+
+	gsm_lchan_interf_meas_push(lchan, bi->rssi);
 }
 
 /* Process an Uplink burst indication */
@@ -1584,7 +1586,7 @@ int trx_sched_ul_burst(struct l1sched_ts *l1ts, struct trx_ul_burst_ind *bi)
 	if (!l1cs->active) {
 		/* handle noise measurements on dedicated and idle channels */
 		if (TRX_CHAN_IS_DEDIC(bi->chan) || bi->chan == TRXC_IDLE)
-			trx_sched_noise_meas(l1cs, bi);
+			trx_sched_noise_meas(l1ts, bi);
 		return 0;
 	}
 
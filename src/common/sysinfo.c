@@ -21,6 +21,7 @@
 #include <errno.h>
 
 #include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/gsm0502.h>
 #include <osmocom/gsm/sysinfo.h>
 
 #include <osmo-bts/logging.h>
@@ -39,11 +40,19 @@ static inline uint8_t *get_si2q_inc_index(struct gsm_bts *bts)
 	return (uint8_t *)GSM_BTS_SI2Q(bts, i);
 }
 
+static void bcch_sched_add(struct gsm_bts *bts, unsigned int tc, enum osmo_sysinfo_type si_type)
+{
+	OSMO_ASSERT(bts->si.bcch_sched[tc].num < ARRAY_SIZE(bts->si.bcch_sched[tc].si_type));
+	bts->si.bcch_sched[tc].si_type[bts->si.bcch_sched[tc].num++] = si_type;
+}
+
 /* Apply the rules from 05.02 6.3.1.3 Mapping of BCCH Data */
-uint8_t *bts_sysinfo_get(struct gsm_bts *bts, const struct gsm_time *g_time)
+static void bcch_sched_update(struct gsm_bts *bts)
 {
-	unsigned int tc4_cnt = 0;
-	unsigned int tc4_sub[4];
+	unsigned int tc;
+
+	for (tc = 0; tc < ARRAY_SIZE(bts->si.bcch_sched); tc++)
+		bts->si.bcch_sched[tc].num = 0;
 
 	/* System information type 2 bis or 2 ter messages are sent if
 	 * needed, as determined by the system operator.  If only one of
@@ -69,86 +78,114 @@ uint8_t *bts_sysinfo_get(struct gsm_bts *bts, const struct gsm_time *g_time)
 	 * 4 consecutive occurrences of TC = 4. */
 
 	/* We only implement BCCH Norm at this time */
-	switch (g_time->tc) {
-	case 0:
-		/* System Information Type 1 need only be sent if
-		 * frequency hopping is in use or when the NCH is
-		 * present in a cell. If the MS finds another message
-		 * when TC = 0, it can assume that System Information
-		 * Type 1 is not in use.  */
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_1))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_1);
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-	case 1:
-		/* A SI 2 message will be sent at least every time TC = 1. */
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-	case 2:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_3);
-	case 3:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_4);
-	case 4:
-		/* iterate over 2ter, 2quater, 9, 13 */
-		/* determine how many SI we need to send on TC=4,
-		 * and which of them we send when */
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) && GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis)) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_2ter;
-			tc4_cnt += 1;
-		}
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater) &&
-		    (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) || GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_2quater;
-			tc4_cnt += 1;
-		}
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_13) && pcu_connected()) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_13;
-			tc4_cnt += 1;
-		}
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_9)) {
-			/* FIXME: check SI3 scheduling info! */
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_9;
-			tc4_cnt += 1;
-		}
-		/* simply send SI2 if we have nothing else to send */
-		if (tc4_cnt == 0)
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-		else {
-			/* increment static counter by one, modulo count */
-			bts->si.tc4_ctr = (bts->si.tc4_ctr + 1) % tc4_cnt;
 
-			if (tc4_sub[bts->si.tc4_ctr] == SYSINFO_TYPE_2quater)
-				return get_si2q_inc_index(bts);
-
-			return GSM_BTS_SI(bts, tc4_sub[bts->si.tc4_ctr]);
-		}
-	case 5:
-		/* 2bis, 2ter, 2quater */
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) && !GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2bis);
-
-		else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) && !GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2ter);
+	/* TC = 0: System Information Type 1 need only be sent if
+	 * frequency hopping is in use or when the NCH is present in a
+	 * cell. If the MS finds another message when TC = 0, it can
+	 * assume that System Information Type 1 is not in use.  */
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_1))
+		bcch_sched_add(bts, 0, SYSINFO_TYPE_1);
+	else
+		bcch_sched_add(bts, 0, SYSINFO_TYPE_2);
+
+	/* TC = 1: A SI 2 message will be sent at least every time TC = 1. */
+	bcch_sched_add(bts, 1, SYSINFO_TYPE_2);
+	bcch_sched_add(bts, 2, SYSINFO_TYPE_3);
+	bcch_sched_add(bts, 3, SYSINFO_TYPE_4);
+	bcch_sched_add(bts, 6, SYSINFO_TYPE_3);
+	bcch_sched_add(bts, 7, SYSINFO_TYPE_4);
+
+	/* TC = 4: iterate over 2ter, 2quater, 9, 13 */
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) && GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis))
+		bcch_sched_add(bts, 4, SYSINFO_TYPE_2ter);
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater) &&
+	    (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) || GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter)))
+		bcch_sched_add(bts, 4, SYSINFO_TYPE_2quater);
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_13) && pcu_connected())
+		bcch_sched_add(bts, 4, SYSINFO_TYPE_13);
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_9)) {
+		/* FIXME: check SI3 scheduling info! */
+		bcch_sched_add(bts, 4, SYSINFO_TYPE_9);
+	}
+	/* simply send SI2 if we have nothing else to send */
+	if (bts->si.bcch_sched[4].num == 0)
+		bcch_sched_add(bts, 4, SYSINFO_TYPE_2);
+
+	/* TC = 5: 2bis, 2ter, 2quater */
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis))
+		bcch_sched_add(bts, 5, SYSINFO_TYPE_2bis);
+	else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
+		bcch_sched_add(bts, 5, SYSINFO_TYPE_2ter);
+	else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater))
+		bcch_sched_add(bts, 5, SYSINFO_TYPE_2quater);
+	else /* simply send SI2 if we have nothing else to send */
+		bcch_sched_add(bts, 5, SYSINFO_TYPE_2);
+}
 
-		else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) && GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2bis);
+/* Resolve the type (NCH, AGCH or PCH) of each CCCH block in the 51-multiframe */
+static void ccch_sched_update(struct gsm_bts *bts)
+{
+	const struct gsm48_system_information_type_3 *si3;
+	uint8_t first_nch = 0, num_nch = 0;
+	uint8_t bs_ag_blks_res = 1;
+	unsigned int fn51;
+	int block;
+
+	/* Note: The number of available access grant channels is set by the
+	 * parameter BS_AG_BLKS_RES via system information type 3. This SI is
+	 * transferred to osmo-bts via RSL */
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_3)) {
+		si3 = GSM_BTS_SI(bts, SYSINFO_TYPE_3);
+		bs_ag_blks_res = si3->control_channel_desc.bs_ag_blks_res;
+	}
 
-		else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater) &&
-			 !GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) && !GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return get_si2q_inc_index(bts);
+	if (bts->asci.pos_nch >= 0) {
+		if (osmo_gsm48_si1ro_nch_pos_decode(bts->asci.pos_nch, &num_nch, &first_nch) < 0)
+			num_nch = 0;
+	}
 
-			/* simply send SI2 if we have nothing else to send */
+	for (fn51 = 0; fn51 < ARRAY_SIZE(bts->si.ccch_msgt); fn51++) {
+		block = gsm0502_fn2ccch_block(fn51);
+		if (block < 0)
+			bts->si.ccch_msgt[fn51] = -1;
+		/* If there is an NCH, check if the block number matches. It has priority over PCH/AGCH. */
+		else if (block >= first_nch && block < first_nch + num_nch)
+			bts->si.ccch_msgt[fn51] = CCCH_MSGT_NCH;
+		else if (block < bs_ag_blks_res)
+			bts->si.ccch_msgt[fn51] = CCCH_MSGT_AGCH;
 		else
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-		break;
-	case 6:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_3);
-	case 7:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_4);
+			bts->si.ccch_msgt[fn51] = CCCH_MSGT_PCH;
 	}
+}
+
+/*! Rebuild the BCCH/CCCH schedule tables of a BTS.  Must be called whenever
+ *  the SI, the NCH position or the PCU connection state changes. */
+void bts_sysinfo_sched_update(struct gsm_bts *bts)
+{
+	bcch_sched_update(bts);
+	ccch_sched_update(bts);
+}
+
+/* Look up the SI to send on BCCH Norm in the schedule */
+uint8_t *bts_sysinfo_get(struct gsm_bts *bts, const struct gsm_time *g_time)
+{
+	uint8_t num = bts->si.bcch_sched[g_time->tc].num;
+	enum osmo_sysinfo_type si_type;
+
+	/* We must transmit a BCCH message on the normal BCCH in all cases. */
+	OSMO_ASSERT(num > 0);
+
+	if (num > 1) {
+		/* increment static counter by one, modulo count */
+		bts->si.tc4_ctr = (bts->si.tc4_ctr + 1) % num;
+		si_type = bts->si.bcch_sched[g_time->tc].si_type[bts->si.tc4_ctr];
+	} else
+		si_type = bts->si.bcch_sched[g_time->tc].si_type[0];
+
+	if (si_type == SYSINFO_TYPE_2quater)
+		return get_si2q_inc_index(bts);
 
-	/* this should never bve reached. We must transmit a BCCH
-	 * message on the normal BCCH in all cases. */
-	OSMO_ASSERT(0);
-	return 0;
+	return GSM_BTS_SI(bts, si_type);
 }
 
 uint8_t num_agch(const struct gsm_bts_trx *trx, const char * arg)
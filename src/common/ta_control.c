@@ -25,6 +25,7 @@
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/bts_trx.h>
 #include <osmo-bts/logging.h>
+#include <osmo-bts/ta_control.h>
 
 /* 3GPP TS 45.010 sec 5.6.3 Delay assessment error:
  * 75% of one bit duration in 1/256 symbols: 256*0.75 */
@@ -39,19 +40,12 @@
 #define TA_MAX_DEC_STEP 2
 
 
-/*! compute the new "Ordered Timing Advance" communicated to the MS and store it in lchan.
- * \param lchan logical channel for which to compute (and in which to store) new power value.
- * \param[in] ms_tx_ta The TA used by the MS and reported in L1SACCH, see struct gsm_sacch_l1_hdr field "ta".
- * \param[in] toa256 Time of Arrival (in 1/256th bits) computed at Rx side
- */
-void lchan_ms_ta_ctrl(struct gsm_lchan *lchan, uint8_t ms_tx_ta, int16_t toa256)
+/*! Shall the TA loop run for the current SACCH block of the given logical channel? */
+bool lchan_ms_ta_ctrl_due(struct gsm_lchan *lchan)
 {
-	int16_t new_ta;
-	/* Shall we skip current block based on configured interval? */
-
 	/* TA control interval: how many blocks do we skip? */
 	if (lchan->ta_ctrl.skip_block_num-- > 0)
-		return;
+		return false;
 
 	/* Reset the number of SACCH blocks to be skipped:
 	 *   ctrl_interval=0 => 0 blocks to skip,
@@ -59,30 +53,41 @@ void lchan_ms_ta_ctrl(struct gsm_lchan *lchan, uint8_t ms_tx_ta, int16_t toa256)
 	 *   ctrl_interval=2 => 3 blocks to skip,
 	 *     so basically ctrl_interval * 2 - 1. */
 	lchan->ta_ctrl.skip_block_num = lchan->ts->trx->ta_ctrl_interval * 2 - 1;
+	return true;
+}
 
-	int16_t delta_ta = toa256/256;
-	if (toa256 >= 0) {
-		if ((toa256 - (256 * delta_ta)) > TOA256_THRESH)
-			delta_ta++;
-		if (delta_ta > TA_MAX_INC_STEP)
-			delta_ta = TA_MAX_INC_STEP;
-	} else {
-		if ((toa256 - (256 * delta_ta)) < -TOA256_THRESH)
-			delta_ta--;
-		if (delta_ta < -TA_MAX_DEC_STEP)
-			delta_ta = -TA_MAX_DEC_STEP;
-	}
+/*! compute the new "Ordered Timing Advance" for a number of logical channels.
+ * \param[in] ms_tx_ta The TAs used by the MSs and reported in L1SACCH.
+ * \param[in] toa256 Times of Arrival (in 1/256th bits) computed at Rx side
+ * \param[out] new_ta The TAs to be ordered
+ * \param[in] num number of entries in the arrays
+ */
+void ta_ctrl_calc(const uint8_t *ms_tx_ta, const int16_t *toa256, int16_t *new_ta, unsigned int num)
+{
+	unsigned int i;
 
-	new_ta = ms_tx_ta + delta_ta;
+	/* written without branches, so that the compiler can vectorize it */
+	for (i = 0; i < num; i++) {
+		int16_t delta_ta = toa256[i] / 256;
+		int16_t rem = toa256[i] - 256 * delta_ta;
 
-	/* Make sure new_ta is never negative: */
-	if (new_ta < TA_MIN)
-		new_ta = TA_MIN;
+		delta_ta += (toa256[i] >= 0 && rem > TOA256_THRESH);
+		delta_ta -= (toa256[i] < 0 && rem < -TOA256_THRESH);
+		delta_ta = delta_ta > TA_MAX_INC_STEP ? TA_MAX_INC_STEP : delta_ta;
+		delta_ta = delta_ta < -TA_MAX_DEC_STEP ? -TA_MAX_DEC_STEP : delta_ta;
 
-	/* Don't ask for out of range TA: */
-	if (new_ta > TA_MAX)
-		new_ta = TA_MAX;
+		new_ta[i] = ms_tx_ta[i] + delta_ta;
+
+		/* Make sure new_ta is never negative: */
+		new_ta[i] = new_ta[i] < TA_MIN ? TA_MIN : new_ta[i];
+		/* Don't ask for out of range TA: */
+		new_ta[i] = new_ta[i] > TA_MAX ? TA_MAX : new_ta[i];
+	}
+}
 
+/*! store the new "Ordered Timing Advance" computed by ta_ctrl_calc() in lchan. */
+void lchan_ms_ta_ctrl_apply(struct gsm_lchan *lchan, int16_t new_ta, int16_t toa256)
+{
 	if (lchan->ta_ctrl.current == (uint8_t)new_ta) {
 		LOGPLCHAN(lchan, DLOOP, LOGL_DEBUG,
 			  "Keeping current TA at %u: TOA was %d\n",
@@ -100,3 +105,20 @@ void lchan_ms_ta_ctrl(struct gsm_lchan *lchan, uint8_t ms_tx_ta, int16_t toa256)
 	/* store the resulting new TA in the lchan */
 	lchan->ta_ctrl.current = (uint8_t)new_ta;
 }
+
+/*! compute the new "Ordered Timing Advance" communicated to the MS and store it in lchan.
+ * \param lchan logical channel for which to compute (and in which to store) new power value.
+ * \param[in] ms_tx_ta The TA used by the MS and reported in L1SACCH, see struct gsm_sacch_l1_hdr field "ta".
+ * \param[in] toa256 Time of Arrival (in 1/256th bits) computed at Rx side
+ */
+void lchan_ms_ta_ctrl(struct gsm_lchan *lchan, uint8_t ms_tx_ta, int16_t toa256)
+{
+	int16_t new_ta;
+
+	/* Shall we skip current block based on configured interval? */
+	if (!lchan_ms_ta_ctrl_due(lchan))
+		return;
+
+	ta_ctrl_calc(&ms_tx_ta, &toa256, &new_ta, 1);
+	lchan_ms_ta_ctrl_apply(lchan, new_ta, toa256);
+}
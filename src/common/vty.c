@@ -31,6 +31,8 @@
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/gsm/abis_nm.h>
+#include <osmocom/gsm/gsm0502.h>
+#include <osmocom/gsm/sysinfo.h>
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 #include <osmocom/vty/vty.h>
 #include <osmocom/vty/stats.h>
@@ -415,6 +417,13 @@ static void config_write_bts_single(struct vty *vty, const struct gsm_bts *bts)
 		VTY_NEWLINE);
 	vty_out(vty, " paging lifetime %u%s", paging_get_lifetime(bts->paging_state),
 		VTY_NEWLINE);
+	if (bts->abis_tx_coalesce_ms >= 0)
+		vty_out(vty, " abis-tx-coalesce %d%s", bts->abis_tx_coalesce_ms, VTY_NEWLINE);
+	if (bts->oml_snapshot.path != NULL)
+		vty_out(vty, " oml-snapshot %s%s", bts->oml_snapshot.path, VTY_NEWLINE);
+	/* the timers of BTS 0 are written as 'timer bts' on the config node */
+	if (bts->nr != 0)
+		osmo_tdef_vty_write(vty, bts->T_defs, " timer ");
 
 	/* Fall-back MS Power Control parameters may be changed by the user */
 	config_write_dpc_params(vty, "uplink", &bts->ms_dpc_params);
@@ -565,7 +574,15 @@ DEFUN_ATTR(cfg_bts,
 	int bts_nr = atoi(argv[0]);
 	struct gsm_bts *bts;
 
-	if (bts_nr >= g_bts_sm->num_bts) {
+	if (bts_nr == g_bts_sm->num_bts && vty->type == VTY_FILE) {
+		/* co-located BTS served by the same process, only from the config
+		 * file as the A-bis link is established after reading it */
+		bts = gsm_bts_alloc(g_bts_sm, bts_nr);
+		if (!bts || bts_init(bts) < 0) {
+			vty_out(vty, "%% Failed to create BTS %u%s", bts_nr, VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+	} else if (bts_nr >= g_bts_sm->num_bts) {
 		vty_out(vty, "%% Unknown BTS number %u (num %u)%s",
 			bts_nr, g_bts_sm->num_bts, VTY_NEWLINE);
 		return CMD_WARNING;
@@ -862,6 +879,80 @@ DEFUN_ATTR(cfg_bts_paging_lifetime,
 	return CMD_SUCCESS;
 }
 
+DEFUN_ATTR(cfg_bts_abis_tx_coalesce,
+	   cfg_bts_abis_tx_coalesce_cmd,
+	   "abis-tx-coalesce [<0-" OSMO_STRINGIFY_VAL(ABIS_TX_COALESCE_MAX_MS) ">]",
+	   "Write the OML/RSL messages to the BSC in batches (one writev() per batch)\n"
+	   "Maximum delay of a message in ms (default: 0, until the end of the main loop iteration)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->abis_tx_coalesce_ms = argc > 0 ? atoi(argv[0]) : 0;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_bts_no_abis_tx_coalesce,
+	   cfg_bts_no_abis_tx_coalesce_cmd,
+	   "no abis-tx-coalesce",
+	   NO_STR "Write each OML/RSL message to the BSC on its own (default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_trx *trx;
+
+	bts->abis_tx_coalesce_ms = -1;
+	abis_tx_queue_flush(&bts->oml_tx_queue);
+	llist_for_each_entry(trx, &bts->trx_list, list)
+		abis_tx_queue_flush(&trx->bb_transc.rsl.tx_queue);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_bts_oml_snapshot,
+	   cfg_bts_oml_snapshot_cmd,
+	   "oml-snapshot PATH",
+	   "Persist the configuration received from the BSC, and warm start from it after a restart\n"
+	   "File to store the configuration in\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct gsm_bts *bts = vty->index;
+
+	if (oml_snapshot_set_path(bts, argv[0]) < 0) {
+		vty_out(vty, "%% Failed to set the OML snapshot file%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_bts_no_oml_snapshot,
+	   cfg_bts_no_oml_snapshot_cmd,
+	   "no oml-snapshot",
+	   NO_STR "Do not persist the configuration received from the BSC (default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct gsm_bts *bts = vty->index;
+
+	oml_snapshot_set_path(bts, NULL);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_timer, cfg_bts_timer_cmd,
+      "timer " OSMO_TDEF_VTY_ARG_SET_OPTIONAL,
+      "Configure or show timers of this BTS\n"
+      OSMO_TDEF_VTY_DOC_SET)
+{
+	struct gsm_bts *bts = vty->index;
+
+	/* If any arguments are missing, redirect to 'show' */
+	if (argc < 2)
+		return osmo_tdef_vty_show_cmd(vty, bts->T_defs, argc ? argv[0] : NULL, NULL);
+	return osmo_tdef_vty_set_cmd(vty, bts->T_defs, argv);
+}
+
 #define AGCH_QUEUE_STR "AGCH queue mgmt\n"
 
 DEFUN_ATTR(cfg_bts_agch_queue_mgmt_params,
@@ -1461,6 +1552,52 @@ DEFUN(show_bts_gprs, show_bts_gprs_cmd,
 	return CMD_SUCCESS;
 }
 
+static const struct value_string ccch_msgt_names[] = {
+	{ CCCH_MSGT_AGCH,	"AGCH" },
+	{ CCCH_MSGT_PCH,	"PCH" },
+	{ CCCH_MSGT_NCH,	"NCH" },
+	{ 0, NULL }
+};
+
+DEFUN(show_bts_ccch_sched, show_bts_ccch_sched_cmd,
+      "show bts <0-255> ccch-schedule",
+      SHOW_STR "Display information about a BTS\n"
+      BTS_NR_STR "BCCH/CCCH schedule as derived from the System Information\n")
+{
+	const struct gsm_bts *bts;
+	unsigned int tc, i, fn51;
+	int block, prev_block = -1;
+
+	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
+	if (bts == NULL) {
+		vty_out(vty, "%% can't find BTS '%s'%s",
+			argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	vty_out(vty, "BCCH Norm (by TC):%s", VTY_NEWLINE);
+	for (tc = 0; tc < ARRAY_SIZE(bts->si.bcch_sched); tc++) {
+		vty_out(vty, "  TC=%u:", tc);
+		for (i = 0; i < bts->si.bcch_sched[tc].num; i++)
+			vty_out(vty, " SI%s", get_value_string(osmo_sitype_strs,
+							    bts->si.bcch_sched[tc].si_type[i]));
+		vty_out(vty, "%s", VTY_NEWLINE);
+	}
+
+	vty_out(vty, "CCCH (by FN mod 51):%s", VTY_NEWLINE);
+	for (fn51 = 0; fn51 < ARRAY_SIZE(bts->si.ccch_msgt); fn51++) {
+		/* one line per block, at its first TDMA frame */
+		block = gsm0502_fn2ccch_block(fn51);
+		if (bts->si.ccch_msgt[fn51] < 0 || block == prev_block)
+			continue;
+		prev_block = block;
+		vty_out(vty, "  FN=%02u: B%d %s%s", fn51, block,
+			get_value_string(ccch_msgt_names, bts->si.ccch_msgt[fn51]), VTY_NEWLINE);
+	}
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(test_send_failure_event_report, test_send_failure_event_report_cmd, "test send-failure-event-report <0-255>",
       "Various testing commands\n"
       "Send a test OML failure event report to the BSC\n" BTS_NR_STR)
@@ -2739,6 +2876,7 @@ int bts_vty_init(void *ctx)
 	install_element_ve(&show_lchan_cmd);
 	install_element_ve(&show_lchan_summary_cmd);
 	install_element_ve(&show_bts_gprs_cmd);
+	install_element_ve(&show_bts_ccch_sched_cmd);
 
 	install_element_ve(&logging_fltr_l1_sapi_cmd);
 	install_element_ve(&no_logging_fltr_l1_sapi_cmd);
@@ -2767,6 +2905,11 @@ int bts_vty_init(void *ctx)
 	install_element(BTS_NODE, &cfg_no_description_cmd);
 	install_element(BTS_NODE, &cfg_bts_paging_queue_size_cmd);
 	install_element(BTS_NODE, &cfg_bts_paging_lifetime_cmd);
+	install_element(BTS_NODE, &cfg_bts_abis_tx_coalesce_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_abis_tx_coalesce_cmd);
+	install_element(BTS_NODE, &cfg_bts_oml_snapshot_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_oml_snapshot_cmd);
+	install_element(BTS_NODE, &cfg_bts_timer_cmd);
 	install_element(BTS_NODE, &cfg_bts_agch_queue_mgmt_default_cmd);
 	install_element(BTS_NODE, &cfg_bts_agch_queue_mgmt_params_cmd);
 	install_element(BTS_NODE, &cfg_bts_ul_power_target_cmd);
@@ -8,6 +8,7 @@
 #include <osmocom/gsm/gsm_utils.h>
 
 #include <osmo-bts/phy_link.h>
+#include <osmo-bts/l1_transp_mq.h>
 
 #include <nrw/litecell15/gsml1prim.h>
 #include <nrw/litecell15/gsml1types.h>
@@ -53,7 +54,7 @@ struct lc15l1_hdl {
 	struct osmo_timer_list alive_timer;
 	unsigned int alive_prim_cnt;
 
-	struct osmo_fd read_ofd[_NUM_MQ_READ];	/* osmo file descriptors */
+	struct l1_mq_rx read_mq[_NUM_MQ_READ];
 	struct osmo_wqueue write_q[_NUM_MQ_WRITE];
 
 	struct {
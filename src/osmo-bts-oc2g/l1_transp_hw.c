@@ -31,16 +31,15 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/uio.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/select.h>
-#include <osmocom/core/write_queue.h>
 #include <osmocom/gsm/gsm_utils.h>
 
 #include <osmo-bts/logging.h>
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/l1_transp_mq.h>
 
 #include <nrw/oc2g/oc2g.h>
 #include <nrw/oc2g/gsml1prim.h>
@@ -82,74 +81,6 @@ static const char *wr_devnames[] = {
 osmo_static_assert(sizeof(GsmL1_Prim_t) + 128 <= OC2GBTS_PRIM_SIZE, l1_prim)
 osmo_static_assert(sizeof(Oc2g_Prim_t) + 128 <= OC2GBTS_PRIM_SIZE, super_prim)
 
-static int wqueue_vector_cb(struct osmo_fd *fd, unsigned int what)
-{
-	struct osmo_wqueue *queue;
-
-	queue = container_of(fd, struct osmo_wqueue, bfd);
-
-	if (what & OSMO_FD_READ)
-		queue->read_cb(fd);
-
-	if (what & OSMO_FD_EXCEPT)
-		queue->except_cb(fd);
-
-	if (what & OSMO_FD_WRITE) {
-		struct iovec iov[5];
-		struct msgb *msg, *tmp;
-		int written, count = 0;
-
-		osmo_fd_write_disable(fd);
-
-		llist_for_each_entry(msg, &queue->msg_queue, list) {
-			/* more writes than we have */
-			if (count >= ARRAY_SIZE(iov))
-				break;
-
-			iov[count].iov_base = msg->l1h;
-			iov[count].iov_len = msgb_l1len(msg);
-			count += 1;
-		}
-
-		/* TODO: check if all lengths are the same. */
-
-
-		/* Nothing scheduled? This should not happen. */
-		if (count == 0) {
-			if (!llist_empty(&queue->msg_queue))
-				osmo_fd_write_enable(fd);
-			return 0;
-		}
-
-		written = writev(fd->fd, iov, count);
-		if (written < 0) {
-			/* nothing written?! */
-			if (!llist_empty(&queue->msg_queue))
-				osmo_fd_write_enable(fd);
-			return 0;
-		}
-
-		/* now delete the written entries */
-		written = written / iov[0].iov_len;
-		count = 0;
-		llist_for_each_entry_safe(msg, tmp, &queue->msg_queue, list) {
-			queue->current_length -= 1;
-
-			llist_del(&msg->list);
-			msgb_free(msg);
-
-			count += 1;
-			if (count >= written)
-				break;
-		}
-
-		if (!llist_empty(&queue->msg_queue))
-			osmo_fd_write_enable(fd);
-	}
-
-	return 0;
-}
-
 static int prim_size_for_queue(int queue)
 {
 	switch (queue) {
@@ -168,9 +99,11 @@ static int prim_size_for_queue(int queue)
 	}
 }
 
-/* callback when there's something to read from the l1 msg_queue */
-static int read_dispatch_one(struct oc2gl1_hdl *fl1h, struct msgb *msg, int queue)
+/* callback for each primitive read from the l1 msg_queue */
+static int read_dispatch_one(void *data, struct msgb *msg, int queue)
 {
+	struct oc2gl1_hdl *fl1h = data;
+
 	switch (queue) {
 	case MQ_SYS_WRITE:
 		return l1if_handle_sysprim(fl1h, msg);
@@ -187,132 +120,21 @@ static int read_dispatch_one(struct oc2gl1_hdl *fl1h, struct msgb *msg, int queu
 	}
 };
 
-static int l1if_fd_cb(struct osmo_fd *ofd, unsigned int what)
-{
-	int i, rc;
-
-	const uint32_t prim_size = prim_size_for_queue(ofd->priv_nr);
-	uint32_t count;
-
-	struct iovec iov[3];
-	struct msgb *msg[ARRAY_SIZE(iov)];
-
-	for (i = 0; i < ARRAY_SIZE(iov); ++i) {
-		msg[i] = msgb_alloc_headroom(prim_size + 128, 128, "1l_fd");
-		msg[i]->l1h = msg[i]->data;
-
-		iov[i].iov_base = msg[i]->l1h;
-		iov[i].iov_len = msgb_tailroom(msg[i]);
-	}
-
-	rc = readv(ofd->fd, iov, ARRAY_SIZE(iov));
-	if (rc < 0) {
-		LOGP(DL1C, LOGL_ERROR, "failed to read from fd: %s\n", strerror(errno));
-		/* N. B: we do not abort to let the cycle below cleanup allocated memory properly,
-		   the return value is ignored by the caller anyway.
-		   TODO: use libexplain's explain_readv() to provide detailed error description */
-		count = 0;
-	} else
-		count = rc / prim_size;
-
-	for (i = 0; i < count; ++i) {
-		msgb_put(msg[i], prim_size);
-		read_dispatch_one(ofd->data, msg[i], ofd->priv_nr);
-	}
-
-	for (i = count; i < ARRAY_SIZE(iov); ++i)
-		msgb_free(msg[i]);
-
-	return 1;
-}
-
-/* callback when we can write to one of the l1 msg_queue devices */
-static int l1fd_write_cb(struct osmo_fd *ofd, struct msgb *msg)
-{
-	int rc;
-
-	rc = write(ofd->fd, msg->l1h, msgb_l1len(msg));
-	if (rc < 0) {
-		LOGP(DL1C, LOGL_ERROR, "error writing to L1 msg_queue: %s\n",
-			strerror(errno));
-		return rc;
-	} else if (rc < msg->len) {
-		LOGP(DL1C, LOGL_ERROR, "short write to L1 msg_queue: "
-			"%u < %u\n", rc, msg->len);
-		return -EIO;
-	}
-
-	return 0;
-}
-
 int l1if_transport_open(int q, struct oc2gl1_hdl *hdl)
 {
 	struct phy_link *plink = hdl->phy_inst->phy_link;
-	int rc;
-        char buf[PATH_MAX];
+	char rd_name[PATH_MAX];
+	char wr_name[PATH_MAX];
 
-	/* Step 1: Open all msg_queue file descriptors */
-	struct osmo_fd *read_ofd = &hdl->read_ofd[q];
-	struct osmo_wqueue *wq = &hdl->write_q[q];
-	struct osmo_fd *write_ofd = &hdl->write_q[q].bfd;
+	snprintf(rd_name, sizeof(rd_name), "%s%d", rd_devnames[q], plink->num);
+	snprintf(wr_name, sizeof(wr_name), "%s%d", wr_devnames[q], plink->num);
 
-        snprintf(buf, sizeof(buf)-1, "%s%d", rd_devnames[q], plink->num);
-        buf[sizeof(buf)-1] = '\0';
-
-	rc = open(buf, O_RDONLY);
-	if (rc < 0) {
-		LOGP(DL1C, LOGL_FATAL, "unable to open msg_queue %s: %s\n",
-			buf, strerror(errno));
-		return rc;
-	}
-	osmo_fd_setup(read_ofd, rc, OSMO_FD_READ, l1if_fd_cb, hdl, q);
-	rc = osmo_fd_register(read_ofd);
-	if (rc < 0) {
-		close(read_ofd->fd);
-		read_ofd->fd = -1;
-		return rc;
-	}
-
-        snprintf(buf, sizeof(buf)-1, "%s%d", wr_devnames[q], plink->num);
-        buf[sizeof(buf)-1] = '\0';
-
-	rc = open(buf, O_WRONLY);
-	if (rc < 0) {
-		LOGP(DL1C, LOGL_FATAL, "unable to open msg_queue %s: %s\n",
-			buf, strerror(errno));
-		goto out_read;
-	}
-	osmo_wqueue_init(wq, 10);
-	wq->write_cb = l1fd_write_cb;
-	osmo_fd_setup(write_ofd, rc, OSMO_FD_WRITE, wqueue_vector_cb, hdl, q);
-	rc = osmo_fd_register(write_ofd);
-	if (rc < 0) {
-		close(write_ofd->fd);
-		write_ofd->fd = -1;
-		goto out_read;
-	}
-
-	return 0;
-
-out_read:
-	close(hdl->read_ofd[q].fd);
-	osmo_fd_unregister(&hdl->read_ofd[q]);
-
-	return rc;
+	return l1_mq_open(&hdl->read_mq[q], &hdl->write_q[q], q, rd_name, wr_name,
+			  prim_size_for_queue(q), read_dispatch_one, hdl);
 }
 
 int l1if_transport_close(int q, struct oc2gl1_hdl *hdl)
 {
-	struct osmo_fd *read_ofd = &hdl->read_ofd[q];
-	struct osmo_fd *write_ofd = &hdl->write_q[q].bfd;
-
-	osmo_fd_unregister(read_ofd);
-	close(read_ofd->fd);
-	read_ofd->fd = -1;
-
-	osmo_fd_unregister(write_ofd);
-	close(write_ofd->fd);
-	write_ofd->fd = -1;
-
+	l1_mq_close(&hdl->read_mq[q], &hdl->write_q[q]);
 	return 0;
 }
@@ -2017,6 +2017,12 @@ static int ts_disconnect_cb(struct gsm_bts_trx *trx, struct msgb *l1_msg,
 	return 0;
 }
 
+int bts_model_warm_start(struct gsm_bts *bts)
+{
+	/* not supported, see BTS_INTERNAL_FLAG_WARM_START */
+	return -ENOTSUP;
+}
+
 int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 {
 	struct msgb *msg = l1p_msgb_alloc();
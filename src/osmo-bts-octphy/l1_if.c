@@ -1784,6 +1784,58 @@ static int octphy_write_cb(struct osmo_fd *fd, struct msgb *msg)
 	return rc;
 }
 
+static void octphy_ring_rx_cb(void *data, const uint8_t *buf, size_t len)
+{
+	struct msgb *msg = msgb_alloc_headroom(len + 24, 24, "PHY Rx");
+
+	if (!msg)
+		return;
+
+	/* this is the fl1h over which the message was received */
+	msg->dst = data;
+	memcpy(msgb_put(msg, len), buf, len);
+
+	rx_octphy_msg(msg);
+}
+
+/* PACKET_MMAP mode: process all frames of a poll wakeup, send all queued frames
+ * with a single syscall */
+static int octphy_ring_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct osmo_wqueue *wq = container_of(ofd, struct osmo_wqueue, bfd);
+	struct octphy_hdl *fl1h = ofd->data;
+	struct msgb *msg, *tmp;
+	int rc;
+
+	if (what & OSMO_FD_READ)
+		pkt_ring_rx(&fl1h->ring, octphy_ring_rx_cb, fl1h);
+
+	if (what & OSMO_FD_WRITE) {
+		osmo_fd_write_disable(ofd);
+
+		llist_for_each_entry_safe(msg, tmp, &wq->msg_queue, list) {
+			rc = pkt_ring_tx_put(&fl1h->ring, msgb_data(msg), msgb_length(msg));
+			/* TX ring full, retry once the kernel has sent some */
+			if (rc == -ENOSPC)
+				break;
+			if (rc < 0)
+				LOGP(DL1P, LOGL_ERROR, "Tx to PHY has failed: %s\n", strerror(-rc));
+			llist_del(&msg->list);
+			wq->current_length--;
+			msgb_free(msg);
+		}
+
+		rc = pkt_ring_tx_flush(&fl1h->ring, &fl1h->phy_addr);
+		if (rc < 0)
+			LOGP(DL1P, LOGL_ERROR, "Tx to PHY has failed: %s\n", strerror(-rc));
+
+		if (!llist_empty(&wq->msg_queue))
+			osmo_fd_write_enable(ofd);
+	}
+
+	return 0;
+}
+
 struct octphy_hdl *l1if_open(struct phy_link *plink)
 {
 	struct octphy_hdl *fl1h;
@@ -1841,14 +1893,31 @@ struct octphy_hdl *l1if_open(struct phy_link *plink)
 	memcpy(fl1h->phy_addr.sll_addr, plink->u.octphy.phy_addr.sll_addr,
 		ETH_ALEN);
 
+	if (plink->u.octphy.packet_mmap) {
+		rc = pkt_ring_open(&fl1h->ring, cOCTPKT_HDR_ETHERTYPE, ifr.ifr_ifindex);
+		if (rc == 0) {
+			/* the rings come with their own sockets */
+			close(sfd);
+			sfd = fl1h->ring.rx_fd;
+			fl1h->use_ring = true;
+		} else {
+			LOGP(DL1C, LOGL_NOTICE, "Falling back to recvfrom()/sendto() on %s\n",
+				phy_dev);
+		}
+	}
+
 	/* Write queue / osmo_fd registration */
 	osmo_wqueue_init(&fl1h->phy_wq, 10);
 	fl1h->phy_wq.write_cb = octphy_write_cb;
 	fl1h->phy_wq.read_cb = octphy_read_cb;
-	osmo_fd_setup(&fl1h->phy_wq.bfd, sfd, OSMO_FD_READ, osmo_wqueue_bfd_cb, fl1h, 0);
+	osmo_fd_setup(&fl1h->phy_wq.bfd, sfd, OSMO_FD_READ,
+		      fl1h->use_ring ? octphy_ring_fd_cb : osmo_wqueue_bfd_cb, fl1h, 0);
 	rc = osmo_fd_register(&fl1h->phy_wq.bfd);
 	if (rc < 0) {
-		close(sfd);
+		if (fl1h->use_ring)
+			pkt_ring_close(&fl1h->ring);
+		else
+			close(sfd);
 		talloc_free(fl1h);
 		return NULL;
 	}
@@ -1859,7 +1928,10 @@ struct octphy_hdl *l1if_open(struct phy_link *plink)
 int l1if_close(struct octphy_hdl *fl1h)
 {
 	osmo_fd_unregister(&fl1h->phy_wq.bfd);
-	close(fl1h->phy_wq.bfd.fd);
+	if (fl1h->use_ring)
+		pkt_ring_close(&fl1h->ring);
+	else
+		close(fl1h->phy_wq.bfd.fd);
 	talloc_free(fl1h);
 
 	return 0;
@@ -14,6 +14,7 @@
 
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/phy_link.h>
+#include <osmo-bts/packet_ring.h>
 
 #include <octphy/octvc1/gsm/octvc1_gsm_api.h>
 
@@ -25,6 +26,9 @@ struct octphy_hdl {
 
 	/* packet socket to talk with PHY */
 	struct osmo_wqueue phy_wq;
+	/* mmap'ed rings, phy_wq.bfd is the RX ring socket then */
+	struct pkt_ring ring;
+	bool use_ring;
 
 	/* address parameters of the PHY */
 	uint32_t session_id;
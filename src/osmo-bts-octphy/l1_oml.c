@@ -1794,6 +1794,12 @@ int bts_model_change_power(struct gsm_bts_trx *trx, int p_trxout_mdBm)
 	return 0;
 }
 
+int bts_model_warm_start(struct gsm_bts *bts)
+{
+	/* not supported, see BTS_INTERNAL_FLAG_WARM_START */
+	return -ENOTSUP;
+}
+
 int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 {
 	struct phy_instance *pinst = trx_phy_instance(ts->trx);
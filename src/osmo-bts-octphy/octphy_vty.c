@@ -193,6 +193,40 @@ DEFUN(cfg_phy_tx_atten_db, cfg_phy_tx_atten_db_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_phy_packet_mmap, cfg_phy_packet_mmap_cmd,
+	"octphy packet-mmap",
+	OCT_STR "Use mmap'ed packet rings towards the OCTPHY (TPACKET_V3 Rx, TPACKET_V2 Tx)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	if (plink->state != PHY_LINK_SHUTDOWN) {
+		vty_out(vty, "Can only reconfigure a PHY link that is down%s",
+			VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	plink->u.octphy.packet_mmap = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_phy_no_packet_mmap, cfg_phy_no_packet_mmap_cmd,
+	"no octphy packet-mmap",
+	NO_STR OCT_STR "Use recvfrom()/sendto() for each packet towards the OCTPHY\n")
+{
+	struct phy_link *plink = vty->index;
+
+	if (plink->state != PHY_LINK_SHUTDOWN) {
+		vty_out(vty, "Can only reconfigure a PHY link that is down%s",
+			VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	plink->u.octphy.packet_mmap = false;
+
+	return CMD_SUCCESS;
+}
+
 #if OCTPHY_USE_16X_OVERSAMPLING == 1
 DEFUN(cfg_phy_over_sample_16x, cfg_phy_over_sample_16x_cmd,
       "octphy over-sample-16x <0-1>",
@@ -395,6 +429,8 @@ void bts_model_config_write_phy(struct vty *vty, const struct phy_link *plink)
 	vty_out(vty, " octphy over-sample-16x %u%s", plink->u.octphy.over_sample_16x,
 		VTY_NEWLINE);
 #endif
+	if (plink->u.octphy.packet_mmap)
+		vty_out(vty, " octphy packet-mmap%s", VTY_NEWLINE);
 }
 
 void bts_model_config_write_phy_inst(struct vty *vty, const struct phy_instance *pinst)
@@ -446,6 +482,8 @@ int bts_model_vty_init(void *ctx)
 #endif
 	install_element(PHY_NODE, &cfg_phy_rx_gain_db_cmd);
 	install_element(PHY_NODE, &cfg_phy_tx_atten_db_cmd);
+	install_element(PHY_NODE, &cfg_phy_packet_mmap_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_packet_mmap_cmd);
 #if OCTPHY_USE_16X_OVERSAMPLING == 1
 	install_element(PHY_NODE, &cfg_phy_over_sample_16x_cmd);
 #endif
@@ -211,6 +211,11 @@ int bts_model_oml_estab(struct gsm_bts *bts)
 	return 0;
 }
 
+int bts_model_warm_start(struct gsm_bts *bts)
+{
+	return -ENOTSUP;
+}
+
 int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 {
 	return -ENOTSUP;
@@ -19,7 +19,10 @@
  *
  */
 
+#define _GNU_SOURCE
 #include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -38,6 +41,9 @@
 #include <osmocom/core/logging.h>
 #include <osmocom/core/socket.h>
 #include <osmocom/core/application.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/gsm/gsm_utils.h>
 
 #include <osmo-bts/logging.h>
@@ -62,11 +68,49 @@ static const uint16_t fwd_udp_ports[_NUM_MQ_WRITE] = {
 #endif
 };
 
+/* maximum number of datagrams per recvmmsg() / sendmmsg() */
+#define L1FWD_BATCH		16
+/* interval for logging the counters, in seconds */
+#define L1FWD_STATS_INTERVAL	60
+
+enum l1fwd_ctr {
+	L1FWD_CTR_UDP_RX_BATCH,
+	L1FWD_CTR_UDP_RX_PRIM,
+	L1FWD_CTR_UDP_TX_BATCH,
+	L1FWD_CTR_UDP_TX_PRIM,
+	L1FWD_CTR_UDP_TX_DROP,
+	L1FWD_CTR_MQ_TX_DROP,
+};
+
+static const struct rate_ctr_desc l1fwd_ctr_desc[] = {
+	[L1FWD_CTR_UDP_RX_BATCH] = { "udp:rx_batch", "recvmmsg() calls returning primitives" },
+	[L1FWD_CTR_UDP_RX_PRIM] = { "udp:rx_prim", "Primitives received from the BTS" },
+	[L1FWD_CTR_UDP_TX_BATCH] = { "udp:tx_batch", "sendmmsg() calls sending primitives" },
+	[L1FWD_CTR_UDP_TX_PRIM] = { "udp:tx_prim", "Primitives sent to the BTS" },
+	[L1FWD_CTR_UDP_TX_DROP] = { "udp:tx_drop", "Primitives from the DSP dropped, UDP queue full" },
+	[L1FWD_CTR_MQ_TX_DROP] = { "mq:tx_drop", "Primitives from the BTS dropped, DSP queue full" },
+};
+static const struct rate_ctr_group_desc l1fwd_ctrg_desc = {
+	"l1fwd",
+	"L1 forwarding proxy counters",
+	OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(l1fwd_ctr_desc),
+	l1fwd_ctr_desc
+};
+
 struct l1fwd_hdl {
 	struct sockaddr_storage remote_sa[_NUM_MQ_WRITE];
 	socklen_t remote_sa_len[_NUM_MQ_WRITE];
 
 	struct osmo_wqueue udp_wq[_NUM_MQ_WRITE];
+	/* receive buffers, kept until a datagram was received into them */
+	struct msgb *udp_rx_msg[_NUM_MQ_WRITE][L1FWD_BATCH];
+
+	struct rate_ctr_group *ctrs;
+	struct osmo_timer_list stats_timer;
+
+	/* write callback of the DSP queues, wrapped by mq_write_fd_cb() */
+	int (*mq_write_cb)(struct osmo_fd *ofd, unsigned int what);
 
 	struct femtol1_hdl *fl1h;
 };
@@ -80,6 +124,7 @@ int l1if_handle_l1prim(int wq, struct femtol1_hdl *fl1h, struct msgb *msg)
 	/* Enqueue message to UDP socket */
 	if (osmo_wqueue_enqueue(&l1fh->udp_wq[wq], msg) != 0) {
 		LOGP(DL1C, LOGL_ERROR, "Write queue %d full. dropping msg\n", wq);
+		rate_ctr_inc2(l1fh->ctrs, L1FWD_CTR_UDP_TX_DROP);
 		msgb_free(msg);
 		return -EAGAIN;
 	}
@@ -94,6 +139,7 @@ int l1if_handle_sysprim(struct femtol1_hdl *fl1h, struct msgb *msg)
 	/* Enqueue message to UDP socket */
 	if (osmo_wqueue_enqueue(&l1fh->udp_wq[MQ_SYS_WRITE], msg) != 0) {
 		LOGP(DL1C, LOGL_ERROR, "MQ_SYS_WRITE ful. dropping msg\n");
+		rate_ctr_inc2(l1fh->ctrs, L1FWD_CTR_UDP_TX_DROP);
 		msgb_free(msg);
 		return -EAGAIN;
 	}
@@ -101,70 +147,193 @@ int l1if_handle_sysprim(struct femtol1_hdl *fl1h, struct msgb *msg)
 }
 
 
-/* data has arrived on the udp socket */
+/* datagrams have arrived on the udp socket */
 static int udp_read_cb(struct osmo_fd *ofd)
 {
-	struct msgb *msg = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "udp_rx");
 	struct l1fwd_hdl *l1fh = ofd->data;
 	struct femtol1_hdl *fl1h = l1fh->fl1h;
-	int rc;
+	struct osmo_wqueue *mq = &fl1h->write_q[ofd->priv_nr];
+	struct msgb **rx_msg = l1fh->udp_rx_msg[ofd->priv_nr];
+	struct sockaddr_storage sa[L1FWD_BATCH];
+	struct mmsghdr mmsg[L1FWD_BATCH];
+	struct iovec iov[L1FWD_BATCH];
+	unsigned int num, max;
+	struct msgb *msg;
+	int i, rc;
+
+	/* Do not read more than the DSP queue can take, the rest stays in the
+	 * socket buffer. While the queue is full, stop polling the socket
+	 * altogether; mq_write_fd_cb() resumes reading once it drained. */
+	max = OSMO_MIN(L1FWD_BATCH, mq->max_length - OSMO_MIN(mq->max_length, mq->current_length));
+	if (max == 0) {
+		osmo_fd_read_disable(ofd);
+		return 0;
+	}
 
-	if (!msg)
+	for (num = 0; num < max; num++) {
+		if (!rx_msg[num]) {
+			rx_msg[num] = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "udp_rx");
+			if (!rx_msg[num])
+				break;
+			rx_msg[num]->l1h = rx_msg[num]->data;
+		}
+		iov[num].iov_base = rx_msg[num]->l1h;
+		iov[num].iov_len = msgb_tailroom(rx_msg[num]);
+		memset(&mmsg[num], 0, sizeof(mmsg[num]));
+		mmsg[num].msg_hdr.msg_iov = &iov[num];
+		mmsg[num].msg_hdr.msg_iovlen = 1;
+		mmsg[num].msg_hdr.msg_name = &sa[num];
+		mmsg[num].msg_hdr.msg_namelen = sizeof(sa[num]);
+	}
+	if (num == 0)
 		return -ENOMEM;
 
-	msg->l1h = msg->data;
-
-	l1fh->remote_sa_len[ofd->priv_nr] = sizeof(l1fh->remote_sa[ofd->priv_nr]);
-	rc = recvfrom(ofd->fd, msg->l1h, msgb_tailroom(msg), 0,
-		      (struct sockaddr *) &l1fh->remote_sa[ofd->priv_nr], &l1fh->remote_sa_len[ofd->priv_nr]);
+	rc = recvmmsg(ofd->fd, mmsg, num, MSG_DONTWAIT, NULL);
 	if (rc < 0) {
+		if (errno == EAGAIN)
+			return 0;
 		perror("read from udp");
-		msgb_free(msg);
-		return rc;
-	} else if (rc == 0) {
-		perror("len=0 read from udp");
-		msgb_free(msg);	
 		return rc;
-	}
-	msgb_put(msg, rc);
+	} else if (rc == 0)
+		return 0;
 
-	DEBUGP(DL1C, "UDP: Received %u bytes for queue %d\n", rc,
-		ofd->priv_nr);
+	rate_ctr_inc2(l1fh->ctrs, L1FWD_CTR_UDP_RX_BATCH);
+	rate_ctr_add2(l1fh->ctrs, L1FWD_CTR_UDP_RX_PRIM, rc);
+
+	/* replies go to whoever sent the most recent primitive */
+	memcpy(&l1fh->remote_sa[ofd->priv_nr], &sa[rc - 1], mmsg[rc - 1].msg_hdr.msg_namelen);
+	l1fh->remote_sa_len[ofd->priv_nr] = mmsg[rc - 1].msg_hdr.msg_namelen;
+
+	for (i = 0; i < rc; i++) {
+		/* empty datagrams leave their buffer in place */
+		if (mmsg[i].msg_len == 0)
+			continue;
 
-	/* put the message into the right queue */
-	if (osmo_wqueue_enqueue(&fl1h->write_q[ofd->priv_nr], msg) != 0) {
-		LOGP(DL1C, LOGL_ERROR, "Write queue %d full. dropping msg\n",
+		msg = rx_msg[i];
+		rx_msg[i] = NULL;
+		msgb_put(msg, mmsg[i].msg_len);
+
+		DEBUGP(DL1C, "UDP: Received %u bytes for queue %d\n", mmsg[i].msg_len,
 			ofd->priv_nr);
-		msgb_free(msg);
-		return -EAGAIN;
+
+		/* put the message into the right queue */
+		if (osmo_wqueue_enqueue(mq, msg) != 0) {
+			LOGP(DL1C, LOGL_ERROR, "Write queue %d full. dropping msg\n",
+				ofd->priv_nr);
+			rate_ctr_inc2(l1fh->ctrs, L1FWD_CTR_MQ_TX_DROP);
+			msgb_free(msg);
+		}
 	}
+
+	if (mq->current_length >= mq->max_length)
+		osmo_fd_read_disable(ofd);
+
 	return 0;
 }
 
-/* callback when we can write to the UDP socket */
-static int udp_write_cb(struct osmo_fd *ofd, struct msgb *msg)
+/* the DSP queue was written to, resume reading from UDP if there is room */
+static int mq_write_fd_cb(struct osmo_fd *ofd, unsigned int what)
 {
+	struct femtol1_hdl *fl1h = ofd->data;
+	struct l1fwd_hdl *l1fh = fl1h->priv;
+	struct osmo_wqueue *mq = container_of(ofd, struct osmo_wqueue, bfd);
 	int rc;
+
+	rc = l1fh->mq_write_cb(ofd, what);
+
+	if (mq->current_length < mq->max_length)
+		osmo_fd_read_enable(&l1fh->udp_wq[ofd->priv_nr].bfd);
+
+	return rc;
+}
+
+/* send as many queued primitives as possible to the UDP socket */
+static int udp_write_cb(struct osmo_fd *ofd)
+{
+	struct osmo_wqueue *wq = container_of(ofd, struct osmo_wqueue, bfd);
 	struct l1fwd_hdl *l1fh = ofd->data;
+	struct mmsghdr mmsg[L1FWD_BATCH];
+	struct iovec iov[L1FWD_BATCH];
+	struct msgb *msg, *tmp;
+	unsigned int count = 0;
+	int i, rc;
+
+	llist_for_each_entry(msg, &wq->msg_queue, list) {
+		if (count >= L1FWD_BATCH)
+			break;
+		iov[count].iov_base = msg->l1h;
+		iov[count].iov_len = msgb_l1len(msg);
+		memset(&mmsg[count], 0, sizeof(mmsg[count]));
+		mmsg[count].msg_hdr.msg_iov = &iov[count];
+		mmsg[count].msg_hdr.msg_iovlen = 1;
+		mmsg[count].msg_hdr.msg_name = &l1fh->remote_sa[ofd->priv_nr];
+		mmsg[count].msg_hdr.msg_namelen = l1fh->remote_sa_len[ofd->priv_nr];
+		count++;
+	}
+	if (count == 0)
+		return 0;
 
-	DEBUGP(DL1C, "UDP: Writing %u bytes for queue %d\n", msgb_l1len(msg),
+	DEBUGP(DL1C, "UDP: Writing %u primitive(s) for queue %d\n", count,
 		ofd->priv_nr);
 
-	rc = sendto(ofd->fd, msg->l1h, msgb_l1len(msg), 0,
-		    (const struct sockaddr *)&l1fh->remote_sa[ofd->priv_nr], l1fh->remote_sa_len[ofd->priv_nr]);
+	rc = sendmmsg(ofd->fd, mmsg, count, 0);
 	if (rc < 0) {
+		if (errno == EAGAIN) {
+			osmo_fd_write_enable(ofd);
+			return 0;
+		}
 		LOGP(DL1C, LOGL_ERROR, "error writing to L1 msg_queue: %s\n",
 			strerror(errno));
-		return rc;
-	} else if (rc < msgb_l1len(msg)) {
-		LOGP(DL1C, LOGL_ERROR, "short write to L1 msg_queue: "
-			"%u < %u\n", rc, msgb_l1len(msg));
-		return -EIO;
+		/* drop the primitive that failed, like osmo_wqueue would */
+		rc = 1;
+	} else {
+		rate_ctr_inc2(l1fh->ctrs, L1FWD_CTR_UDP_TX_BATCH);
+		rate_ctr_add2(l1fh->ctrs, L1FWD_CTR_UDP_TX_PRIM, rc);
+	}
+
+	i = 0;
+	llist_for_each_entry_safe(msg, tmp, &wq->msg_queue, list) {
+		if (i++ >= rc)
+			break;
+		wq->current_length--;
+		llist_del(&msg->list);
+		msgb_free(msg);
+	}
+
+	if (!llist_empty(&wq->msg_queue))
+		osmo_fd_write_enable(ofd);
+
+	return 0;
+}
+
+static int udp_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	if (what & OSMO_FD_READ)
+		udp_read_cb(ofd);
+
+	if (what & OSMO_FD_WRITE) {
+		osmo_fd_write_disable(ofd);
+		udp_write_cb(ofd);
 	}
 
 	return 0;
 }
 
+static void stats_timer_cb(void *data)
+{
+	struct l1fwd_hdl *l1fh = data;
+	const struct rate_ctr *ctr;
+	unsigned int i;
+
+	for (i = 0; i < l1fwd_ctrg_desc.num_ctr; i++) {
+		ctr = rate_ctr_group_get_ctr(l1fh->ctrs, i);
+		LOGP(DL1C, LOGL_INFO, "%s: %" PRIu64 " (%s)\n", l1fwd_ctr_desc[i].name,
+		     ctr->current, l1fwd_ctr_desc[i].description);
+	}
+
+	osmo_timer_schedule(&l1fh->stats_timer, L1FWD_STATS_INTERVAL, 0);
+}
+
 int main(int argc, char **argv)
 {
 	struct l1fwd_hdl *l1fh;
@@ -205,15 +374,22 @@ int main(int argc, char **argv)
 	l1fh->fl1h = fl1h;
 	fl1h->priv = l1fh;
 
+	l1fh->ctrs = rate_ctr_group_alloc(l1fh, &l1fwd_ctrg_desc, 0);
+	osmo_timer_setup(&l1fh->stats_timer, stats_timer_cb, l1fh);
+	osmo_timer_schedule(&l1fh->stats_timer, L1FWD_STATS_INTERVAL, 0);
+
+	/* get notified whenever a DSP queue drains */
+	l1fh->mq_write_cb = fl1h->write_q[0].bfd.cb;
+	for (i = 0; i < ARRAY_SIZE(fl1h->write_q); i++)
+		fl1h->write_q[i].bfd.cb = mq_write_fd_cb;
+
 	/* Open UDP */
 	for (i = 0; i < ARRAY_SIZE(l1fh->udp_wq); i++) {
 		struct osmo_wqueue *wq = &l1fh->udp_wq[i];
 
 		osmo_wqueue_init(wq, 10);
-		wq->write_cb = udp_write_cb;
-		wq->read_cb = udp_read_cb;
 
-		osmo_fd_setup(&wq->bfd, -1, OSMO_FD_READ, osmo_wqueue_bfd_cb, l1fh, i);
+		osmo_fd_setup(&wq->bfd, -1, OSMO_FD_READ, udp_fd_cb, l1fh, i);
 		rc = osmo_sock_init_ofd(&wq->bfd, AF_UNSPEC, SOCK_DGRAM,
 					IPPROTO_UDP, NULL, fwd_udp_ports[i],
 					OSMO_SOCK_F_BIND);
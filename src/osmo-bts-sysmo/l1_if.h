@@ -8,6 +8,7 @@
 #include <osmocom/gsm/gsm_utils.h>
 
 #include <osmo-bts/phy_link.h>
+#include <osmo-bts/l1_transp_mq.h>
 
 #include <sysmocom/femtobts/gsml1prim.h>
 
@@ -57,7 +58,7 @@ struct femtol1_hdl {
 	struct osmo_timer_list alive_timer;
 	unsigned int alive_prim_cnt;
 
-	struct osmo_fd read_ofd[_NUM_MQ_READ];	/* osmo file descriptors */
+	struct l1_mq_rx read_mq[_NUM_MQ_READ];
 	struct osmo_wqueue write_q[_NUM_MQ_WRITE];
 
 	struct {
@@ -426,7 +426,7 @@ int l1if_tch_encode(struct gsm_lchan *lchan, uint8_t *data, uint8_t *len,
 		}
 
 		/* DTX DL-specific logic below: */
-		switch (lchan->tch.dtx.dl_amr_fsm->state) {
+		switch (lchan->tch.dtx.dl_amr_state) {
 		case ST_ONSET_V:
 			*payload_type = GsmL1_TchPlType_Amr_Onset;
 			dtx_cache_payload(lchan, rtp_pl, rtp_pl_len, fn, 0);
@@ -471,7 +471,7 @@ int l1if_tch_encode(struct gsm_lchan *lchan, uint8_t *data, uint8_t *len,
 			return -EBADMSG;
 		default:
 			LOGP(DRTP, LOGL_ERROR, "Unhandled DTX DL AMR FSM state "
-			     "%d\n", lchan->tch.dtx.dl_amr_fsm->state);
+			     "%d\n", lchan->tch.dtx.dl_amr_state);
 			return -EINVAL;
 		}
 		break;
@@ -0,0 +1,206 @@
+/* osmo-bts-burst-trace - render a binary burst trace file into log text */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmo-bts/burst_trace.h>
+
+static int filter_trx = -1;
+static int filter_tn = -1;
+
+/* The formats are read from the file: only accept up to BURST_TRACE_NUM_ARGS
+ * integer conversions, so that they can safely be passed to printf(). */
+static bool event_fmt_valid(const char *fmt, size_t len)
+{
+	unsigned int num = 0;
+	const char *p;
+
+	if (strnlen(fmt, len) == len)
+		return false;
+
+	for (p = fmt; *p != '\0'; p++) {
+		if (*p != '%')
+			continue;
+		p++;
+		if (*p == '%')
+			continue;
+		p += strspn(p, "-+ #0123456789");
+		if (*p == '\0' || strchr("diuxX", *p) == NULL)
+			return false;
+		if (++num > BURST_TRACE_NUM_ARGS)
+			return false;
+	}
+
+	return true;
+}
+
+static void print_rec(const struct burst_trace_hdr *hdr, const struct burst_trace_rec *rec,
+		      uint32_t time_us, const bool *fmt_valid)
+{
+	const char *chan = "";
+
+	if (rec->chan < BURST_TRACE_CHAN_MAX)
+		chan = hdr->chan_names[rec->chan];
+
+	/* same context as LOGL1S(), the pchan is not known here */
+	printf("+%u.%06u %s (trx=%u,ts=%u) %.*s: ", time_us / 1000000, time_us % 1000000,
+	       gsm_fn_as_gsmtime_str(rec->fn), rec->trx, rec->tn, BURST_TRACE_NAME_LEN, chan);
+
+	if (rec->event < _BURST_TRACE_EV_MAX && fmt_valid[rec->event])
+		printf(hdr->event_fmts[rec->event], rec->arg[0], rec->arg[1], rec->arg[2], rec->arg[3]);
+	else
+		printf("event %u (%d, %d, %d, %d)", rec->event,
+		       rec->arg[0], rec->arg[1], rec->arg[2], rec->arg[3]);
+	printf("\n");
+}
+
+static int decode(const char *path)
+{
+	const struct burst_trace_hdr *hdr;
+	const struct burst_trace_rec *recs;
+	bool fmt_valid[_BURST_TRACE_EV_MAX];
+	uint64_t head, idx, torn = 0;
+	uint32_t time0 = 0;
+	bool first = true;
+	struct stat st;
+	void *map;
+	int fd, i;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return -errno;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < BURST_TRACE_HDR_SIZE) {
+		fprintf(stderr, "%s is not a burst trace file\n", path);
+		close(fd);
+		return -EINVAL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Failed to map %s: %s\n", path, strerror(errno));
+		return -errno;
+	}
+
+	hdr = map;
+	if (memcmp(hdr->magic, BURST_TRACE_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->rec_size != sizeof(struct burst_trace_rec) ||
+	    hdr->num_recs == 0 || (hdr->num_recs & (hdr->num_recs - 1)) != 0 ||
+	    st.st_size < BURST_TRACE_HDR_SIZE + (off_t) hdr->num_recs * hdr->rec_size) {
+		fprintf(stderr, "%s is not a burst trace file (or of another version)\n", path);
+		munmap(map, st.st_size);
+		return -EINVAL;
+	}
+	recs = (const struct burst_trace_rec *) ((const uint8_t *) map + BURST_TRACE_HDR_SIZE);
+
+	for (i = 0; i < _BURST_TRACE_EV_MAX; i++)
+		fmt_valid[i] = event_fmt_valid(hdr->event_fmts[i], BURST_TRACE_FMT_LEN);
+
+	/* the file may still be written to, only render what was there when we started */
+	head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	idx = head > hdr->num_recs ? head - hdr->num_recs : 0;
+	for (; idx < head; idx++) {
+		const struct burst_trace_rec *rec = &recs[idx & (hdr->num_recs - 1)];
+
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != (uint32_t) (idx + 1)) {
+			torn++;
+			continue;
+		}
+		if (filter_trx >= 0 && rec->trx != filter_trx)
+			continue;
+		if (filter_tn >= 0 && rec->tn != filter_tn)
+			continue;
+
+		if (first) {
+			time0 = rec->time_us;
+			first = false;
+		}
+		print_rec(hdr, rec, rec->time_us - time0, fmt_valid);
+	}
+
+	if (head > hdr->num_recs)
+		fprintf(stderr, "%" PRIu64 " older records were overwritten\n", head - hdr->num_recs);
+	if (torn > 0)
+		fprintf(stderr, "%" PRIu64 " records were being written and are skipped\n", torn);
+
+	munmap(map, st.st_size);
+	return 0;
+}
+
+static void print_help(const char *name)
+{
+	printf("Usage: %s [-t TRX] [-s TS] FILE\n\n"
+	       "Render a trace written by 'burst-trace start FILE' into log text.\n\n"
+	       "  -h --help           This text\n"
+	       "  -t --trx TRX        Only show records of the given TRX\n"
+	       "  -s --timeslot TS    Only show records of the given timeslot\n",
+	       name);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_options[] = {
+		{ "help", 0, 0, 'h' },
+		{ "trx", 1, 0, 't' },
+		{ "timeslot", 1, 0, 's' },
+		{ 0, 0, 0, 0 }
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "ht:s:", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			print_help(argv[0]);
+			return EXIT_SUCCESS;
+		case 't':
+			filter_trx = atoi(optarg);
+			break;
+		case 's':
+			filter_tn = atoi(optarg);
+			break;
+		default:
+			print_help(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind != argc - 1) {
+		print_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	return decode(argv[optind]) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -256,7 +256,8 @@ static uint8_t trx_set_trx(struct gsm_bts_trx *trx)
 
 /* set ts attributes */
 static uint8_t trx_set_ts_as_pchan(struct gsm_bts_trx_ts *ts,
-				   enum gsm_phys_chan_config pchan)
+				   enum gsm_phys_chan_config pchan,
+				   bool early_connect)
 {
 	struct phy_instance *pinst = trx_phy_instance(ts->trx);
 	struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
@@ -301,7 +302,11 @@ static uint8_t trx_set_ts_as_pchan(struct gsm_bts_trx_ts *ts,
 	slottype = transceiver_chan_types[pchan];
 
 
-	struct trx_prov_ev_cfg_ts_data data = { .tn = tn, .slottype = slottype };
+	struct trx_prov_ev_cfg_ts_data data = {
+		.tn = tn,
+		.slottype = slottype,
+		.early_connect = early_connect,
+	};
 	if (ts->tsc_set != 0) {
 		/* On TRXC we use 3GPP compliant numbering, so +1 */
 		data.tsc_set = ts->tsc_set + 1;
@@ -336,7 +341,7 @@ static uint8_t trx_set_ts(struct gsm_bts_trx_ts *ts)
 		break;
 	}
 
-	return trx_set_ts_as_pchan(ts, pchan);
+	return trx_set_ts_as_pchan(ts, pchan, false);
 }
 
 
@@ -701,6 +706,47 @@ int bts_model_oml_estab(struct gsm_bts *bts)
 	return 0;
 }
 
+/* Provision the transceivers as if the BSC had configured and enabled them,
+ * the configuration sent by the BSC later on is applied on top. */
+int bts_model_warm_start(struct gsm_bts *bts)
+{
+	struct gsm_bts_trx *trx;
+	struct phy_instance *pinst;
+	struct trx_l1h *l1h;
+	bool unlocked;
+	unsigned int tn;
+	int rc;
+
+	trx_set_bts(bts);
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		pinst = trx_phy_instance(trx);
+		l1h = pinst->u.osmotrx.hdl;
+		unlocked = trx->mo.nm_state.administrative == NM_STATE_UNLOCKED;
+
+		trx_set_trx(trx);
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			struct gsm_bts_trx_ts *ts = &trx->ts[tn];
+
+			if (ts->pchan == GSM_PCHAN_NONE)
+				continue;
+			if (ts->pchan == GSM_PCHAN_OSMO_DYN && ts->dyn.pchan_is == GSM_PCHAN_NONE)
+				continue;
+			if (trx_set_ts(ts) != 0)
+				return -EINVAL;
+		}
+
+		trx_if_cmd_rfmute(l1h, !unlocked);
+		l1h->config.ramp_on_poweron = unlocked;
+
+		rc = osmo_fsm_inst_dispatch(l1h->provision_fi, TRX_PROV_EV_CFG_ENABLE, (void *)(intptr_t)true);
+		if (rc != 0)
+			return rc;
+	}
+
+	return 0;
+}
+
 int bts_model_change_power(struct gsm_bts_trx *trx, int p_trxout_mdBm)
 {
 	struct phy_instance *pinst = trx_phy_instance(trx);
@@ -719,13 +765,25 @@ int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
 			 enum gsm_phys_chan_config as_pchan)
 {
+	struct phy_instance *pinst = trx_phy_instance(ts->trx);
+	struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
+	bool early_connect;
 	int rc;
 	LOGP(DL1C, LOGL_DEBUG, "%s bts_model_ts_connect(as_pchan=%s)\n",
 	     gsm_ts_name(ts), gsm_pchan_name(as_pchan));
 
-	rc = trx_set_ts_as_pchan(ts, as_pchan);
-	if (rc)
+	/* The scheduler is switched to the new multiframe right away (in
+	 * trx_set_ts_as_pchan()), only the transceiver is reconfigured via
+	 * TRXC.  If configured, don't wait for that round trip: the PCU (or
+	 * the pending CHAN ACTIV) then goes ahead while SETSLOT is in transit. */
+	early_connect = pinst->phy_link->u.osmotrx.early_ts_connect &&
+			l1h->provision_fi->state == TRX_PROV_ST_OPEN_POWERON;
+
+	rc = trx_set_ts_as_pchan(ts, as_pchan, early_connect);
+	if (rc || early_connect) {
 		cb_ts_connected(ts, rc);
+		return;
+	}
 
 	/* cb_ts_connected will be called in l1if_setslot_cb once we receive RSP SETSLOT */
 }
@@ -34,7 +34,7 @@ enum {
 	BTSTRX_CTR_SCHED_UL_FH_NO_CARRIER,
 };
 
-/*! clock state of a given TRX */
+/*! clock state of a given PHY link */
 struct osmo_trx_clock_state {
 	/*! number of FN periods without TRX clock indication */
 	uint32_t fn_without_clock_ind;
@@ -56,7 +56,6 @@ struct osmo_trx_clock_state {
 
 /* gsm_bts->model_priv, specific to osmo-bts-trx */
 struct bts_trx_priv {
-	struct osmo_trx_clock_state clk_s;
 	struct rate_ctr_group *ctrs;		/* bts-trx specific rate counters */
 };
 
@@ -67,7 +66,8 @@ struct trx_config {
 	bool			setformat_acked;
 
 	bool			enabled;
-
+	/* warm start: ramp up the power once the transceiver is on */
+	bool			ramp_on_poweron;
 
 	bool			arfcn_valid;
 	uint16_t		arfcn;
@@ -114,6 +114,7 @@ struct trx_config {
 		bool tsc_valid;
 	}			setslot[TRX_NR_TS];
 	bool			setslot_sent[TRX_NR_TS];
+	bool			setslot_acked[TRX_NR_TS];
 };
 
 struct trx_l1h {
@@ -132,6 +133,14 @@ struct trx_l1h {
 	struct osmo_timer_list	trx_ctrl_timer;
 	struct osmo_fd		trx_ofd_data;
 
+	/* TRXD Downlink PDUs batched until the end of the TDMA frame */
+	struct {
+		uint8_t		*buf;		/* TRXD_MSG_BUF_SIZE */
+		uint8_t		*cur;		/* next PDU in buf */
+		uint8_t		*last_pdu;	/* last encoded PDU */
+		unsigned int	pdu_num;
+	} data_tx;
+
 	/* transceiver config */
 	struct trx_config	config;
 	struct osmo_fsm_inst	*provision_fi;
@@ -126,8 +126,7 @@ int bts_model_handle_options(int argc, char **argv)
 int bts_model_init(struct gsm_bts *bts)
 {
 	struct bts_trx_priv *bts_trx = talloc_zero(bts, struct bts_trx_priv);
-	bts_trx->clk_s.fn_timer_ofd.fd = -1;
-	bts_trx->ctrs = rate_ctr_group_alloc(bts_trx, &btstrx_ctrg_desc, 0);
+	bts_trx->ctrs = rate_ctr_group_alloc(bts_trx, &btstrx_ctrg_desc, bts->nr);
 
 	bts->model_priv = bts_trx;
 	bts->variant = BTS_OSMO_TRX;
@@ -161,6 +160,7 @@ int bts_model_init(struct gsm_bts *bts)
 
 	bts_internal_flag_set(bts, BTS_INTERNAL_FLAG_MEAS_PAYLOAD_COMB);
 	bts_internal_flag_set(bts, BTS_INTERNAL_FLAG_INTERF_MEAS);
+	bts_internal_flag_set(bts, BTS_INTERNAL_FLAG_WARM_START);
 
 	/* The default HR codec output format in the absence of saved
 	 * vty config needs to match what was implemented previously,
@@ -214,6 +214,8 @@ void bts_model_phy_link_set_defaults(struct phy_link *plink)
 	plink->u.osmotrx.rts_advance = 3;
 	/* attempt use newest TRXD version by default: */
 	plink->u.osmotrx.trxd_pdu_ver_max = TRX_DATA_PDU_VER;
+	plink->u.osmotrx.clk_s = talloc_zero(plink, struct osmo_trx_clock_state);
+	plink->u.osmotrx.clk_s->fn_timer_ofd.fd = -1;
 }
 
 void bts_model_phy_instance_set_defaults(struct phy_instance *pinst)
@@ -32,6 +32,7 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/scheduler.h>
 #include <osmo-bts/scheduler_backend.h>
+#include <osmo-bts/burst_trace.h>
 
 #include <sched_utils.h>
 
@@ -39,6 +40,7 @@
 int tx_fcch_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 {
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "Transmitting FCCH\n");
+	BURST_TRACE_L1SB(l1ts, br, BURST_TRACE_EV_DL_FCCH, 0, 0, 0, 0);
 
 	/* A frequency correction burst is basically a sequence of zeros */
 	memset(br->burst, 0x00, GSM_BURST_LEN);
@@ -56,6 +58,7 @@ int tx_sch_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 	uint8_t t3p, bsic;
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "Transmitting SCH\n");
+	BURST_TRACE_L1SB(l1ts, br, BURST_TRACE_EV_DL_SCH, 0, 0, 0, 0);
 
 	/* BURST BYPASS */
 
@@ -21,10 +21,12 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <errno.h>
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/core/rate_ctr.h>
 #include <osmocom/coding/gsm0503_coding.h>
 
 #include <osmo-bts/bts.h>
@@ -32,29 +34,71 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/scheduler.h>
 #include <osmo-bts/scheduler_backend.h>
+#include <osmo-bts/burst_trace.h>
 
 #include <sched_utils.h>
+#include <sched_ul_dec.h>
+
+/* Stealing bits q(0..7) of CS-1..CS-4, see 3GPP TS 45.003, section 5.1.
+ * GMSK modulated EGPRS blocks (MCS-1..MCS-4) use the ones of CS-4. */
+static const ubit_t pdtch_hl_hn[4][8] = {
+	{ 1, 1, 1, 1, 1, 1, 1, 1 },
+	{ 1, 1, 0, 0, 1, 0, 0, 0 },
+	{ 0, 0, 1, 0, 0, 0, 0, 1 },
+	{ 0, 0, 0, 1, 0, 1, 1, 0 },
+};
+
+/* Minimum soft distance between the best match and CS-4, roughly one
+ * reliable stealing bit, below which a block is not known to be GPRS */
+#define PDTCH_HL_HN_MARGIN	(2 * 127)
+
+/* Tell from the stealing bits of a GMSK block whether it is CS-1..CS-3,
+ * i.e. cannot be EGPRS.  This costs next to nothing compared to running
+ * a decoder on it. */
+static bool pdtch_is_gprs_cs123(const sbit_t *bursts)
+{
+	int dist[ARRAY_SIZE(pdtch_hl_hn)] = { 0 };
+	unsigned int i, j, best = 0;
+	sbit_t hl_hn[8];
+
+	/* hl and hn follow the first half of the data bits, see rx_pdtch_fn() */
+	for (i = 0; i < 4; i++) {
+		hl_hn[i * 2] = bursts[i * 116 + 57];
+		hl_hn[i * 2 + 1] = bursts[i * 116 + 58];
+	}
+
+	for (i = 0; i < ARRAY_SIZE(pdtch_hl_hn); i++) {
+		for (j = 0; j < 8; j++)
+			dist[i] += abs((pdtch_hl_hn[i][j] ? -127 : 127) - hl_hn[j]);
+		if (dist[i] < dist[best])
+			best = i;
+	}
 
-/* Maximum size of a EGPRS message in bytes */
-#define EGPRS_0503_MAX_BYTES	155
+	return best != 3 && dist[3] - dist[best] >= PDTCH_HL_HN_MARGIN;
+}
+
+static int pdtch_decode(struct ul_dec_job *job, bool egprs)
+{
+	job->egprs = egprs;
+	if (egprs)
+		return gsm0503_pdtch_egprs_decode(job->l2, job->bursts, job->bursts_len,
+						  NULL, &job->n_errors, &job->n_bits_total);
+	return gsm0503_pdtch_decode(job->l2, job->bursts, NULL,
+				    &job->n_errors, &job->n_bits_total);
+}
 
 /*! \brief a single PDTCH burst was received by the PHY, process it */
 int rx_pdtch_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 {
 	struct l1sched_chan_state *chan_state = &l1ts->chan_state[bi->chan];
 	sbit_t *burst, *bursts_p = chan_state->ul_bursts;
-	uint32_t first_fn;
 	uint32_t *mask = &chan_state->ul_mask;
 	struct l1sched_meas_set meas_avg;
-	uint8_t l2[EGPRS_0503_MAX_BYTES];
-	int n_errors = 0;
+	struct ul_dec_job job;
 	int n_bursts_bits = 0;
-	int n_bits_total = 0;
-	uint16_t ber10k;
-	int rc;
-	enum osmo_ph_pres_info_type presence_info;
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Received PDTCH bid=%u\n", bi->bid);
+	BURST_TRACE_L1SB(l1ts, bi, BURST_TRACE_EV_UL_PDTCH, bi->bid, 0, 0, 0);
 
 	/* An MS may be polled to send an ACK in form of four Access Bursts */
 	if (bi->flags & TRX_BI_F_ACCESS_BURST)
@@ -105,38 +149,93 @@ int rx_pdtch_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	}
 	*mask = 0x0;
 
+	job = (struct ul_dec_job) {
+		.type = UL_DEC_PDTCH,
+		.l1ts = l1ts,
+		.chan = bi->chan,
+		.first_fn = GSM_TDMA_FN_SUB(bi->fn, 3),
+		.fn = bi->fn,
+		.meas_avg = meas_avg,
+		.bursts = bursts_p,
+		.bursts_len = n_bursts_bits,
+		.burst_len = bi->burst_len,
+		.egprs_hint = chan_state->ul_pdtch_egprs,
+	};
+
+	/* decode on a decoder thread, if configured; the result is delivered later */
+	if (ul_dec_submit(&job) == 0)
+		return 0;
+
+	rx_pdtch_decode(&job);
+	return rx_pdtch_deliver(&job);
+}
+
+/* Decode a complete set of PDTCH bursts.  This may run on a decoder thread,
+ * so it must neither log nor touch the scheduler state. */
+void rx_pdtch_decode(struct ul_dec_job *job)
+{
+	bool egprs;
+
+	/* 8-PSK modulated bursts can only be EGPRS (MCS-5..MCS-9), and
+	 * there is nothing to tell from a NOPE.ind */
+	if (job->burst_len != GSM_BURST_LEN) {
+		job->rc = pdtch_decode(job, true);
+		return;
+	}
+
+	/* CS-1..CS-3 are told apart from EGPRS by their stealing bits */
+	if (pdtch_is_gprs_cs123(job->bursts)) {
+		job->rc = pdtch_decode(job, false);
+		return;
+	}
+
 	/*
-	 * Attempt to decode EGPRS bursts first. For 8-PSK EGPRS this is all we
-	 * do. Attempt GPRS decoding on EGPRS failure. If the burst is GPRS,
-	 * then we incur decoding overhead of 31 bits on the Type 3 EGPRS
-	 * header, which is tolerable.
+	 * CS-4 or MCS-1..MCS-4 (or too noisy to tell): attempt the decoder of
+	 * the coding scheme family seen last on this timeslot first, and the
+	 * other one if that fails.
 	 */
-	rc = gsm0503_pdtch_egprs_decode(l2, bursts_p, n_bursts_bits,
-				NULL, &n_errors, &n_bits_total);
-
-	if ((bi->burst_len == GSM_BURST_LEN) && (rc < 0)) {
-		rc = gsm0503_pdtch_decode(l2, bursts_p, NULL,
-				  &n_errors, &n_bits_total);
+	egprs = job->egprs_hint;
+	job->rc = pdtch_decode(job, egprs);
+	if (job->rc <= 0) {
+		job->fallback = true;
+		job->rc = pdtch_decode(job, !egprs);
 	}
+}
+
+/* Pass the result of rx_pdtch_decode() on to the upper layers */
+int rx_pdtch_deliver(const struct ul_dec_job *job)
+{
+	struct l1sched_ts *l1ts = job->l1ts;
+	struct l1sched_chan_state *chan_state = &l1ts->chan_state[job->chan];
+	enum osmo_ph_pres_info_type presence_info;
+	uint16_t ber10k;
+	int rc = job->rc;
+
+	if (job->fallback)
+		rate_ctr_inc2(l1ts->ctrs, L1SCHED_TS_CTR_UL_PDTCH_DEC_FALLBACK);
 
 	if (rc > 0) {
 		presence_info = PRES_INFO_BOTH;
+		if (job->egprs != job->egprs_hint)
+			rate_ctr_inc2(l1ts->ctrs, L1SCHED_TS_CTR_UL_PDTCH_HINT_MISMATCH);
+		/* the hint for the next GMSK block on this timeslot */
+		chan_state->ul_pdtch_egprs = job->egprs;
 	} else {
-		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi,
-			BAD_DATA_MSG_FMT "\n", BAD_DATA_MSG_ARGS);
+		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, job, BAD_DATA_MSG_FMT "\n",
+			rc, job->n_errors, job->n_bits_total,
+			job->fn % l1ts->mf_period, l1ts->mf_period);
 		rc = 0;
 		presence_info = PRES_INFO_INVALID;
 	}
 
-	ber10k = compute_ber10k(n_bits_total, n_errors);
+	ber10k = compute_ber10k(job->n_bits_total, job->n_errors);
 
-	first_fn = GSM_TDMA_FN_SUB(bi->fn, 3);
-	return _sched_compose_ph_data_ind(l1ts, first_fn, bi->chan,
-					  &l2[0], rc,
+	return _sched_compose_ph_data_ind(l1ts, job->first_fn, job->chan,
+					  &job->l2[0], rc,
 					  ber10k,
-					  meas_avg.rssi,
-					  meas_avg.toa256,
-					  meas_avg.ci_cb,
+					  job->meas_avg.rssi,
+					  job->meas_avg.toa256,
+					  job->meas_avg.ci_cb,
 					  presence_info);
 }
 
@@ -216,6 +315,7 @@ send_burst:
 	*mask |= (1 << br->bid);
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "Transmitting burst=%u.\n", br->bid);
+	BURST_TRACE_L1SB(l1ts, br, BURST_TRACE_EV_DL_BURST, br->bid, 0, 0, 0);
 
 	return 0;
 }
@@ -22,7 +22,6 @@
  */
 
 #include <stdint.h>
-#include <limits.h>
 #include <errno.h>
 
 #include <osmocom/core/bits.h>
@@ -34,74 +33,11 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/scheduler.h>
 #include <osmo-bts/scheduler_backend.h>
+#include <osmo-bts/burst_trace.h>
+#include <osmo-bts/rach_synch_seq.h>
 
 #include <sched_utils.h>
 
-/* 3GPP TS 05.02, section 5.2.7 */
-#define RACH_EXT_TAIL_LEN	8
-#define RACH_SYNCH_SEQ_LEN	41
-
-enum rach_synch_seq_t {
-	RACH_SYNCH_SEQ_UNKNOWN = -1,
-	RACH_SYNCH_SEQ_TS0, /* GSM, GMSK (default) */
-	RACH_SYNCH_SEQ_TS1, /* EGPRS, 8-PSK */
-	RACH_SYNCH_SEQ_TS2, /* EGPRS, GMSK */
-	RACH_SYNCH_SEQ_NUM
-};
-
-static struct value_string rach_synch_seq_names[] = {
-	{ RACH_SYNCH_SEQ_UNKNOWN,	"UNKNOWN" },
-	{ RACH_SYNCH_SEQ_TS0,		"TS0: GSM, GMSK" },
-	{ RACH_SYNCH_SEQ_TS1,		"TS1: EGPRS, 8-PSK" },
-	{ RACH_SYNCH_SEQ_TS2,		"TS2: EGPRS, GMSK" },
-	{ 0, NULL },
-};
-
-static enum rach_synch_seq_t rach_get_synch_seq(sbit_t *bits, int *best_score)
-{
-	sbit_t *synch_seq_burst = bits + RACH_EXT_TAIL_LEN;
-	enum rach_synch_seq_t seq = RACH_SYNCH_SEQ_TS0;
-	int score[RACH_SYNCH_SEQ_NUM] = { 0 };
-	int max_score = INT_MIN;
-	int i, j;
-
-	/* 3GPP TS 05.02, section 5.2.7 "Access burst (AB)", synch. sequence bits */
-	static const char synch_seq_ref[RACH_SYNCH_SEQ_NUM][RACH_SYNCH_SEQ_LEN] = {
-		[RACH_SYNCH_SEQ_TS0] = "01001011011111111001100110101010001111000",
-		[RACH_SYNCH_SEQ_TS1] = "01010100111110001000011000101111001001101",
-		[RACH_SYNCH_SEQ_TS2] = "11101111001001110101011000001101101110111",
-	};
-
-	/* Get a multiplier for j-th bit of i-th synch. sequence */
-#define RACH_SYNCH_SEQ_MULT \
-	(synch_seq_ref[i][j] == '1' ? -1 : 1)
-
-	/* For each synch. sequence, count the bit match score. Since we deal with
-	 * soft-bits (-127...127), we sum the absolute values of matching ones,
-	 * and subtract the absolute values of different ones, so the resulting
-	 * score is more accurate than it could be with hard-bits. */
-	for (i = 0; i < RACH_SYNCH_SEQ_NUM; i++) {
-		for (j = 0; j < RACH_SYNCH_SEQ_LEN; j++)
-			score[i] += RACH_SYNCH_SEQ_MULT * synch_seq_burst[j];
-
-		/* Keep the maximum value updated */
-		if (score[i] > max_score) {
-			max_score = score[i];
-			seq = i;
-		}
-	}
-
-	/* Calculate an approximate level of our confidence */
-	if (best_score != NULL)
-		*best_score = max_score;
-
-	/* At least 1/3 of a synch. sequence shall match */
-	if (max_score < (127 * RACH_SYNCH_SEQ_LEN / 3))
-		return RACH_SYNCH_SEQ_UNKNOWN;
-
-	return seq;
-}
-
 int rx_rach_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 {
 	struct gsm_bts_trx *trx = l1ts->ts->trx;
@@ -132,7 +68,7 @@ int rx_rach_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		if (bi->flags & TRX_BI_F_TS_INFO)
 			synch_seq = (enum rach_synch_seq_t) bi->tsc;
 		else
-			synch_seq = rach_get_synch_seq((sbit_t *) bi->burst, &best_score);
+			synch_seq = rach_synch_seq_detect(bi->burst, &best_score);
 	}
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi,
@@ -146,6 +82,8 @@ int rx_rach_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		LOGPC(DL1P, LOGL_DEBUG, " match=%.1f%%",
 		      best_score * 100.0 / (127 * RACH_SYNCH_SEQ_LEN));
 	LOGPC(DL1P, LOGL_DEBUG, "\n");
+	BURST_TRACE_L1SB(l1ts, bi, BURST_TRACE_EV_UL_RACH, synch_seq, bi->rssi, bi->toa256,
+			 (bi->flags & TRX_BI_F_CI_CB) ? bi->ci_cb : 0);
 
 	/* Compose a new L1SAP primitive */
 	memset(&l1sap, 0x00, sizeof(l1sap));
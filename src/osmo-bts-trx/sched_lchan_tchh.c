@@ -41,6 +41,7 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/scheduler.h>
 #include <osmo-bts/scheduler_backend.h>
+#include <osmo-bts/burst_trace.h>
 #include <osmo-bts/msg_utils.h>
 
 #include <sched_utils.h>
@@ -176,6 +177,7 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		return rx_rach_fn(l1ts, bi);
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Received TCH/H, bid=%u\n", bi->bid);
+	BURST_TRACE_L1SB(l1ts, bi, BURST_TRACE_EV_UL_TCHH, bi->bid, 0, 0, 0);
 
 	/* shift the buffer by 2 bursts leftwards */
 	if (bi->bid == 0) {
@@ -206,6 +208,7 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi,
 			"UL burst buffer is not filled up: mask=0x%02x != 0x3f\n",
 			*mask);
+		BURST_TRACE_L1SB(l1ts, bi, BURST_TRACE_EV_UL_MASK, *mask, 0, 0, 0);
 		return 0; /* TODO: send BFI */
 	}
 
@@ -270,6 +273,8 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 				"Received AMR DTX frame (rc=%d, BER %d/%d): %s\n",
 				rc, n_errors, n_bits_total,
 				gsm0503_amr_dtx_frame_name(chan_state->amr_last_dtx));
+			BURST_TRACE_L1SB(l1ts, bi, BURST_TRACE_EV_UL_AMR_DTX, rc, n_errors,
+					 n_bits_total, chan_state->amr_last_dtx);
 			is_sub = 1;
 		}
 
@@ -570,6 +575,7 @@ send_burst:
 	*mask |= (1 << br->bid);
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "Transmitting burst=%u.\n", br->bid);
+	BURST_TRACE_L1SB(l1ts, br, BURST_TRACE_EV_DL_BURST, br->bid, 0, 0, 0);
 
 	return 0;
 }
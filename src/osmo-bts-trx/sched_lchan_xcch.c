@@ -21,10 +21,13 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <errno.h>
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/core/rate_ctr.h>
 #include <osmocom/coding/gsm0503_coding.h>
 
 #include <osmo-bts/bts.h>
@@ -32,8 +35,11 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/scheduler.h>
 #include <osmo-bts/scheduler_backend.h>
+#include <osmo-bts/burst_trace.h>
 
 #include <sched_utils.h>
+#include <sched_ul_dec.h>
+#include <sched_xcch_cache.h>
 
 /* Add two arrays of sbits */
 static void add_sbits(sbit_t *current, const sbit_t *previous)
@@ -49,12 +55,8 @@ int rx_data_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	sbit_t *burst, *bursts_p = chan_state->ul_bursts;
 	uint32_t *first_fn = &chan_state->ul_first_fn;
 	uint32_t *mask = &chan_state->ul_mask;
-	uint8_t l2[GSM_MACBLOCK_LEN], l2_len;
 	struct l1sched_meas_set meas_avg;
-	int n_errors = 0;
-	int n_bits_total = 0;
-	uint16_t ber10k;
-	int rc;
+	struct ul_dec_job job;
 	struct gsm_lchan *lchan = chan_state->lchan;
 	bool rep_sacch = L1SAP_IS_LINK_SACCH(trx_chan_desc[bi->chan].link_id) && lchan->rep_acch.ul_sacch_active;
 
@@ -64,6 +66,7 @@ int rx_data_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		return rx_rach_fn(l1ts, bi);
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Received Data, bid=%u\n", bi->bid);
+	BURST_TRACE_L1SB(l1ts, bi, BURST_TRACE_EV_UL_DATA, bi->bid, 0, 0, 0);
 
 	/* clear burst & store frame number of first burst */
 	if (bi->bid == 0) {
@@ -108,42 +111,79 @@ int rx_data_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	}
 	*mask = 0x0;
 
-	/* decode */
-	rc = gsm0503_xcch_decode(l2, BUFPOS(bursts_p, 0), &n_errors, &n_bits_total);
-	if (rc) {
-		LOGL1SB(DL1P, LOGL_NOTICE, l1ts, bi,
-			BAD_DATA_MSG_FMT "\n", BAD_DATA_MSG_ARGS);
+	job = (struct ul_dec_job) {
+		.type = UL_DEC_XCCH,
+		.l1ts = l1ts,
+		.chan = bi->chan,
+		.first_fn = *first_fn,
+		.fn = bi->fn,
+		.meas_avg = meas_avg,
+		.bursts = bursts_p,
+		.bursts_len = (rep_sacch ? 8 : 4) * BPLEN,
+		.rep_sacch = rep_sacch,
+	};
+
+	/* decode on a decoder thread, if configured; the result is delivered later */
+	if (ul_dec_submit(&job) == 0)
+		return 0;
+
+	rx_data_decode(&job);
+	return rx_data_deliver(&job);
+}
+
+/* Decode a complete set of xCCH bursts.  This may run on a decoder thread,
+ * so it must neither log nor touch the scheduler state. */
+void rx_data_decode(struct ul_dec_job *job)
+{
+	sbit_t *bursts_p = job->bursts;
+
+	job->rc = gsm0503_xcch_decode(job->l2, BUFPOS(bursts_p, 0), &job->n_errors, &job->n_bits_total);
+	if (job->rc == 0 || !job->rep_sacch)
+		return;
+
+	/* When SACCH Repetition is active, we may try to decode the
+	 * current SACCH block by including the information from the
+	 * information from the previous SACCH block. See also:
+	 * 3GPP TS 44.006, section 11.2 */
+	add_sbits(BUFPOS(bursts_p, 0), BUFPOS(bursts_p, 4));
+	job->rc_rep = gsm0503_xcch_decode(job->l2, BUFPOS(bursts_p, 0), &job->n_errors, &job->n_bits_total);
+}
+
+/* Pass the result of rx_data_decode() on to the upper layers */
+int rx_data_deliver(const struct ul_dec_job *job)
+{
+	struct l1sched_ts *l1ts = job->l1ts;
+	uint8_t l2_len = GSM_MACBLOCK_LEN;
+	uint16_t ber10k;
+
+	if (job->rc) {
+		LOGL1SB(DL1P, LOGL_NOTICE, l1ts, job, BAD_DATA_MSG_FMT "\n",
+			job->rc, job->n_errors, job->n_bits_total,
+			job->fn % l1ts->mf_period, l1ts->mf_period);
 		l2_len = 0;
 
-		/* When SACCH Repetition is active, we may try to decode the
-		 * current SACCH block by including the information from the
-		 * information from the previous SACCH block. See also:
-		 * 3GPP TS 44.006, section 11.2 */
-		if (rep_sacch) {
-			add_sbits(BUFPOS(bursts_p, 0), BUFPOS(bursts_p, 4));
-			rc = gsm0503_xcch_decode(l2, BUFPOS(bursts_p, 0), &n_errors, &n_bits_total);
-			if (rc) {
-				LOGL1SB(DL1P, LOGL_NOTICE, l1ts, bi,
+		if (job->rep_sacch) {
+			if (job->rc_rep) {
+				LOGL1SB(DL1P, LOGL_NOTICE, l1ts, job,
 				       "Combining current SACCH block with previous SACCH block also yields bad data (%u/%u)\n",
-				       bi->fn % l1ts->mf_period, l1ts->mf_period);
+				       job->fn % l1ts->mf_period, l1ts->mf_period);
 			} else {
-				LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi,
+				LOGL1SB(DL1P, LOGL_DEBUG, l1ts, job,
 				       "Combining current SACCH block with previous SACCH block yields good data (%u/%u)\n",
-				       bi->fn % l1ts->mf_period, l1ts->mf_period);
+				       job->fn % l1ts->mf_period, l1ts->mf_period);
 				l2_len = GSM_MACBLOCK_LEN;
 			}
 		}
-	} else
-		l2_len = GSM_MACBLOCK_LEN;
+	}
 
-	ber10k = compute_ber10k(n_bits_total, n_errors);
+	ber10k = compute_ber10k(job->n_bits_total, job->n_errors);
 
-	return _sched_compose_ph_data_ind(l1ts, *first_fn, bi->chan,
-					  &l2[0], l2_len,
+	return _sched_compose_ph_data_ind(l1ts, job->first_fn, job->chan,
+					  &job->l2[0], l2_len,
 					  ber10k,
-					  meas_avg.rssi,
-					  meas_avg.toa256,
-					  meas_avg.ci_cb,
+					  job->meas_avg.rssi,
+					  job->meas_avg.toa256,
+					  job->meas_avg.ci_cb,
 					  PRES_INFO_UNKNOWN);
 }
 
@@ -183,7 +223,7 @@ int tx_data_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 	/* BURST BYPASS */
 
 	/* encode bursts */
-	gsm0503_xcch_encode(bursts_p, msg->l2h);
+	xcch_encode_cached(l1ts, bursts_p, msg->l2h);
 
 	/* free message */
 	msgb_free(msg);
@@ -200,6 +240,7 @@ send_burst:
 	*mask |= (1 << br->bid);
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "Transmitting burst=%u.\n", br->bid);
+	BURST_TRACE_L1SB(l1ts, br, BURST_TRACE_EV_DL_BURST, br->bid, 0, 0, 0);
 
 	return 0;
 }
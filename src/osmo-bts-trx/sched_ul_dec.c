@@ -0,0 +1,322 @@
+/* Uplink channel decoding on worker threads */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/phy_link.h>
+#include <osmo-bts/scheduler.h>
+
+#include <sched_ul_dec.h>
+
+struct ul_dec_entry {
+	struct ul_dec_job job;
+	sbit_t buf[GSM0503_EGPRS_BURSTS_NBITS];
+};
+
+static void *ul_dec_worker_thread(void *data)
+{
+	struct ul_dec_worker *w = data;
+	struct ul_dec_pool *pool = w->pool;
+	struct ul_dec_job *job;
+	uint32_t head, done = w->done;
+	uint64_t val;
+
+	while (1) {
+		head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+		if (head == done) {
+			if (__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE))
+				break;
+			/* announce that we are going to sleep, then check once more
+			 * so that a job queued meanwhile is not left behind */
+			__atomic_store_n(&w->sleeping, true, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&w->head, __ATOMIC_SEQ_CST) == done &&
+			    !__atomic_load_n(&pool->stop, __ATOMIC_SEQ_CST)) {
+				if (read(w->efd, &val, sizeof(val)) < 0 && errno != EINTR)
+					break;
+			}
+			__atomic_store_n(&w->sleeping, false, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		job = &w->ring[done & (UL_DEC_RING_SIZE - 1)].job;
+		switch (job->type) {
+		case UL_DEC_XCCH:
+			rx_data_decode(job);
+			break;
+		case UL_DEC_PDTCH:
+			rx_pdtch_decode(job);
+			break;
+		}
+
+		/* the job may be delivered by the main thread from now on */
+		done++;
+		__atomic_store_n(&w->done, done, __ATOMIC_SEQ_CST);
+
+		/* the main thread may be blocked on a full ring of ours */
+		if (__atomic_exchange_n(&w->waiting, false, __ATOMIC_SEQ_CST)) {
+			val = 1;
+			OSMO_ASSERT(write(w->done_efd, &val, sizeof(val)) == sizeof(val));
+		}
+
+		/* only wake up the main thread if it does not know yet */
+		if (!__atomic_exchange_n(&pool->wake_pending, true, __ATOMIC_SEQ_CST)) {
+			val = 1;
+			if (write(pool->ofd.fd, &val, sizeof(val)) < 0)
+				__atomic_store_n(&pool->wake_pending, false, __ATOMIC_SEQ_CST);
+		}
+	}
+
+	return NULL;
+}
+
+/* Deliver the decoded jobs of a worker in the order they were submitted */
+static unsigned int ul_dec_worker_deliver(struct ul_dec_worker *w)
+{
+	uint32_t done = __atomic_load_n(&w->done, __ATOMIC_ACQUIRE);
+	const struct l1sched_chan_state *chan_state;
+	const struct ul_dec_job *job;
+	unsigned int num = 0;
+
+	while (w->tail != done) {
+		job = &w->ring[w->tail & (UL_DEC_RING_SIZE - 1)].job;
+		chan_state = &job->l1ts->chan_state[job->chan];
+		/* the logical channel may have been deactivated, and possibly
+		 * activated again for another lchan, meanwhile */
+		if (chan_state->active && chan_state->gen == job->gen) {
+			switch (job->type) {
+			case UL_DEC_XCCH:
+				rx_data_deliver(job);
+				break;
+			case UL_DEC_PDTCH:
+				rx_pdtch_deliver(job);
+				break;
+			}
+		}
+		w->tail++;
+		num++;
+	}
+
+	return num;
+}
+
+/* Block the main thread until the worker decoded something to be delivered */
+static void ul_dec_worker_wait(struct ul_dec_worker *w)
+{
+	uint64_t val;
+
+	/* same handshake as the worker going to sleep, see above */
+	__atomic_store_n(&w->waiting, true, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&w->done, __ATOMIC_SEQ_CST) == w->tail) {
+		if (read(w->done_efd, &val, sizeof(val)) < 0 && errno != EINTR)
+			LOGP(DL1C, LOGL_ERROR, "Failed to wait for UL decoder thread: %s\n", strerror(errno));
+	}
+	__atomic_store_n(&w->waiting, false, __ATOMIC_SEQ_CST);
+}
+
+static int ul_dec_pool_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct ul_dec_pool *pool = ofd->data;
+	unsigned int i;
+	uint64_t val;
+
+	if (read(ofd->fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		return -errno;
+
+	/* re-arm before looking at the rings, so that no job is left behind */
+	__atomic_store_n(&pool->wake_pending, false, __ATOMIC_SEQ_CST);
+	for (i = 0; i < pool->num_workers; i++)
+		ul_dec_worker_deliver(&pool->worker[i]);
+
+	return 0;
+}
+
+/*! Start a pool of decoder threads.
+ *  \param[in] ctx talloc context
+ *  \param[in] num_threads number of decoder threads
+ *  \returns pool on success; NULL on error */
+struct ul_dec_pool *ul_dec_pool_alloc(void *ctx, unsigned int num_threads)
+{
+	struct ul_dec_pool *pool;
+	struct ul_dec_worker *w;
+	char name[16];
+	int fd, rc;
+
+	if (num_threads == 0 || num_threads > UL_DEC_THREADS_MAX)
+		return NULL;
+
+	pool = talloc_zero(ctx, struct ul_dec_pool);
+	if (!pool)
+		return NULL;
+
+	fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0) {
+		talloc_free(pool);
+		return NULL;
+	}
+	osmo_fd_setup(&pool->ofd, fd, OSMO_FD_READ, ul_dec_pool_fd_cb, pool, 0);
+	if (osmo_fd_register(&pool->ofd) < 0) {
+		close(fd);
+		talloc_free(pool);
+		return NULL;
+	}
+
+	while (pool->num_workers < num_threads) {
+		w = &pool->worker[pool->num_workers];
+		w->pool = pool;
+		w->ring = talloc_zero_array(pool, struct ul_dec_entry, UL_DEC_RING_SIZE);
+		if (!w->ring)
+			goto err;
+		w->efd = eventfd(0, EFD_CLOEXEC);
+		if (w->efd < 0)
+			goto err;
+		w->done_efd = eventfd(0, EFD_CLOEXEC);
+		if (w->done_efd < 0) {
+			close(w->efd);
+			goto err;
+		}
+
+		rc = pthread_create(&w->thread, NULL, ul_dec_worker_thread, w);
+		if (rc != 0) {
+			LOGP(DL1C, LOGL_ERROR, "Failed to start UL decoder thread: %s\n", strerror(rc));
+			close(w->done_efd);
+			close(w->efd);
+			goto err;
+		}
+		snprintf(name, sizeof(name), "ul_dec%u", pool->num_workers);
+		pthread_setname_np(w->thread, name);
+		pool->num_workers++;
+	}
+
+	LOGP(DL1C, LOGL_NOTICE, "Started %u UL decoder threads\n", pool->num_workers);
+	return pool;
+
+err:
+	ul_dec_pool_free(pool);
+	return NULL;
+}
+
+/*! Wait for the decoder threads to decode all queued jobs, and deliver them */
+void ul_dec_pool_flush(struct ul_dec_pool *pool)
+{
+	struct ul_dec_worker *w;
+	unsigned int i;
+
+	for (i = 0; i < pool->num_workers; i++) {
+		w = &pool->worker[i];
+		while (w->tail != w->head) {
+			if (ul_dec_worker_deliver(w) == 0)
+				ul_dec_worker_wait(w);
+		}
+	}
+}
+
+/*! Stop the decoder threads after delivering all queued jobs, and free the pool */
+void ul_dec_pool_free(struct ul_dec_pool *pool)
+{
+	struct ul_dec_worker *w;
+	uint64_t val = 1;
+	unsigned int i;
+
+	ul_dec_pool_flush(pool);
+
+	__atomic_store_n(&pool->stop, true, __ATOMIC_SEQ_CST);
+	for (i = 0; i < pool->num_workers; i++) {
+		w = &pool->worker[i];
+		if (write(w->efd, &val, sizeof(val)) == sizeof(val))
+			pthread_join(w->thread, NULL);
+		close(w->done_efd);
+		close(w->efd);
+	}
+
+	osmo_fd_unregister(&pool->ofd);
+	close(pool->ofd.fd);
+	talloc_free(pool);
+}
+
+/*! Hand a complete set of bursts over to the decoder threads of its PHY link.
+ *  All jobs of an lchan (e.g. SDCCH and its SACCH) are decoded by the same
+ *  thread, so that their results are delivered in order.  If the thread is
+ *  behind, this blocks until it decoded the oldest job.  Results are dropped
+ *  if the logical channel was re-activated before they are delivered.
+ *  \returns 0 if the job was queued, the result is delivered from the main loop;
+ *  -ENOTSUP if there are no decoder threads, the caller decodes synchronously */
+int ul_dec_submit(const struct ul_dec_job *job)
+{
+	const struct gsm_bts_trx_ts *ts = job->l1ts->ts;
+	struct ul_dec_pool *pool = ts->trx->pinst->phy_link->u.osmotrx.ul_dec;
+	struct ul_dec_worker *w;
+	const struct gsm_lchan *lchan;
+	struct ul_dec_entry *e;
+	unsigned int key;
+	uint64_t val = 1;
+
+	if (pool == NULL)
+		return -ENOTSUP;
+
+	switch (job->chan) {
+	case TRXC_SACCHTF:
+	case TRXC_SACCHTH_0:
+	case TRXC_SACCHTH_1:
+		/* TCH and FACCH are decoded on the main thread, so must be
+		 * the SACCH of the same lchan to keep them in order */
+		return -ENOTSUP;
+	default:
+		break;
+	}
+
+	/* spread the lchans of all timeslots of all TRX */
+	lchan = job->l1ts->chan_state[job->chan].lchan;
+	key = (ts->trx->nr * TRX_NR_TS + ts->nr) * TS_MAX_LCHAN + lchan->nr;
+	w = &pool->worker[key % pool->num_workers];
+
+	while (w->head - w->tail >= UL_DEC_RING_SIZE) {
+		if (ul_dec_worker_deliver(w) == 0)
+			ul_dec_worker_wait(w);
+	}
+
+	e = &w->ring[w->head & (UL_DEC_RING_SIZE - 1)];
+	OSMO_ASSERT(job->bursts_len <= ARRAY_SIZE(e->buf));
+	e->job = *job;
+	e->job.gen = job->l1ts->chan_state[job->chan].gen;
+	e->job.bursts = e->buf;
+	memcpy(e->buf, job->bursts, job->bursts_len * sizeof(sbit_t));
+
+	__atomic_store_n(&w->head, w->head + 1, __ATOMIC_SEQ_CST);
+
+	/* only wake up the worker if it went to sleep */
+	if (__atomic_exchange_n(&w->sleeping, false, __ATOMIC_SEQ_CST)) {
+		if (write(w->efd, &val, sizeof(val)) < 0)
+			LOGP(DL1C, LOGL_ERROR, "Failed to wake up UL decoder thread: %s\n", strerror(errno));
+	}
+
+	return 0;
+}
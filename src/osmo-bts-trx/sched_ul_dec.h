@@ -0,0 +1,108 @@
+/* Uplink channel decoding on worker threads */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/select.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmo-bts/scheduler.h>
+
+#define UL_DEC_THREADS_MAX	16
+#define UL_DEC_RING_SIZE	64	/* jobs per worker, power of two */
+
+/* Maximum size of a EGPRS message in bytes */
+#define EGPRS_0503_MAX_BYTES	155
+
+enum ul_dec_type {
+	UL_DEC_XCCH,
+	UL_DEC_PDTCH,
+};
+
+/* A complete set of bursts to be decoded, and the result of decoding it.
+ * Filled by the lchan handler, decoded by rx_*_decode(), which may run on
+ * a worker thread, and delivered by rx_*_deliver() on the main thread. */
+struct ul_dec_job {
+	enum ul_dec_type type;
+	struct l1sched_ts *l1ts;
+	enum trx_chan_type chan;
+	uint32_t gen;			/* activation of the logical channel, see ul_dec_submit() */
+	uint32_t first_fn;		/* TDMA frame number of the first burst */
+	uint32_t fn;			/* TDMA frame number of the last burst */
+	struct l1sched_meas_set meas_avg;
+
+	sbit_t *bursts;
+	unsigned int bursts_len;	/* number of soft-bits to decode from */
+	bool rep_sacch;			/* xCCH: previous block follows in bursts */
+	uint16_t burst_len;		/* PDTCH: length of the last burst */
+	bool egprs_hint;		/* PDTCH: try the EGPRS decoder first */
+
+	int rc;
+	int rc_rep;			/* xCCH: after combining with the previous block */
+	int n_errors;
+	int n_bits_total;
+	bool egprs;			/* PDTCH: decoded by the EGPRS decoder */
+	bool fallback;			/* PDTCH: both decoders were tried */
+	uint8_t l2[EGPRS_0503_MAX_BYTES];
+};
+
+struct ul_dec_worker {
+	struct ul_dec_pool *pool;
+	pthread_t thread;
+	int efd;			/* eventfd to wake up the worker */
+	bool sleeping;			/* worker waits on efd */
+	int done_efd;			/* eventfd to wake up the main thread */
+	bool waiting;			/* main thread waits on done_efd */
+
+	/* Single ring for both directions: entries in [tail, done) are decoded
+	 * and wait for delivery, those in [done, head) wait for the worker. */
+	struct ul_dec_entry *ring;
+	uint32_t head;			/* written by the main thread only */
+	uint32_t done;			/* written by the worker only */
+	uint32_t tail;			/* written by the main thread only */
+};
+
+struct ul_dec_pool {
+	struct ul_dec_worker worker[UL_DEC_THREADS_MAX];
+	unsigned int num_workers;
+	struct osmo_fd ofd;		/* eventfd to wake up the main thread */
+	bool wake_pending;
+	bool stop;
+};
+
+struct ul_dec_pool *ul_dec_pool_alloc(void *ctx, unsigned int num_threads);
+void ul_dec_pool_free(struct ul_dec_pool *pool);
+void ul_dec_pool_flush(struct ul_dec_pool *pool);
+
+int ul_dec_submit(const struct ul_dec_job *job);
+
+/* sched_lchan_xcch.c */
+void rx_data_decode(struct ul_dec_job *job);
+int rx_data_deliver(const struct ul_dec_job *job);
+
+/* sched_lchan_pdtch.c */
+void rx_pdtch_decode(struct ul_dec_job *job);
+int rx_pdtch_deliver(const struct ul_dec_job *job);
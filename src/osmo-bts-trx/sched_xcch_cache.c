@@ -0,0 +1,76 @@
+/* Cache of channel coded downlink xCCH blocks */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmo-bts/scheduler.h>
+
+#include <sched_xcch_cache.h>
+
+/* Most DL blocks are repetitions (System Information, empty paging, LAPDm
+ * fill frames, SACCH filling).  Entries are looked up by a hash of the MAC
+ * block and hold a copy of it, so a block which changed (e.g. new SI) can
+ * never hit a stale entry.  The downlink is only scheduled from the main
+ * thread, hence no locking. */
+struct xcch_enc_cache_entry {
+	bool valid;
+	uint8_t l2[GSM_MACBLOCK_LEN];
+	ubit_t bursts[4 * 116];
+};
+
+static struct xcch_enc_cache_entry xcch_enc_cache[XCCH_ENC_CACHE_SIZE];
+
+static unsigned int xcch_enc_cache_hash(const uint8_t *l2)
+{
+	uint32_t hash = 2166136261u; /* FNV-1a */
+	unsigned int i;
+
+	for (i = 0; i < GSM_MACBLOCK_LEN; i++)
+		hash = (hash ^ l2[i]) * 16777619u;
+
+	return (hash ^ (hash >> 16)) & (XCCH_ENC_CACHE_SIZE - 1);
+}
+
+/* Same as gsm0503_xcch_encode(), but skip encoding of recently seen blocks */
+void xcch_encode_cached(struct l1sched_ts *l1ts, ubit_t *bursts, const uint8_t *l2)
+{
+	struct xcch_enc_cache_entry *ent = &xcch_enc_cache[xcch_enc_cache_hash(l2)];
+
+	if (ent->valid && memcmp(ent->l2, l2, GSM_MACBLOCK_LEN) == 0) {
+		memcpy(bursts, ent->bursts, sizeof(ent->bursts));
+		rate_ctr_inc2(l1ts->ctrs, L1SCHED_TS_CTR_DL_XCCH_CACHE_HIT);
+		return;
+	}
+
+	gsm0503_xcch_encode(bursts, l2);
+	rate_ctr_inc2(l1ts->ctrs, L1SCHED_TS_CTR_DL_XCCH_CACHE_MISS);
+
+	memcpy(ent->l2, l2, GSM_MACBLOCK_LEN);
+	memcpy(ent->bursts, bursts, sizeof(ent->bursts));
+	ent->valid = true;
+}
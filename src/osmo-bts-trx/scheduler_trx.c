@@ -67,76 +67,6 @@
 #define SCHED_FH_PARAMS_VALS(ts) \
 	(ts)->hopping.hsn, (ts)->hopping.maio, (ts)->hopping.arfcn_num
 
-static void lchan_report_interf_meas(const struct gsm_lchan *lchan)
-{
-	const struct gsm_bts_trx_ts *ts = lchan->ts;
-	const struct l1sched_ts *l1ts = ts->priv;
-	enum trx_chan_type dcch, acch;
-	int interf_avg;
-
-	/* We're not interested in active CS channels */
-	if (lchan->state == LCHAN_S_ACTIVE) {
-		if (lchan->type != GSM_LCHAN_PDTCH)
-			return;
-	}
-
-	switch (lchan->type) {
-	case GSM_LCHAN_SDCCH:
-		if (ts->pchan == GSM_PCHAN_CCCH_SDCCH4 ||
-		    ts->pchan == GSM_PCHAN_CCCH_SDCCH4_CBCH) {
-			dcch = TRXC_SDCCH4_0 + lchan->nr;
-			acch = TRXC_SACCH4_0 + lchan->nr;
-		} else { /* SDCCH/8 otherwise */
-			dcch = TRXC_SDCCH8_0 + lchan->nr;
-			acch = TRXC_SACCH8_0 + lchan->nr;
-		}
-		break;
-	case GSM_LCHAN_TCH_F:
-		dcch = TRXC_TCHF;
-		acch = TRXC_SACCHTF;
-		break;
-	case GSM_LCHAN_TCH_H:
-		dcch = TRXC_TCHH_0 + lchan->nr;
-		acch = TRXC_SACCHTH_0 + lchan->nr;
-		break;
-	case GSM_LCHAN_PDTCH:
-		/* We use idle TDMA frames on PDCH */
-		dcch = TRXC_IDLE;
-		acch = TRXC_IDLE;
-		break;
-	default:
-		/* Skip other lchan types */
-		return;
-	}
-
-	OSMO_ASSERT(dcch < ARRAY_SIZE(l1ts->chan_state));
-	OSMO_ASSERT(acch < ARRAY_SIZE(l1ts->chan_state));
-
-	interf_avg = (l1ts->chan_state[dcch].meas.interf_avg +
-		      l1ts->chan_state[acch].meas.interf_avg) / 2;
-
-	gsm_lchan_interf_meas_push((struct gsm_lchan *) lchan, interf_avg);
-}
-
-static void bts_report_interf_meas(const struct gsm_bts *bts)
-{
-	const struct gsm_bts_trx *trx;
-	unsigned int tn, ln;
-
-	llist_for_each_entry(trx, &bts->trx_list, list) {
-		/* Skip pushing interf_meas for disabled TRX */
-		if (trx->mo.nm_state.operational != NM_OPSTATE_ENABLED ||
-		    trx->bb_transc.mo.nm_state.operational != NM_OPSTATE_ENABLED)
-			continue;
-
-		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
-			const struct gsm_bts_trx_ts *ts = &trx->ts[tn];
-			for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++)
-				lchan_report_interf_meas(&ts->lchan[ln]);
-		}
-	}
-}
-
 /* Find a route (PHY instance) for a given Downlink burst request */
 static struct phy_instance *dlfh_route_br(const struct trx_dl_burst_req *br,
 					  struct gsm_bts_trx_ts *ts)
@@ -272,10 +202,6 @@ static void bts_sched_fn(struct gsm_bts *bts, const uint32_t fn)
 	struct gsm_bts_trx *trx;
 	unsigned int tn;
 
-	/* Report interference measurements */
-	if (fn % 104 == 0) /* SACCH period */
-		bts_report_interf_meas(bts);
-
 	/* send time indication */
 	l1if_mph_time_ind(bts, fn);
 
@@ -402,12 +328,34 @@ static inline void normalize_timespec(struct timespec *ts)
 	ts->tv_nsec = ts->tv_nsec % 1000000000;
 }
 
+/*! run the scheduler of each BTS clocked by the given PHY link for the given FN */
+static void trx_sched_fn(struct phy_link *plink, uint32_t fn)
+{
+	struct phy_instance *pinst;
+
+	llist_for_each_entry(pinst, &plink->instances, list) {
+		if (phy_instance_is_c0(pinst))
+			bts_sched_fn(pinst->trx->bts, fn);
+	}
+}
+
+/*! shut down each BTS clocked by the given PHY link */
+static void trx_sched_shutdown(struct phy_link *plink, const char *reason)
+{
+	struct phy_instance *pinst;
+
+	llist_for_each_entry(pinst, &plink->instances, list) {
+		if (phy_instance_is_c0(pinst))
+			bts_shutdown(pinst->trx->bts, reason);
+	}
+}
+
 /*! this is the timerfd-callback firing for every FN to be processed */
 static int trx_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
 {
-	struct gsm_bts *bts = ofd->data;
-	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
-	struct osmo_trx_clock_state *tcs = &bts_trx->clk_s;
+	struct phy_link *plink = ofd->data;
+	struct osmo_trx_clock_state *tcs = plink->u.osmotrx.clk_s;
+	struct phy_instance *pinst;
 	struct timespec tv_now;
 	uint64_t expire_count;
 	int64_t elapsed_us, error_us;
@@ -423,14 +371,21 @@ static int trx_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
 	OSMO_ASSERT(rc == sizeof(expire_count));
 
 	if (expire_count > 1) {
-		LOGP(DL1C, LOGL_NOTICE, "FN timer expire_count=%"PRIu64": We missed %"PRIu64" timers\n",
-		     expire_count, expire_count - 1);
-		rate_ctr_add(rate_ctr_group_get_ctr(bts_trx->ctrs, BTSTRX_CTR_SCHED_DL_MISS_FN), expire_count - 1);
+		LOGPPHL(plink, DL1C, LOGL_NOTICE, "FN timer expire_count=%"PRIu64": We missed %"PRIu64" timers\n",
+			expire_count, expire_count - 1);
+		llist_for_each_entry(pinst, &plink->instances, list) {
+			struct bts_trx_priv *bts_trx;
+			if (!phy_instance_is_c0(pinst))
+				continue;
+			bts_trx = (struct bts_trx_priv *)pinst->trx->bts->model_priv;
+			rate_ctr_add(rate_ctr_group_get_ctr(bts_trx->ctrs, BTSTRX_CTR_SCHED_DL_MISS_FN),
+				     expire_count - 1);
+		}
 	}
 
 	/* check if transceiver is still alive */
 	if (tcs->fn_without_clock_ind++ == TRX_LOSS_FRAMES) {
-		LOGP(DL1C, LOGL_NOTICE, "No more clock from transceiver\n");
+		LOGPPHL(plink, DL1C, LOGL_NOTICE, "No more clock from transceiver\n");
 		goto no_clock;
 	}
 
@@ -446,20 +401,20 @@ static int trx_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
 
 	/* if someone played with clock, or if the process stalled */
 	if (elapsed_us > GSM_TDMA_FN_DURATION_uS * MAX_FN_SKEW || elapsed_us < 0) {
-		LOGP(DL1C, LOGL_ERROR, "PC clock skew: elapsed_us=%" PRId64 ", error_us=%" PRId64 "\n",
+		LOGPPHL(plink, DL1C, LOGL_ERROR, "PC clock skew: elapsed_us=%" PRId64 ", error_us=%" PRId64 "\n",
 			elapsed_us, error_us);
 		goto no_clock;
 	}
 
 	/* call bts_sched_fn() for all expired FN */
 	for (i = 0; i < expire_count; i++)
-		bts_sched_fn(bts, GSM_TDMA_FN_INC(tcs->last_fn_timer.fn));
+		trx_sched_fn(plink, GSM_TDMA_FN_INC(tcs->last_fn_timer.fn));
 
 	return 0;
 
 no_clock:
 	osmo_timerfd_disable(&tcs->fn_timer_ofd);
-	bts_shutdown(bts, "No clock from osmo-trx");
+	trx_sched_shutdown(plink, "No clock from osmo-trx");
 	return -1;
 }
 
@@ -467,24 +422,22 @@ no_clock:
  *  means it wasn't replaced and hence no CLOCK IND was received. */
 static int trx_start_noclockind_to_cb(struct osmo_fd *ofd, unsigned int what)
 {
-	struct gsm_bts *bts = ofd->data;
-	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
-	struct osmo_trx_clock_state *tcs = &bts_trx->clk_s;
+	struct phy_link *plink = ofd->data;
+	struct osmo_trx_clock_state *tcs = plink->u.osmotrx.clk_s;
 
 	osmo_fd_close(&tcs->fn_timer_ofd); /* Avoid being called again */
-	bts_shutdown(bts, "No clock since TRX was started");
+	trx_sched_shutdown(plink, "No clock since TRX was started");
 	return -1;
 }
 
 /*! \brief PHY informs us clock indications should start to be received */
-int trx_sched_clock_started(struct gsm_bts *bts)
+int trx_sched_clock_started(struct phy_link *plink)
 {
-	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
-	struct osmo_trx_clock_state *tcs = &bts_trx->clk_s;
+	struct osmo_trx_clock_state *tcs = plink->u.osmotrx.clk_s;
 	const struct timespec it_val = {3, 0};
 	const struct timespec it_intval = {0, 0};
 
-	LOGP(DL1C, LOGL_NOTICE, "GSM clock started, waiting for clock indications\n");
+	LOGPPHL(plink, DL1C, LOGL_NOTICE, "GSM clock started, waiting for clock indications\n");
 	osmo_fd_close(&tcs->fn_timer_ofd);
 	memset(tcs, 0, sizeof(*tcs));
 	tcs->fn_timer_ofd.fd = -1;
@@ -492,18 +445,17 @@ int trx_sched_clock_started(struct gsm_bts *bts)
 	 * seconds. Upon clock ind receival, fn_timer_ofd will be reused and
 	 * timeout won't trigger.
 	 */
-	osmo_timerfd_setup(&tcs->fn_timer_ofd, trx_start_noclockind_to_cb, bts);
+	osmo_timerfd_setup(&tcs->fn_timer_ofd, trx_start_noclockind_to_cb, plink);
 	osmo_timerfd_schedule(&tcs->fn_timer_ofd, &it_val, &it_intval);
 	return 0;
 }
 
 /*! \brief PHY informs us no more clock indications should be received anymore */
-int trx_sched_clock_stopped(struct gsm_bts *bts)
+int trx_sched_clock_stopped(struct phy_link *plink)
 {
-	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
-	struct osmo_trx_clock_state *tcs = &bts_trx->clk_s;
+	struct osmo_trx_clock_state *tcs = plink->u.osmotrx.clk_s;
 
-	LOGP(DL1C, LOGL_NOTICE, "GSM clock stopped\n");
+	LOGPPHL(plink, DL1C, LOGL_NOTICE, "GSM clock stopped\n");
 	osmo_fd_close(&tcs->fn_timer_ofd);
 
 	return 0;
@@ -511,26 +463,25 @@ int trx_sched_clock_stopped(struct gsm_bts *bts)
 
 /*! reset clock with current fn and schedule it. Called when trx becomes
  *  available or when max clock skew is reached */
-static int trx_setup_clock(struct gsm_bts *bts, struct osmo_trx_clock_state *tcs,
+static int trx_setup_clock(struct phy_link *plink, struct osmo_trx_clock_state *tcs,
 	struct timespec *tv_now, const struct timespec *interval, uint32_t fn)
 {
 	/* schedule first FN clock timer */
-	osmo_timerfd_setup(&tcs->fn_timer_ofd, trx_fn_timer_cb, bts);
+	osmo_timerfd_setup(&tcs->fn_timer_ofd, trx_fn_timer_cb, plink);
 	osmo_timerfd_schedule(&tcs->fn_timer_ofd, NULL, interval);
 
 	tcs->last_fn_timer.fn = fn;
 	tcs->last_fn_timer.tv = *tv_now;
 	/* call trx scheduler function for new 'last' FN */
-	bts_sched_fn(bts, tcs->last_fn_timer.fn);
+	trx_sched_fn(plink, tcs->last_fn_timer.fn);
 
 	return 0;
 }
 
 /*! called every time we receive a clock indication from TRX */
-int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
+int trx_sched_clock(struct phy_link *plink, uint32_t fn)
 {
-	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
-	struct osmo_trx_clock_state *tcs = &bts_trx->clk_s;
+	struct osmo_trx_clock_state *tcs = plink->u.osmotrx.clk_s;
 	struct timespec tv_now;
 	int elapsed_fn;
 	int64_t elapsed_us, elapsed_us_since_clk, elapsed_fn_since_clk, error_us_since_clk;
@@ -559,7 +510,7 @@ int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
 	elapsed_fn_since_clk = compute_elapsed_fn(tcs->last_clk_ind.fn, fn);
 	/* error (delta) between local clock since last CLK and CLK based on FN clock at TRX */
 	error_us_since_clk = elapsed_us_since_clk - (GSM_TDMA_FN_DURATION_uS * elapsed_fn_since_clk);
-	LOGP(DL1C, LOGL_INFO, "TRX Clock Ind: elapsed_us=%7"PRId64", "
+	LOGPPHL(plink, DL1C, LOGL_INFO, "TRX Clock Ind: elapsed_us=%7"PRId64", "
 		"elapsed_fn=%3"PRId64", error_us=%+5"PRId64"\n",
 		elapsed_us_since_clk, elapsed_fn_since_clk, error_us_since_clk);
 
@@ -573,12 +524,12 @@ int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
 
 	/* check for max clock skew */
 	if (elapsed_fn > MAX_FN_SKEW || elapsed_fn < -MAX_FN_SKEW) {
-		LOGP(DL1C, LOGL_NOTICE, "GSM clock skew: old fn=%u, "
+		LOGPPHL(plink, DL1C, LOGL_NOTICE, "GSM clock skew: old fn=%u, "
 			"new fn=%u\n", tcs->last_fn_timer.fn, fn);
-		return trx_setup_clock(bts, tcs, &tv_now, &interval, fn);
+		return trx_setup_clock(plink, tcs, &tv_now, &interval, fn);
 	}
 
-	LOGP(DL1C, LOGL_INFO, "GSM clock jitter: %" PRId64 "us (elapsed_fn=%d)\n",
+	LOGPPHL(plink, DL1C, LOGL_INFO, "GSM clock jitter: %" PRId64 "us (elapsed_fn=%d)\n",
 		elapsed_fn * GSM_TDMA_FN_DURATION_uS - elapsed_us, elapsed_fn);
 
 	/* too many frames have been processed already */
@@ -588,7 +539,7 @@ int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
 		 * transmitted. */
 		first.tv_nsec += (0 - elapsed_fn) * GSM_TDMA_FN_DURATION_nS;
 		normalize_timespec(&first);
-		LOGP(DL1C, LOGL_NOTICE, "We were %d FN faster than TRX, compensating\n", -elapsed_fn);
+		LOGPPHL(plink, DL1C, LOGL_NOTICE, "We were %d FN faster than TRX, compensating\n", -elapsed_fn);
 		/* set time to the time our next FN has to be transmitted */
 		osmo_timerfd_schedule(&tcs->fn_timer_ofd, &first, &interval);
 		return 0;
@@ -596,12 +547,12 @@ int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
 
 	/* transmit what we still need to transmit */
 	while (fn != tcs->last_fn_timer.fn) {
-		bts_sched_fn(bts, GSM_TDMA_FN_INC(tcs->last_fn_timer.fn));
+		trx_sched_fn(plink, GSM_TDMA_FN_INC(tcs->last_fn_timer.fn));
 		fn_caught_up++;
 	}
 
 	if (fn_caught_up) {
-		LOGP(DL1C, LOGL_NOTICE, "We were %d FN slower than TRX, compensated\n", elapsed_fn);
+		LOGPPHL(plink, DL1C, LOGL_NOTICE, "We were %d FN slower than TRX, compensated\n", elapsed_fn);
 		tcs->last_fn_timer.tv = tv_now;
 	}
 
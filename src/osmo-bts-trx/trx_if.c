@@ -46,10 +46,12 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/bts.h>
 #include <osmo-bts/scheduler.h>
+#include <osmo-bts/burst_trace.h>
 
 #include "l1_if.h"
 #include "trx_if.h"
 #include "trx_provision_fsm.h"
+#include "sched_ul_dec.h"
 
 #include "btsconfig.h"
 
@@ -148,7 +150,7 @@ static int trx_clk_read_cb(struct osmo_fd *ofd, unsigned int what)
 		return 0;
 	}
 	/* inform core TRX clock handling code that a FN has been received */
-	trx_sched_clock(pinst->trx->bts, fn);
+	trx_sched_clock(plink, fn);
 
 	return 0;
 }
@@ -213,6 +215,11 @@ void trx_if_init(struct trx_l1h *l1h)
 
 	l1h->trx_ofd_ctrl.fd = -1;
 	l1h->trx_ofd_data.fd = -1;
+
+	/* each TRX batches its own Downlink bursts, TRX of several BTS may be served concurrently */
+	l1h->data_tx.buf = talloc_size(l1h, TRXD_MSG_BUF_SIZE);
+	OSMO_ASSERT(l1h->data_tx.buf);
+	l1h->data_tx.cur = l1h->data_tx.buf;
 }
 
 /*! Send a new TRX control command.
@@ -1012,7 +1019,7 @@ static const char *trx_data_desc_msg(const struct trx_ul_burst_ind *bi)
 	return buf;
 }
 
-/* TRXD buffer used by Rx/Tx handlers */
+/* TRXD buffer used by the Rx handler, each message is processed completely before returning */
 static uint8_t trx_data_buf[TRXD_MSG_BUF_SIZE];
 
 /* Parse TRXD message from transceiver, compose an UL burst indication. */
@@ -1107,6 +1114,9 @@ static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
 		LOGPPHI(l1h->phy_inst, DTRX, LOGL_DEBUG, "Rx %s (pdu_ver=%u): %s\n",
 			(bi.flags & TRX_BI_F_NOPE_IND) ? "NOPE.ind" : "UL burst",
 			pdu_ver, trx_data_desc_msg(&bi));
+		BURST_TRACE(l1h->phy_inst->trx->nr, bi.tn, BURST_TRACE_CHAN_NONE, bi.fn,
+			    (bi.flags & TRX_BI_F_NOPE_IND) ? BURST_TRACE_EV_TRXD_NOPE : BURST_TRACE_EV_TRXD_RX,
+			    bi.rssi, bi.toa256, (bi.flags & TRX_BI_F_CI_CB) ? bi.ci_cb : 0, bi.flags);
 
 		/* Number of processed PDUs */
 		bi._num_pdus++;
@@ -1127,9 +1137,7 @@ static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
 int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 {
 	uint8_t pdu_ver = l1h->config.trxd_pdu_ver_use;
-	static uint8_t *buf = &trx_data_buf[0];
-	static uint8_t *last_pdu = NULL;
-	static unsigned int pdu_num = 0;
+	uint8_t *buf = l1h->data_tx.cur;
 	ssize_t snd_len, buf_len;
 
 	/* Make sure that the PHY is powered on */
@@ -1141,13 +1149,13 @@ int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 
 	/* Burst batching breaker */
 	if (br == NULL) {
-		if (pdu_num > 0)
+		if (l1h->data_tx.pdu_num > 0)
 			goto sendall;
 		return -ENOMSG;
 	}
 
 	/* Pointer to the last encoded PDU */
-	last_pdu = &buf[0];
+	l1h->data_tx.last_pdu = &buf[0];
 
 	switch (pdu_ver) {
 	/* Both versions have the same PDU format */
@@ -1169,7 +1177,7 @@ int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 		buf[4] = (uint8_t) br->scpir;
 		buf[5] = buf[6] = buf[7] = 0x00; /* Spare */
 		/* Some fields are not present in batched PDUs */
-		if (pdu_num == 0) {
+		if (l1h->data_tx.pdu_num == 0) {
 			buf[0] |= (pdu_ver & 0x0f) << 4;
 			osmo_store32be(br->fn, buf + 8);
 			buf += 4;
@@ -1186,7 +1194,8 @@ int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 	buf += br->burst_len;
 
 	/* One more PDU in the buffer */
-	pdu_num++;
+	l1h->data_tx.pdu_num++;
+	l1h->data_tx.cur = buf;
 
 	/* TRXDv2: wait for the batching breaker */
 	if (pdu_ver >= 2)
@@ -1195,22 +1204,23 @@ int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 sendall:
 	LOGPPHI(l1h->phy_inst, DTRX, LOGL_DEBUG,
 		"Tx TRXDv%u datagram with %u PDU(s)\n",
-		pdu_ver, pdu_num);
+		pdu_ver, l1h->data_tx.pdu_num);
 
 	/* TRXDv2: unset BATCH.ind in the last PDU */
 	if (pdu_ver >= 2)
-		last_pdu[1] &= ~(1 << 7);
+		l1h->data_tx.last_pdu[1] &= ~(1 << 7);
 
-	buf_len = buf - &trx_data_buf[0];
-	buf = &trx_data_buf[0];
-	pdu_num = 0;
+	buf_len = buf - l1h->data_tx.buf;
+	l1h->data_tx.cur = l1h->data_tx.buf;
+	l1h->data_tx.pdu_num = 0;
 
-	snd_len = send(l1h->trx_ofd_data.fd, trx_data_buf, buf_len, 0);
+	snd_len = send(l1h->trx_ofd_data.fd, l1h->data_tx.buf, buf_len, 0);
 	if (OSMO_UNLIKELY(snd_len <= 0)) {
-		strerror_r(errno, (char *) trx_data_buf, sizeof(trx_data_buf));
+		char errbuf[64];
+		strerror_r(errno, errbuf, sizeof(errbuf));
 		LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
 			"send() failed on TRXD with rc=%zd (%s)\n",
-			snd_len, trx_data_buf);
+			snd_len, errbuf);
 		return -2;
 	}
 
@@ -1305,8 +1315,12 @@ static int trx_if_open(struct trx_l1h *l1h)
 static void trx_phy_inst_close(struct phy_instance *pinst)
 {
 	struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
+	struct ul_dec_pool *ul_dec = pinst->phy_link->u.osmotrx.ul_dec;
 
 	trx_if_close(l1h);
+	/* deliver what is still being decoded while the scheduler is there */
+	if (ul_dec)
+		ul_dec_pool_flush(ul_dec);
 	if (pinst->trx)
 		trx_sched_clean(pinst->trx);
 }
@@ -1355,6 +1369,13 @@ int bts_model_phy_link_open(struct phy_link *plink)
 		return -1;
 	}
 
+	if (plink->u.osmotrx.ul_dec_threads > 0) {
+		plink->u.osmotrx.ul_dec = ul_dec_pool_alloc(plink, plink->u.osmotrx.ul_dec_threads);
+		if (!plink->u.osmotrx.ul_dec)
+			LOGPPHL(plink, DL1C, LOGL_ERROR, "Cannot start UL decoder threads, "
+				"decoding on the main thread\n");
+	}
+
 	/* open the individual instances with their ctrl+data sockets */
 	llist_for_each_entry(pinst, &plink->instances, list) {
 		struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
@@ -1373,6 +1394,10 @@ cleanup:
 			pinst->u.osmotrx.hdl = NULL;
 		}
 	}
+	if (plink->u.osmotrx.ul_dec) {
+		ul_dec_pool_free(plink->u.osmotrx.ul_dec);
+		plink->u.osmotrx.ul_dec = NULL;
+	}
 	trx_udp_close(&plink->u.osmotrx.trx_ofd_clk);
 	return -1;
 }
@@ -1380,14 +1405,13 @@ cleanup:
 /*! close the PHY link using TRX protocol */
 int bts_model_phy_link_close(struct phy_link *plink)
 {
-	bool clock_stopped = false;
 	struct phy_instance *pinst;
-	llist_for_each_entry(pinst, &plink->instances, list) {
-		if (!clock_stopped) {
-			clock_stopped = true;
-			trx_sched_clock_stopped(pinst->trx->bts);
-		}
+	trx_sched_clock_stopped(plink);
+	llist_for_each_entry(pinst, &plink->instances, list)
 		trx_phy_inst_close(pinst);
+	if (plink->u.osmotrx.ul_dec) {
+		ul_dec_pool_free(plink->u.osmotrx.ul_dec);
+		plink->u.osmotrx.ul_dec = NULL;
 	}
 	trx_udp_close(&plink->u.osmotrx.trx_ofd_clk);
 	phy_link_state_set(plink, PHY_LINK_SHUTDOWN);
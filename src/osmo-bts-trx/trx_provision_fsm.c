@@ -34,6 +34,7 @@
 #include <osmo-bts/bts.h>
 #include <osmo-bts/rsl.h>
 #include <osmo-bts/nm_common_fsm.h>
+#include <osmo-bts/oml.h>
 #include <osmo-bts/signal.h>
 
 #include "l1_if.h"
@@ -108,6 +109,7 @@ static void trx_provision_reset(struct trx_l1h *l1h)
 	l1h->config.setformat_acked = false;
 
 	l1h->config.enabled = false;
+	l1h->config.ramp_on_poweron = false;
 	l1h->config.arfcn_valid = false;
 	l1h->config.arfcn = 0;
 	l1h->config.rxtune_sent = false;
@@ -137,6 +139,7 @@ static void trx_provision_reset(struct trx_l1h *l1h)
 	for (tn = 0; tn < TRX_NR_TS; tn++) {
 		l1h->config.setslot_valid[tn] = false;
 		l1h->config.setslot_sent[tn] = false;
+		l1h->config.setslot_acked[tn] = false;
 		l1h->config.setslot[tn].slottype = 0;
 		l1h->config.setslot[tn].tsc_set = 0;
 		l1h->config.setslot[tn].tsc_val = 0;
@@ -215,6 +218,14 @@ int l1if_provision_transceiver_trx(struct trx_l1h *l1h)
 	return 0;
 }
 
+/* Remember that the transceiver has the slot configured, unless a newer
+ * SETSLOT with another slot type was sent in the meantime */
+static void setslot_ack(struct trx_l1h *l1h, uint8_t tn, uint8_t type, int rc)
+{
+	if (rc == 0 && l1h->config.setslot[tn].slottype == type)
+		l1h->config.setslot_acked[tn] = true;
+}
+
 static void l1if_setslot_cb(struct trx_l1h *l1h, uint8_t tn, uint8_t type, int rc)
 {
 	struct phy_instance *pinst = l1h->phy_inst;
@@ -235,6 +246,8 @@ static void l1if_setslot_cb(struct trx_l1h *l1h, uint8_t tn, uint8_t type, int r
 		return;
 	}
 
+	setslot_ack(l1h, tn, type, rc);
+
 	ts = &trx->ts[tn];
 	LOGPPHI(pinst, DL1C, LOGL_DEBUG, "%s l1if_setslot_cb(as_pchan=%s),"
 	     " calling cb_ts_connected(rc=%d)\n",
@@ -242,6 +255,44 @@ static void l1if_setslot_cb(struct trx_l1h *l1h, uint8_t tn, uint8_t type, int r
 	cb_ts_connected(ts, rc);
 }
 
+/* The timeslot was reported connected before sending SETSLOT already: on
+ * failure, take it out of service so that neither the BSC nor the PCU keep
+ * using a timeslot the transceiver is not configured for. */
+static void l1if_setslot_early_cb(struct trx_l1h *l1h, uint8_t tn, uint8_t type, int rc)
+{
+	struct phy_instance *pinst = l1h->phy_inst;
+	struct gsm_bts_trx_ts *ts;
+
+	if (tn >= TRX_NR_TS) {
+		LOGPPHI(pinst, DL1C, LOGL_ERROR, "transceiver SETSLOT invalid param TN (%" PRIu8 ")\n",
+			tn);
+		return;
+	}
+
+	setslot_ack(l1h, tn, type, rc);
+	if (rc == 0)
+		return;
+
+	ts = &pinst->trx->ts[tn];
+	LOGPPHI(pinst, DL1C, LOGL_ERROR, "%s transceiver SETSLOT (TS_TYPE=%" PRIu8 ") failed"
+		" after the timeslot was reported connected, disabling it\n", gsm_ts_name(ts), type);
+	oml_tx_failure_event_rep(&ts->mo, NM_SEVER_MAJOR, OSMO_EVT_WARN_SW_WARN,
+				 "transceiver SETSLOT (TS_TYPE=%" PRIu8 ") failed", type);
+	osmo_fsm_inst_dispatch(ts->mo.fi, NM_EV_DISABLE, NULL);
+}
+
+/* Whether the transceiver confirmed the given slot configuration */
+static bool ts_data_acked(const struct trx_l1h *l1h, const struct trx_prov_ev_cfg_ts_data *data)
+{
+	const struct trx_config *cfg = &l1h->config;
+
+	return cfg->setslot_acked[data->tn] &&
+	       cfg->setslot[data->tn].slottype == data->slottype &&
+	       cfg->setslot[data->tn].tsc_valid == data->tsc_valid &&
+	       (!data->tsc_valid || (cfg->setslot[data->tn].tsc_set == data->tsc_set &&
+				     cfg->setslot[data->tn].tsc_val == data->tsc_val));
+}
+
 static void update_ts_data(struct trx_l1h *l1h, struct trx_prov_ev_cfg_ts_data *data)
 {
 	l1h->config.setslot[data->tn].slottype = data->slottype;
@@ -251,6 +302,7 @@ static void update_ts_data(struct trx_l1h *l1h, struct trx_prov_ev_cfg_ts_data *
 
 	l1h->config.setslot_valid[data->tn] = true;
 	l1h->config.setslot_sent[data->tn] = false;
+	l1h->config.setslot_acked[data->tn] = false;
 }
 
 /* Whether a given TRX is fully configured */
@@ -526,6 +578,46 @@ static void st_open_poweroff(struct osmo_fsm_inst *fi, uint32_t event, void *dat
 }
 
 
+/* After a warm start, the transceiver may have been powered on before the BSC
+ * configures it.  The configuration is expected to be the same (see
+ * oml_snapshot_rx_attr()), since it cannot be changed while powered on. */
+static void st_open_cfg_powered(struct osmo_fsm_inst *fi, uint32_t event, void *data)
+{
+	struct trx_l1h *l1h = (struct trx_l1h *)fi->priv;
+	struct phy_instance *pinst = l1h->phy_inst;
+	uint16_t arfcn;
+	uint8_t bsic;
+
+	switch (event) {
+	case TRX_PROV_EV_CFG_ENABLE:
+		if ((bool)data == l1h->config.enabled)
+			return;
+		break;
+	case TRX_PROV_EV_CFG_BSIC:
+		bsic = (uint8_t)(intptr_t)data;
+		if (!pinst->phy_link->u.osmotrx.use_legacy_setbsic) {
+			if (l1h->config.tsc_valid && l1h->config.tsc == BSIC2BCC(bsic))
+				return;
+		} else {
+			if (l1h->config.bsic_valid && l1h->config.bsic == bsic)
+				return;
+		}
+		break;
+	case TRX_PROV_EV_CFG_ARFCN:
+		arfcn = (uint16_t)(intptr_t)data;
+		if (pinst->trx->bts->band == GSM_BAND_1900)
+			arfcn |= ARFCN_PCS;
+		if (l1h->config.arfcn_valid && l1h->config.arfcn == arfcn)
+			return;
+		break;
+	default:
+		OSMO_ASSERT(0);
+	}
+
+	LOGPFSML(fi, LOGL_ERROR, "Ignoring %s, the transceiver is powered on already\n",
+		 osmo_fsm_event_name(fi->fsm, event));
+}
+
 static void st_open_wait_power_cnf_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_state)
 {
 	struct trx_l1h *l1h = (struct trx_l1h *)fi->priv;
@@ -546,17 +638,22 @@ static void st_open_wait_power_cnf(struct osmo_fsm_inst *fi, uint32_t event, voi
 	case TRX_PROV_EV_POWERON_CNF:
 		rc = (uint16_t)(intptr_t)data;
 		if (rc == 0 && plink->state != PHY_LINK_CONNECTED) {
-			trx_sched_clock_started(pinst->trx->bts);
+			trx_sched_clock_started(plink);
 			phy_link_state_set(plink, PHY_LINK_CONNECTED);
 			trx_prov_fsm_state_chg(fi, TRX_PROV_ST_OPEN_POWERON);
 		} else if (rc != 0 && plink->state != PHY_LINK_SHUTDOWN) {
-			trx_sched_clock_stopped(pinst->trx->bts);
+			trx_sched_clock_stopped(plink);
 			phy_link_state_set(plink, PHY_LINK_SHUTDOWN);
 		}
 		break;
 	case TRX_PROV_EV_CFG_TS:
 		update_ts_data(l1h, (struct trx_prov_ev_cfg_ts_data*)data);
 		break;
+	case TRX_PROV_EV_CFG_ENABLE:
+	case TRX_PROV_EV_CFG_BSIC:
+	case TRX_PROV_EV_CFG_ARFCN:
+		st_open_cfg_powered(fi, event, data);
+		break;
 	case TRX_PROV_EV_CLOSE:
 		/* power off transceiver, if not already */
 		if (pinst->num == 0 && !plink->u.osmotrx.poweroff_sent) {
@@ -596,6 +693,12 @@ static void st_open_poweron_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_sta
 			l1h->config.setslot_sent[tn] = true;
 		}
 	}
+
+	/* warm start: the BSC did not unlock the TRX (again) yet */
+	if (l1h->config.ramp_on_poweron) {
+		l1h->config.ramp_on_poweron = false;
+		l1if_trx_start_power_ramp(l1h->phy_inst->trx, NULL);
+	}
 }
 
 static void st_open_poweron(struct osmo_fsm_inst *fi, uint32_t event, void *data)
@@ -616,11 +719,21 @@ static void st_open_poweron(struct osmo_fsm_inst *fi, uint32_t event, void *data
 		break;
 	case TRX_PROV_EV_CFG_TS:
 		ts_data = (struct trx_prov_ev_cfg_ts_data*)data;
+		/* e.g. a dynamic TS going PDCH -> NONE -> PDCH: if nobody waits
+		 * for the response, there's nothing to tell the transceiver */
+		if (ts_data->early_connect && ts_data_acked(l1h, ts_data))
+			break;
 		update_ts_data(l1h, ts_data);
 		/* While in this state we can send SETSLOT immediately */
-		trx_if_cmd_setslot(l1h, ts_data->tn, l1if_setslot_cb);
+		trx_if_cmd_setslot(l1h, ts_data->tn, ts_data->early_connect ?
+				   l1if_setslot_early_cb : l1if_setslot_cb);
 		l1h->config.setslot_sent[ts_data->tn] = true;
 		break;
+	case TRX_PROV_EV_CFG_ENABLE:
+	case TRX_PROV_EV_CFG_BSIC:
+	case TRX_PROV_EV_CFG_ARFCN:
+		st_open_cfg_powered(fi, event, data);
+		break;
 	default:
 		OSMO_ASSERT(0);
 	}
@@ -678,6 +791,9 @@ static struct osmo_fsm_state trx_prov_fsm_states[] = {
 		.in_event_mask =
 			X(TRX_PROV_EV_CLOSE) |
 			X(TRX_PROV_EV_POWERON_CNF) |
+			X(TRX_PROV_EV_CFG_ENABLE) |
+			X(TRX_PROV_EV_CFG_BSIC) |
+			X(TRX_PROV_EV_CFG_ARFCN) |
 			X(TRX_PROV_EV_CFG_TS),
 		.out_state_mask =
 			X(TRX_PROV_ST_OPEN_POWERON) |
@@ -689,6 +805,9 @@ static struct osmo_fsm_state trx_prov_fsm_states[] = {
 	[TRX_PROV_ST_OPEN_POWERON] = {
 		.in_event_mask =
 			X(TRX_PROV_EV_CLOSE) |
+			X(TRX_PROV_EV_CFG_ENABLE) |
+			X(TRX_PROV_EV_CFG_BSIC) |
+			X(TRX_PROV_EV_CFG_ARFCN) |
 			X(TRX_PROV_EV_CFG_TS),
 		.out_state_mask =
 			X(TRX_PROV_ST_OPEN_WAIT_POWEROFF_CNF),
@@ -42,6 +42,9 @@ struct trx_prov_ev_cfg_ts_data {
 	uint8_t tsc_set;
 	uint8_t tsc_val;
 	bool tsc_valid;
+
+	/* cb_ts_connected() was called already, don't wait for RSP SETSLOT */
+	bool early_connect;
 };
 
 enum trx_provision_fsm_events {
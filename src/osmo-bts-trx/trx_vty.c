@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <stdint.h>
 #include <ctype.h>
 #include <inttypes.h>
@@ -42,6 +43,7 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/vty.h>
 #include <osmo-bts/scheduler.h>
+#include <osmo-bts/burst_trace.h>
 #include <osmo-bts/bts.h>
 
 #include "l1_if.h"
@@ -52,69 +54,75 @@
 
 #define OSMOTRX_STR	"OsmoTRX Transceiver configuration\n"
 
-DEFUN(show_transceiver, show_transceiver_cmd, "show transceiver",
-	SHOW_STR "Display information about transceivers\n")
+static void show_transceiver_single(struct vty *vty, const struct gsm_bts_trx *trx)
 {
-	struct gsm_bts_trx *trx;
-	struct trx_l1h *l1h;
+	struct phy_instance *pinst = trx_phy_instance(trx);
+	struct phy_link *plink = pinst->phy_link;
+	char *sname = osmo_sock_get_name(NULL, plink->u.osmotrx.trx_ofd_clk.fd);
+	struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
 	unsigned int tn;
 
-	llist_for_each_entry(trx, &g_bts->trx_list, list) {
-		struct phy_instance *pinst = trx_phy_instance(trx);
-		struct phy_link *plink = pinst->phy_link;
-		char *sname = osmo_sock_get_name(NULL, plink->u.osmotrx.trx_ofd_clk.fd);
-		l1h = pinst->u.osmotrx.hdl;
-		vty_out(vty, "TRX %d %s%s", trx->nr, sname, VTY_NEWLINE);
-		talloc_free(sname);
-		vty_out(vty, " %s%s",
-			trx_if_powered(l1h) ? "poweron":"poweroff",
+	vty_out(vty, "BTS %u TRX %d %s%s", trx->bts->nr, trx->nr, sname, VTY_NEWLINE);
+	talloc_free(sname);
+	vty_out(vty, " %s%s",
+		trx_if_powered(l1h) ? "poweron":"poweroff",
+		VTY_NEWLINE);
+	vty_out(vty, "phy link state: %s%s",
+		phy_link_state_name(phy_link_state_get(plink)), VTY_NEWLINE);
+	if (l1h->config.arfcn_valid)
+		vty_out(vty, " arfcn  : %d%s%s",
+			(l1h->config.arfcn & ~ARFCN_PCS),
+			(l1h->config.arfcn & ARFCN_PCS) ? " (PCS)" : "",
 			VTY_NEWLINE);
-		vty_out(vty, "phy link state: %s%s",
-			phy_link_state_name(phy_link_state_get(plink)), VTY_NEWLINE);
-		if (l1h->config.arfcn_valid)
-			vty_out(vty, " arfcn  : %d%s%s",
-				(l1h->config.arfcn & ~ARFCN_PCS),
-				(l1h->config.arfcn & ARFCN_PCS) ? " (PCS)" : "",
-				VTY_NEWLINE);
-		else
-			vty_out(vty, " arfcn  : undefined%s", VTY_NEWLINE);
-		if (l1h->config.tsc_valid)
-			vty_out(vty, " tsc    : %d%s", l1h->config.tsc,
-				VTY_NEWLINE);
-		else
-			vty_out(vty, " tsc    : undefined%s", VTY_NEWLINE);
-		if (l1h->config.bsic_valid)
-			vty_out(vty, " bsic   : %d%s", l1h->config.bsic,
-				VTY_NEWLINE);
-		else
-			vty_out(vty, " bsic   : undefined%s", VTY_NEWLINE);
-
-		/* trx->ts[tn].priv is NULL in absence of the A-bis connection */
-		if (trx->bb_transc.rsl.link == NULL)
-			continue;
-
-		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
-			const struct gsm_bts_trx_ts *ts = &trx->ts[tn];
-			const struct l1sched_ts *l1ts = ts->priv;
-			const struct trx_sched_multiframe *mf;
+	else
+		vty_out(vty, " arfcn  : undefined%s", VTY_NEWLINE);
+	if (l1h->config.tsc_valid)
+		vty_out(vty, " tsc    : %d%s", l1h->config.tsc,
+			VTY_NEWLINE);
+	else
+		vty_out(vty, " tsc    : undefined%s", VTY_NEWLINE);
+	if (l1h->config.bsic_valid)
+		vty_out(vty, " bsic   : %d%s", l1h->config.bsic,
+			VTY_NEWLINE);
+	else
+		vty_out(vty, " bsic   : undefined%s", VTY_NEWLINE);
+
+	/* trx->ts[tn].priv is NULL in absence of the A-bis connection */
+	if (trx->bb_transc.rsl.link == NULL)
+		return;
+
+	for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+		const struct gsm_bts_trx_ts *ts = &trx->ts[tn];
+		const struct l1sched_ts *l1ts = ts->priv;
+		const struct trx_sched_multiframe *mf;
+
+		OSMO_ASSERT(l1ts != NULL);
+		mf = &trx_sched_multiframes[l1ts->mf_index];
+
+		vty_out(vty, "  timeslot #%u (%s)%s",
+			tn, mf->name, VTY_NEWLINE);
+		vty_out(vty, "    pending DL prims    : %u%s",
+			llist_count(&l1ts->dl_prims), VTY_NEWLINE);
+		vty_out(vty, "    interference        : %ddBm%s",
+			ts->lchan[0].meas.interf_meas_avg_dbm,
+			VTY_NEWLINE);
+	}
+}
 
-			OSMO_ASSERT(l1ts != NULL);
-			mf = &trx_sched_multiframes[l1ts->mf_index];
+DEFUN(show_transceiver, show_transceiver_cmd, "show transceiver",
+	SHOW_STR "Display information about transceivers\n")
+{
+	const struct gsm_bts *bts;
+	const struct gsm_bts_trx *trx;
 
-			vty_out(vty, "  timeslot #%u (%s)%s",
-				tn, mf->name, VTY_NEWLINE);
-			vty_out(vty, "    pending DL prims    : %u%s",
-				llist_count(&l1ts->dl_prims), VTY_NEWLINE);
-			vty_out(vty, "    interference        : %ddBm%s",
-				l1ts->chan_state[TRXC_IDLE].meas.interf_avg,
-				VTY_NEWLINE);
-		}
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+		llist_for_each_entry(trx, &bts->trx_list, list)
+			show_transceiver_single(vty, trx);
 	}
 
 	return CMD_SUCCESS;
 }
 
-
 static void show_phy_inst_single(struct vty *vty, struct phy_instance *pinst)
 {
 	uint8_t tn;
@@ -196,18 +204,26 @@ DEFUN(show_phy, show_phy_cmd, "show phy",
 
 DEFUN_HIDDEN(test_send_trxc,
 	     test_send_trxc_cmd,
-	     "test send-trxc-cmd <0-255> CMD [.ARGS]",
+	     "test send-trxc-cmd bts <0-255> trx <0-255> CMD [.ARGS]",
 	     "Various testing commands\n"
 	     "Send an arbitrary TRX command\n"
-	     "Transceiver number\n"
+	     "BTS Number\n" "BTS Number\n"
+	     "Transceiver\n" "Transceiver number\n"
 	     "TRXC command\n" "TRXC command arguments\n")
 {
+	const struct gsm_bts *bts;
 	const struct gsm_bts_trx *trx;
 	const struct phy_instance *pinst;
 	struct trx_l1h *l1h;
 	int rc;
 
-	trx = gsm_bts_trx_num(g_bts, atoi(argv[0]));
+	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
+	if (bts == NULL) {
+		vty_out(vty, "%% Could not find BTS%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	trx = gsm_bts_trx_num(bts, atoi(argv[1]));
 	if (trx == NULL) {
 		vty_out(vty, "%% Could not find TRX%s", VTY_NEWLINE);
 		return CMD_WARNING;
@@ -216,17 +232,66 @@ DEFUN_HIDDEN(test_send_trxc,
 	pinst = trx_phy_instance(trx);
 	l1h = pinst->u.osmotrx.hdl;
 
-	if (argc > 2) {
-		char *cmd_args = argv_concat(argv, argc, 2);
-		rc = trx_ctrl_cmd(l1h, 0, argv[1], "%s", cmd_args);
+	if (argc > 3) {
+		char *cmd_args = argv_concat(argv, argc, 3);
+		rc = trx_ctrl_cmd(l1h, 0, argv[2], "%s", cmd_args);
 		talloc_free(cmd_args);
 	} else {
-		rc = trx_ctrl_cmd(l1h, 0, argv[1], "");
+		rc = trx_ctrl_cmd(l1h, 0, argv[2], "");
 	}
 
 	return (rc == 0) ? CMD_SUCCESS : CMD_WARNING;
 }
 
+#define BURST_TRACE_STR "Binary trace of per-burst scheduler events\n"
+
+DEFUN(burst_trace_start, burst_trace_start_cmd,
+      "burst-trace start FILE [<1024-16777216>]",
+      BURST_TRACE_STR "Start writing trace records into a ring buffer file\n"
+      "File name (created or truncated)\n"
+      "Number of records in the ring buffer (default 65536)\n")
+{
+	unsigned int num_recs = BURST_TRACE_RECS_DEF;
+	int rc;
+
+	if (argc > 1)
+		num_recs = atoi(argv[1]);
+
+	rc = burst_trace_start(argv[0], num_recs);
+	if (rc < 0) {
+		vty_out(vty, "%% Failed to start burst trace into '%s': %s%s",
+			argv[0], strerror(-rc), VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(burst_trace_stop, burst_trace_stop_cmd,
+      "burst-trace stop",
+      BURST_TRACE_STR "Stop tracing, decode the file with osmo-bts-burst-trace\n")
+{
+	burst_trace_stop();
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_burst_trace, show_burst_trace_cmd,
+      "show burst-trace",
+      SHOW_STR BURST_TRACE_STR)
+{
+	const struct burst_trace_hdr *hdr = g_burst_trace.hdr;
+
+	if (hdr == NULL) {
+		vty_out(vty, "Burst trace is not running%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	vty_out(vty, "Burst trace into '%s': %" PRIu64 " records written, ring of %u%s",
+		g_burst_trace.path, __atomic_load_n(&hdr->head, __ATOMIC_RELAXED),
+		g_burst_trace.num_recs, VTY_NEWLINE);
+	return CMD_SUCCESS;
+}
+
 DEFUN_USRATTR(cfg_trx_nominal_power, cfg_trx_nominal_power_cmd,
 	      X(BTS_VTY_TRX_POWERCYCLE),
 	      "nominal-tx-power <-10-100>",
@@ -268,8 +333,14 @@ DEFUN_DEPRECATED(cfg_phy_ms_power_loop, cfg_phy_ms_power_loop_cmd,
 		self->string, VTY_NEWLINE);
 
 	uint8_t rxlev = dbm2rxlev(atoi(argv[0]));
-	g_bts->ms_dpc_params.rxlev_meas.lower_thresh = rxlev;
-	g_bts->ms_dpc_params.rxlev_meas.upper_thresh = rxlev;
+	struct gsm_bts *bts;
+
+	/* The 'phy' nodes precede the 'bts' nodes in the config file, so the
+	 * instances of this link are not yet bound to any TRX: apply to all. */
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+		bts->ms_dpc_params.rxlev_meas.lower_thresh = rxlev;
+		bts->ms_dpc_params.rxlev_meas.upper_thresh = rxlev;
+	}
 
 	return CMD_SUCCESS;
 }
@@ -587,6 +658,44 @@ DEFUN_USRATTR(cfg_phy_trxd_max_version, cfg_phy_trxd_max_version_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN_USRATTR(cfg_phy_ul_decode_threads, cfg_phy_ul_decode_threads_cmd,
+	      X(BTS_VTY_TRX_POWERCYCLE),
+	      "osmotrx ul-decode-threads <0-16>", OSMOTRX_STR
+	      "Decode xCCH and PDTCH Uplink bursts on a pool of threads\n"
+	      "Number of decoder threads (0: decode on the main thread, default)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.ul_dec_threads = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_early_ts_connect, cfg_phy_early_ts_connect_cmd,
+	   "osmotrx early-ts-connect", OSMOTRX_STR
+	   "Complete dynamic timeslot switches without waiting for the transceiver "
+	   "to confirm the new slot type (RSP SETSLOT)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.early_ts_connect = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_no_early_ts_connect, cfg_phy_no_early_ts_connect_cmd,
+	   "no osmotrx early-ts-connect",
+	   NO_STR OSMOTRX_STR "Wait for RSP SETSLOT on dynamic timeslot switches (default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.early_ts_connect = false;
+
+	return CMD_SUCCESS;
+}
+
 void bts_model_config_write_phy(struct vty *vty, const struct phy_link *plink)
 {
 	if (plink->u.osmotrx.local_ip)
@@ -613,6 +722,12 @@ void bts_model_config_write_phy(struct vty *vty, const struct phy_link *plink)
 
 	if (plink->u.osmotrx.trxd_pdu_ver_max != TRX_DATA_PDU_VER)
 		vty_out(vty, " osmotrx trxd-max-version %d%s", plink->u.osmotrx.trxd_pdu_ver_max, VTY_NEWLINE);
+
+	if (plink->u.osmotrx.ul_dec_threads > 0)
+		vty_out(vty, " osmotrx ul-decode-threads %u%s", plink->u.osmotrx.ul_dec_threads, VTY_NEWLINE);
+
+	if (plink->u.osmotrx.early_ts_connect)
+		vty_out(vty, " osmotrx early-ts-connect%s", VTY_NEWLINE);
 }
 
 void bts_model_config_write_phy_inst(struct vty *vty, const struct phy_instance *pinst)
@@ -663,7 +778,11 @@ int bts_model_vty_init(void *ctx)
 	install_element_ve(&show_transceiver_cmd);
 	install_element_ve(&show_phy_cmd);
 
+	install_element_ve(&show_burst_trace_cmd);
+
 	install_element(ENABLE_NODE, &test_send_trxc_cmd);
+	install_element(ENABLE_NODE, &burst_trace_start_cmd);
+	install_element(ENABLE_NODE, &burst_trace_stop_cmd);
 
 	install_element(TRX_NODE, &cfg_trx_nominal_power_cmd);
 	install_element(TRX_NODE, &cfg_trx_no_nominal_power_cmd);
@@ -680,6 +799,9 @@ int bts_model_vty_init(void *ctx)
 	install_element(PHY_NODE, &cfg_phy_setbsic_cmd);
 	install_element(PHY_NODE, &cfg_phy_no_setbsic_cmd);
 	install_element(PHY_NODE, &cfg_phy_trxd_max_version_cmd);
+	install_element(PHY_NODE, &cfg_phy_ul_decode_threads_cmd);
+	install_element(PHY_NODE, &cfg_phy_early_ts_connect_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_early_ts_connect_cmd);
 
 	install_element(PHY_INST_NODE, &cfg_phyinst_rxgain_cmd);
 	install_element(PHY_INST_NODE, &cfg_phyinst_tx_atten_cmd);
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <time.h>
+
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/scheduler.h>
 
@@ -8,8 +14,23 @@
 /* gsm_bts->model_priv, specific to osmo-bts-virtual */
 struct bts_virt_priv {
 	uint32_t last_fn;
-	struct timeval tv_clock;
-	struct osmo_timer_list fn_timer;
+	struct osmo_fd fn_timer_ofd;		/* CLOCK_MONOTONIC timerfd, one expiry per FN */
+	struct osmo_timer_list fn_idle_timer;	/* virtual time: zero timeout, one FN per select loop */
+	struct rate_ctr_group *ctrs;		/* bts-virt specific rate counters */
+
+	/* lateness of the FN processing against the ideal frame clock */
+	struct {
+		struct timespec tv_start;	/* time of FN tick 0 */
+		uint64_t ticks;			/* FNs processed since tv_start */
+		int64_t last_us;		/* lateness of the most recent tick */
+		int64_t max_us;
+		int64_t sum_us;			/* for the average over all ticks */
+	} clk;
+};
+
+enum {
+	BTSVIRT_CTR_SCHED_DL_MISS_FN,
+	BTSVIRT_CTR_SCHED_DL_LATE_FN,
 };
 
 struct vbts_l1h {
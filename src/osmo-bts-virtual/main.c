@@ -35,6 +35,8 @@
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/application.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats.h>
 #include <osmocom/vty/telnet_interface.h>
 #include <osmocom/vty/logging.h>
 #include <osmocom/vty/ports.h>
@@ -49,6 +51,24 @@
 #include "virtual_um.h"
 #include "l1_if.h"
 
+static const struct rate_ctr_desc btsvirt_ctr_desc[] = {
+	[BTSVIRT_CTR_SCHED_DL_MISS_FN] = {
+		"virt_clk:sched_dl_miss_fn",
+		"Downlink frames scheduled later than expected due to missed timerfd event (due to high system load)"
+	},
+	[BTSVIRT_CTR_SCHED_DL_LATE_FN] = {
+		"virt_clk:sched_dl_late_fn",
+		"Frame clock ticks processed more than half a frame later than the ideal TDMA clock"
+	},
+};
+static const struct rate_ctr_group_desc btsvirt_ctrg_desc = {
+	"bts-virt",
+	"osmo-bts-virtual specific counters",
+	OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(btsvirt_ctr_desc),
+	btsvirt_ctr_desc
+};
+
 /* dummy, since no direct dsp support */
 uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx)
 {
@@ -58,6 +78,9 @@ uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx)
 int bts_model_init(struct gsm_bts *bts)
 {
 	struct bts_virt_priv *bts_virt = talloc_zero(bts, struct bts_virt_priv);
+	bts_virt->fn_timer_ofd.fd = -1;
+	bts_virt->ctrs = rate_ctr_group_alloc(bts_virt, &btsvirt_ctrg_desc, bts->nr);
+
 	bts->model_priv = bts_virt;
 	bts->variant = BTS_OSMO_VIRTUAL;
 	bts->support.ciphers = CIPHER_A5(1) | CIPHER_A5(2) | CIPHER_A5(3);
@@ -154,6 +177,12 @@ void bts_model_phy_instance_set_defaults(struct phy_instance *pinst)
 	LOGP(DLGLOBAL, LOGL_NOTICE, "Unimplemented %s\n", __func__);
 }
 
+int bts_model_warm_start(struct gsm_bts *bts)
+{
+	LOGP(DLGLOBAL, LOGL_NOTICE, "Unimplemented %s\n", __func__);
+	return -ENOTSUP;
+}
+
 int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 {
 	LOGP(DLGLOBAL, LOGL_NOTICE, "Unimplemented %s\n", __func__);
@@ -1,9 +1,14 @@
+#define _GNU_SOURCE
+#include <errno.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
 #include <netdb.h>
 #include <osmocom/core/socket.h>
 #include <osmocom/core/select.h>
 #include <osmocom/core/osmo_io.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -54,33 +59,88 @@ mcast_server_sock_setup(void *ctx, const char *tx_mcast_group, uint16_t tx_mcast
 	return iofd;
 }
 
-static void mcast_sock_read_cb(struct osmo_io_fd *iofd, int res, struct msgb *msg)
+static struct msgb *mcast_sock_rx_msgb_alloc(void)
 {
-	struct mcast_bidir_sock *bidir_sock = osmo_iofd_get_data(iofd);
-	bidir_sock->read_cb(res, msg, bidir_sock->data);
+	return msgb_alloc_headroom(MCAST_SOCK_RX_MSGB_SIZE + 128, 128, "mcast_sock_rx");
 }
 
-const struct osmo_io_ops clnt_ioops = {
-	.read_cb = mcast_sock_read_cb,
-	/* no write call-back as we don't write to the socket */
-};
+/* receive all pending datagrams with a single recvmmsg() */
+static int mcast_sock_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct mcast_bidir_sock *bidir_sock = ofd->data;
+	struct mmsghdr mmsg[MCAST_SOCK_BATCH_MAX];
+	struct iovec iov[MCAST_SOCK_BATCH_MAX];
+	unsigned int i, num;
+	struct msgb *msg;
+	int rc;
+
+	for (num = 0; num < MCAST_SOCK_BATCH_MAX; num++) {
+		if (!bidir_sock->rx_msg[num]) {
+			bidir_sock->rx_msg[num] = mcast_sock_rx_msgb_alloc();
+			if (!bidir_sock->rx_msg[num])
+				break;
+		}
+		iov[num].iov_base = msgb_data(bidir_sock->rx_msg[num]);
+		iov[num].iov_len = msgb_tailroom(bidir_sock->rx_msg[num]);
+		mmsg[num] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_iov = &iov[num],
+				.msg_iovlen = 1,
+			},
+		};
+	}
+	if (num == 0)
+		return -ENOMEM;
+
+	rc = recvmmsg(ofd->fd, mmsg, num, MSG_DONTWAIT, NULL);
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		/* let the user know that the socket died */
+		bidir_sock->read_cb(-errno, NULL, bidir_sock->data);
+		return 0;
+	}
+
+	bidir_sock->stats.rx_batches++;
+	bidir_sock->stats.rx_msgs += rc;
+
+	for (i = 0; i < rc; i++) {
+		msg = bidir_sock->rx_msg[i];
+		bidir_sock->rx_msg[i] = NULL;
+		if (mmsg[i].msg_hdr.msg_flags & MSG_TRUNC) {
+			msgb_free(msg);
+			continue;
+		}
+		msgb_put(msg, mmsg[i].msg_len);
+		bidir_sock->read_cb(mmsg[i].msg_len, msg, bidir_sock->data);
+	}
+
+	/* keep the unused buffers at the start of the array */
+	for (i = 0, num = 0; i < ARRAY_SIZE(bidir_sock->rx_msg); i++) {
+		if (!bidir_sock->rx_msg[i])
+			continue;
+		msg = bidir_sock->rx_msg[i];
+		bidir_sock->rx_msg[i] = NULL;
+		bidir_sock->rx_msg[num++] = msg;
+	}
+
+	return 0;
+}
 
 /* the client socket is what we use for reception.  It is a UDP socket
  * that's bound to the GSMTAP UDP port and subscribed to the respective
  * multicast group */
-static struct osmo_io_fd *
-mcast_client_sock_setup(void *ctx, const char *mcast_group, uint16_t mcast_port,
-			void (*read_cb)(int rc, struct msgb *msg, void *data))
+static int
+mcast_client_sock_setup(struct mcast_bidir_sock *bidir_sock, const char *mcast_group, uint16_t mcast_port)
 {
 	int rc, fd;
 	unsigned int flags = OSMO_SOCK_F_BIND | OSMO_SOCK_F_NO_MCAST_ALL | OSMO_SOCK_F_UDP_REUSEADDR;
-	struct osmo_io_fd *iofd;
 
 	/* Create mcast client socket */
 	rc = osmo_sock_init(AF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, mcast_port, flags);
 	if (rc < 0) {
 		perror("Could not create mcast client socket");
-		return NULL;
+		return rc;
 	}
 	fd = rc;
 
@@ -89,17 +149,18 @@ mcast_client_sock_setup(void *ctx, const char *mcast_group, uint16_t mcast_port,
 	if (rc < 0) {
 		perror("Failed to join to mcast goup");
 		close(fd);
-		return NULL;
+		return rc;
 	}
 
-	iofd = osmo_iofd_setup(ctx, fd, "mcast_client_sock", OSMO_IO_FD_MODE_READ_WRITE, &clnt_ioops, ctx);
-	if (!iofd) {
+	osmo_fd_setup(&bidir_sock->rx_ofd, fd, OSMO_FD_READ, mcast_sock_read_cb, bidir_sock, 0);
+	rc = osmo_fd_register(&bidir_sock->rx_ofd);
+	if (rc < 0) {
 		close(fd);
-		return NULL;
+		bidir_sock->rx_ofd.fd = -1;
+		return rc;
 	}
 
-	osmo_iofd_register(iofd, -1);
-	return iofd;
+	return 0;
 }
 
 struct mcast_bidir_sock *
@@ -108,7 +169,7 @@ mcast_bidir_sock_setup(void *ctx, const char *tx_mcast_group, uint16_t tx_mcast_
 			void (*read_cb)(int rc, struct msgb *msg, void *data),
 			void *data)
 {
-	struct mcast_bidir_sock *bidir_sock = talloc(ctx, struct mcast_bidir_sock);
+	struct mcast_bidir_sock *bidir_sock = talloc_zero(ctx, struct mcast_bidir_sock);
 
 	if (!bidir_sock)
 		return NULL;
@@ -116,28 +177,92 @@ mcast_bidir_sock_setup(void *ctx, const char *tx_mcast_group, uint16_t tx_mcast_
 	bidir_sock->read_cb = read_cb;
 	bidir_sock->data = data;
 
-	bidir_sock->rx_iofd = mcast_client_sock_setup(bidir_sock, rx_mcast_group, rx_mcast_port, read_cb);
-	if (!bidir_sock->rx_iofd) {
+	if (mcast_client_sock_setup(bidir_sock, rx_mcast_group, rx_mcast_port) < 0) {
 		talloc_free(bidir_sock);
 		return NULL;
 	}
 	bidir_sock->tx_iofd = mcast_server_sock_setup(bidir_sock, tx_mcast_group, tx_mcast_port, loopback);
 	if (!bidir_sock->tx_iofd) {
-		osmo_iofd_free(bidir_sock->rx_iofd);
+		osmo_fd_close(&bidir_sock->rx_ofd);
 		talloc_free(bidir_sock);
 		return NULL;
 	}
 	return bidir_sock;
 }
 
+/*! Queue a datagram for transmission, takes ownership of msg.
+ *  The queue is sent by mcast_bidir_sock_tx_flush(), or as soon as it is full. */
 int mcast_bidir_sock_tx_msg(struct mcast_bidir_sock *bidir_sock, struct msgb *msg)
 {
-	return osmo_iofd_write_msgb(bidir_sock->tx_iofd, msg);
+	int rc = 0;
+
+	if (bidir_sock->tx_num == ARRAY_SIZE(bidir_sock->tx_msg))
+		rc = mcast_bidir_sock_tx_flush(bidir_sock);
+
+	bidir_sock->tx_msg[bidir_sock->tx_num++] = msg;
+	return rc < 0 ? rc : 0;
+}
+
+/*! Send all queued datagrams with a single sendmmsg().
+ *  Whatever the socket does not take right away is handed to the osmo_io
+ *  write queue, which preserves the order of the datagrams.
+ *  \returns number of datagrams sent by sendmmsg(); negative errno on error */
+int mcast_bidir_sock_tx_flush(struct mcast_bidir_sock *bidir_sock)
+{
+	struct mmsghdr mmsg[MCAST_SOCK_BATCH_MAX];
+	struct iovec iov[MCAST_SOCK_BATCH_MAX];
+	unsigned int i, num = bidir_sock->tx_num;
+	int rc = 0, sent = 0;
+
+	if (num == 0)
+		return 0;
+	bidir_sock->tx_num = 0;
+
+	/* do not overtake datagrams still waiting in the osmo_io write queue */
+	if (osmo_iofd_txqueue_len(bidir_sock->tx_iofd) == 0) {
+		for (i = 0; i < num; i++) {
+			iov[i].iov_base = msgb_data(bidir_sock->tx_msg[i]);
+			iov[i].iov_len = msgb_length(bidir_sock->tx_msg[i]);
+			mmsg[i] = (struct mmsghdr) {
+				.msg_hdr = {
+					.msg_iov = &iov[i],
+					.msg_iovlen = 1,
+				},
+			};
+		}
+
+		rc = sendmmsg(osmo_iofd_get_fd(bidir_sock->tx_iofd), mmsg, num, MSG_DONTWAIT);
+		if (rc < 0) {
+			rc = (errno == EAGAIN) ? 0 : -errno;
+		} else {
+			sent = rc;
+			bidir_sock->stats.tx_batches++;
+			bidir_sock->stats.tx_msgs += sent;
+		}
+	}
+
+	for (i = 0; i < sent; i++)
+		msgb_free(bidir_sock->tx_msg[i]);
+	for (i = sent; i < num; i++) {
+		if (rc < 0 || osmo_iofd_write_msgb(bidir_sock->tx_iofd, bidir_sock->tx_msg[i]) < 0)
+			msgb_free(bidir_sock->tx_msg[i]);
+	}
+
+	return rc < 0 ? rc : sent;
 }
 
 void mcast_bidir_sock_close(struct mcast_bidir_sock *bidir_sock)
 {
+	unsigned int i;
+
+	for (i = 0; i < bidir_sock->tx_num; i++)
+		msgb_free(bidir_sock->tx_msg[i]);
+	for (i = 0; i < ARRAY_SIZE(bidir_sock->rx_msg); i++) {
+		if (bidir_sock->rx_msg[i])
+			msgb_free(bidir_sock->rx_msg[i]);
+	}
+
 	osmo_iofd_free(bidir_sock->tx_iofd);
-	osmo_iofd_free(bidir_sock->rx_iofd);
+	osmo_fd_close(&bidir_sock->rx_ofd);
 	talloc_free(bidir_sock);
 }
@@ -6,11 +6,26 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/osmo_io.h>
 
+/* maximum number of datagrams per recvmmsg()/sendmmsg() */
+#define MCAST_SOCK_BATCH_MAX	64
+#define MCAST_SOCK_RX_MSGB_SIZE	1024
+
 struct mcast_bidir_sock {
 	struct osmo_io_fd *tx_iofd;
-	struct osmo_io_fd *rx_iofd;
+	struct osmo_fd rx_ofd;
 	void (*read_cb)(int rc, struct msgb *msg, void *data);
 	void *data;
+
+	/* receive buffers, kept across reads, only the consumed ones are replaced */
+	struct msgb *rx_msg[MCAST_SOCK_BATCH_MAX];
+	/* datagrams queued by mcast_bidir_sock_tx_msg(), sent by mcast_bidir_sock_tx_flush() */
+	struct msgb *tx_msg[MCAST_SOCK_BATCH_MAX];
+	unsigned int tx_num;
+
+	struct {
+		uint64_t rx_msgs, rx_batches;
+		uint64_t tx_msgs, tx_batches;
+	} stats;
 };
 
 struct mcast_bidir_sock *
@@ -20,4 +35,5 @@ mcast_bidir_sock_setup(void *ctx, const char *tx_mcast_group, uint16_t tx_mcast_
 			void *data);
 
 int mcast_bidir_sock_tx_msg(struct mcast_bidir_sock *bidir_sock, struct msgb *msg);
+int mcast_bidir_sock_tx_flush(struct mcast_bidir_sock *bidir_sock);
 void mcast_bidir_sock_close(struct mcast_bidir_sock* bidir_sock);
@@ -25,13 +25,17 @@
 #include <string.h>
 #include <errno.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <ctype.h>
+#include <time.h>
 
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/bits.h>
 #include <osmocom/core/gsmtap_util.h>
 #include <osmocom/core/gsmtap.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/timer_compat.h>
 #include <osmocom/gsm/rsl.h>
 
 #include <osmo-bts/gsm_data.h>
@@ -104,7 +108,7 @@ static void _tx_to_virt_um(struct l1sched_ts *l1ts,
 			       "GSMTAP msg could not send to virtual Um: %s\n", strerror(-rc));
 		else
 			LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br,
-			       "Sending GSMTAP message to virtual Um\n");
+			       "Queued GSMTAP message for virtual Um\n");
 	} else
 		LOGL1SB(DL1P, LOGL_ERROR, l1ts, br, "GSMTAP msg could not be created!\n");
 
@@ -492,63 +496,139 @@ static int vbts_sched_fn(struct gsm_bts *bts, uint32_t fn)
 		}
 	}
 
+	/* send all GSMTAP messages of this FN at once */
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		struct phy_instance *pinst = trx_phy_instance(trx);
+		int rc;
+
+		if (!pinst || !pinst->phy_link->u.virt.virt_um)
+			continue;
+		rc = virt_um_flush(pinst->phy_link->u.virt.virt_um);
+		if (rc < 0)
+			LOGPFN(DL1P, LOGL_ERROR, fn, "GSMTAP msgs could not be sent to virtual Um: %s\n",
+			       strerror(-rc));
+	}
+
 	return 0;
 }
 
-static void vbts_fn_timer_cb(void *data)
+/*! compute the number of micro-seconds difference elapsed between \a last and \a now */
+static inline int64_t compute_elapsed_us(const struct timespec *last, const struct timespec *now)
 {
-	struct gsm_bts *bts = data;
+	struct timespec elapsed;
+
+	timespecsub(now, last, &elapsed);
+	return (int64_t)(elapsed.tv_sec * 1000000) + (elapsed.tv_nsec / 1000);
+}
+
+/* account the lateness of the FN tick just processed against the ideal frame clock,
+ * which is derived from the start time, so that the error does not accumulate */
+static void vbts_clk_account(struct bts_virt_priv *bts_virt, const struct timespec *tv_now)
+{
+	int64_t lateness_us;
+
+	lateness_us = compute_elapsed_us(&bts_virt->clk.tv_start, tv_now)
+		    - (int64_t)(bts_virt->clk.ticks * GSM_TDMA_FN_DURATION_uS);
+
+	bts_virt->clk.last_us = lateness_us;
+	bts_virt->clk.sum_us += lateness_us;
+	if (lateness_us > bts_virt->clk.max_us)
+		bts_virt->clk.max_us = lateness_us;
+	if (lateness_us > GSM_TDMA_FN_DURATION_uS / 2)
+		rate_ctr_inc2(bts_virt->ctrs, BTSVIRT_CTR_SCHED_DL_LATE_FN);
+}
+
+/*! this is the timerfd-callback firing for every FN to be processed */
+static int vbts_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct gsm_bts *bts = ofd->data;
 	struct bts_virt_priv *bts_virt = (struct bts_virt_priv *)bts->model_priv;
-	struct timeval tv_now;
-	struct timeval *tv_clock = &bts_virt->tv_clock;
-	int32_t elapsed_us;
-
-	gettimeofday(&tv_now, NULL);
-
-	/* check how much time elapsed till the last timer callback call.
-	 * this value should be about 4.615 ms (a bit greater) as this is the scheduling interval */
-	elapsed_us = (tv_now.tv_sec - tv_clock->tv_sec) * 1000000
-	                + (tv_now.tv_usec - tv_clock->tv_usec);
-
-	/* not so good somehow a lot of time passed between two timer callbacks */
-	if (elapsed_us > 2 *GSM_TDMA_FN_DURATION_uS)
-		LOGP(DL1P, LOGL_NOTICE, "vbts_fn_timer_cb after %d us\n", elapsed_us);
-
-	/* schedule the current frame/s (fn = frame number)
-	 * this loop will be called at least once, but can also be executed
-	 * multiple times if more than one frame duration (4615us) passed till the last callback */
-	while (elapsed_us > GSM_TDMA_FN_DURATION_uS / 2) {
-		const struct timeval tv_frame = {
-			.tv_sec = 0,
-			.tv_usec = GSM_TDMA_FN_DURATION_uS,
-		};
-		timeradd(tv_clock, &tv_frame, tv_clock);
-		/* increment the frame number in the BTS model instance */
-		vbts_sched_fn(bts, GSM_TDMA_FN_INC(bts_virt->last_fn));
-		elapsed_us -= GSM_TDMA_FN_DURATION_uS;
+	struct timespec tv_now;
+	uint64_t expire_count;
+	int rc, i;
+
+	if (!(what & OSMO_FD_READ))
+		return 0;
+
+	/* read from timerfd: number of expirations of periodic timer */
+	rc = read(ofd->fd, (void *) &expire_count, sizeof(expire_count));
+	if (rc < 0 && errno == EAGAIN)
+		return 0;
+	OSMO_ASSERT(rc == sizeof(expire_count));
+
+	if (expire_count > 1) {
+		LOGP(DL1P, LOGL_NOTICE, "FN timer expire_count=%"PRIu64": We missed %"PRIu64" timers\n",
+		     expire_count, expire_count - 1);
+		rate_ctr_add2(bts_virt->ctrs, BTSVIRT_CTR_SCHED_DL_MISS_FN, expire_count - 1);
 	}
 
-	/* re-schedule the timer */
-	/* timer is set to frame duration - elapsed time to guarantee that this cb method will be
-	 * periodically executed every 4.615ms */
-	osmo_timer_schedule(&bts_virt->fn_timer, 0, GSM_TDMA_FN_DURATION_uS - elapsed_us);
+	/* the timerfd is periodic on CLOCK_MONOTONIC: the ticks do not drift, and
+	 * ticks missed due to load are caught up here rather than being lost */
+	clock_gettime(CLOCK_MONOTONIC, &tv_now);
+	bts_virt->clk.ticks += expire_count;
+	vbts_clk_account(bts_virt, &tv_now);
+
+	for (i = 0; i < expire_count; i++)
+		vbts_sched_fn(bts, GSM_TDMA_FN_INC(bts_virt->last_fn));
+
+	return 0;
+}
+
+/*! virtual time: process one FN per iteration of the select loop, so that
+ *  the Um and Abis sockets are still serviced between two FNs */
+static void vbts_fn_idle_timer_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+	struct bts_virt_priv *bts_virt = (struct bts_virt_priv *)bts->model_priv;
+	struct timespec tv_now;
+
+	clock_gettime(CLOCK_MONOTONIC, &tv_now);
+	bts_virt->clk.ticks++;
+	vbts_clk_account(bts_virt, &tv_now);
+
+	vbts_sched_fn(bts, GSM_TDMA_FN_INC(bts_virt->last_fn));
+
+	osmo_timer_schedule(&bts_virt->fn_idle_timer, 0, 0);
 }
 
 int vbts_sched_start(struct gsm_bts *bts)
 {
 	struct bts_virt_priv *bts_virt = (struct bts_virt_priv *)bts->model_priv;
-	LOGP(DL1P, LOGL_NOTICE, "starting VBTS scheduler\n");
+	const struct timespec interval = { .tv_sec = 0, .tv_nsec = GSM_TDMA_FN_DURATION_nS };
+	struct phy_instance *pinst = trx_phy_instance(bts->c0);
+	int rc;
 
-	if (!bts_virt)
+	if (!bts_virt || !pinst)
 		return -EINVAL;
 
-	memset(&bts_virt->fn_timer, 0, sizeof(bts_virt->fn_timer));
-	bts_virt->fn_timer.cb = vbts_fn_timer_cb;
-	bts_virt->fn_timer.data = bts;
+	LOGP(DL1P, LOGL_NOTICE, "starting VBTS scheduler (%s time)\n",
+	     pinst->phy_link->u.virt.virtual_time ? "virtual" : "real");
+
+	/* we may be restarted after an OML link re-establishment */
+	if (bts_virt->fn_timer_ofd.fd >= 0)
+		osmo_timerfd_disable(&bts_virt->fn_timer_ofd);
+	osmo_timer_del(&bts_virt->fn_idle_timer);
+
+	memset(&bts_virt->clk, 0, sizeof(bts_virt->clk));
+	clock_gettime(CLOCK_MONOTONIC, &bts_virt->clk.tv_start);
+
+	if (pinst->phy_link->u.virt.virtual_time) {
+		osmo_timer_setup(&bts_virt->fn_idle_timer, vbts_fn_idle_timer_cb, bts);
+		osmo_timer_schedule(&bts_virt->fn_idle_timer, 0, 0);
+		return 0;
+	}
 
-	gettimeofday(&bts_virt->tv_clock, NULL);
 	/* trigger the first timer after 4615us (a frame duration) */
-	osmo_timer_schedule(&bts_virt->fn_timer, 0, GSM_TDMA_FN_DURATION_uS);
+	rc = osmo_timerfd_setup(&bts_virt->fn_timer_ofd, vbts_fn_timer_cb, bts);
+	if (rc < 0) {
+		LOGP(DL1P, LOGL_ERROR, "Failed to set up the FN timerfd\n");
+		return rc;
+	}
+	rc = osmo_timerfd_schedule(&bts_virt->fn_timer_ofd, NULL, &interval);
+	if (rc < 0) {
+		LOGP(DL1P, LOGL_ERROR, "Failed to schedule the FN timerfd\n");
+		return rc;
+	}
 
 	return 0;
 }
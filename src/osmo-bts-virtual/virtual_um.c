@@ -30,6 +30,7 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 
 /**
  * Virtual UM interface file descriptor read callback.
@@ -37,7 +38,9 @@
 static void virt_um_read_cb(int rc, struct msgb *msg, void *data)
 {
 	struct virt_um_inst *vui = data;
-	msg->l1h = msg->data;
+
+	if (msg)
+		msg->l1h = msg->data;
 
 	/* call the l1 callback function for a received msg */
 	vui->recv_cb(vui, msg);
@@ -58,6 +61,8 @@ struct virt_um_inst *virt_um_init(void *ctx, char *tx_mcast_group, uint16_t tx_m
 		return NULL;
 	}
 	vui->recv_cb = recv_cb;
+	clock_gettime(CLOCK_MONOTONIC, &vui->tv_start);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &vui->cpu_start);
 
 	/* -1 means default, i.e. no TTL explicitly configured in VTY */
 	if (ttl >= 0) {
@@ -76,7 +81,7 @@ struct virt_um_inst *virt_um_init(void *ctx, char *tx_mcast_group, uint16_t tx_m
 			perror("Cannot bind multicast tx to given device");
 			goto out_close;
 		}
-		int rxfd = osmo_iofd_get_fd(vui->mcast_sock->rx_iofd);
+		int rxfd = vui->mcast_sock->rx_ofd.fd;
 		rc = osmo_sock_mcast_iface_set(rxfd, dev_name);
 		if (rc < 0) {
 			perror("Cannot bind multicast rx to given device");
@@ -99,17 +104,17 @@ void virt_um_destroy(struct virt_um_inst *vui)
 }
 
 /**
- * Write msg to to multicast socket and free msg afterwards
+ * Queue msg for the multicast socket, it is sent and freed by virt_um_flush()
  */
 int virt_um_write_msg(struct virt_um_inst *vui, struct msgb *msg)
 {
-	int rc;
-
-	rc = mcast_bidir_sock_tx_msg(vui->mcast_sock, msg);
-	if (rc < 0) {
-		msgb_free(msg);
-		rc = -errno;
-	}
+	return mcast_bidir_sock_tx_msg(vui->mcast_sock, msg);
+}
 
-	return rc;
+/**
+ * Send all queued messages at once, called at the end of each FN
+ */
+int virt_um_flush(struct virt_um_inst *vui)
+{
+	return mcast_bidir_sock_tx_flush(vui->mcast_sock);
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <time.h>
+
 #include <osmocom/core/select.h>
 #include <osmocom/core/msgb.h>
 #include "osmo_mcast_sock.h"
@@ -19,6 +21,9 @@ struct virt_um_inst {
 	void *priv;
 	struct mcast_bidir_sock *mcast_sock;
 	void (*recv_cb)(struct virt_um_inst *vui, struct msgb *msg);
+	/* start of the measurement for the frames per second statistics */
+	struct timespec tv_start;
+	struct timespec cpu_start;
 };
 
 struct virt_um_inst *virt_um_init(
@@ -29,3 +34,4 @@ struct virt_um_inst *virt_um_init(
 void virt_um_destroy(struct virt_um_inst *vui);
 
 int virt_um_write_msg(struct virt_um_inst *vui, struct msgb *msg);
+int virt_um_flush(struct virt_um_inst *vui);
@@ -23,7 +23,9 @@
 #include <unistd.h>
 #include <errno.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <ctype.h>
+#include <time.h>
 
 #include <arpa/inet.h>
 
@@ -39,10 +41,12 @@
 #include <osmocom/vty/misc.h>
 
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts.h>
 #include <osmo-bts/phy_link.h>
 #include <osmo-bts/logging.h>
 #include <osmo-bts/vty.h>
 #include "virtual_um.h"
+#include "l1_if.h"
 
 #define TRX_STR "Transceiver related commands\n" "TRX number\n"
 
@@ -82,6 +86,8 @@ void bts_model_config_write_phy(struct vty *vty, const struct phy_link *plink)
 	if (plink->u.virt.bts_mcast_port != DEFAULT_MS_MCAST_PORT)
 		vty_out(vty, " virtual-um bts-udp-port %u%s",
 			plink->u.virt.bts_mcast_port, VTY_NEWLINE);
+	if (plink->u.virt.virtual_time)
+		vty_out(vty, " virtual-um clock virtual%s", VTY_NEWLINE);
 
 }
 
@@ -189,6 +195,99 @@ DEFUN(cfg_phy_mcast_ttl, cfg_phy_mcast_ttl_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_phy_clock, cfg_phy_clock_cmd,
+	"virtual-um clock (realtime|virtual)",
+	VUM_STR "Configure the source of the TDMA frame clock\n"
+	"Advance one FN every 4.615 ms (default)\n"
+	"Advance FNs as fast as possible, for benchmarking and testing\n")
+{
+	struct phy_link *plink = vty->index;
+
+	if (plink->state != PHY_LINK_SHUTDOWN) {
+		vty_out(vty, "Can only reconfigure a PHY link that is down%s",
+			VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	plink->u.virt.virtual_time = !strcmp(argv[0], "virtual");
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_clock, show_clock_cmd,
+	"show virtual-um clock",
+	SHOW_STR VUM_STR "Display the lateness of the TDMA frame clock\n")
+{
+	struct gsm_bts *bts;
+
+	llist_for_each_entry(bts, &g_bts_sm->bts_list, list) {
+		const struct bts_virt_priv *bts_virt = bts->model_priv;
+		struct phy_instance *pinst = trx_phy_instance(bts->c0);
+
+		vty_out(vty, "BTS %u: %s time, %"PRIu64" FNs processed%s", bts->nr,
+			pinst && pinst->phy_link->u.virt.virtual_time ? "virtual" : "real",
+			bts_virt->clk.ticks, VTY_NEWLINE);
+		if (bts_virt->clk.ticks == 0)
+			continue;
+		vty_out(vty, " lateness: last %"PRId64" us, max %"PRId64" us, avg %"PRId64" us%s",
+			bts_virt->clk.last_us, bts_virt->clk.max_us,
+			bts_virt->clk.sum_us / (int64_t)bts_virt->clk.ticks, VTY_NEWLINE);
+	}
+
+	return CMD_SUCCESS;
+}
+
+static double timespec_elapsed_s(clockid_t clk, const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(clk, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void show_stats_single(struct vty *vty, const struct phy_link *plink)
+{
+	const struct virt_um_inst *vui = plink->u.virt.virt_um;
+	const struct mcast_bidir_sock *sock;
+	double wall_s, cpu_s;
+
+	vty_out(vty, "PHY %u%s", plink->num, VTY_NEWLINE);
+	if (!vui) {
+		vty_out(vty, " virtual Um not open%s", VTY_NEWLINE);
+		return;
+	}
+	sock = vui->mcast_sock;
+
+	vty_out(vty, " tx: %"PRIu64" msgs in %"PRIu64" sendmmsg() calls%s",
+		sock->stats.tx_msgs, sock->stats.tx_batches, VTY_NEWLINE);
+	vty_out(vty, " rx: %"PRIu64" msgs in %"PRIu64" recvmmsg() calls%s",
+		sock->stats.rx_msgs, sock->stats.rx_batches, VTY_NEWLINE);
+
+	/* the process is single threaded: per CPU second is per core */
+	wall_s = timespec_elapsed_s(CLOCK_MONOTONIC, &vui->tv_start);
+	cpu_s = timespec_elapsed_s(CLOCK_PROCESS_CPUTIME_ID, &vui->cpu_start);
+	if (wall_s > 0 && cpu_s > 0)
+		vty_out(vty, " frames/s: %.0f, frames per CPU second: %.0f%s",
+			(sock->stats.tx_msgs + sock->stats.rx_msgs) / wall_s,
+			(sock->stats.tx_msgs + sock->stats.rx_msgs) / cpu_s, VTY_NEWLINE);
+}
+
+DEFUN(show_stats, show_stats_cmd,
+	"show virtual-um stats",
+	SHOW_STR VUM_STR "Display the GSMTAP throughput of the virtual Um\n")
+{
+	int i;
+
+	for (i = 0; i < 255; i++) {
+		struct phy_link *plink = phy_link_by_num(i);
+		if (!plink)
+			break;
+		show_stats_single(vty, plink);
+	}
+
+	return CMD_SUCCESS;
+}
+
 int bts_model_vty_init(void *ctx)
 {
 	install_element(PHY_NODE, &cfg_phy_ms_mcast_group_cmd);
@@ -197,6 +296,10 @@ int bts_model_vty_init(void *ctx)
 	install_element(PHY_NODE, &cfg_phy_bts_mcast_port_cmd);
 	install_element(PHY_NODE, &cfg_phy_mcast_dev_cmd);
 	install_element(PHY_NODE, &cfg_phy_mcast_ttl_cmd);
+	install_element(PHY_NODE, &cfg_phy_clock_cmd);
+
+	install_element_ve(&show_clock_cmd);
+	install_element_ve(&show_stats_cmd);
 
 	return 0;
 }
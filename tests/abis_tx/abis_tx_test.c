@@ -0,0 +1,276 @@
+/* testing the coalesced transmission of Abis signalling messages */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/abis/abis.h>
+#include <osmocom/abis/e1_input.h>
+#include <osmocom/gsm/protocol/ipaccess.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/abis_tx.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+#define NUM_MSGS	2000
+#define MSG_LEN		200
+#define IPA_HDR_LEN	3
+
+static struct gsm_bts *bts;
+static struct abis_tx_queue *q;
+static struct e1inp_ts sign_ts;
+static struct e1inp_sign_link sign_link;
+static int sv[2];
+
+/* what libosmo-abis got to send, without coalescing */
+static unsigned int num_abis_sendmsg;
+static unsigned int last_abis_sendmsg_len;
+
+int abis_sendmsg(struct msgb *msg)
+{
+	num_abis_sendmsg++;
+	last_abis_sendmsg_len = msgb_length(msg);
+	msgb_free(msg);
+	return 0;
+}
+
+/* the osmo_fd callback of libosmo-abis */
+static unsigned int num_ipa_fd_cb;
+
+static int ipa_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	num_ipa_fd_cb++;
+	return 0;
+}
+
+static void send_msg(unsigned int len, uint8_t seq)
+{
+	struct msgb *msg = msgb_alloc_headroom(len + 16, 16, __func__);
+
+	memset(msgb_put(msg, len), seq, len);
+	msg->dst = &sign_link;
+	ASSERT_TRUE(abis_tx_queue_send(q, msg) == 0);
+}
+
+/* read whatever the other end of the connection got */
+static size_t read_all(uint8_t *buf, size_t size)
+{
+	size_t len = 0;
+	ssize_t rc;
+
+	while (len < size && (rc = read(sv[1], buf + len, size - len)) > 0)
+		len += rc;
+	return len;
+}
+
+/* The socket takes only part of a batch, cutting through a message: the rest
+ * of it must be written first on the next attempt */
+static void test_partial_write(void)
+{
+	static uint8_t buf[NUM_MSGS * (IPA_HDR_LEN + MSG_LEN)];
+	unsigned int i, num_partial = 0;
+	size_t len = 0;
+	bool intact = true;
+
+	printf("\n%s()\n", __func__);
+
+	bts->abis_tx_coalesce_ms = 0;
+	for (i = 0; i < NUM_MSGS; i++)
+		send_msg(MSG_LEN, i & 0xff);
+
+	while (q->num_msgs > 0) {
+		struct msgb *first;
+
+		abis_tx_queue_flush(q);
+		first = llist_first_entry_or_null(&q->msgs, struct msgb, list);
+		if (first && msgb_length(first) != IPA_HDR_LEN + MSG_LEN)
+			num_partial++;
+		len += read_all(buf + len, sizeof(buf) - len);
+	}
+	len += read_all(buf + len, sizeof(buf) - len);
+
+	for (i = 0; i < NUM_MSGS; i++) {
+		const uint8_t *hdr = &buf[i * (IPA_HDR_LEN + MSG_LEN)];
+
+		if (hdr[0] != 0 || hdr[1] != MSG_LEN || hdr[2] != sign_link.tei
+		    || hdr[IPA_HDR_LEN] != (i & 0xff) || hdr[IPA_HDR_LEN + MSG_LEN - 1] != (i & 0xff))
+			intact = false;
+	}
+
+	printf("received %zu bytes, %s\n", len, intact ? "intact and in order" : "CORRUPTED");
+	printf("message cut by a partial write: %s\n", num_partial > 0 ? "yes" : "no");
+	ASSERT_TRUE(!osmo_timer_pending(&q->flush_timer));
+}
+
+/* libosmo-abis still has messages of its own to write, the queued ones must
+ * go after them */
+static void test_ordering_guard(void)
+{
+	uint8_t buf[64];
+	struct msgb *busy = msgb_alloc(16, __func__);
+
+	printf("\n%s()\n", __func__);
+
+	bts->abis_tx_coalesce_ms = 0;
+	num_abis_sendmsg = 0;
+	send_msg(5, 0x11);
+	msgb_enqueue(&sign_link.tx_list, busy);
+	abis_tx_queue_flush(q);
+	printf("libosmo-abis busy: %u queued, %u sent by libosmo-abis (%u bytes), %zu bytes written\n",
+	       q->num_msgs, num_abis_sendmsg, last_abis_sendmsg_len, read_all(buf, sizeof(buf)));
+	send_msg(5, 0x12);
+	printf("libosmo-abis still busy: %u queued, %u sent by libosmo-abis\n",
+	       q->num_msgs, num_abis_sendmsg);
+
+	msgb_free(msgb_dequeue(&sign_link.tx_list));
+	send_msg(5, 0x13);
+	abis_tx_queue_flush(q);
+	printf("libosmo-abis idle: %u queued, %zu bytes written\n", q->num_msgs,
+	       read_all(buf, sizeof(buf)));
+	num_abis_sendmsg = 0;
+}
+
+/* 'no abis-tx-coalesce' while messages are queued: these are written first */
+static void test_disable_drain(void)
+{
+	uint8_t buf[64];
+	size_t len;
+
+	printf("\n%s()\n", __func__);
+
+	bts->abis_tx_coalesce_ms = 0;
+	send_msg(1, 0x21);
+	send_msg(1, 0x22);
+	bts->abis_tx_coalesce_ms = -1;
+	send_msg(1, 0x23);
+	printf("disabled: %u queued, %u sent by libosmo-abis\n", q->num_msgs, num_abis_sendmsg);
+
+	abis_tx_queue_flush(q);
+	len = read_all(buf, sizeof(buf));
+	printf("flushed: %u queued, %zu bytes written: %02x %02x %02x\n", q->num_msgs, len,
+	       buf[IPA_HDR_LEN], buf[2 * IPA_HDR_LEN + 1], buf[3 * IPA_HDR_LEN + 2]);
+
+	send_msg(1, 0x24);
+	printf("drained: %u queued, %u sent by libosmo-abis\n", q->num_msgs, num_abis_sendmsg);
+}
+
+/* Waiting for the socket, the queue owns the osmo_fd of libosmo-abis, which
+ * must not read (and answer an IPA CCM) in the middle of a message */
+static void test_fd_ownership(void)
+{
+	static uint8_t buf[ABIS_TX_BATCH_MAX * (IPA_HDR_LEN + MSG_LEN)];
+	struct osmo_fd *ofd = &sign_ts.driver.ipaccess.fd;
+	unsigned int i, num_events = 0;
+	size_t len = 0;
+
+	printf("\n%s()\n", __func__);
+
+	bts->abis_tx_coalesce_ms = 0;
+	num_ipa_fd_cb = 0;
+	/* a full batch is written right away */
+	for (i = 0; i < ABIS_TX_BATCH_MAX; i++)
+		send_msg(MSG_LEN, i);
+	printf("socket full: %s, fd %s, read %s, write %s\n",
+	       q->partial ? "message cut" : "no message cut",
+	       ofd->cb == ipa_fd_cb ? "not owned" : "owned",
+	       ofd->when & OSMO_FD_READ ? "enabled" : "disabled",
+	       ofd->when & OSMO_FD_WRITE ? "enabled" : "disabled");
+
+	ofd->cb(ofd, OSMO_FD_READ);
+	printf("read events passed on: %u\n", num_ipa_fd_cb);
+
+	while (q->num_msgs > 0) {
+		len += read_all(buf + len, sizeof(buf) - len);
+		ofd->cb(ofd, OSMO_FD_WRITE);
+		ASSERT_TRUE(++num_events < 1000);
+	}
+	len += read_all(buf + len, sizeof(buf) - len);
+	printf("written on write readiness: %zu bytes, fd %s, read %s, write %s\n", len,
+	       ofd->cb == ipa_fd_cb ? "not owned" : "owned",
+	       ofd->when & OSMO_FD_READ ? "enabled" : "disabled",
+	       ofd->when & OSMO_FD_WRITE ? "enabled" : "disabled");
+	ASSERT_TRUE(!osmo_timer_pending(&q->flush_timer));
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_bts_ctx;
+	int sndbuf = 4096;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+
+	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
+	ASSERT_TRUE(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	ASSERT_TRUE(bts != NULL);
+	ASSERT_TRUE(bts_init(bts) == 0);
+
+	/* an IPA connection with the OML link on it */
+	ASSERT_TRUE(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	ASSERT_TRUE(fcntl(sv[0], F_SETFL, O_NONBLOCK) == 0);
+	ASSERT_TRUE(fcntl(sv[1], F_SETFL, O_NONBLOCK) == 0);
+	ASSERT_TRUE(setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) == 0);
+
+	sign_ts.driver.ipaccess.fd.fd = sv[0];
+	sign_ts.driver.ipaccess.fd.cb = ipa_fd_cb;
+	sign_ts.driver.ipaccess.fd.when = OSMO_FD_READ;
+	INIT_LLIST_HEAD(&sign_ts.sign.sign_links);
+	sign_link.ts = &sign_ts;
+	sign_link.tei = IPAC_PROTO_OML;
+	INIT_LLIST_HEAD(&sign_link.tx_list);
+	llist_add_tail(&sign_link.list, &sign_ts.sign.sign_links);
+
+	bts->oml_link = &sign_link;
+	q = &bts->oml_tx_queue;
+
+	test_partial_write();
+	test_ordering_guard();
+	test_disable_drain();
+	test_fd_ownership();
+
+	bts->oml_link = NULL;
+	close(sv[0]);
+	close(sv[1]);
+
+	printf("Success\n");
+
+	return 0;
+}
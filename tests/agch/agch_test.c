@@ -189,6 +189,158 @@ static void test_agch_queue(void)
 	       bts->agch_queue.pch_msgs);
 }
 
+static void test_agch_queue_priority(void)
+{
+	static const char *class_name[] = { "CS", "PS", "REJ" };
+	static const int classes[] = { BTS_AGCH_CLASS_REJ, BTS_AGCH_CLASS_PS, BTS_AGCH_CLASS_CS,
+				       BTS_AGCH_CLASS_REJ, BTS_AGCH_CLASS_PS, BTS_AGCH_CLASS_CS };
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	struct msgb *msg;
+	int idx, rc;
+
+	g_time.fn = 0;
+	g_time.t1 = 0;
+	g_time.t2 = 0;
+	g_time.t3 = 6;
+
+	printf("Testing AGCH messages queue priorities.\n");
+	bts->agch_queue.thresh_level = GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DISABLE;
+
+	for (idx = 0; idx < ARRAY_SIZE(classes); idx++) {
+		msg = msgb_alloc(GSM_MACBLOCK_LEN, __func__);
+		if (classes[idx] == BTS_AGCH_CLASS_REJ) {
+			put_imm_ass_rej(msg, idx, 10);
+		} else {
+			put_imm_ass(msg, idx);
+			((struct bts_agch_msg_cb *) msg->cb)->is_ps = (classes[idx] == BTS_AGCH_CLASS_PS);
+		}
+		bts_agch_enqueue(bts, msg);
+	}
+
+	printf("AGCH filled: occupied %d, merged %"PRIu64"\n",
+	       bts->agch_queue.length, bts->agch_queue.merged_msgs);
+
+	while (1) {
+		struct gsm48_imm_ass *ima = (struct gsm48_imm_ass *)out_buf;
+
+		rc = bts_ccch_copy_msg(bts, out_buf, &g_time, CCCH_MSGT_AGCH);
+		if (rc <= 0)
+			break;
+		if (ima->msg_type == GSM48_MT_RR_IMM_ASS_REJ)
+			printf("Dequeued %s, refs %d\n", class_name[BTS_AGCH_CLASS_REJ],
+			       count_imm_ass_rej_refs((struct gsm48_imm_ass_rej *)ima));
+		else
+			printf("Dequeued %s, t1 %u\n", class_name[classes[ima->req_ref.t1]],
+			       ima->req_ref.t1);
+	}
+}
+
+/* A steady stream of assignments must not starve the rejects */
+static void test_agch_queue_fairness(void)
+{
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	struct msgb *msg;
+	int idx, rc;
+
+	g_time.fn = 0;
+	g_time.t1 = 0;
+	g_time.t2 = 0;
+	g_time.t3 = 6;
+
+	printf("Testing AGCH messages queue fairness.\n");
+	bts->agch_queue.thresh_level = GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DISABLE;
+
+	for (idx = 0; idx < 12; idx++) {
+		msg = msgb_alloc(GSM_MACBLOCK_LEN, __func__);
+		put_imm_ass(msg, idx);
+		bts_agch_enqueue(bts, msg);
+	}
+	/* merged into 3 messages */
+	for (idx = 0; idx < 12; idx++) {
+		msg = msgb_alloc(GSM_MACBLOCK_LEN, __func__);
+		put_imm_ass_rej(msg, idx, 10);
+		bts_agch_enqueue(bts, msg);
+	}
+
+	printf("AGCH filled: occupied %d\n", bts->agch_queue.length);
+
+	printf("Dequeued:");
+	while (1) {
+		struct gsm48_imm_ass *ima = (struct gsm48_imm_ass *)out_buf;
+
+		rc = bts_ccch_copy_msg(bts, out_buf, &g_time, CCCH_MSGT_AGCH);
+		if (rc <= 0)
+			break;
+		printf(" %s", ima->msg_type == GSM48_MT_RR_IMM_ASS_REJ ? "REJ" : "CS");
+	}
+	printf("\n");
+}
+
+/* Under overload, the rejects must keep their share of the AGCH instead of
+ * being dropped before anything else */
+static void test_agch_queue_red_fairness(void)
+{
+	static const char *class_name[] = { "CS", "PS", "REJ" };
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	int sent[_NUM_BTS_AGCH_CLASS] = { 0 };
+	int rej_ref_count = 0;
+	uint64_t dropped = bts->agch_queue.dropped_msgs;
+	struct gsm_time g_time;
+	struct msgb *msg;
+	int block, idx, c;
+	int rc = 0;
+
+	g_time.fn = 0;
+	g_time.t1 = 0;
+	g_time.t2 = 0;
+	g_time.t3 = 6;
+
+	printf("Testing AGCH messages queue fairness under overload.\n");
+	bts->agch_queue.max_length = 32;
+
+	bts->agch_queue.low_level = 30;
+	bts->agch_queue.high_level = 30;
+	bts->agch_queue.thresh_level = 60;
+
+	/* three messages arrive per CCCH block, only one can be sent */
+	for (block = 0; block < 60 || rc > 0; block++) {
+		struct gsm48_imm_ass *ima = (struct gsm48_imm_ass *)out_buf;
+
+		if (block < 60) {
+			for (c = BTS_AGCH_CLASS_CS; c <= BTS_AGCH_CLASS_PS; c++) {
+				msg = msgb_alloc(GSM_MACBLOCK_LEN, __func__);
+				put_imm_ass(msg, c);
+				((struct bts_agch_msg_cb *) msg->cb)->is_ps = (c == BTS_AGCH_CLASS_PS);
+				bts_agch_enqueue(bts, msg);
+			}
+			/* merged into one message */
+			for (idx = 0; idx < 4; idx++) {
+				msg = msgb_alloc(GSM_MACBLOCK_LEN, __func__);
+				put_imm_ass_rej(msg, (block * 4 + idx) % 32, 10);
+				bts_agch_enqueue(bts, msg);
+			}
+		}
+
+		rc = bts_ccch_copy_msg(bts, out_buf, &g_time, CCCH_MSGT_AGCH);
+		if (rc <= 0)
+			continue;
+		if (ima->msg_type == GSM48_MT_RR_IMM_ASS_REJ) {
+			sent[BTS_AGCH_CLASS_REJ]++;
+			rej_ref_count += count_imm_ass_rej_refs((struct gsm48_imm_ass_rej *)ima);
+		} else {
+			sent[ima->req_ref.t1]++;
+		}
+	}
+
+	printf("AGCH drained: blocks %d, %s %d, %s %d, %s %d (refs %d), dropped %"PRIu64"\n",
+	       block, class_name[BTS_AGCH_CLASS_CS], sent[BTS_AGCH_CLASS_CS],
+	       class_name[BTS_AGCH_CLASS_PS], sent[BTS_AGCH_CLASS_PS],
+	       class_name[BTS_AGCH_CLASS_REJ], sent[BTS_AGCH_CLASS_REJ], rej_ref_count,
+	       bts->agch_queue.dropped_msgs - dropped);
+}
+
 static void test_agch_queue_length_computation(void)
 {
 	static const int ccch_configs[] = {
@@ -235,6 +387,9 @@ int main(int argc, char **argv)
 
 	test_agch_queue_length_computation();
 	test_agch_queue();
+	test_agch_queue_priority();
+	test_agch_queue_fairness();
+	test_agch_queue_red_fairness();
 	printf("Success\n");
 
 	return 0;
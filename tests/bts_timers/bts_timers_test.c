@@ -0,0 +1,134 @@
+/* testing the timers of co-located BTSs configured from the config file */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/tdef.h>
+#include <osmocom/vty/vty.h>
+#include <osmocom/vty/command.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/vty.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+#define CFG_PATH	"bts_timers_test.cfg"
+
+/* 'timer bts' on the config node sits between the two BTS nodes, so that
+ * allocating BTS 1 would have reset it with a shared set of timers */
+static const char *cfg =
+	"bts 0\n"
+	" timer X1 10\n"
+	"timer bts X2 9\n"
+	"bts 1\n"
+	" timer X1 20\n";
+
+int bts_model_vty_init(void *ctx) { return 0; }
+void bts_model_config_write_bts(struct vty *vty, const struct gsm_bts *bts) { }
+void bts_model_config_write_trx(struct vty *vty, const struct gsm_bts_trx *trx) { }
+void bts_model_config_write_phy(struct vty *vty, const struct phy_link *plink) { }
+void bts_model_config_write_phy_inst(struct vty *vty, const struct phy_instance *pinst) { }
+
+static void write_file(const char *path, const char *str)
+{
+	FILE *f = fopen(path, "w");
+
+	ASSERT_TRUE(f != NULL);
+	ASSERT_TRUE(fputs(str, f) >= 0);
+	ASSERT_TRUE(fclose(f) == 0);
+}
+
+static void print_timers(const struct gsm_bts *bts)
+{
+	printf("bts %u: X1 = %lu s, X2 = %lu s\n", bts->nr,
+	       osmo_tdef_get(bts->T_defs, -1, OSMO_TDEF_S, -1),
+	       osmo_tdef_get(bts->T_defs, -2, OSMO_TDEF_S, -1));
+}
+
+static void test_read_config(void)
+{
+	printf("Testing reading the timers of two BTS\n");
+
+	write_file(CFG_PATH, cfg);
+	ASSERT_TRUE(vty_read_config_file(CFG_PATH, NULL) == 0);
+	ASSERT_TRUE(g_bts_sm->num_bts == 2);
+
+	print_timers(gsm_bts_num(g_bts_sm, 0));
+	print_timers(gsm_bts_num(g_bts_sm, 1));
+}
+
+static void test_write_config(void)
+{
+	char line[256];
+	FILE *f;
+
+	printf("Testing writing the timers of two BTS\n");
+
+	ASSERT_TRUE(osmo_vty_write_config_file(CFG_PATH) == 0);
+
+	f = fopen(CFG_PATH, "r");
+	ASSERT_TRUE(f != NULL);
+	while (fgets(line, sizeof(line), f)) {
+		if (strstr(line, "bts ") == line || strstr(line, "timer"))
+			printf("%s", line);
+	}
+	fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	struct gsm_bts *bts;
+
+	msgb_talloc_ctx_init(ctx, 0);
+	osmo_init_logging2(ctx, &bts_log_info);
+	bts_vty_info.tall_ctx = ctx;
+	vty_init(&bts_vty_info);
+	bts_vty_init(ctx);
+
+	g_bts_sm = gsm_bts_sm_alloc(ctx);
+	ASSERT_TRUE(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	ASSERT_TRUE(bts != NULL);
+	ASSERT_TRUE(bts_init(bts) == 0);
+
+	test_read_config();
+	test_write_config();
+
+	unlink(CFG_PATH);
+	printf("Success\n");
+
+	return 0;
+}
@@ -0,0 +1,316 @@
+/* comparing the table driven V.110 RA1/RA2 conversion against libosmocore */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm44021.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/isdn/v110.h>
+#include <osmocom/trau/csd_ra2.h>
+
+#include <osmo-bts/csd_v110.h>
+#include <osmo-bts/lchan.h>
+
+#define NUM_ROUNDS	500
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+struct test_case {
+	const char *name;
+	enum gsm48_chan_mode tch_mode;
+	enum lchan_csd_mode csd_mode;
+};
+
+static const struct test_case tests[] = {
+	{ "TCH/F9.6",		GSM48_CMODE_DATA_12k0,	LCHAN_CSD_M_T_9600 },
+	{ "TCH/F9.6 NT",	GSM48_CMODE_DATA_12k0,	LCHAN_CSD_M_NT },
+	{ "TCH/[FH]4.8",	GSM48_CMODE_DATA_6k0,	LCHAN_CSD_M_T_4800 },
+	{ "TCH/[FH]4.8 NT",	GSM48_CMODE_DATA_6k0,	LCHAN_CSD_M_NT },
+	{ "TCH/[FH]2.4",	GSM48_CMODE_DATA_3k6,	LCHAN_CSD_M_T_2400 },
+	{ "TCH/[FH]2.4 600",	GSM48_CMODE_DATA_3k6,	LCHAN_CSD_M_T_600 },
+	{ "TCH/F14.4",		GSM48_CMODE_DATA_14k5,	LCHAN_CSD_M_T_14400 },
+};
+
+/* 3GPP TS 44.021, Figure 4: Coding of data rates (E1/E2/E3 bits) */
+static const uint8_t e1e2e3_map[_LCHAN_CSD_M_NUM][3] = {
+	[LCHAN_CSD_M_T_600]	= { 1, 0, 0 },
+	[LCHAN_CSD_M_T_1200]	= { 0, 1, 0 },
+	[LCHAN_CSD_M_T_2400]	= { 1, 1, 0 },
+	[LCHAN_CSD_M_T_4800]	= { 0, 1, 1 },
+	[LCHAN_CSD_M_T_9600]	= { 0, 1, 1 },
+};
+
+/* csd_v110_rtp_encode() as it used to be, frame by frame through libosmocore */
+static int ref_rtp_encode(const struct gsm_lchan *lchan, uint8_t *rtp,
+			  const uint8_t *data, size_t data_len,
+			  uint8_t nt48_half_num)
+{
+	const struct csd_v110_lchan_desc *desc = &csd_v110_lchan_desc[lchan->tch_mode];
+	ubit_t ra_bits[80 * 4];
+
+	if (lchan->tch_mode == GSM48_CMODE_DATA_14k5) {
+		osmo_csd144_to_atrau_bits(&ra_bits[0], &data[0], &data[2], 1, 0);
+		goto ra1_ra2;
+	}
+
+	if (data_len < CSD_V110_NUM_BITS(desc)) {
+		memset(&ra_bits[0], 0x01, sizeof(ra_bits));
+		for (unsigned int i = 0; i < desc->num_frames; i++)
+			memset(&ra_bits[i * 80], 0x00, 8);
+		goto ra1_ra2;
+	}
+
+	for (unsigned int i = 0; i < desc->num_frames; i++) {
+		struct osmo_v110_decoded_frame df;
+
+		if (desc->num_frame_bits == 60)
+			osmo_csd_12k_6k_decode_frame(&df, &data[i * 60], 60);
+		else
+			osmo_csd_3k6_decode_frame(&df, &data[i * 36], 36);
+
+		if (lchan->csd_mode == LCHAN_CSD_M_NT) {
+			df.e_bits[0] = 0;
+			if (desc->num_frames == 4)
+				df.e_bits[1] = (i >> 1) & 0x01;
+			else
+				df.e_bits[1] = nt48_half_num;
+			df.e_bits[2] = (i >> 0) & 0x01;
+		} else {
+			df.e_bits[0] = e1e2e3_map[lchan->csd_mode][0];
+			df.e_bits[1] = e1e2e3_map[lchan->csd_mode][1];
+			df.e_bits[2] = e1e2e3_map[lchan->csd_mode][2];
+		}
+
+		osmo_v110_encode_frame(&ra_bits[i * 80], 80, &df);
+	}
+
+ra1_ra2:
+	if (desc->ra2_ir == 16)
+		osmo_csd_ra2_16k_pack(&rtp[0], &ra_bits[0], RFC4040_RTP_PLEN);
+	else
+		osmo_csd_ra2_8k_pack(&rtp[0], &ra_bits[0], RFC4040_RTP_PLEN);
+
+	return RFC4040_RTP_PLEN;
+}
+
+static bool ref_check_v110_align(const ubit_t *ra_bits)
+{
+	ubit_t bit0 = 0, bit1 = 1;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		bit0 |= ra_bits[i];
+	for (i = 1; i < 10; i++)
+		bit1 &= ra_bits[i * 8];
+	return (bit0 == 0) && (bit1 == 1);
+}
+
+/* csd_v110_rtp_decode() as it used to be */
+static int ref_rtp_decode(const struct gsm_lchan *lchan, uint8_t *data,
+			  uint8_t *align_bits, const uint8_t *rtp, size_t rtp_len)
+{
+	const struct csd_v110_lchan_desc *desc = &csd_v110_lchan_desc[lchan->tch_mode];
+	ubit_t ra_bits[80 * 4];
+	uint8_t align_accum = 0;
+
+	if (desc->ra2_ir == 16)
+		osmo_csd_ra2_16k_unpack(&ra_bits[0], &rtp[0], RFC4040_RTP_PLEN);
+	else
+		osmo_csd_ra2_8k_unpack(&ra_bits[0], &rtp[0], RFC4040_RTP_PLEN);
+
+	if (lchan->tch_mode == GSM48_CMODE_DATA_14k5) {
+		int rc = osmo_csd144_from_atrau_bits(&data[0], &data[2], NULL, NULL, &ra_bits[0]);
+		return rc == 0 ? CSD_V110_NUM_BITS(desc) : rc;
+	}
+
+	for (unsigned int i = 0; i < desc->num_frames; i++) {
+		struct osmo_v110_decoded_frame df;
+
+		if (!ref_check_v110_align(&ra_bits[i * 80]))
+			return -EINVAL;
+		osmo_v110_decode_frame(&df, &ra_bits[i * 80], 80);
+		if (desc->num_frame_bits == 60)
+			osmo_csd_12k_6k_encode_frame(&data[i * 60], 60, &df);
+		else
+			osmo_csd_3k6_encode_frame(&data[i * 36], 36, &df);
+		align_accum <<= 2;
+		align_accum |= df.e_bits[1] << 1;
+		align_accum |= df.e_bits[2] << 0;
+	}
+
+	if (align_bits)
+		*align_bits = align_accum;
+	return CSD_V110_NUM_BITS(desc);
+}
+
+static unsigned int rand_state = 1;
+
+static unsigned int test_rand(void)
+{
+	/* deterministic across platforms, unlike rand() */
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 16) & 0x7fff;
+}
+
+static void random_bits(ubit_t *bits, unsigned int num)
+{
+	for (unsigned int i = 0; i < num; i++)
+		bits[i] = test_rand() & 0x01;
+}
+
+static void test_encode(const struct test_case *tc, const struct gsm_lchan *lchan)
+{
+	const struct csd_v110_lchan_desc *desc = &csd_v110_lchan_desc[tc->tch_mode];
+	const unsigned int bit_num = CSD_V110_NUM_BITS(desc);
+	uint8_t rtp[RFC4040_RTP_PLEN], ref_rtp[RFC4040_RTP_PLEN];
+	ubit_t data[290];
+	unsigned int r;
+
+	for (r = 0; r < NUM_ROUNDS; r++) {
+		random_bits(&data[0], bit_num);
+		ASSERT_TRUE(csd_v110_rtp_encode(lchan, rtp, data, bit_num, r & 1) == RFC4040_RTP_PLEN);
+		ASSERT_TRUE(ref_rtp_encode(lchan, ref_rtp, data, bit_num, r & 1) == RFC4040_RTP_PLEN);
+		ASSERT_TRUE(memcmp(rtp, ref_rtp, sizeof(rtp)) == 0);
+	}
+
+	if (tc->tch_mode == GSM48_CMODE_DATA_14k5)
+		return;
+
+	/* idle frames */
+	ASSERT_TRUE(csd_v110_rtp_encode(lchan, rtp, NULL, 0, 0) == RFC4040_RTP_PLEN);
+	ASSERT_TRUE(ref_rtp_encode(lchan, ref_rtp, NULL, 0, 0) == RFC4040_RTP_PLEN);
+	ASSERT_TRUE(memcmp(rtp, ref_rtp, sizeof(rtp)) == 0);
+}
+
+static void test_decode(const struct test_case *tc, const struct gsm_lchan *lchan)
+{
+	const struct csd_v110_lchan_desc *desc = &csd_v110_lchan_desc[tc->tch_mode];
+	const unsigned int bit_num = CSD_V110_NUM_BITS(desc);
+	uint8_t rtp[RFC4040_RTP_PLEN];
+	ubit_t data[290], ref_data[290];
+	uint8_t align = 0, ref_align = 0;
+	unsigned int r, num_valid = 0;
+	int rc, ref_rc;
+
+	for (r = 0; r < NUM_ROUNDS; r++) {
+		/* a valid frame with some bits flipped, sometimes hitting
+		 * the alignment pattern or the repeated 2.4 kbit/s D-bits */
+		random_bits(&data[0], bit_num);
+		ref_rtp_encode(lchan, rtp, data, bit_num, r & 1);
+		for (unsigned int i = 0; i < r % 4; i++)
+			rtp[test_rand() % sizeof(rtp)] ^= 1 << (test_rand() % 8);
+
+		memset(data, 0xff, sizeof(data));
+		memset(ref_data, 0xff, sizeof(ref_data));
+		rc = csd_v110_rtp_decode(lchan, data, &align, rtp, sizeof(rtp));
+		ref_rc = ref_rtp_decode(lchan, ref_data, &ref_align, rtp, sizeof(rtp));
+		ASSERT_TRUE(rc == ref_rc);
+		if (rc < 0)
+			continue;
+		ASSERT_TRUE(memcmp(data, ref_data, bit_num) == 0);
+		if (tc->tch_mode != GSM48_CMODE_DATA_14k5)
+			ASSERT_TRUE(align == ref_align);
+		num_valid++;
+	}
+
+	/* the RAA' function has its own idea of a valid frame */
+	if (tc->tch_mode != GSM48_CMODE_DATA_14k5)
+		printf("  %u of %u frames decoded\n", num_valid, NUM_ROUNDS);
+}
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+/* not part of the expected output, gives an idea of the per-block cost */
+static void bench(const struct test_case *tc, const struct gsm_lchan *lchan)
+{
+	const struct csd_v110_lchan_desc *desc = &csd_v110_lchan_desc[tc->tch_mode];
+	const unsigned int bit_num = CSD_V110_NUM_BITS(desc);
+	const unsigned int rounds = 20000;
+	uint8_t rtp[RFC4040_RTP_PLEN];
+	ubit_t data[290];
+	struct timespec start, end;
+	double enc_ns, ref_enc_ns, dec_ns, ref_dec_ns;
+	unsigned int r;
+
+	random_bits(&data[0], bit_num);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++)
+		ref_rtp_encode(lchan, rtp, data, bit_num, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ref_enc_ns = elapsed_ns(&start, &end) / rounds;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++)
+		csd_v110_rtp_encode(lchan, rtp, data, bit_num, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	enc_ns = elapsed_ns(&start, &end) / rounds;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++)
+		ref_rtp_decode(lchan, data, NULL, rtp, sizeof(rtp));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ref_dec_ns = elapsed_ns(&start, &end) / rounds;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++)
+		csd_v110_rtp_decode(lchan, data, NULL, rtp, sizeof(rtp));
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	dec_ns = elapsed_ns(&start, &end) / rounds;
+
+	fprintf(stderr, "%s: encode %.0f ns (was %.0f ns), decode %.0f ns (was %.0f ns) per block\n",
+		tc->name, enc_ns, ref_enc_ns, dec_ns, ref_dec_ns);
+}
+
+int main(int argc, char **argv)
+{
+	for (unsigned int i = 0; i < ARRAY_SIZE(tests); i++) {
+		const struct test_case *tc = &tests[i];
+		struct gsm_lchan lchan = {
+			.tch_mode = tc->tch_mode,
+			.csd_mode = tc->csd_mode,
+		};
+
+		printf("Testing '%s'\n", tc->name);
+		test_encode(tc, &lchan);
+		test_decode(tc, &lchan);
+		bench(tc, &lchan);
+	}
+
+	printf("Success\n");
+	return 0;
+}
@@ -0,0 +1,196 @@
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <osmocom/core/application.h>
+#include <osmocom/core/fsm.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/dtx_dl_amr_fsm.h>
+
+static void *ctx;
+
+/* Dispatch an event to both the osmo_fsm and the table, compare the outcome */
+static int dispatch_both(struct osmo_fsm_inst *fi, uint8_t *state, enum dtx_dl_amr_fsm_events e)
+{
+	int rc, next;
+
+	OSMO_ASSERT(fi->state == *state);
+	rc = osmo_fsm_inst_dispatch(fi, e, NULL);
+	next = dtx_dl_amr_fsm_next(*state, e);
+
+	if ((rc < 0) != (next < 0) || (next >= 0 && fi->state != next)) {
+		printf("MISMATCH: state %s, event %s: osmo_fsm rc=%d -> %s, table -> %d\n",
+		       osmo_fsm_state_name(&dtx_dl_amr_fsm, *state),
+		       get_value_string(dtx_dl_amr_fsm_event_names, e),
+		       rc, osmo_fsm_inst_state_name(fi), next);
+		exit(EXIT_FAILURE);
+	}
+
+	if (next >= 0)
+		*state = next;
+	return next;
+}
+
+/* Every event in every state, print the table as a side effect */
+static void test_all_transitions(void)
+{
+	struct osmo_fsm_inst *fi;
+	unsigned int s, e, num_permitted = 0;
+	uint8_t state;
+
+	printf("\n%s()\n", __func__);
+
+	fi = osmo_fsm_inst_alloc(&dtx_dl_amr_fsm, ctx, NULL, LOGL_DEBUG, NULL);
+	OSMO_ASSERT(fi != NULL);
+
+	for (s = 0; s < _ST_DTX_DL_AMR_NUM; s++) {
+		printf("%s:\n", osmo_fsm_state_name(&dtx_dl_amr_fsm, s));
+		for (e = 0; e < _E_DTX_DL_AMR_NUM; e++) {
+			/* jump right into the state under test */
+			fi->state = state = s;
+			if (dispatch_both(fi, &state, e) < 0)
+				continue;
+			printf("  %s -> %s\n", get_value_string(dtx_dl_amr_fsm_event_names, e),
+			       osmo_fsm_state_name(&dtx_dl_amr_fsm, state));
+			num_permitted++;
+		}
+	}
+
+	printf("%u of %u state/event pairs permitted\n",
+	       num_permitted, _ST_DTX_DL_AMR_NUM * _E_DTX_DL_AMR_NUM);
+	osmo_fsm_inst_free(fi);
+}
+
+static const struct {
+	const char *name;
+	enum dtx_dl_amr_fsm_events events[16];
+	unsigned int num_events;
+} sequences[] = {
+	{
+		.name = "AMR FR: talk spurt, silence, talk spurt",
+		.events = { E_VOICE, E_SID_F, E_SID_U, E_COMPL, E_SID_U, E_ONSET, E_COMPL, E_COMPL, E_VOICE },
+		.num_events = 9,
+	},
+	{
+		.name = "AMR HR: SID-FIRST P1/P2, SID-UPDATE inhibited",
+		.events = { E_SID_F, E_FIRST, E_COMPL, E_COMPL, E_INHIB, E_COMPL, E_VOICE },
+		.num_events = 7,
+	},
+	{
+		.name = "AMR HR: SID-FIRST inhibited by speech",
+		.events = { E_INHIB, E_COMPL, E_COMPL, E_VOICE },
+		.num_events = 4,
+	},
+	{
+		.name = "FACCH interrupting silence",
+		.events = { E_SID_F, E_FACCH, E_COMPL, E_FACCH, E_SID_U, E_COMPL, E_SID_U, E_FACCH, E_COMPL, E_COMPL },
+		.num_events = 10,
+	},
+};
+
+/* Replay sequences of events as caused by the frames of a call */
+static void test_sequences(void)
+{
+	struct osmo_fsm_inst *fi;
+	unsigned int i, j;
+	uint8_t state;
+
+	printf("\n%s()\n", __func__);
+
+	for (i = 0; i < ARRAY_SIZE(sequences); i++) {
+		fi = osmo_fsm_inst_alloc(&dtx_dl_amr_fsm, ctx, NULL, LOGL_DEBUG, NULL);
+		OSMO_ASSERT(fi != NULL);
+		state = ST_VOICE;
+
+		printf("%s:\n  %s", sequences[i].name, osmo_fsm_state_name(&dtx_dl_amr_fsm, state));
+		for (j = 0; j < sequences[i].num_events; j++) {
+			if (dispatch_both(fi, &state, sequences[i].events[j]) < 0)
+				printf(" -(%s not permitted)",
+				       get_value_string(dtx_dl_amr_fsm_event_names, sequences[i].events[j]));
+			else
+				printf(" -> %s", osmo_fsm_state_name(&dtx_dl_amr_fsm, state));
+		}
+		printf("\n");
+		osmo_fsm_inst_free(fi);
+	}
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t test_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 16) & 0x7fff;
+}
+
+/* Random walk, mostly along permitted events to get deep into the FSM */
+static void test_random_walk(void)
+{
+	unsigned int i, num_rejected = 0;
+	uint32_t visited[_ST_DTX_DL_AMR_NUM] = { 0 };
+	unsigned int num_visited = 0;
+	struct osmo_fsm_inst *fi;
+	enum dtx_dl_amr_fsm_events e;
+	uint8_t state = ST_VOICE;
+
+	printf("\n%s()\n", __func__);
+
+	fi = osmo_fsm_inst_alloc(&dtx_dl_amr_fsm, ctx, NULL, LOGL_DEBUG, NULL);
+	OSMO_ASSERT(fi != NULL);
+
+	for (i = 0; i < 100000; i++) {
+		do {
+			e = test_rand() % _E_DTX_DL_AMR_NUM;
+		} while (test_rand() % 16 != 0 && dtx_dl_amr_fsm_next(state, e) < 0);
+
+		if (!(visited[state] & X(e)))
+			num_visited++;
+		visited[state] |= X(e);
+
+		if (dispatch_both(fi, &state, e) < 0)
+			num_rejected++;
+	}
+
+	printf("%u events replayed (%u not permitted), %u state/event pairs visited\n",
+	       i, num_rejected, num_visited);
+	osmo_fsm_inst_free(fi);
+}
+
+int main(int argc, char **argv)
+{
+	ctx = talloc_named_const(NULL, 0, "dtx_dl_amr_test");
+	osmo_init_logging2(ctx, &bts_log_info);
+	log_set_print_filename2(osmo_stderr_target, LOG_FILENAME_NONE);
+	log_set_use_color(osmo_stderr_target, 0);
+
+	OSMO_ASSERT(osmo_fsm_register(&dtx_dl_amr_fsm) == 0);
+
+	test_all_transitions();
+	test_sequences();
+	test_random_walk();
+
+	printf("\nSuccess\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+/* testing the asynchronous GSMTAP tap over a UDP socket pair */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/gsmtap.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsmtap_tap.h>
+
+#define RING_SIZE	8
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+static int rx_fd, tx_fd;
+
+static void open_sockets(void)
+{
+	struct sockaddr_in sa = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t sa_len = sizeof(sa);
+	int rcvbuf = 1 << 20;
+
+	rx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	ASSERT_TRUE(rx_fd >= 0);
+	setsockopt(rx_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	ASSERT_TRUE(bind(rx_fd, (struct sockaddr *) &sa, sizeof(sa)) == 0);
+	ASSERT_TRUE(getsockname(rx_fd, (struct sockaddr *) &sa, &sa_len) == 0);
+
+	tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	ASSERT_TRUE(tx_fd >= 0);
+	ASSERT_TRUE(connect(tx_fd, (struct sockaddr *) &sa, sizeof(sa)) == 0);
+}
+
+static int queue_frame(struct gsmtap_tap *tap, uint32_t fn)
+{
+	uint8_t data[23];
+
+	memset(data, fn & 0xff, sizeof(data));
+	return gsmtap_tap_send(tap, GSMTAP_TYPE_UM, 871, fn % 8, GSMTAP_CHANNEL_SDCCH8,
+			       fn % 4, fn, -60, 0, data, sizeof(data));
+}
+
+/* receive and verify frames with consecutive FNs, starting at fn */
+static unsigned int receive_frames(uint32_t fn, unsigned int num)
+{
+	struct pollfd pfd = { .fd = rx_fd, .events = POLLIN };
+	const struct gsmtap_hdr *gh;
+	uint8_t buf[512];
+	unsigned int count = 0;
+	ssize_t rc;
+
+	while (count < num && poll(&pfd, 1, 1000) == 1) {
+		rc = recv(rx_fd, buf, sizeof(buf), 0);
+		ASSERT_TRUE(rc == sizeof(*gh) + 23);
+		gh = (const struct gsmtap_hdr *) buf;
+		ASSERT_TRUE(gh->version == GSMTAP_VERSION);
+		ASSERT_TRUE(gh->hdr_len == sizeof(*gh) / 4);
+		ASSERT_TRUE(gh->type == GSMTAP_TYPE_UM);
+		ASSERT_TRUE(ntohs(gh->arfcn) == 871);
+		ASSERT_TRUE(ntohl(gh->frame_number) == fn + count);
+		ASSERT_TRUE(gh->timeslot == (fn + count) % 8);
+		ASSERT_TRUE(gh->sub_slot == (fn + count) % 4);
+		ASSERT_TRUE(gh->sub_type == GSMTAP_CHANNEL_SDCCH8);
+		ASSERT_TRUE(gh->signal_dbm == -60);
+		ASSERT_TRUE(buf[sizeof(*gh)] == ((fn + count) & 0xff));
+		count++;
+	}
+
+	return count;
+}
+
+static void test_gsmtap_tap(void *ctx)
+{
+	struct gsmtap_tap *tap;
+	unsigned int i, dropped = 0;
+	uint8_t big[GSMTAP_TAP_DATA_MAX + 1] = { 0 };
+	int rc;
+
+	printf("Testing a tap with %u ring entries\n", RING_SIZE);
+
+	tap = gsmtap_tap_alloc(ctx, tx_fd, RING_SIZE);
+	ASSERT_TRUE(tap != NULL);
+	ASSERT_TRUE(gsmtap_tap_alloc(ctx, tx_fd, RING_SIZE + 1) == NULL);
+
+	/* the writer is not running yet: the ring fills up and frames are dropped */
+	for (i = 0; i < RING_SIZE + 3; i++) {
+		rc = queue_frame(tap, i);
+		if (rc == -ENOBUFS)
+			dropped++;
+		else
+			ASSERT_TRUE(rc == 0);
+	}
+	printf("queued %u frames, %u dropped\n", RING_SIZE + 3, dropped);
+
+	rc = gsmtap_tap_send(tap, GSMTAP_TYPE_UM, 871, 0, GSMTAP_CHANNEL_SDCCH8, 0, 0, 0, 0,
+			     big, sizeof(big));
+	printf("oversized frame: %s\n", strerror(-rc));
+
+	ASSERT_TRUE(gsmtap_tap_start(tap) == 0);
+	printf("received %u frames\n", receive_frames(0, RING_SIZE));
+
+	/* the writer went to sleep meanwhile, it needs to be woken up */
+	for (i = 100; i < 100 + 3 * RING_SIZE; i++) {
+		while (queue_frame(tap, i) == -ENOBUFS)
+			usleep(100);
+	}
+	printf("received %u frames after wake-up\n", receive_frames(100, 3 * RING_SIZE));
+
+	/* the frames queued last are sent before the writer exits */
+	for (i = 200; i < 200 + RING_SIZE; i++) {
+		while (queue_frame(tap, i) == -ENOBUFS)
+			usleep(100);
+	}
+	gsmtap_tap_free(tap);
+	printf("received %u frames queued before free\n", receive_frames(200, RING_SIZE));
+}
+
+/* the writer is asleep and can not be woken up: it must not outlive the tap */
+static void test_free_wakeup_failure(void *ctx)
+{
+	struct gsmtap_tap *tap;
+	int fd;
+
+	printf("Testing free with a failing wake-up\n");
+
+	tap = gsmtap_tap_alloc(ctx, tx_fd, RING_SIZE);
+	ASSERT_TRUE(tap != NULL);
+	ASSERT_TRUE(gsmtap_tap_start(tap) == 0);
+	while (!__atomic_load_n(&tap->sleeping, __ATOMIC_SEQ_CST))
+		usleep(100);
+	usleep(10000);
+
+	/* the writer keeps waiting on its eventfd, writes to this one fail */
+	fd = open("/dev/null", O_RDONLY);
+	ASSERT_TRUE(fd >= 0);
+	ASSERT_TRUE(dup2(fd, tap->efd) == tap->efd);
+	close(fd);
+
+	gsmtap_tap_free(tap);
+	printf("writer stopped\n");
+}
+
+/* how long the producer side takes per frame, in bursts like those of a TDMA frame */
+static void bench_gsmtap_tap(void *ctx)
+{
+	const unsigned int num_bursts = 5000, burst_len = 64;
+	struct gsmtap_tap *tap;
+	struct timespec start, end;
+	unsigned int i, j, dropped = 0;
+	double elapsed_ns = 0;
+
+	tap = gsmtap_tap_alloc(ctx, tx_fd, GSMTAP_TAP_RING_SIZE_DEFAULT);
+	ASSERT_TRUE(tap != NULL);
+	ASSERT_TRUE(gsmtap_tap_start(tap) == 0);
+
+	for (i = 0; i < num_bursts; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (j = 0; j < burst_len; j++) {
+			if (queue_frame(tap, i * burst_len + j) < 0)
+				dropped++;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		elapsed_ns += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+		/* let the writer catch up, as it would between two TDMA frames */
+		while (__atomic_load_n(&tap->tail, __ATOMIC_ACQUIRE) != tap->head)
+			usleep(10);
+	}
+	gsmtap_tap_free(tap);
+
+	fprintf(stderr, "producer: %.0f ns per frame, %u of %u dropped\n",
+		elapsed_ns / (num_bursts * burst_len), dropped, num_bursts * burst_len);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 1, "gsmtap_tap_test");
+
+	osmo_init_logging2(ctx, &bts_log_info);
+
+	open_sockets();
+	test_gsmtap_tap(ctx);
+	test_free_wakeup_failure(ctx);
+	bench_gsmtap_tap(ctx);
+
+	close(tx_fd);
+	close(rx_fd);
+	printf("Success\n");
+	return 0;
+}
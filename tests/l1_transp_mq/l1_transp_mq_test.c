@@ -0,0 +1,219 @@
+/* testing the DSP message queue transport against pipes */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/l1_transp_mq.h>
+
+#define PRIM_SIZE	256
+#define QUEUE_NR	1
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+static void *tall_test_ctx;
+
+/* the DSP side of the message queues is emulated with a pair of pipes */
+static int to_bts[2];
+static int from_bts[2];
+
+static struct l1_mq_rx rx;
+static struct osmo_wqueue wq;
+
+static unsigned int rx_count;
+static uint8_t rx_last;
+
+static int rx_cb(void *data, struct msgb *msg, int queue)
+{
+	ASSERT_TRUE(data == &rx_count);
+	ASSERT_TRUE(queue == QUEUE_NR);
+	ASSERT_TRUE(msgb_l1len(msg) == PRIM_SIZE);
+
+	rx_last = msg->l1h[0];
+	rx_count++;
+	msgb_free(msg);
+	return 0;
+}
+
+static void transp_open(void)
+{
+	int rc;
+
+	ASSERT_TRUE(pipe(to_bts) == 0);
+	ASSERT_TRUE(pipe(from_bts) == 0);
+	fcntl(to_bts[0], F_SETFL, O_NONBLOCK);
+	fcntl(from_bts[0], F_SETFL, O_NONBLOCK);
+
+	rc = l1_mq_setup(&rx, &wq, QUEUE_NR, to_bts[0], from_bts[1], 64,
+			 PRIM_SIZE, rx_cb, &rx_count);
+	ASSERT_TRUE(rc == 0);
+}
+
+static void transp_close(void)
+{
+	l1_mq_close(&rx, &wq);
+	close(to_bts[1]);
+	close(from_bts[0]);
+}
+
+static void enqueue_prim(uint8_t val, size_t len)
+{
+	struct msgb *msg = msgb_alloc(len, "l1_prim");
+
+	msg->l1h = msgb_put(msg, len);
+	memset(msg->l1h, val, len);
+	ASSERT_TRUE(osmo_wqueue_enqueue(&wq, msg) == 0);
+}
+
+static void dsp_write_prims(uint8_t first, unsigned int num)
+{
+	uint8_t buf[PRIM_SIZE];
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		memset(buf, first + i, sizeof(buf));
+		ASSERT_TRUE(write(to_bts[1], buf, sizeof(buf)) == sizeof(buf));
+	}
+}
+
+static void test_tx_batch(void)
+{
+	uint8_t buf[64 * 32];
+	unsigned int i, len, pos;
+	ssize_t rc;
+
+	printf("Testing TX batching of primitives with different lengths\n");
+
+	transp_open();
+
+	for (i = 0; i < 40; i++)
+		enqueue_prim(i, 16 + (i % 5) * 4);
+	printf("queued %u primitives\n", wq.current_length);
+
+	/* one writev() takes at most L1_MQ_TX_BATCH_MAX primitives */
+	wq.bfd.cb(&wq.bfd, OSMO_FD_WRITE);
+	printf("after 1st write: %u primitives left, write %s\n", wq.current_length,
+	       wq.bfd.when & OSMO_FD_WRITE ? "enabled" : "disabled");
+	wq.bfd.cb(&wq.bfd, OSMO_FD_WRITE);
+	printf("after 2nd write: %u primitives left, write %s\n", wq.current_length,
+	       wq.bfd.when & OSMO_FD_WRITE ? "enabled" : "disabled");
+
+	rc = read(from_bts[0], buf, sizeof(buf));
+	printf("DSP read %zd bytes\n", rc);
+
+	/* all primitives arrived in order and with their own length */
+	for (i = 0, pos = 0; i < 40; i++) {
+		len = 16 + (i % 5) * 4;
+		ASSERT_TRUE(pos + len <= rc);
+		ASSERT_TRUE(buf[pos] == i && buf[pos + len - 1] == i);
+		pos += len;
+	}
+	ASSERT_TRUE(pos == rc);
+
+	transp_close();
+}
+
+static void test_rx_batch(void)
+{
+	unsigned int i, kept;
+
+	printf("Testing adaptive RX batching\n");
+
+	transp_open();
+	rx_count = 0;
+
+	dsp_write_prims(0, 20);
+	for (i = 0; rx_count < 20; i++) {
+		unsigned int before = rx_count;
+		rx.ofd.cb(&rx.ofd, OSMO_FD_READ);
+		printf("read #%u: %u primitive(s), batch now %u\n", i, rx_count - before, rx.batch);
+	}
+	ASSERT_TRUE(rx_last == 19);
+
+	/* a lightly loaded queue shrinks the batch again, unused buffers are kept */
+	for (i = 0; i < 3; i++) {
+		dsp_write_prims(100 + i, 1);
+		rx.ofd.cb(&rx.ofd, OSMO_FD_READ);
+		printf("single primitive %u received, batch now %u\n", rx_last, rx.batch);
+	}
+	for (i = 0, kept = 0; i < ARRAY_SIZE(rx.msg); i++) {
+		if (rx.msg[i])
+			kept++;
+	}
+	printf("%u receive buffers kept, total %u primitives\n", kept, rx_count);
+
+	transp_close();
+}
+
+/* not part of the expected output, gives an idea of the achievable throughput */
+static void bench_loopback(void)
+{
+	struct timespec start, end;
+	unsigned int i, n = 20000;
+	double us;
+
+	transp_open();
+	rx_count = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n; i++) {
+		dsp_write_prims(i, 4);
+		while (rx_count < (i + 1) * 4)
+			rx.ofd.cb(&rx.ofd, OSMO_FD_READ);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+	fprintf(stderr, "RX: %u primitives of %u bytes in %.0f us (%.3f us/prim)\n",
+		rx_count, PRIM_SIZE, us, us / rx_count);
+
+	transp_close();
+}
+
+int main(int argc, char **argv)
+{
+	tall_test_ctx = talloc_named_const(NULL, 1, "l1_transp_mq_test");
+	msgb_talloc_ctx_init(tall_test_ctx, 0);
+
+	osmo_init_logging2(tall_test_ctx, &bts_log_info);
+
+	test_tx_batch();
+	test_rx_batch();
+	bench_loopback();
+	printf("Success\n");
+
+	return 0;
+}
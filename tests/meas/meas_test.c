@@ -448,6 +448,75 @@ static void test_ts45008_83_is_sub(void)
 		test_ts45008_83_is_sub_single(i, 1, false);
 }
 
+static void test_interf_meas_print(const struct gsm_bts_trx_ts *ts, const char *what)
+{
+	const uint32_t *hist = ts->interf_band_hist;
+
+	printf("%s: histogram %u,%u,%u,%u,%u\n", what,
+	       hist[0], hist[1], hist[2], hist[3], hist[4]);
+}
+
+static void test_interf_meas_avg(struct gsm_lchan *lchan)
+{
+	printf("lchan %u: %u samples", lchan->nr, lchan->meas.interf_meas_num);
+	if (lchan->meas.interf_meas_num > 0) {
+		gsm_lchan_interf_meas_calc_avg(lchan);
+		printf(", avg %d dBm, band %u", lchan->meas.interf_meas_avg_dbm,
+		       lchan->meas.interf_band);
+	}
+	printf("\n");
+}
+
+static void test_interf_meas(void)
+{
+	static const int16_t boundary[] = { -115, -109, -103, -97, -91, -85 };
+	struct gsm_bts_trx_ts *ts = &trx->ts[7];
+	unsigned int ln, i;
+
+	printf("\n\n");
+	printf("===========================================================\n");
+	printf("Testing interference measurements\n");
+
+	memcpy(bts->interference.boundary, boundary, sizeof(boundary));
+	memset(ts->interf_band_hist, 0, sizeof(ts->interf_band_hist));
+
+	ts->pchan = GSM_PCHAN_SDCCH8_SACCH8C;
+	for (ln = 0; ln < 4; ln++) {
+		ts->lchan[ln].type = GSM_LCHAN_SDCCH;
+		ts->lchan[ln].state = LCHAN_S_NONE;
+		memset(&ts->lchan[ln].meas, 0, sizeof(ts->lchan[ln].meas));
+	}
+
+	/* Idle SDCCH: every sample counts */
+	gsm_lchan_interf_meas_push(&ts->lchan[0], -112);
+	gsm_lchan_interf_meas_push(&ts->lchan[0], -106);
+	gsm_lchan_interf_meas_push(&ts->lchan[0], -100);
+	/* Active SDCCH: not reported, samples are ignored */
+	ts->lchan[1].state = LCHAN_S_ACTIVE;
+	gsm_lchan_interf_meas_push(&ts->lchan[1], -90);
+	gsm_lchan_interf_meas_push(&ts->lchan[2], -88);
+	gsm_lchan_interf_meas_push(&ts->lchan[2], -94);
+	test_interf_meas_print(ts, "SDCCH/8");
+	for (ln = 0; ln < 3; ln++)
+		test_interf_meas_avg(&ts->lchan[ln]);
+
+	/* The sum stays bounded if no average is taken, the average intact */
+	for (i = 0; i < UINT16_MAX; i++)
+		gsm_lchan_interf_meas_push(&ts->lchan[3], -100);
+	gsm_lchan_interf_meas_push(&ts->lchan[3], -110);
+	test_interf_meas_avg(&ts->lchan[3]);
+
+	/* Active PDCH: samples of the idle frames count */
+	memset(ts->interf_band_hist, 0, sizeof(ts->interf_band_hist));
+	ts->pchan = GSM_PCHAN_PDCH;
+	ts->lchan[0].type = GSM_LCHAN_PDTCH;
+	ts->lchan[0].state = LCHAN_S_ACTIVE;
+	gsm_lchan_interf_meas_push(&ts->lchan[0], -95);
+	gsm_lchan_interf_meas_push(&ts->lchan[0], -99);
+	test_interf_meas_print(ts, "PDCH");
+	test_interf_meas_avg(&ts->lchan[0]);
+}
+
 int main(int argc, char **argv)
 {
 	void *tall_bts_ctx;
@@ -534,6 +603,7 @@ int main(int argc, char **argv)
 	test_lchan_meas_process_measurement(false, true);
 	test_lchan_meas_process_measurement(true, true);
 	test_ts45008_83_is_sub();
+	test_interf_meas();
 
 	printf("Success\n");
 
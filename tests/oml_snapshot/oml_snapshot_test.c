@@ -0,0 +1,313 @@
+/* testing the persisted OML/SI snapshot and the warm start from it */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/protocol/gsm_12_21.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/bts_shutdown_fsm.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/oml.h>
+#include <osmo-bts/oml_snapshot.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+#define SNAP_PATH	"oml_snapshot_test.snap"
+
+/* OML attributes as set by the BSC: BSIC 63, BCCH ARFCN 123 */
+static const uint8_t bts_attr[] = {
+	NM_ATT_BSIC, 0x3f,
+	NM_ATT_BCCH_ARFCN, 0x00, 0x7b,
+};
+static const uint8_t bts_attr_other_arfcn[] = {
+	NM_ATT_BCCH_ARFCN, 0x00, 0x7c,
+};
+static const uint8_t trx_attr[] = {
+	NM_ATT_RF_MAXPOWR_R, 0x02,
+};
+static const uint8_t ts0_attr[] = {
+	NM_ATT_CHAN_COMB, NM_CHANC_BCCHComb,
+	NM_ATT_TSC, 0x05,
+};
+static const uint8_t ts1_attr[] = {
+	NM_ATT_CHAN_COMB, NM_CHANC_SDCCH,
+	NM_ATT_TSC, 0x05,
+};
+
+static void *ctx;
+static unsigned int bts_nr;
+
+static struct tlv_parsed *attr(void *owner, const uint8_t *buf, size_t len)
+{
+	struct tlv_parsed *tp = talloc_zero(owner, struct tlv_parsed);
+
+	ASSERT_TRUE(oml_tlv_parse(tp, buf, len) >= 0);
+	return tp;
+}
+
+static struct gsm_bts *bts_create(void)
+{
+	struct gsm_bts *bts;
+
+	bts = gsm_bts_alloc(g_bts_sm, bts_nr++);
+	ASSERT_TRUE(bts != NULL);
+	ASSERT_TRUE(bts_init(bts) == 0);
+	bts_internal_flag_set(bts, BTS_INTERNAL_FLAG_WARM_START);
+	/* keep bts_shutdown() from exiting the test right away */
+	bts->c0->mo.nm_state.operational = NM_OPSTATE_ENABLED;
+
+	return bts;
+}
+
+static void clock_advance(unsigned int secs)
+{
+	osmo_clock_override_add(CLOCK_MONOTONIC, secs, 0);
+	osmo_timers_prepare();
+	osmo_timers_update();
+}
+
+/* The BSC configured the BTS, which is on air */
+static struct gsm_bts *bts_create_configured(void)
+{
+	struct gsm_bts *bts = bts_create();
+	struct gsm_bts_trx *trx = bts->c0;
+
+	bts->mo.nm_attr = attr(bts, bts_attr, sizeof(bts_attr));
+	trx->mo.nm_attr = attr(trx, trx_attr, sizeof(trx_attr));
+	trx->mo.nm_state.administrative = NM_STATE_UNLOCKED;
+	trx->ts[0].mo.nm_attr = attr(trx, ts0_attr, sizeof(ts0_attr));
+	trx->ts[1].mo.nm_attr = attr(trx, ts1_attr, sizeof(ts1_attr));
+	trx->ts[0].mo.nm_state.operational = NM_OPSTATE_ENABLED;
+
+	memset(GSM_BTS_SI(bts, SYSINFO_TYPE_2), 0x22, sizeof(sysinfo_buf_t));
+	memset(GSM_BTS_SI(bts, SYSINFO_TYPE_2ter), 0x23, sizeof(sysinfo_buf_t));
+	bts->si_valid = (1 << SYSINFO_TYPE_2) | (1 << SYSINFO_TYPE_2ter);
+
+	return bts;
+}
+
+/* Let the BSC configured BTS write its snapshot, and read it back */
+static size_t write_snapshot(struct gsm_bts *bts, uint8_t *buf, size_t buf_len)
+{
+	FILE *f;
+	size_t len;
+
+	ASSERT_TRUE(oml_snapshot_set_path(bts, SNAP_PATH) == 0);
+	clock_advance(OML_SNAPSHOT_WRITE_DELAY);
+	/* written on a separate thread, completion is signalled to the main loop */
+	ASSERT_TRUE(bts->oml_snapshot.writer.running);
+	while (bts->oml_snapshot.writer.running)
+		osmo_select_main(0);
+	ASSERT_TRUE(oml_snapshot_set_path(bts, NULL) == 0);
+
+	f = fopen(SNAP_PATH, "r");
+	ASSERT_TRUE(f != NULL);
+	len = fread(buf, 1, buf_len, f);
+	fclose(f);
+
+	return len;
+}
+
+static void write_file(const uint8_t *buf, size_t len)
+{
+	FILE *f = fopen(SNAP_PATH, "w");
+
+	ASSERT_TRUE(f != NULL);
+	ASSERT_TRUE(fwrite(buf, 1, len, f) == len);
+	fclose(f);
+}
+
+static struct gsm_bts *warm_start(void)
+{
+	struct gsm_bts *bts = bts_create();
+	int rc;
+
+	ASSERT_TRUE(oml_snapshot_set_path(bts, SNAP_PATH) == 0);
+	rc = oml_snapshot_warm_start(bts);
+	printf("warm start: %s\n", rc == 0 ? "ok" : strerror(-rc));
+
+	return bts;
+}
+
+static void test_round_trip(const uint8_t *snap, size_t snap_len)
+{
+	struct gsm_bts *bts;
+
+	printf("\n%s()\n", __func__);
+	write_file(snap, snap_len);
+
+	bts = warm_start();
+	ASSERT_TRUE(bts->oml_snapshot.warm);
+	printf("ARFCN %u, BSIC %u\n", bts->c0->arfcn, bts->bsic);
+	printf("TS0 %s, TSC %u\n", gsm_pchan_name(bts->c0->ts[0].pchan), bts->c0->ts[0].tsc_oml);
+	printf("TS1 %s, TSC %u\n", gsm_pchan_name(bts->c0->ts[1].pchan), bts->c0->ts[1].tsc_oml);
+	printf("TRX max power reduction %u dB\n", bts->c0->max_power_red);
+	printf("SI2 %s, SI2ter %s\n",
+	       GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2) &&
+	       bts->si_buf[SYSINFO_TYPE_2][0][0] == 0x22 ? "restored" : "missing",
+	       GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) &&
+	       bts->si_buf[SYSINFO_TYPE_2ter][0][0] == 0x23 ? "restored" : "missing");
+
+	/* the BSC sends the same configuration again */
+	oml_snapshot_rx_attr(&bts->mo, attr(bts, bts_attr, sizeof(bts_attr)));
+	oml_snapshot_rx_attr(&bts->c0->ts[0].mo, attr(bts, ts0_attr, sizeof(ts0_attr)));
+	printf("same attributes: %s\n", bts->oml_snapshot.warm ? "still warm" : "discarded");
+
+	/* RSL comes up, the BSC sends SI2 only */
+	oml_snapshot_rsl_up(bts->c0);
+	oml_snapshot_si_refreshed(bts, SYSINFO_TYPE_2);
+	clock_advance(OML_SNAPSHOT_SI_GRACE);
+	printf("after the SI grace period: %s, SI2 %s, SI2ter %s\n",
+	       bts->oml_snapshot.warm ? "still warm" : "confirmed",
+	       GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2) ? "valid" : "dropped",
+	       GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) ? "valid" : "dropped");
+	printf("snapshot file %s\n", access(SNAP_PATH, F_OK) == 0 ? "kept" : "removed");
+}
+
+static void test_rx_attr_mismatch(const uint8_t *snap, size_t snap_len)
+{
+	struct gsm_bts *bts;
+
+	printf("\n%s()\n", __func__);
+	write_file(snap, snap_len);
+
+	bts = warm_start();
+	oml_snapshot_rx_attr(&bts->mo, attr(bts, bts_attr_other_arfcn, sizeof(bts_attr_other_arfcn)));
+	printf("other BCCH ARFCN: %s, shutdown %s\n",
+	       bts->oml_snapshot.warm ? "still warm" : "discarded",
+	       bts_shutdown_in_progress(bts) ? "in progress" : "not started");
+	printf("snapshot file %s\n", access(SNAP_PATH, F_OK) == 0 ? "kept" : "removed");
+}
+
+static void test_corrupt(const uint8_t *snap, size_t snap_len)
+{
+	uint8_t buf[4096];
+	struct gsm_bts *bts;
+
+	printf("\n%s()\n", __func__);
+	ASSERT_TRUE(snap_len <= sizeof(buf));
+
+	unlink(SNAP_PATH);
+	printf("no file: ");
+	bts = warm_start();
+
+	printf("truncated header: ");
+	write_file(snap, 6);
+	bts = warm_start();
+
+	printf("truncated record: ");
+	write_file(snap, snap_len - 10);
+	bts = warm_start();
+
+	printf("no end marker: ");
+	write_file(snap, snap_len - 5);
+	bts = warm_start();
+
+	printf("bad magic: ");
+	memcpy(buf, snap, snap_len);
+	buf[0] ^= 0xff;
+	write_file(buf, snap_len);
+	bts = warm_start();
+
+	printf("bad version: ");
+	memcpy(buf, snap, snap_len);
+	buf[8]++;
+	write_file(buf, snap_len);
+	bts = warm_start();
+
+	printf("record length beyond the end: ");
+	memcpy(buf, snap, snap_len);
+	buf[9 + 3] = 0xff;
+	write_file(buf, snap_len);
+	bts = warm_start();
+
+	printf("BCCH ARFCN out of range: ");
+	memcpy(buf, snap, snap_len);
+	/* first record: BTS attributes, starting with the BCCH ARFCN */
+	ASSERT_TRUE(buf[9] == 0x01 && buf[9 + 5] == NM_ATT_BCCH_ARFCN);
+	buf[9 + 6] = 0x04;
+	write_file(buf, snap_len);
+	bts = warm_start();
+	printf("running from the snapshot: %s\n", bts->oml_snapshot.warm ? "yes" : "no");
+}
+
+static void test_no_bsc(const uint8_t *snap, size_t snap_len)
+{
+	struct gsm_bts *bts;
+
+	printf("\n%s()\n", __func__);
+	write_file(snap, snap_len);
+
+	bts = warm_start();
+	clock_advance(OML_SNAPSHOT_BSC_TIMEOUT - 1);
+	printf("before the deadline: %s\n", bts->oml_snapshot.warm ? "still warm" : "discarded");
+	clock_advance(1);
+	printf("after the deadline: %s, shutdown %s\n",
+	       bts->oml_snapshot.warm ? "still warm" : "discarded",
+	       bts_shutdown_in_progress(bts) ? "in progress" : "not started");
+	printf("snapshot file %s\n", access(SNAP_PATH, F_OK) == 0 ? "kept" : "removed");
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t snap[4096];
+	size_t snap_len;
+
+	ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(ctx, 0);
+	osmo_init_logging2(ctx, &bts_log_info);
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+
+	g_bts_sm = gsm_bts_sm_alloc(ctx);
+	ASSERT_TRUE(g_bts_sm != NULL);
+
+	snap_len = write_snapshot(bts_create_configured(), snap, sizeof(snap));
+	printf("snapshot written\n");
+
+	test_round_trip(snap, snap_len);
+	test_corrupt(snap, snap_len);
+	test_rx_attr_mismatch(snap, snap_len);
+	test_no_bsc(snap, snap_len);
+
+	unlink(SNAP_PATH);
+	printf("Success\n");
+
+	return 0;
+}
@@ -0,0 +1,173 @@
+/* testing the PACKET_MMAP rings against a fake PHY on a veth pair */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/packet_ring.h>
+
+/* IEEE 802 local experimental ethertype */
+#define TEST_PROTO	0x88b5
+#define NUM_FRAMES	40
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+static struct sockaddr_ll ll_addr(int ifindex)
+{
+	struct sockaddr_ll sa = {
+		.sll_family = AF_PACKET,
+		.sll_protocol = htons(TEST_PROTO),
+		.sll_ifindex = ifindex,
+		.sll_halen = ETH_ALEN,
+		.sll_addr = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+	};
+	return sa;
+}
+
+static size_t frame_len(unsigned int i)
+{
+	return 64 + (i * 37) % 1400;
+}
+
+static void frame_fill(uint8_t *buf, unsigned int i)
+{
+	memset(buf, i, frame_len(i));
+}
+
+/* the fake PHY echoes every frame it receives */
+static int fake_phy_open(int ifindex)
+{
+	struct sockaddr_ll sa = ll_addr(ifindex);
+	int fd;
+
+	fd = socket(AF_PACKET, SOCK_DGRAM, htons(TEST_PROTO));
+	ASSERT_TRUE(fd >= 0);
+	ASSERT_TRUE(bind(fd, (struct sockaddr *) &sa, sizeof(sa)) == 0);
+	return fd;
+}
+
+static unsigned int fake_phy_echo(int fd, int ifindex, unsigned int num)
+{
+	struct sockaddr_ll sa = ll_addr(ifindex);
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint8_t buf[PKT_RING_FRAME_SIZE];
+	unsigned int count = 0;
+	ssize_t len;
+
+	while (count < num && poll(&pfd, 1, 1000) > 0) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		ASSERT_TRUE(len == frame_len(buf[0]));
+		ASSERT_TRUE(buf[0] == count && buf[len - 1] == (uint8_t) count);
+		/* mark it, to tell the echo from our own looped back frame */
+		buf[1] = 0xee;
+		ASSERT_TRUE(sendto(fd, buf, len, 0, (struct sockaddr *) &sa, sizeof(sa)) == len);
+		count++;
+	}
+	return count;
+}
+
+static unsigned int rx_count;
+
+static void rx_cb(void *data, const uint8_t *buf, size_t len)
+{
+	ASSERT_TRUE(data == &rx_count);
+	ASSERT_TRUE(buf[0] == rx_count && buf[1] == 0xee);
+	ASSERT_TRUE(len == frame_len(rx_count));
+	rx_count++;
+}
+
+static void test_ring_echo(const char *dev, const char *phy_dev)
+{
+	int ifindex = if_nametoindex(dev);
+	int phy_ifindex = if_nametoindex(phy_dev);
+	struct sockaddr_ll dst = ll_addr(ifindex);
+	struct pollfd pfd;
+	struct pkt_ring ring;
+	uint8_t buf[PKT_RING_FRAME_SIZE];
+	unsigned int i, echoed;
+	int phy_fd, rc;
+
+	printf("Testing %u frames through the rings and back\n", NUM_FRAMES);
+
+	ASSERT_TRUE(ifindex > 0 && phy_ifindex > 0);
+	phy_fd = fake_phy_open(phy_ifindex);
+	ASSERT_TRUE(pkt_ring_open(&ring, TEST_PROTO, ifindex) == 0);
+
+	/* all frames leave with a single flush */
+	for (i = 0; i < NUM_FRAMES; i++) {
+		frame_fill(buf, i);
+		ASSERT_TRUE(pkt_ring_tx_put(&ring, buf, frame_len(i)) == 0);
+	}
+	printf("pending TX frames: %u\n", ring.tx_pending);
+	rc = pkt_ring_tx_flush(&ring, &dst);
+	printf("flush: %s, pending TX frames: %u\n", rc > 0 ? "ok" : strerror(-rc), ring.tx_pending);
+
+	echoed = fake_phy_echo(phy_fd, phy_ifindex, NUM_FRAMES);
+	printf("fake PHY echoed %u frames\n", echoed);
+
+	pfd.fd = ring.rx_fd;
+	pfd.events = POLLIN;
+	while (rx_count < NUM_FRAMES && poll(&pfd, 1, 1000) > 0)
+		pkt_ring_rx(&ring, rx_cb, &rx_count);
+	printf("received %u frames from the RX ring\n", rx_count);
+
+	/* oversized frames are refused */
+	rc = pkt_ring_tx_put(&ring, buf, PKT_RING_FRAME_SIZE);
+	printf("oversized frame: %s\n", strerror(-rc));
+
+	pkt_ring_close(&ring);
+	close(phy_fd);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 1, "packet_ring_test");
+
+	osmo_init_logging2(ctx, &bts_log_info);
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s DEV PHY_DEV (a veth pair)\n", argv[0]);
+		return 77;
+	}
+
+	test_ring_echo(argv[1], argv[2]);
+	printf("Success\n");
+
+	return 0;
+}
@@ -20,6 +20,8 @@
  */
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/application.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/rate_ctr.h>
 
 #include <osmo-bts/bts.h>
 #include <osmo-bts/bts_sm.h>
@@ -30,6 +32,7 @@
 #include <osmo-bts/notification.h>
 
 #include <unistd.h>
+#include <string.h>
 
 static struct gsm_bts *bts;
 
@@ -126,6 +129,154 @@ static void test_paging_sleep(void)
 	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 0);
 }
 
+static void test_paging_batch(void)
+{
+	struct paging_state *ps = bts->paging_state;
+	unsigned int queue_max = paging_get_queue_max(ps);
+	struct paging_identity ids[4];
+	unsigned int i;
+	int rc;
+	printf("Testing batched paging admission.\n");
+
+	for (i = 0; i < ARRAY_SIZE(ids); i++) {
+		ids[i].paging_group = 0;
+		ids[i].chan_needed = 0;
+		memcpy(ids[i].identity_lv, static_ilv, sizeof(static_ilv));
+		ids[i].identity_lv[8] = i;
+	}
+
+	/* duplicates within a batch are only added once */
+	ids[2].identity_lv[8] = 0;
+	rc = paging_add_identities(ps, ids, 3);
+	ASSERT_TRUE(rc == 2);
+	ASSERT_TRUE(paging_queue_length(ps) == 2);
+
+	/* queued identities are admitted on flush */
+	rc = paging_enqueue_identity(ps, 0, ids[3].identity_lv, 0);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_queue_length(ps) == 2);
+	paging_flush_identities(ps);
+	ASSERT_TRUE(paging_queue_length(ps) == 3);
+
+	/* the remainder of a batch is dropped once the queue is full */
+	paging_reset(ps);
+	paging_set_queue_max(ps, 2);
+	rc = paging_add_identities(ps, ids, 4);
+	ASSERT_TRUE(rc == 2);
+	ASSERT_TRUE(paging_queue_length(ps) == 2);
+
+	paging_reset(ps);
+	paging_set_queue_max(ps, queue_max);
+}
+
+static void test_paging_macblock_batch(void)
+{
+	static const char * const imsis[] = { "001010000000001", "001010000000002", "001010000000003" };
+	struct paging_state *ps = bts->paging_state;
+	unsigned int queue_max = paging_get_queue_max(ps);
+	uint8_t macblock[GSM_MACBLOCK_LEN];
+	struct paging_macblock mbs[ARRAY_SIZE(imsis)];
+	uint8_t identity_lv[sizeof(static_ilv)];
+	unsigned int i, grp, num_groups = 0;
+	int rc;
+	printf("Testing batched PS paging admission.\n");
+
+	memset(macblock, 0x2b, sizeof(macblock));
+	for (i = 0; i < ARRAY_SIZE(mbs); i++) {
+		mbs[i] = (struct paging_macblock) {
+			.msg_id = i,
+			.imsi = imsis[i],
+			.macblock = macblock,
+		};
+	}
+
+	/* admitted right away */
+	rc = paging_add_macblocks(ps, mbs, 1);
+	ASSERT_TRUE(rc == 1);
+	ASSERT_TRUE(paging_deferred_length(ps) == 0);
+	paging_reset(ps);
+
+	/* CS pagings congest the queue, the PS pagings are deferred */
+	paging_set_queue_max(ps, 3);
+	memcpy(identity_lv, static_ilv, sizeof(static_ilv));
+	for (i = 0; i < 2; i++) {
+		identity_lv[8] = i;
+		rc = paging_add_identity(ps, 0, identity_lv, 0);
+		ASSERT_TRUE(rc == 0);
+	}
+	rc = paging_add_macblocks(ps, mbs, 2);
+	ASSERT_TRUE(rc == 2);
+	ASSERT_TRUE(paging_deferred_length(ps) == 2);
+	for (grp = 1; grp <= UINT8_MAX; grp++)
+		ASSERT_TRUE(paging_group_queue_empty(ps, grp));
+
+	/* once the congestion is over, the deferred ones are admitted along with the next batch */
+	paging_set_queue_max(ps, queue_max);
+	rc = paging_add_macblocks(ps, &mbs[2], 1);
+	ASSERT_TRUE(rc == 1);
+	ASSERT_TRUE(paging_deferred_length(ps) == 0);
+	for (grp = 1; grp <= UINT8_MAX; grp++) {
+		if (!paging_group_queue_empty(ps, grp))
+			num_groups++;
+	}
+	ASSERT_TRUE(num_groups == ARRAY_SIZE(mbs));
+	ASSERT_TRUE(paging_queue_length(ps) == 2);
+
+	paging_reset(ps);
+}
+
+/* A single MAC block is deferred like a batch, and deferred ones expire */
+static void test_paging_macblock_deferred_expiry(void)
+{
+	static const char * const imsis[] = { "001010000000001", "001010000000002", "001010000000003" };
+	struct paging_state *ps = bts->paging_state;
+	unsigned int queue_max = paging_get_queue_max(ps);
+	const struct rate_ctr *drop_ps = rate_ctr_group_get_ctr(bts->ctrs, BTS_CTR_PAGING_DROP_PS);
+	uint64_t num_dropped = drop_ps->current;
+	uint8_t macblock[GSM_MACBLOCK_LEN];
+	uint8_t identity_lv[sizeof(static_ilv)];
+	unsigned int i, grp, num_groups = 0;
+	int rc;
+	printf("Testing expiry of deferred PS pagings.\n");
+
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+	memset(macblock, 0x2b, sizeof(macblock));
+
+	/* CS pagings congest the queue */
+	paging_set_queue_max(ps, 3);
+	memcpy(identity_lv, static_ilv, sizeof(static_ilv));
+	for (i = 0; i < 2; i++) {
+		identity_lv[8] = i;
+		rc = paging_add_identity(ps, 0, identity_lv, 0);
+		ASSERT_TRUE(rc == 0);
+	}
+
+	rc = paging_add_macblock(ps, 0, imsis[0], false, macblock);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_deferred_length(ps) == 1);
+	osmo_clock_override_add(CLOCK_MONOTONIC, 3, 0);
+	rc = paging_add_macblock(ps, 1, imsis[1], false, macblock);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_deferred_length(ps) == 2);
+	ASSERT_TRUE(drop_ps->current == num_dropped);
+
+	/* the congestion is over after the first one expired */
+	osmo_clock_override_add(CLOCK_MONOTONIC, 3, 0);
+	paging_set_queue_max(ps, queue_max);
+	rc = paging_add_macblock(ps, 2, imsis[2], false, macblock);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_deferred_length(ps) == 0);
+	for (grp = 1; grp <= UINT8_MAX; grp++) {
+		if (!paging_group_queue_empty(ps, grp))
+			num_groups++;
+	}
+	ASSERT_TRUE(num_groups == 2);
+	ASSERT_TRUE(drop_ps->current == num_dropped + 1);
+
+	osmo_clock_override_enable(CLOCK_MONOTONIC, false);
+	paging_reset(ps);
+}
+
 /* Set up a dummy trx with a valid setting for bs_ag_blks_res in SI3 */
 static struct gsm_bts_trx *test_is_ccch_for_agch_setup(uint8_t bs_ag_blks_res)
 {
@@ -137,6 +288,7 @@ static struct gsm_bts_trx *test_is_ccch_for_agch_setup(uint8_t bs_ag_blks_res)
 	bts.si_valid |= 0x8;
 	bts.asci.pos_nch = -1;
 	memcpy(&bts.si_buf[SYSINFO_TYPE_3][0], &si3, sizeof(si3));
+	bts_sysinfo_sched_update(&bts);
 	return &trx;
 }
 
@@ -361,6 +513,9 @@ int main(int argc, char **argv)
 
 	test_paging_smoke();
 	test_paging_sleep();
+	test_paging_batch();
+	test_paging_macblock_batch();
+	test_paging_macblock_deferred_expiry();
 	test_is_ccch_for_agch();
 	test_paging_rest_octets1();
 	test_paging_rest_octets2();
@@ -0,0 +1,317 @@
+/* testing the batched primitives (PCU_IF_MSG_BATCH) of the PCU socket */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/bit16gen.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/pcu_if.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+#define SOCK_PATH	"pcu_batch_test.sock"
+
+static struct gsm_bts *bts;
+static int pcu_fd = -1;
+
+/* data[] of the batch being built by the PCU side */
+static uint8_t batch_data[1024];
+static size_t batch_data_len;
+
+static void run_main_loop(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < 8; i++)
+		osmo_select_main(1);
+}
+
+static const char *prim_name(uint8_t msg_type)
+{
+	static char buf[16];
+
+	switch (msg_type) {
+	case PCU_IF_MSG_INFO_IND:
+		return "INFO.ind";
+	case PCU_IF_MSG_TIME_IND:
+		return "TIME.ind";
+	case PCU_IF_MSG_RACH_IND:
+		return "RACH.ind";
+	default:
+		snprintf(buf, sizeof(buf), "0x%02x", msg_type);
+		return buf;
+	}
+}
+
+/* Print what the BTS sent to the PCU side, one line per message */
+static void pcu_side_rx(void)
+{
+	uint8_t buf[8192];
+	const struct gsm_pcu_if *pcu_prim = (const struct gsm_pcu_if *) buf;
+	ssize_t rc;
+
+	run_main_loop();
+
+	while ((rc = recv(pcu_fd, buf, sizeof(buf), 0)) > 0) {
+		const uint8_t *cur = pcu_prim->u.batch.data;
+		unsigned int i;
+
+		if (pcu_prim->msg_type != PCU_IF_MSG_BATCH) {
+			printf("rx %s\n", prim_name(pcu_prim->msg_type));
+			continue;
+		}
+
+		ASSERT_TRUE(pcu_prim->u.batch.version == PCU_IF_BATCH_VERSION);
+		ASSERT_TRUE(rc == PCUIF_HDR_SIZE + sizeof(pcu_prim->u.batch) + osmo_load16be(&pcu_prim->u.batch.length));
+		printf("rx batch:");
+		for (i = 0; i < pcu_prim->u.batch.num_prims; i++) {
+			uint16_t len = osmo_load16be(cur);
+
+			cur += sizeof(uint16_t);
+			printf(" %s", prim_name(((const struct gsm_pcu_if *) cur)->msg_type));
+			cur += len;
+		}
+		printf("\n");
+		ASSERT_TRUE(cur == buf + rc);
+	}
+}
+
+static void batch_reset(void)
+{
+	batch_data_len = 0;
+}
+
+/* Append a length field, and that many bytes of the primitive (if any) */
+static void batch_append(uint16_t len, const struct gsm_pcu_if *pcu_prim, size_t prim_len)
+{
+	ASSERT_TRUE(batch_data_len + sizeof(uint16_t) + prim_len <= sizeof(batch_data));
+	osmo_store16be(len, &batch_data[batch_data_len]);
+	batch_data_len += sizeof(uint16_t);
+	memcpy(&batch_data[batch_data_len], pcu_prim, prim_len);
+	batch_data_len += prim_len;
+}
+
+static void batch_append_txt_ind(const char *text)
+{
+	struct gsm_pcu_if pcu_prim = {
+		.msg_type = PCU_IF_MSG_TXT_IND,
+		.u.txt_ind.type = PCU_VERSION,
+	};
+	size_t len = PCUIF_HDR_SIZE + sizeof(pcu_prim.u.txt_ind);
+
+	osmo_strlcpy(pcu_prim.u.txt_ind.text, text, sizeof(pcu_prim.u.txt_ind.text));
+	batch_append(len, &pcu_prim, len);
+}
+
+/* Send a batch with the given header fields and data[] built so far */
+static void pcu_side_tx_batch(uint8_t version, uint8_t num_prims, uint16_t length)
+{
+	uint8_t buf[PCUIF_HDR_SIZE + sizeof(struct gsm_pcu_if_batch) + sizeof(batch_data)];
+	struct gsm_pcu_if *pcu_prim = (struct gsm_pcu_if *) buf;
+
+	memset(buf, 0, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.batch));
+	pcu_prim->msg_type = PCU_IF_MSG_BATCH;
+	pcu_prim->u.batch.version = version;
+	pcu_prim->u.batch.num_prims = num_prims;
+	osmo_store16be(length, &pcu_prim->u.batch.length);
+	memcpy(pcu_prim->u.batch.data, batch_data, batch_data_len);
+
+	ASSERT_TRUE(send(pcu_fd, buf, PCUIF_HDR_SIZE + sizeof(pcu_prim->u.batch) + batch_data_len, 0) > 0);
+	run_main_loop();
+}
+
+/* Two TIME.ind in the same main loop iteration */
+static void print_batching(void)
+{
+	pcu_tx_time_ind(bts, 0);
+	pcu_tx_time_ind(bts, 4);
+	pcu_side_rx();
+}
+
+/* Batches the BTS must not take as negotiation */
+static void test_rejected(void)
+{
+	printf("\n%s()\n", __func__);
+
+	printf("unsupported version:\n");
+	batch_reset();
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION + 1, 0, 0);
+	print_batching();
+
+	printf("data[] shorter than indicated:\n");
+	batch_reset();
+	batch_append_txt_ind("0.1");
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION, 1, batch_data_len + 1);
+	print_batching();
+	printf("pcu_version: '%s'\n", bts->pcu_version);
+}
+
+static void test_negotiation(void)
+{
+	printf("\n%s()\n", __func__);
+
+	batch_reset();
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION, 0, 0);
+
+	/* each TIME.ind starts the batch of its frame */
+	print_batching();
+
+	/* the primitives of one frame go into one batch */
+	pcu_tx_time_ind(bts, 8);
+	pcu_tx_rach_ind(bts->nr, 0, 0, 0, 0x42, 8, 0, GSM_L1_BURST_TYPE_ACCESS_0, PCU_IF_SAPI_RACH);
+	pcu_tx_rach_ind(bts->nr, 0, 0, 0, 0x43, 8, 0, GSM_L1_BURST_TYPE_ACCESS_0, PCU_IF_SAPI_RACH);
+	pcu_side_rx();
+
+	/* sent at the end of the main loop iteration, without waiting for a TIME.ind */
+	pcu_tx_rach_ind(bts->nr, 0, 0, 0, 0x44, 9, 0, GSM_L1_BURST_TYPE_ACCESS_0, PCU_IF_SAPI_RACH);
+	pcu_side_rx();
+}
+
+static void test_rx(void)
+{
+	printf("\n%s()\n", __func__);
+
+	batch_reset();
+	batch_append_txt_ind("1.0");
+	batch_append_txt_ind("1.1");
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION, 2, batch_data_len);
+	printf("pcu_version: '%s'\n", bts->pcu_version);
+}
+
+/* A broken length field ends the batch, an invalid primitive is skipped */
+static void test_rx_malformed(void)
+{
+	const struct gsm_pcu_if nested = {
+		.msg_type = PCU_IF_MSG_BATCH,
+		.u.batch.version = PCU_IF_BATCH_VERSION,
+	};
+	const struct gsm_pcu_if txt_ind = {
+		.msg_type = PCU_IF_MSG_TXT_IND,
+		.u.txt_ind.type = PCU_VERSION,
+	};
+
+	printf("\n%s()\n", __func__);
+
+	printf("length field missing:\n");
+	batch_reset();
+	batch_append_txt_ind("2.0");
+	batch_data[batch_data_len++] = 0;
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION, 3, batch_data_len);
+	printf("pcu_version: '%s'\n", bts->pcu_version);
+
+	printf("primitive shorter than its header:\n");
+	batch_reset();
+	batch_append(PCUIF_HDR_SIZE - 1, &txt_ind, PCUIF_HDR_SIZE - 1);
+	batch_append_txt_ind("2.1");
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION, 2, batch_data_len);
+	printf("pcu_version: '%s'\n", bts->pcu_version);
+
+	printf("primitive exceeding data[]:\n");
+	batch_reset();
+	batch_append_txt_ind("2.2");
+	batch_append(PCUIF_HDR_SIZE + sizeof(txt_ind.u.txt_ind) + 1, &txt_ind,
+		     PCUIF_HDR_SIZE + sizeof(txt_ind.u.txt_ind));
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION, 2, batch_data_len);
+	printf("pcu_version: '%s'\n", bts->pcu_version);
+
+	printf("primitive shorter than its message type:\n");
+	batch_reset();
+	batch_append(PCUIF_HDR_SIZE + 1, &txt_ind, PCUIF_HDR_SIZE + 1);
+	batch_append_txt_ind("2.3");
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION, 2, batch_data_len);
+	printf("pcu_version: '%s'\n", bts->pcu_version);
+
+	printf("nested batch:\n");
+	batch_reset();
+	batch_append(PCUIF_HDR_SIZE + sizeof(nested.u.batch), &nested, PCUIF_HDR_SIZE + sizeof(nested.u.batch));
+	batch_append_txt_ind("2.4");
+	pcu_side_tx_batch(PCU_IF_BATCH_VERSION, 2, batch_data_len);
+	printf("pcu_version: '%s'\n", bts->pcu_version);
+
+	/* still batching */
+	print_batching();
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_bts_ctx;
+	struct sockaddr_un addr = {
+		.sun_family = AF_UNIX,
+		.sun_path = SOCK_PATH,
+	};
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+
+	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
+	ASSERT_TRUE(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	ASSERT_TRUE(bts != NULL);
+	ASSERT_TRUE(bts_init(bts) == 0);
+	/* a failure event report is sent on behalf of C0 */
+	ASSERT_TRUE(gsm_bts_trx_alloc(bts) != NULL);
+
+	unlink(SOCK_PATH);
+	ASSERT_TRUE(pcu_sock_init(SOCK_PATH, 100) == 0);
+
+	/* connect as the PCU, the BTS offers batching in the INFO.ind */
+	pcu_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	ASSERT_TRUE(pcu_fd >= 0);
+	ASSERT_TRUE(connect(pcu_fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+	ASSERT_TRUE(fcntl(pcu_fd, F_SETFL, O_NONBLOCK) == 0);
+	printf("connected:\n");
+	pcu_side_rx();
+	print_batching();
+
+	test_rejected();
+	test_negotiation();
+	test_rx();
+	test_rx_malformed();
+
+	pcu_sock_exit();
+	close(pcu_fd);
+	unlink(SOCK_PATH);
+
+	printf("Success\n");
+
+	return 0;
+}
@@ -0,0 +1,257 @@
+/* testing the shared memory rings towards the PCU */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/pcu_if.h>
+#include <osmo-bts/pcu_shm.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+/* The PCU side, looking at the shared memory through its own mapping */
+struct pcu_side {
+	uint8_t *mem;
+	size_t size;
+	struct gsm_pcu_if_shm cnf;
+	struct gsm_pcu_if_shm_ring *tx;	/* BTS -> PCU */
+	struct gsm_pcu_if_shm_ring *rx;	/* PCU -> BTS */
+};
+
+static void pcu_side_map(struct pcu_side *pcu, const struct pcu_shm *shm)
+{
+	pcu_shm_fill_cnf(shm, &pcu->cnf);
+	pcu->size = pcu->cnf.size;
+	pcu->mem = mmap(NULL, pcu->size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->mem_fd, 0);
+	ASSERT_TRUE(pcu->mem != MAP_FAILED);
+	pcu->tx = (struct gsm_pcu_if_shm_ring *) (pcu->mem + pcu->cnf.ring_offset[0]);
+	pcu->rx = (struct gsm_pcu_if_shm_ring *) (pcu->mem + pcu->cnf.ring_offset[1]);
+}
+
+static struct gsm_pcu_if_shm_slot *pcu_side_slot(const struct pcu_side *pcu,
+						 struct gsm_pcu_if_shm_ring *ring, uint32_t idx)
+{
+	return (struct gsm_pcu_if_shm_slot *)
+		&ring->slots[(idx & (pcu->cnf.num_slots - 1)) * pcu->cnf.slot_size];
+}
+
+/* Consume one primitive from the BTS -> PCU ring, returns its fn or -1 */
+static int pcu_side_consume(struct pcu_side *pcu)
+{
+	const struct gsm_pcu_if_shm_slot *slot;
+	const struct gsm_pcu_if *prim;
+	uint32_t tail = pcu->tx->tail;
+	int fn;
+
+	if (tail == pcu->tx->head)
+		return -1;
+
+	slot = pcu_side_slot(pcu, pcu->tx, tail);
+	prim = (const struct gsm_pcu_if *) slot->prim;
+	ASSERT_TRUE(slot->len == PCUIF_HDR_SIZE + sizeof(prim->u.time_ind));
+	ASSERT_TRUE(prim->msg_type == PCU_IF_MSG_TIME_IND);
+	fn = prim->u.time_ind.fn;
+
+	pcu->tx->tail = tail + 1;
+	return fn;
+}
+
+/* Produce one primitive of the given length into the PCU -> BTS ring */
+static void pcu_side_produce(struct pcu_side *pcu, uint16_t len, uint32_t fn)
+{
+	struct gsm_pcu_if_shm_slot *slot;
+	struct gsm_pcu_if *prim;
+	uint32_t head = pcu->rx->head;
+
+	slot = pcu_side_slot(pcu, pcu->rx, head);
+	slot->len = len;
+	prim = (struct gsm_pcu_if *) slot->prim;
+	prim->msg_type = PCU_IF_MSG_TIME_IND;
+	prim->u.time_ind.fn = fn;
+
+	pcu->rx->head = head + 1;
+}
+
+static int push_time_ind(struct pcu_shm *shm, uint32_t fn)
+{
+	struct gsm_pcu_if prim = {
+		.msg_type = PCU_IF_MSG_TIME_IND,
+		.u.time_ind.fn = fn,
+	};
+
+	return pcu_shm_push(shm, &prim, PCUIF_HDR_SIZE + sizeof(prim.u.time_ind));
+}
+
+static void test_layout(void *ctx)
+{
+	struct pcu_side pcu;
+	struct pcu_shm *shm;
+
+	printf("%s\n", __func__);
+
+	/* rounded up to a power of two */
+	shm = pcu_shm_alloc(ctx, 100);
+	ASSERT_TRUE(shm != NULL);
+	pcu_side_map(&pcu, shm);
+
+	printf("version %u, %u slots per ring\n", pcu.cnf.version, pcu.cnf.num_slots);
+	ASSERT_TRUE(pcu.cnf.slot_size % PCU_IF_SHM_CACHELINE == 0);
+	ASSERT_TRUE(pcu.cnf.slot_size >= sizeof(struct gsm_pcu_if_shm_slot) + sizeof(struct gsm_pcu_if));
+	ASSERT_TRUE(pcu.tx->num_slots == pcu.cnf.num_slots && pcu.rx->num_slots == pcu.cnf.num_slots);
+	ASSERT_TRUE(pcu.tx->slot_size == pcu.cnf.slot_size && pcu.rx->slot_size == pcu.cnf.slot_size);
+	ASSERT_TRUE(pcu.cnf.ring_offset[1] + sizeof(*pcu.rx) +
+		    pcu.cnf.num_slots * pcu.cnf.slot_size <= pcu.cnf.size);
+
+	munmap(pcu.mem, pcu.size);
+	pcu_shm_free(shm);
+
+	/* the default, and the maximum */
+	shm = pcu_shm_alloc(ctx, 0);
+	printf("0 slots requested: %u slots\n", shm->num_slots);
+	pcu_shm_free(shm);
+	shm = pcu_shm_alloc(ctx, 100000);
+	printf("100000 slots requested: %u slots\n", shm->num_slots);
+	pcu_shm_free(shm);
+}
+
+static void test_tx(void *ctx, uint32_t start)
+{
+	struct gsm_pcu_if prim = { .msg_type = PCU_IF_MSG_DATA_IND };
+	struct pcu_side pcu;
+	struct pcu_shm *shm;
+	unsigned int i;
+	int rc;
+
+	printf("%s(start=0x%08x)\n", __func__, start);
+
+	shm = pcu_shm_alloc(ctx, 4);
+	ASSERT_TRUE(shm != NULL);
+	pcu_side_map(&pcu, shm);
+	/* free running indexes about to wrap */
+	shm->tx_head = pcu.tx->head = pcu.tx->tail = start;
+
+	for (i = 0; i < 5; i++) {
+		rc = push_time_ind(shm, i);
+		printf("push fn=%u: %d\n", i, rc);
+	}
+
+	printf("consumed fn=%d\n", pcu_side_consume(&pcu));
+	printf("push fn=5: %d\n", push_time_ind(shm, 5));
+	while ((rc = pcu_side_consume(&pcu)) >= 0)
+		printf("consumed fn=%d\n", rc);
+
+	/* larger than a slot, can't ever be sent */
+	rc = pcu_shm_push(shm, &prim, pcu.cnf.slot_size);
+	printf("push of a slot_size primitive: %s\n", rc == -EMSGSIZE ? "-EMSGSIZE" : "unexpected");
+	ASSERT_TRUE(pcu.tx->head == pcu.tx->tail);
+
+	munmap(pcu.mem, pcu.size);
+	pcu_shm_free(shm);
+}
+
+static void test_rx(void *ctx)
+{
+	struct gsm_pcu_if *prim;
+	struct pcu_side pcu;
+	struct pcu_shm *shm;
+	size_t len;
+
+	printf("%s\n", __func__);
+
+	shm = pcu_shm_alloc(ctx, 4);
+	ASSERT_TRUE(shm != NULL);
+	pcu_side_map(&pcu, shm);
+
+	ASSERT_TRUE(pcu_shm_peek(shm, &len) == NULL);
+
+	pcu_side_produce(&pcu, PCUIF_HDR_SIZE + sizeof(prim->u.time_ind), 1);
+	/* shorter than the header, and longer than the slot */
+	pcu_side_produce(&pcu, PCUIF_HDR_SIZE - 1, 2);
+	pcu_side_produce(&pcu, pcu.cnf.slot_size, 3);
+	pcu_side_produce(&pcu, PCUIF_HDR_SIZE + sizeof(prim->u.time_ind), 4);
+
+	while ((prim = pcu_shm_peek(shm, &len))) {
+		printf("peek: fn=%u, %s\n", prim->u.time_ind.fn,
+		       len == PCUIF_HDR_SIZE + sizeof(prim->u.time_ind) ? "len ok" : "len wrong");
+		/* the slot is not released before pop */
+		ASSERT_TRUE(pcu_shm_peek(shm, &len) == prim);
+		pcu_shm_pop(shm);
+	}
+	printf("rx ring tail=%u head=%u\n", pcu.rx->tail, pcu.rx->head);
+
+	munmap(pcu.mem, pcu.size);
+	pcu_shm_free(shm);
+}
+
+static void test_eventfd(void *ctx)
+{
+	struct pcu_shm *shm;
+	uint64_t val = 1;
+
+	printf("%s\n", __func__);
+
+	shm = pcu_shm_alloc(ctx, 4);
+	ASSERT_TRUE(shm != NULL);
+
+	/* signals of the BTS accumulate until the PCU reads them */
+	ASSERT_TRUE(pcu_shm_signal(shm) == 0);
+	ASSERT_TRUE(pcu_shm_signal(shm) == 0);
+	ASSERT_TRUE(read(shm->tx_efd, &val, sizeof(val)) == sizeof(val));
+	printf("PCU read %u signals\n", (unsigned int) val);
+
+	/* acknowledging twice does not block */
+	val = 1;
+	ASSERT_TRUE(write(shm->rx_efd, &val, sizeof(val)) == sizeof(val));
+	printf("ack: %d\n", pcu_shm_ack(shm));
+	printf("ack: %d\n", pcu_shm_ack(shm));
+
+	pcu_shm_free(shm);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 1, "pcu_shm_test");
+
+	osmo_init_logging2(ctx, &bts_log_info);
+
+	test_layout(ctx);
+	test_tx(ctx, 0);
+	test_tx(ctx, UINT32_MAX - 1);
+	test_rx(ctx);
+	test_eventfd(ctx);
+
+	printf("Success\n");
+	return 0;
+}
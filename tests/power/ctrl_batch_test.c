@@ -0,0 +1,284 @@
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+
+#include <osmo-bts/bts.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/l1sap.h>
+#include <osmo-bts/power_control.h>
+#include <osmo-bts/ta_control.h>
+
+#include <stdio.h>
+
+#define NUM_PERIODS	64
+
+static struct gsm_bts *g_bts = NULL;
+/* the control loops of trx[0] run batched, those of trx[1] per lchan */
+static struct gsm_bts_trx *g_trx[2] = { NULL, NULL };
+
+/* simple deterministic pseudo random numbers */
+static uint32_t rnd_state = 1;
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) & 0xffffff;
+}
+
+static struct gsm_lchan *lchan_by_idx(struct gsm_bts_trx *trx, unsigned int idx)
+{
+	struct gsm_bts_trx_ts *ts = &trx->ts[idx % TRX_NR_TS];
+
+	/* the second half of the lchans are VAMOS shadow lchans */
+	if (idx >= TRX_NR_TS * TS_MAX_LCHAN)
+		ts = ts->vamos.peer;
+	return &ts->lchan[(idx / TRX_NR_TS) % TS_MAX_LCHAN];
+}
+
+static void init_meas_params(struct gsm_power_ctrl_meas_params *mp)
+{
+	if (rnd() % 2) {
+		mp->algo = GSM_PWR_CTRL_MEAS_AVG_ALGO_OSMO_EWMA;
+		mp->ewma.alpha = 1 + rnd() % 99;
+	}
+}
+
+static void init_lchan(struct gsm_lchan *lchan, unsigned int idx)
+{
+	static const enum gsm_chan_t types[] = {
+		GSM_LCHAN_SDCCH, GSM_LCHAN_TCH_F, GSM_LCHAN_TCH_H, GSM_LCHAN_PDTCH,
+	};
+	struct gsm_power_ctrl_params *params;
+
+	lchan->state = LCHAN_S_ACTIVE;
+	lchan->type = types[idx % ARRAY_SIZE(types)];
+	lchan->tch_mode = (idx / 4) % 2 ? GSM48_CMODE_SPEECH_AMR : GSM48_CMODE_SPEECH_V1;
+
+	params = &lchan->ms_dpc_params;
+	power_ctrl_params_def_reset(params, false);
+	params->ctrl_interval = idx % 3;
+	init_meas_params(&params->rxlev_meas);
+	init_meas_params(&params->ci_fr_meas);
+	init_meas_params(&params->ci_hr_meas);
+	init_meas_params(&params->ci_amr_fr_meas);
+	init_meas_params(&params->ci_amr_hr_meas);
+	init_meas_params(&params->ci_sdcch_meas);
+	init_meas_params(&params->ci_gprs_meas);
+	lchan->ms_power_ctrl.dpc_params = params;
+	lchan->ms_power_ctrl.current = 15;
+	lchan->ms_power_ctrl.max = 2;
+
+	params = &lchan->bs_dpc_params;
+	power_ctrl_params_def_reset(params, true);
+	params->ctrl_interval = idx % 2;
+	init_meas_params(&params->rxlev_meas);
+	init_meas_params(&params->rxqual_meas);
+	lchan->bs_power_ctrl.dpc_params = params;
+	lchan->bs_power_ctrl.current = 0;
+	lchan->bs_power_ctrl.max = 2 * 10;
+
+	lchan->ta_ctrl.current = idx % 64;
+}
+
+static void init_test(const char *name)
+{
+	unsigned int i, n;
+
+	if (g_bts != NULL)
+		talloc_free(g_bts);
+
+	g_bts = talloc_zero(tall_bts_ctx, struct gsm_bts);
+	OSMO_ASSERT(g_bts != NULL);
+
+	INIT_LLIST_HEAD(&g_bts->trx_list);
+	g_bts->band = GSM_BAND_1800;
+
+	for (n = 0; n < ARRAY_SIZE(g_trx); n++) {
+		g_trx[n] = gsm_bts_trx_alloc(g_bts);
+		OSMO_ASSERT(g_trx[n] != NULL);
+		gsm_bts_trx_init_shadow_ts(g_trx[n]);
+		g_trx[n]->ms_pwr_ctl_soft = true;
+		g_trx[n]->ta_ctrl_interval = 1;
+
+		/* same parameters for the lchans of both TRX */
+		rnd_state = 1;
+		for (i = 0; i < LCHAN_CTRL_BATCH_MAX; i++)
+			init_lchan(lchan_by_idx(g_trx[n], i), i);
+	}
+	g_bts->c0 = g_trx[0];
+
+	printf("\nStarting test case '%s'\n", name);
+}
+
+static void check_meas_proc(const struct gsm_power_ctrl_meas_proc_state *a,
+			    const struct gsm_power_ctrl_meas_proc_state *b)
+{
+	OSMO_ASSERT(a->meas_num == b->meas_num);
+	OSMO_ASSERT(a->ewma.Avg100 == b->ewma.Avg100);
+}
+
+static void check_power_ctrl(const struct lchan_power_ctrl_state *a,
+			     const struct lchan_power_ctrl_state *b)
+{
+	OSMO_ASSERT(a->current == b->current);
+	OSMO_ASSERT(a->skip_block_num == b->skip_block_num);
+	check_meas_proc(&a->rxlev_meas_proc, &b->rxlev_meas_proc);
+	check_meas_proc(&a->rxqual_meas_proc, &b->rxqual_meas_proc);
+	check_meas_proc(&a->ci_meas_proc, &b->ci_meas_proc);
+}
+
+static void check_lchan(const struct gsm_lchan *a, const struct gsm_lchan *b)
+{
+	check_power_ctrl(&a->ms_power_ctrl, &b->ms_power_ctrl);
+	check_power_ctrl(&a->bs_power_ctrl, &b->bs_power_ctrl);
+	OSMO_ASSERT(a->ta_ctrl.current == b->ta_ctrl.current);
+	OSMO_ASSERT(a->ta_ctrl.skip_block_num == b->ta_ctrl.skip_block_num);
+}
+
+/* Feed one SACCH period worth of measurements for all lchans into both TRX.
+ * If same_fn is set, the SACCH blocks of all lchans end in the same TDMA frame. */
+static void feed_period(unsigned int period, bool same_fn)
+{
+	unsigned int i, n_changed = 0;
+
+	for (i = 0; i < LCHAN_CTRL_BATCH_MAX; i++) {
+		struct gsm_lchan *lchan = lchan_by_idx(g_trx[0], i);
+		struct gsm_lchan *ref = lchan_by_idx(g_trx[1], i);
+		/* TCH/F: the SACCH blocks of two timeslots end in the same TDMA frame */
+		uint32_t fn = period * 104 + (same_fn ? 0 : (i % TRX_NR_TS) / 2 * 26) + 12;
+		struct gsm48_meas_res mr = {
+			.rxlev_full = rnd() % 64,
+			.rxqual_full = rnd() % 8,
+			.rxlev_sub = rnd() % 64,
+			.rxqual_sub = rnd() % 8,
+		};
+		bool mr_valid = rnd() % 4 != 0;
+		bool dl_dtx = rnd() % 2;
+		int8_t ul_rssi_dbm = -110 + rnd() % 70;
+		int16_t ul_lqual_cb = -50 + rnd() % 300;
+		int16_t toa256 = -1024 + rnd() % 2048;
+
+		ref->tch.dtx.dl_active = dl_dtx;
+		lchan_ms_ta_ctrl(ref, ref->ta_ctrl.current, toa256);
+		lchan_ms_pwr_ctrl(ref, ref->ms_power_ctrl.current, ul_rssi_dbm, ul_lqual_cb);
+		if (mr_valid)
+			lchan_bs_pwr_ctrl(ref, &mr);
+
+		lchan->tch.dtx.dl_active = dl_dtx;
+		lchan_ctrl_batch_add(lchan, fn, lchan->ta_ctrl.current, toa256,
+				     lchan->ms_power_ctrl.current, ul_rssi_dbm, ul_lqual_cb,
+				     mr_valid ? &mr : NULL);
+	}
+
+	if (same_fn)
+		OSMO_ASSERT(g_trx[0]->ctrl_batch->num == LCHAN_CTRL_BATCH_MAX);
+	lchan_ctrl_batch_flush(g_trx[0]);
+
+	for (i = 0; i < LCHAN_CTRL_BATCH_MAX; i++) {
+		struct gsm_lchan *lchan = lchan_by_idx(g_trx[0], i);
+
+		check_lchan(lchan, lchan_by_idx(g_trx[1], i));
+		if (lchan->ms_power_ctrl.current != 15 || lchan->bs_power_ctrl.current != 0)
+			n_changed++;
+	}
+
+	/* make sure that the loops did actually do something */
+	if (period == NUM_PERIODS - 1) {
+		OSMO_ASSERT(n_changed > 0);
+		printf("%u lchans match after %u SACCH periods\n",
+		       LCHAN_CTRL_BATCH_MAX, NUM_PERIODS);
+	}
+}
+
+static void test_batch_vs_lchan(void)
+{
+	unsigned int period;
+
+	init_test(__func__);
+
+	for (period = 0; period < NUM_PERIODS; period++)
+		feed_period(period, false);
+}
+
+static void test_batch_full(void)
+{
+	unsigned int period;
+
+	init_test(__func__);
+
+	for (period = 0; period < NUM_PERIODS; period++)
+		feed_period(period, true);
+}
+
+static void test_batch_cancel(void)
+{
+	struct gsm_lchan *lchan_rel, *lchan_cancel, *lchan;
+	struct gsm_lchan ref_rel, ref_cancel;
+
+	init_test(__func__);
+
+	lchan = lchan_by_idx(g_trx[0], 0);
+	lchan_rel = lchan_by_idx(g_trx[0], 1);
+	lchan_cancel = lchan_by_idx(g_trx[0], 2);
+
+	/* SACCH blocks of lchans which are released or re-activated before the
+	 * loops run must not touch the lchan anymore */
+	lchan_ctrl_batch_add(lchan, 12, 0, 512, 0, -110, 0, NULL);
+	lchan_ctrl_batch_add(lchan_rel, 12, 0, 512, 0, -110, 0, NULL);
+	lchan_ctrl_batch_add(lchan_cancel, 12, 0, 512, 0, -110, 0, NULL);
+
+	lchan_rel->state = LCHAN_S_NONE;
+	lchan_ctrl_batch_cancel(lchan_cancel);
+	ref_rel = *lchan_rel;
+	ref_cancel = *lchan_cancel;
+
+	/* a SACCH block in another TDMA frame runs the loops of the previous one */
+	lchan_ctrl_batch_add(lchan, 38, 2, 0, 15, -75, 0, NULL);
+	OSMO_ASSERT(g_trx[0]->ctrl_batch->num == 1);
+
+	check_lchan(lchan_rel, &ref_rel);
+	check_lchan(lchan_cancel, &ref_cancel);
+	printf("Released and cancelled lchans are untouched\n");
+
+	lchan_ctrl_batch_flush(g_trx[0]);
+	OSMO_ASSERT(g_trx[0]->ctrl_batch->num == 0);
+}
+
+int main(int argc, char **argv)
+{
+	printf("Testing batched SACCH control loops...\n");
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	log_set_print_filename2(osmo_stderr_target, LOG_FILENAME_NONE);
+	log_set_use_color(osmo_stderr_target, 0);
+	log_set_print_category(osmo_stderr_target, 0);
+	log_set_print_category_hex(osmo_stderr_target, 0);
+
+	test_batch_vs_lchan();
+	test_batch_full();
+	test_batch_cancel();
+
+	printf("Batched SACCH control loops test OK\n");
+
+	return 0;
+}
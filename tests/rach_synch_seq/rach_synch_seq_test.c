@@ -0,0 +1,214 @@
+/* testing the synch. sequence detection of Access Bursts */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/rach_synch_seq.h>
+
+#define BURST_LEN	148
+#define NUM_BURSTS	4096
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+static const char synch_seq_str[RACH_SYNCH_SEQ_NUM][RACH_SYNCH_SEQ_LEN + 1] = {
+	[RACH_SYNCH_SEQ_TS0] = "01001011011111111001100110101010001111000",
+	[RACH_SYNCH_SEQ_TS1] = "01010100111110001000011000101111001001101",
+	[RACH_SYNCH_SEQ_TS2] = "11101111001001110101011000001101101110111",
+};
+
+static sbit_t bursts[NUM_BURSTS][BURST_LEN];
+
+/* the correlator as it used to be, straight from the character strings */
+static enum rach_synch_seq_t ref_detect(const sbit_t *bits, int *best_score)
+{
+	const sbit_t *synch_seq_burst = bits + RACH_EXT_TAIL_LEN;
+	enum rach_synch_seq_t seq = RACH_SYNCH_SEQ_TS0;
+	int score[RACH_SYNCH_SEQ_NUM] = { 0 };
+	int max_score = INT_MIN;
+	int i, j;
+
+	for (i = 0; i < RACH_SYNCH_SEQ_NUM; i++) {
+		for (j = 0; j < RACH_SYNCH_SEQ_LEN; j++)
+			score[i] += (synch_seq_str[i][j] == '1' ? -1 : 1) * synch_seq_burst[j];
+		if (score[i] > max_score) {
+			max_score = score[i];
+			seq = i;
+		}
+	}
+
+	*best_score = max_score;
+	if (max_score < (127 * RACH_SYNCH_SEQ_LEN / 3))
+		return RACH_SYNCH_SEQ_UNKNOWN;
+	return seq;
+}
+
+static unsigned int rand_state = 1;
+
+static int test_rand(void)
+{
+	/* deterministic across platforms, unlike rand() */
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 16) & 0x7fff;
+}
+
+static sbit_t soft_bit(char bit, int level)
+{
+	return bit == '1' ? -level : level;
+}
+
+static void burst_fill(sbit_t *burst, int seq, int level, int noise)
+{
+	int i, v;
+
+	for (i = 0; i < BURST_LEN; i++) {
+		if (seq >= 0 && i >= RACH_EXT_TAIL_LEN && i < RACH_EXT_TAIL_LEN + RACH_SYNCH_SEQ_LEN)
+			v = soft_bit(synch_seq_str[seq][i - RACH_EXT_TAIL_LEN], level);
+		else
+			v = (test_rand() & 1) ? level : -level;
+		if (noise > 0)
+			v += test_rand() % (2 * noise + 1) - noise;
+		burst[i] = OSMO_MAX(-127, OSMO_MIN(127, v));
+	}
+}
+
+static void test_clean_bursts(void)
+{
+	enum rach_synch_seq_t detected;
+	sbit_t burst[BURST_LEN];
+	int seq, score;
+
+	printf("\n%s\n", __func__);
+
+	for (seq = 0; seq < RACH_SYNCH_SEQ_NUM; seq++) {
+		burst_fill(burst, seq, 127, 0);
+		detected = rach_synch_seq_detect(burst, &score);
+		printf("%s: detected %s, score %d\n", get_value_string(rach_synch_seq_names, seq),
+		       get_value_string(rach_synch_seq_names, detected), score);
+	}
+
+	burst_fill(burst, -1, 0, 0);
+	detected = rach_synch_seq_detect(burst, &score);
+	printf("no signal: detected %s, score %d\n",
+	       get_value_string(rach_synch_seq_names, detected), score);
+}
+
+/* noisy and random bursts must be classified exactly like before */
+static void test_against_reference(void)
+{
+	const sbit_t *batch[RACH_SYNCH_SEQ_BATCH_MAX];
+	enum rach_synch_seq_t seq[RACH_SYNCH_SEQ_BATCH_MAX], ref_seq;
+	int score[RACH_SYNCH_SEQ_BATCH_MAX], ref_score;
+	unsigned int detected[RACH_SYNCH_SEQ_NUM + 1] = { 0 };
+	unsigned int i, j;
+
+	printf("\n%s\n", __func__);
+
+	for (i = 0; i < NUM_BURSTS; i++)
+		burst_fill(bursts[i], (int) (i % 4) - 1, 20 + i % 100, i % 160);
+
+	for (i = 0; i < NUM_BURSTS; i += RACH_SYNCH_SEQ_BATCH_MAX) {
+		for (j = 0; j < RACH_SYNCH_SEQ_BATCH_MAX; j++)
+			batch[j] = bursts[i + j];
+		rach_synch_seq_detect_batch(batch, RACH_SYNCH_SEQ_BATCH_MAX, seq, score);
+
+		for (j = 0; j < RACH_SYNCH_SEQ_BATCH_MAX; j++) {
+			ref_seq = ref_detect(bursts[i + j], &ref_score);
+			ASSERT_TRUE(seq[j] == ref_seq);
+			ASSERT_TRUE(score[j] == ref_score);
+			ASSERT_TRUE(rach_synch_seq_detect(bursts[i + j], NULL) == ref_seq);
+			detected[seq[j] + 1]++;
+		}
+	}
+
+	printf("%u bursts match the reference\n", NUM_BURSTS);
+	for (i = 0; i < ARRAY_SIZE(detected); i++)
+		printf("  %s: %u\n", get_value_string(rach_synch_seq_names, (int) i - 1), detected[i]);
+}
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+/* not part of the expected output, gives an idea of the per-burst cost */
+static void bench_detect(void)
+{
+	const unsigned int rounds = 200;
+	const sbit_t *batch[RACH_SYNCH_SEQ_BATCH_MAX];
+	enum rach_synch_seq_t seq[RACH_SYNCH_SEQ_BATCH_MAX];
+	struct timespec start, end;
+	unsigned int i, j, r;
+	volatile int sink = 0;
+	int score;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < NUM_BURSTS; i++)
+			sink += ref_detect(bursts[i], &score);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fprintf(stderr, "reference: %.1f ns per burst\n", elapsed_ns(&start, &end) / (rounds * NUM_BURSTS));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < NUM_BURSTS; i++)
+			sink += rach_synch_seq_detect(bursts[i], &score);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fprintf(stderr, "single: %.1f ns per burst\n", elapsed_ns(&start, &end) / (rounds * NUM_BURSTS));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < NUM_BURSTS; i += RACH_SYNCH_SEQ_BATCH_MAX) {
+			for (j = 0; j < RACH_SYNCH_SEQ_BATCH_MAX; j++)
+				batch[j] = bursts[i + j];
+			rach_synch_seq_detect_batch(batch, RACH_SYNCH_SEQ_BATCH_MAX, seq, NULL);
+			sink += seq[0];
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fprintf(stderr, "batch of %u: %.1f ns per burst\n", RACH_SYNCH_SEQ_BATCH_MAX,
+		elapsed_ns(&start, &end) / (rounds * NUM_BURSTS));
+}
+
+int main(int argc, char **argv)
+{
+	printf("Testing RACH synch. sequence detection\n");
+
+	test_clean_bursts();
+	test_against_reference();
+	bench_detect();
+
+	printf("\nSuccess\n");
+	return 0;
+}
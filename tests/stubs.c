@@ -42,6 +42,9 @@ uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx)
 __attribute__((weak)) int bts_model_oml_estab(struct gsm_bts *bts)
 { return 0; }
 
+int bts_model_warm_start(struct gsm_bts *bts)
+{ return 0; }
+
 __attribute__((weak)) int bts_model_change_power(struct gsm_bts_trx *trx, int p_trxout_mdBm)
 { return 0; }
 
@@ -57,10 +60,10 @@ int bts_model_adjst_ms_pwr(struct gsm_lchan *lchan)
 __attribute__((weak)) void bts_model_abis_close(struct gsm_bts *bts)
 { }
 
-int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
+__attribute__((weak)) int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 { return 0; }
 
-void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
+__attribute__((weak)) void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
 			 enum gsm_phys_chan_config as_pchan)
 { return; }
 
@@ -0,0 +1,153 @@
+/* testing the binary burst trace of osmo-bts-trx */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/scheduler.h>
+#include <osmo-bts/scheduler_backend.h>
+#include <osmo-bts/burst_trace.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+#define NUM_WRITERS	3
+#define NUM_CYCLES	200
+
+/* burst_trace_start() copies the names into the file, nothing else of the
+ * scheduler is needed here */
+const struct trx_chan_desc trx_chan_desc[_TRX_CHAN_MAX] = {
+	[TRXC_TCHF]	= { .name = "TCH/F" },
+	[TRXC_SDCCH8_0]	= { .name = "SDCCH/8(0)" },
+};
+
+static bool writers_stop;
+
+static void *writer_main(void *arg)
+{
+	uint32_t fn = 0;
+
+	while (!__atomic_load_n(&writers_stop, __ATOMIC_RELAXED)) {
+		BURST_TRACE(0, 1, TRXC_TCHF, fn, BURST_TRACE_EV_UL_TCHF, fn % 4, 0, 0, 0);
+		fn++;
+	}
+
+	return NULL;
+}
+
+/* The trace is stopped and restarted while other threads keep writing */
+static void test_stop_concurrent(const char *path)
+{
+	pthread_t writers[NUM_WRITERS];
+	unsigned int i;
+
+	printf("\n%s()\n", __func__);
+
+	for (i = 0; i < NUM_WRITERS; i++)
+		ASSERT_TRUE(pthread_create(&writers[i], NULL, writer_main, NULL) == 0);
+
+	for (i = 0; i < NUM_CYCLES; i++) {
+		ASSERT_TRUE(burst_trace_start(path, BURST_TRACE_RECS_MIN) == 0);
+		burst_trace_stop();
+	}
+
+	__atomic_store_n(&writers_stop, true, __ATOMIC_RELAXED);
+	for (i = 0; i < NUM_WRITERS; i++)
+		pthread_join(writers[i], NULL);
+
+	printf("%u start/stop cycles with %u writer threads\n", NUM_CYCLES, NUM_WRITERS);
+	ASSERT_TRUE(g_burst_trace.num_writers == 0);
+	unlink(path);
+}
+
+/* Leave a trace for osmo-bts-burst-trace, see testsuite.at */
+static void test_write(const char *path)
+{
+	static const char bad_fmt[] = "%s";
+	unsigned int i;
+	int fd;
+
+	printf("\n%s()\n", __func__);
+
+	ASSERT_TRUE(burst_trace_start(path, 0) == 0);
+	printf("%u records\n", g_burst_trace.num_recs);
+
+	/* more than fit into the ring */
+	for (i = 0; i < BURST_TRACE_RECS_MIN + 10; i++)
+		BURST_TRACE(0, 0, TRXC_SDCCH8_0, i, BURST_TRACE_EV_DL_BURST, i % 4, 0, 0, 0);
+
+	BURST_TRACE(0, 2, TRXC_TCHF, 100, BURST_TRACE_EV_TRXD_RX, -60, 12, 30, 0x00);
+	BURST_TRACE(0, 2, TRXC_TCHF, 101, BURST_TRACE_EV_UL_TCHF, 3, 0, 0, 0);
+	BURST_TRACE(0, 2, TRXC_TCHF, 102, BURST_TRACE_EV_UL_DATA, 1, 0, 0, 0);
+	BURST_TRACE(0, 2, BURST_TRACE_CHAN_NONE, 103, BURST_TRACE_EV_DL_FCCH, 0, 0, 0, 0);
+	BURST_TRACE(1, 2, TRXC_SDCCH8_0, 104, BURST_TRACE_EV_DL_BURST, 1, 0, 0, 0);
+	/* an event of a newer version */
+	BURST_TRACE(0, 2, TRXC_TCHF, 105, _BURST_TRACE_EV_MAX, 4, 3, 2, 1);
+
+	printf("%" PRIu64 " records written\n", g_burst_trace.hdr->head);
+	burst_trace_stop();
+
+	/* the decoder must not pass a format it cannot fill to printf() */
+	fd = open(path, O_WRONLY);
+	ASSERT_TRUE(fd >= 0);
+	ASSERT_TRUE(pwrite(fd, bad_fmt, sizeof(bad_fmt),
+			   offsetof(struct burst_trace_hdr, event_fmts[BURST_TRACE_EV_UL_DATA])) == sizeof(bad_fmt));
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_bts_ctx;
+	char *tmp_path;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s FILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+
+	tmp_path = talloc_asprintf(tall_bts_ctx, "%s.tmp", argv[1]);
+	test_stop_concurrent(tmp_path);
+	test_write(argv[1]);
+
+	printf("Success\n");
+
+	return 0;
+}
@@ -0,0 +1,354 @@
+/* testing dynamic timeslot switches with the osmo-bts-trx provisioning FSM */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/fsm.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/gsm/rsl.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/nm_common_fsm.h>
+#include <osmo-bts/phy_link.h>
+#include <osmo-bts/rsl.h>
+
+#include "l1_if.h"
+#include "trx_if.h"
+#include "trx_provision_fsm.h"
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+/* TRXC slot types, see transceiver_chan_types[] in l1_if.c */
+#define SLOTTYPE_TCHF	1
+#define SLOTTYPE_PDCH	13
+
+static struct gsm_bts *bts;
+static struct gsm_bts_trx *trx;
+static struct phy_link *plink;
+static struct trx_l1h *l1h;
+
+/* the last SETSLOT sent, waiting for its RSP */
+static unsigned int num_setslot;
+static trx_if_cmd_setslot_cb *setslot_cb;
+static uint8_t setslot_tn;
+
+static unsigned int num_chan_act_ack;
+
+/*
+ * The parts of osmo-bts-trx around its provisioning FSM
+ */
+
+enum gsm_phys_chan_config transceiver_chan_type_2_pchan(uint8_t type)
+{
+	switch (type) {
+	case SLOTTYPE_TCHF:
+		return GSM_PCHAN_TCH_F;
+	case SLOTTYPE_PDCH:
+		return GSM_PCHAN_PDCH;
+	default:
+		return GSM_PCHAN_UNKNOWN;
+	}
+}
+
+int trx_if_cmd_setslot(struct trx_l1h *l1h, uint8_t tn, trx_if_cmd_setslot_cb *cb)
+{
+	num_setslot++;
+	setslot_cb = cb;
+	setslot_tn = tn;
+	return 0;
+}
+
+int trx_if_cmd_poweron(struct trx_l1h *l1h, trx_if_cmd_poweronoff_cb *cb) { return 0; }
+int trx_if_cmd_poweroff(struct trx_l1h *l1h, trx_if_cmd_poweronoff_cb *cb) { return 0; }
+int trx_if_cmd_settsc(struct trx_l1h *l1h, uint8_t tsc, trx_if_cmd_generic_cb *cb) { return 0; }
+int trx_if_cmd_setbsic(struct trx_l1h *l1h, uint8_t bsic, trx_if_cmd_generic_cb *cb) { return 0; }
+int trx_if_cmd_setrxgain(struct trx_l1h *l1h, int db) { return 0; }
+int trx_if_cmd_getnompower(struct trx_l1h *l1h, trx_if_cmd_getnompower_cb *cb) { return 0; }
+int trx_if_cmd_setmaxdly(struct trx_l1h *l1h, int dly) { return 0; }
+int trx_if_cmd_setmaxdlynb(struct trx_l1h *l1h, int dly) { return 0; }
+int trx_if_cmd_rxtune(struct trx_l1h *l1h, uint16_t arfcn, trx_if_cmd_generic_cb *cb) { return 0; }
+int trx_if_cmd_txtune(struct trx_l1h *l1h, uint16_t arfcn, trx_if_cmd_generic_cb *cb) { return 0; }
+int trx_if_cmd_rfmute(struct trx_l1h *l1h, bool mute) { return 0; }
+int trx_if_cmd_setformat(struct trx_l1h *l1h, uint8_t ver, trx_if_cmd_generic_cb *cb) { return 0; }
+int bts_model_phy_link_close(struct phy_link *plink) { return 0; }
+int trx_sched_clock_started(struct phy_link *plink) { return 0; }
+int trx_sched_clock_stopped(struct phy_link *plink) { return 0; }
+void l1if_trx_set_nominal_power(struct gsm_bts_trx *trx, int nominal_power) { }
+int l1if_trx_start_power_ramp(struct gsm_bts_trx *trx, ramp_compl_cb_t ramp_compl_cb) { return 0; }
+
+int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
+{
+	cb_ts_disconnected(ts);
+	return 0;
+}
+
+/* Like bts_model_ts_connect() of osmo-bts-trx, minus the scheduler */
+void bts_model_ts_connect(struct gsm_bts_trx_ts *ts, enum gsm_phys_chan_config as_pchan)
+{
+	struct trx_prov_ev_cfg_ts_data data = {
+		.tn = ts->nr,
+		.slottype = as_pchan == GSM_PCHAN_PDCH ? SLOTTYPE_PDCH : SLOTTYPE_TCHF,
+	};
+
+	data.early_connect = plink->u.osmotrx.early_ts_connect &&
+			     l1h->provision_fi->state == TRX_PROV_ST_OPEN_POWERON;
+	osmo_fsm_inst_dispatch(l1h->provision_fi, TRX_PROV_EV_CFG_TS, &data);
+	if (data.early_connect)
+		cb_ts_connected(ts, 0);
+}
+
+/* the transceiver answers the last SETSLOT */
+static void rsp_setslot(int rc)
+{
+	trx_if_cmd_setslot_cb *cb = setslot_cb;
+
+	ASSERT_TRUE(cb != NULL);
+	setslot_cb = NULL;
+	cb(l1h, setslot_tn, l1h->config.setslot[setslot_tn].slottype, rc);
+}
+
+/* what goes to the BSC */
+int abis_sendmsg(struct msgb *msg)
+{
+	struct abis_rsl_common_hdr *rh = (struct abis_rsl_common_hdr *)msg->data;
+
+	if (rh->msg_type == RSL_MT_CHAN_ACTIV_ACK)
+		num_chan_act_ack++;
+	msgb_free(msg);
+	return 0;
+}
+
+static void send_pdch_activ(uint8_t tn)
+{
+	struct msgb *msg = msgb_alloc_headroom(128, 64, __func__);
+
+	msgb_tv_put(msg, RSL_IE_ACT_TYPE, RSL_ACT_OSMO_PDCH);
+	rsl_dch_push_hdr(msg, RSL_MT_CHAN_ACTIV, RSL_CHAN_OSMO_PDCH | tn);
+	msg->l2h = msg->data;
+	msg->trx = trx;
+	down_rsl(trx, msg);
+}
+
+static void clock_advance_ms(unsigned int ms)
+{
+	osmo_clock_override_add(CLOCK_MONOTONIC, ms / 1000, (ms % 1000) * 1000000);
+}
+
+static void print_ts(const struct gsm_bts_trx_ts *ts)
+{
+	printf("TS%u: %s, CHAN ACTIV %s, switching: %s, SETSLOT sent: %u, CHAN ACTIV ACK sent: %u\n",
+	       ts->nr, gsm_pchan_name(ts->dyn.pchan_is),
+	       ts->lchan[0].pending_chan_activ ? "pending" : "done",
+	       ts->dyn.switching ? "yes" : "no", num_setslot, num_chan_act_ack);
+}
+
+static void print_switch_ctrs(void)
+{
+	unsigned int i;
+
+	for (i = BTS_CTR_DYN_TS_SWITCH; i <= BTS_CTR_DYN_TS_SWITCH_GE_200MS; i++) {
+		printf("  %s: %" PRIu64 "\n", bts->ctrs->desc->ctr_desc[i].name,
+		       rate_ctr_group_get_ctr(bts->ctrs, i)->current);
+	}
+}
+
+static void dyn_ts_init(uint8_t tn)
+{
+	struct gsm_bts_trx_ts *ts = &trx->ts[tn];
+
+	ts->pchan = GSM_PCHAN_OSMO_DYN;
+	ts->mo.nm_state.operational = NM_OPSTATE_ENABLED;
+	ts->mo.nm_state.availability = NM_AVSTATE_OK;
+	ts->mo.fi->state = NM_CHAN_ST_OP_ENABLED;
+}
+
+/* The timeslot is reported connected before SETSLOT is sent: the CHAN ACTIV
+ * is continued from within its own re-connect */
+static void test_early_connect(void)
+{
+	struct gsm_bts_trx_ts *ts = &trx->ts[1];
+
+	printf("\n%s()\n", __func__);
+
+	plink->u.osmotrx.early_ts_connect = true;
+	dyn_ts_init(ts->nr);
+
+	send_pdch_activ(ts->nr);
+	print_ts(ts);
+	ASSERT_TRUE(ts->dyn.pchan_is == GSM_PCHAN_PDCH);
+	ASSERT_TRUE(ts->lchan[0].pending_chan_activ == NULL);
+
+	/* nobody waits for it */
+	rsp_setslot(0);
+	print_ts(ts);
+	print_switch_ctrs();
+}
+
+/* PDCH -> NONE -> PDCH: the transceiver has the slot configured already */
+static void test_setslot_skipped(void)
+{
+	struct gsm_bts_trx_ts *ts = &trx->ts[1];
+
+	printf("\n%s()\n", __func__);
+
+	/* as if the PCU released the PDCH */
+	ts->dyn.pchan_is = GSM_PCHAN_NONE;
+
+	send_pdch_activ(ts->nr);
+	print_ts(ts);
+	ASSERT_TRUE(setslot_cb == NULL);
+	print_switch_ctrs();
+}
+
+/* Without early connect, the switch is done with the RSP SETSLOT */
+static void test_latency(void)
+{
+	static const unsigned int delay_ms[] = { 5, 20, 100, 300 };
+	unsigned int i;
+
+	printf("\n%s()\n", __func__);
+
+	plink->u.osmotrx.early_ts_connect = false;
+
+	for (i = 0; i < ARRAY_SIZE(delay_ms); i++) {
+		struct gsm_bts_trx_ts *ts = &trx->ts[2 + i];
+
+		dyn_ts_init(ts->nr);
+		send_pdch_activ(ts->nr);
+		print_ts(ts);
+
+		clock_advance_ms(delay_ms[i]);
+		printf("RSP SETSLOT after %u ms\n", delay_ms[i]);
+		rsp_setslot(0);
+		print_ts(ts);
+	}
+
+	print_switch_ctrs();
+}
+
+/* A failed switch is not counted, and is not ongoing anymore */
+static void test_connect_error(void)
+{
+	struct gsm_bts_trx_ts *ts = &trx->ts[6];
+
+	printf("\n%s()\n", __func__);
+
+	dyn_ts_init(ts->nr);
+	send_pdch_activ(ts->nr);
+	ASSERT_TRUE(ts->dyn.switching);
+
+	clock_advance_ms(1);
+	printf("RSP SETSLOT failed\n");
+	rsp_setslot(-EIO);
+	ASSERT_TRUE(!ts->dyn.switching);
+	print_switch_ctrs();
+}
+
+/* A failed SETSLOT after the timeslot was reported connected early takes the
+ * timeslot out of service, and it is configured again once back in service */
+static void test_early_connect_error(void)
+{
+	struct gsm_bts_trx_ts *ts = &trx->ts[7];
+
+	printf("\n%s()\n", __func__);
+
+	plink->u.osmotrx.early_ts_connect = true;
+	dyn_ts_init(ts->nr);
+
+	send_pdch_activ(ts->nr);
+	print_ts(ts);
+	ASSERT_TRUE(ts->dyn.pchan_is == GSM_PCHAN_PDCH);
+
+	printf("RSP SETSLOT failed\n");
+	rsp_setslot(-EIO);
+	printf("TS%u: NM state %s\n", ts->nr, osmo_fsm_inst_state_name(ts->mo.fi));
+	ASSERT_TRUE(ts->mo.fi->state == NM_CHAN_ST_OP_DISABLED_OFFLINE);
+
+	/* back in service: the failed SETSLOT is not taken for configured */
+	dyn_ts_init(ts->nr);
+	ts->dyn.pchan_is = GSM_PCHAN_NONE;
+	send_pdch_activ(ts->nr);
+	print_ts(ts);
+	ASSERT_TRUE(setslot_cb != NULL);
+	rsp_setslot(0);
+	ASSERT_TRUE(l1h->config.setslot_acked[ts->nr]);
+	ASSERT_TRUE(ts->mo.fi->state == NM_CHAN_ST_OP_ENABLED);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_bts_ctx;
+	struct phy_instance *pinst;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+
+	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
+	ASSERT_TRUE(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	ASSERT_TRUE(bts != NULL);
+	ASSERT_TRUE(bts_init(bts) == 0);
+	trx = bts->c0;
+
+	plink = phy_link_create(tall_bts_ctx, 0);
+	ASSERT_TRUE(plink != NULL);
+	pinst = phy_instance_create(plink, 0);
+	ASSERT_TRUE(pinst != NULL);
+	phy_instance_link_to_trx(pinst, trx);
+
+	l1h = talloc_zero(tall_bts_ctx, struct trx_l1h);
+	l1h->phy_inst = pinst;
+	pinst->u.osmotrx.hdl = l1h;
+	l1h->provision_fi = osmo_fsm_inst_alloc(&trx_prov_fsm, l1h, l1h, LOGL_INFO, NULL);
+	ASSERT_TRUE(l1h->provision_fi != NULL);
+	/* the transceiver is up and running, skip the provisioning */
+	l1h->provision_fi->state = TRX_PROV_ST_OPEN_POWERON;
+
+	test_early_connect();
+	test_setslot_skipped();
+	test_latency();
+	test_connect_error();
+	test_early_connect_error();
+
+	printf("Success\n");
+
+	return 0;
+}
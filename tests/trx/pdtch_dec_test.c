@@ -0,0 +1,318 @@
+/* testing the choice of the Uplink PDTCH decoder of osmo-bts-trx */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/scheduler.h>
+#include <osmo-bts/scheduler_backend.h>
+
+#include <sched_ul_dec.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+static const struct rate_ctr_desc l1ts_ctr_desc[] = {
+	[L1SCHED_TS_CTR_DL_LATE] =	{"l1sched_ts:dl_late", "unused"},
+	[L1SCHED_TS_CTR_DL_NOT_FOUND] =	{"l1sched_ts:dl_not_found", "unused"},
+	[L1SCHED_TS_CTR_DL_XCCH_CACHE_HIT] = {"l1sched_ts:dl_xcch_cache_hit", "unused"},
+	[L1SCHED_TS_CTR_DL_XCCH_CACHE_MISS] = {"l1sched_ts:dl_xcch_cache_miss", "unused"},
+	[L1SCHED_TS_CTR_UL_PDTCH_DEC_FALLBACK] = {"l1sched_ts:ul_pdtch_dec_fallback", "both decoders"},
+	[L1SCHED_TS_CTR_UL_PDTCH_HINT_MISMATCH] = {"l1sched_ts:ul_pdtch_hint_mismatch", "hint mismatch"},
+};
+static const struct rate_ctr_group_desc l1ts_ctrg_desc = {
+	"l1sched_ts",
+	"L1 scheduler timeslot",
+	OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(l1ts_ctr_desc),
+	l1ts_ctr_desc
+};
+
+/* Stealing bits q(0..7) of CS-1..CS-4, MCS-1..MCS-4 use the ones of CS-4 */
+static const ubit_t hl_hn[4][8] = {
+	{ 1, 1, 1, 1, 1, 1, 1, 1 },
+	{ 1, 1, 0, 0, 1, 0, 0, 0 },
+	{ 0, 0, 1, 0, 0, 0, 0, 1 },
+	{ 0, 0, 0, 1, 0, 1, 1, 0 },
+};
+
+enum block_family {
+	BLOCK_GPRS,
+	BLOCK_EGPRS,
+	BLOCK_GARBAGE,	/* neither decoder succeeds */
+};
+
+struct test_block {
+	const char *name;
+	unsigned int cs;		/* stealing bits, index into hl_hn[] */
+	enum block_family family;
+	int len;			/* returned by the matching decoder */
+};
+
+static const struct test_block cs1 = { "CS-1", 0, BLOCK_GPRS, 23 };
+static const struct test_block cs2 = { "CS-2", 1, BLOCK_GPRS, 34 };
+static const struct test_block cs3 = { "CS-3", 2, BLOCK_GPRS, 40 };
+static const struct test_block cs4 = { "CS-4", 3, BLOCK_GPRS, 54 };
+static const struct test_block mcs1 = { "MCS-1", 3, BLOCK_EGPRS, 27 };
+static const struct test_block mcs2 = { "MCS-2", 3, BLOCK_EGPRS, 33 };
+static const struct test_block mcs3 = { "MCS-3", 3, BLOCK_EGPRS, 42 };
+static const struct test_block mcs4 = { "MCS-4", 3, BLOCK_EGPRS, 49 };
+static const struct test_block garbage = { "garbage", 3, BLOCK_GARBAGE, 0 };
+
+static struct gsm_bts *bts;
+static struct l1sched_ts l1ts;
+static uint32_t fn;
+
+/* the block being decoded, and what happened to it */
+static const struct test_block *cur_block;
+static char decoders[32];
+static struct ul_dec_job submitted;
+static bool job_submitted;
+static size_t delivered_len;
+
+/*
+ * Stand-ins for the decoders of libosmocoding: these record the order in
+ * which they are attempted and succeed for blocks of their family only.
+ */
+
+int gsm0503_pdtch_decode(uint8_t *l2_data, const sbit_t *bursts, uint8_t *usf_p,
+			 int *n_errors, int *n_bits_total)
+{
+	osmo_strlcpy(decoders + strlen(decoders), decoders[0] ? " GPRS" : "GPRS",
+		     sizeof(decoders) - strlen(decoders));
+	*n_errors = 0;
+	*n_bits_total = GSM0503_GPRS_BURSTS_NBITS;
+	return cur_block->family == BLOCK_GPRS ? cur_block->len : -1;
+}
+
+int gsm0503_pdtch_egprs_decode(uint8_t *l2_data, const sbit_t *bursts, uint16_t nbits,
+			       uint8_t *usf_p, int *n_errors, int *n_bits_total)
+{
+	osmo_strlcpy(decoders + strlen(decoders), decoders[0] ? " EGPRS" : "EGPRS",
+		     sizeof(decoders) - strlen(decoders));
+	*n_errors = 0;
+	*n_bits_total = nbits;
+	return cur_block->family == BLOCK_EGPRS ? cur_block->len : -1;
+}
+
+/* The Downlink is not tested */
+int gsm0503_pdtch_encode(ubit_t *bursts, const uint8_t *l2_data, uint8_t l2_len) { return -1; }
+int gsm0503_pdtch_egprs_encode(ubit_t *bursts, const uint8_t *l2_data, uint8_t l2_len) { return -1; }
+struct msgb *_sched_dequeue_prim(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br) { return NULL; }
+const ubit_t _sched_train_seq_gmsk_nb[4][8][26];
+const ubit_t _sched_train_seq_8psk_nb[8][78];
+const struct trx_chan_desc trx_chan_desc[_TRX_CHAN_MAX] = {
+	[TRXC_PDTCH] = { .name = "PDTCH" },
+};
+
+/*
+ * The parts of the osmo-bts-trx scheduler around rx_pdtch_fn()
+ */
+
+int rx_rach_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
+{
+	ASSERT_TRUE(0);
+	return 0;
+}
+
+void trx_sched_meas_push(struct l1sched_chan_state *chan_state, const struct trx_ul_burst_ind *bi) { }
+
+void trx_sched_meas_avg(const struct l1sched_chan_state *chan_state, struct l1sched_meas_set *avg,
+			enum sched_meas_avg_mode mode)
+{
+	memset(avg, 0, sizeof(*avg));
+}
+
+/* Like a decoder thread: rx_pdtch_decode() and rx_pdtch_deliver() are run by the test */
+int ul_dec_submit(const struct ul_dec_job *job)
+{
+	submitted = *job;
+	job_submitted = true;
+	return 0;
+}
+
+int _sched_compose_ph_data_ind(struct l1sched_ts *l1ts, uint32_t fn,
+			       enum trx_chan_type chan,
+			       const uint8_t *data, size_t data_len,
+			       uint16_t ber10k, float rssi,
+			       int16_t ta_offs_256bits, int16_t link_qual_cb,
+			       enum osmo_ph_pres_info_type presence_info)
+{
+	delivered_len = data_len;
+	return 0;
+}
+
+static uint64_t ctr_get(unsigned int idx)
+{
+	return rate_ctr_group_get_ctr(l1ts.ctrs, idx)->current;
+}
+
+/* Feed the 4 GMSK bursts of a block, with the stealing bits of its coding
+ * scheme at the given soft-bit amplitude, and the one at flip_pos inverted */
+static void rx_block(const struct test_block *block, sbit_t amplitude, int flip_pos)
+{
+	uint64_t fallback = ctr_get(L1SCHED_TS_CTR_UL_PDTCH_DEC_FALLBACK);
+	uint64_t mismatch = ctr_get(L1SCHED_TS_CTR_UL_PDTCH_HINT_MISMATCH);
+	bool hint = l1ts.chan_state[TRXC_PDTCH].ul_pdtch_egprs;
+	unsigned int bid;
+
+	cur_block = block;
+	decoders[0] = '\0';
+	job_submitted = false;
+
+	for (bid = 0; bid < 4; bid++) {
+		struct trx_ul_burst_ind bi = {
+			.fn = fn++,
+			.chan = TRXC_PDTCH,
+			.bid = bid,
+			.burst_len = GSM_BURST_LEN,
+		};
+		int q = bid * 2;
+
+		/* hl and hn surround the training sequence */
+		bi.burst[3 + 57] = (hl_hn[block->cs][q] ^ (flip_pos == q)) ? -amplitude : amplitude;
+		bi.burst[87] = (hl_hn[block->cs][q + 1] ^ (flip_pos == q + 1)) ? -amplitude : amplitude;
+
+		ASSERT_TRUE(rx_pdtch_fn(&l1ts, &bi) == 0);
+	}
+
+	ASSERT_TRUE(job_submitted);
+	ASSERT_TRUE(submitted.egprs_hint == hint);
+	rx_pdtch_decode(&submitted);
+	rx_pdtch_deliver(&submitted);
+
+	printf("%s%s (expecting %s): tried %s, result %s, fallback: +%" PRIu64 ", mismatch: +%" PRIu64 "\n",
+	       block->name, amplitude < 127 ? " noisy" : (flip_pos >= 0 ? " bit error" : ""),
+	       hint ? "EGPRS" : "GPRS", decoders,
+	       delivered_len ? (submitted.egprs ? "EGPRS" : "GPRS") : "bad data",
+	       ctr_get(L1SCHED_TS_CTR_UL_PDTCH_DEC_FALLBACK) - fallback,
+	       ctr_get(L1SCHED_TS_CTR_UL_PDTCH_HINT_MISMATCH) - mismatch);
+	ASSERT_TRUE(delivered_len == block->len);
+}
+
+/* CS-1..CS-3 are never run through the EGPRS decoder */
+static void test_cs123(void)
+{
+	printf("\n%s()\n", __func__);
+
+	rx_block(&cs1, 127, -1);
+	rx_block(&cs2, 127, -1);
+	rx_block(&cs3, 127, -1);
+	/* a single wrong stealing bit is still told apart from CS-4 */
+	rx_block(&cs1, 127, 0);
+	rx_block(&cs3, 127, 7);
+}
+
+/* CS-4 and MCS-1..MCS-4 share their stealing bits: the family seen last
+ * is attempted first */
+static void test_cs4_mcs1234(void)
+{
+	printf("\n%s()\n", __func__);
+
+	rx_block(&cs4, 127, -1);
+	rx_block(&mcs1, 127, -1);
+	rx_block(&mcs2, 127, -1);
+	rx_block(&mcs3, 127, -1);
+	rx_block(&mcs4, 127, -1);
+	rx_block(&cs4, 127, -1);
+	rx_block(&cs4, 127, -1);
+	/* CS-1..CS-3 update the expectation as well */
+	rx_block(&mcs2, 127, -1);
+	rx_block(&cs2, 127, -1);
+	rx_block(&mcs3, 127, -1);
+}
+
+/* Blocks too noisy to tell from CS-4 are decoded like CS-4 */
+static void test_noisy(void)
+{
+	printf("\n%s()\n", __func__);
+
+	rx_block(&cs1, 16, -1);
+	rx_block(&mcs1, 127, -1);
+	rx_block(&cs2, 16, -1);
+	rx_block(&cs3, 16, -1);
+	rx_block(&mcs4, 16, -1);
+}
+
+/* Neither decoder succeeds: the expectation is kept */
+static void test_garbage(void)
+{
+	printf("\n%s()\n", __func__);
+
+	rx_block(&garbage, 127, -1);
+	rx_block(&mcs1, 127, -1);
+	rx_block(&garbage, 127, -1);
+	rx_block(&mcs1, 127, -1);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_bts_ctx;
+	struct gsm_bts_trx *trx;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+
+	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
+	ASSERT_TRUE(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	ASSERT_TRUE(bts != NULL);
+	trx = gsm_bts_trx_alloc(bts);
+	ASSERT_TRUE(trx != NULL);
+
+	l1ts.ts = &trx->ts[7];
+	trx->ts[7].priv = &l1ts;
+	l1ts.mf_period = 52;
+	l1ts.ctrs = rate_ctr_group_alloc(tall_bts_ctx, &l1ts_ctrg_desc, 0);
+	ASSERT_TRUE(l1ts.ctrs != NULL);
+	l1ts.chan_state[TRXC_PDTCH].ul_bursts = talloc_zero_size(tall_bts_ctx, GSM0503_EGPRS_BURSTS_NBITS);
+	ASSERT_TRUE(l1ts.chan_state[TRXC_PDTCH].ul_bursts != NULL);
+	l1ts.chan_state[TRXC_PDTCH].active = true;
+
+	test_cs123();
+	test_cs4_mcs1234();
+	test_noisy();
+	test_garbage();
+
+	printf("Success\n");
+
+	return 0;
+}
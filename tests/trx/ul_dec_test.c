@@ -0,0 +1,272 @@
+/* testing the Uplink decoder threads of osmo-bts-trx */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/phy_link.h>
+#include <osmo-bts/scheduler.h>
+
+#include <sched_ul_dec.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+#define NUM_THREADS	3
+#define NUM_BLOCKS	(UL_DEC_RING_SIZE * 3)
+
+static struct gsm_bts *bts;
+static struct gsm_bts_trx *trx;
+static struct l1sched_ts l1ts;
+static sbit_t bursts[4 * 116];
+
+/* what was delivered to the upper layers, per lchan */
+static unsigned int num_delivered[TS_MAX_LCHAN];
+static uint32_t last_fn[TS_MAX_LCHAN];
+static bool in_order;
+
+/* Stand-ins for the decoders of sched_lchan_xcch.c: these run on the decoder
+ * threads, take a while for some blocks so that the order of completion is
+ * shuffled, and pass the frame number on as the result. */
+void rx_data_decode(struct ul_dec_job *job)
+{
+	if (job->fn % 3 == 0)
+		usleep(200);
+	job->rc = 0;
+	job->n_bits_total = job->fn;
+}
+
+int rx_data_deliver(const struct ul_dec_job *job)
+{
+	const struct gsm_lchan *lchan = job->l1ts->chan_state[job->chan].lchan;
+
+	/* the main thread must see what the decoder thread produced */
+	ASSERT_TRUE(job->n_bits_total == (int)job->fn);
+
+	if (num_delivered[lchan->nr] > 0 && job->fn <= last_fn[lchan->nr])
+		in_order = false;
+	last_fn[lchan->nr] = job->fn;
+	num_delivered[lchan->nr]++;
+	return 0;
+}
+
+void rx_pdtch_decode(struct ul_dec_job *job)
+{
+	ASSERT_TRUE(0);
+}
+
+int rx_pdtch_deliver(const struct ul_dec_job *job)
+{
+	ASSERT_TRUE(0);
+	return 0;
+}
+
+static void reset_delivered(void)
+{
+	memset(num_delivered, 0, sizeof(num_delivered));
+	memset(last_fn, 0, sizeof(last_fn));
+	in_order = true;
+}
+
+static void chan_activate(enum trx_chan_type chan, unsigned int lchan_nr)
+{
+	struct l1sched_chan_state *chan_state = &l1ts.chan_state[chan];
+
+	chan_state->lchan = &l1ts.ts->lchan[lchan_nr];
+	chan_state->active = true;
+	chan_state->gen++;
+}
+
+static int submit(enum trx_chan_type chan, uint32_t fn)
+{
+	const struct ul_dec_job job = {
+		.type = UL_DEC_XCCH,
+		.l1ts = &l1ts,
+		.chan = chan,
+		.first_fn = fn,
+		.fn = fn,
+		.bursts = bursts,
+		.bursts_len = ARRAY_SIZE(bursts),
+	};
+
+	return ul_dec_submit(&job);
+}
+
+static void print_delivered(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < TS_MAX_LCHAN; i++) {
+		if (num_delivered[i] > 0)
+			printf("lchan %u: %u blocks delivered\n", i, num_delivered[i]);
+	}
+	printf("%s\n", in_order ? "in order" : "OUT OF ORDER");
+}
+
+/* SDCCH and SACCH blocks of all lchans of a timeslot, interleaved */
+static void test_order(void)
+{
+	uint32_t fn;
+	unsigned int i;
+
+	printf("\n%s()\n", __func__);
+	reset_delivered();
+
+	for (i = 0; i < 8; i++) {
+		chan_activate(TRXC_SDCCH8_0 + i, i);
+		chan_activate(TRXC_SACCH8_0 + i, i);
+	}
+
+	for (fn = 1; fn <= NUM_BLOCKS; fn++) {
+		i = fn % 8;
+		ASSERT_TRUE(submit((fn & 8) ? TRXC_SACCH8_0 + i : TRXC_SDCCH8_0 + i, fn) == 0);
+	}
+
+	ul_dec_pool_flush(trx->pinst->phy_link->u.osmotrx.ul_dec);
+	print_delivered();
+}
+
+/* More blocks of a single lchan than fit into the ring of its worker,
+ * without running the main loop in between */
+static void test_ring_full(void)
+{
+	uint32_t fn;
+
+	printf("\n%s()\n", __func__);
+	reset_delivered();
+
+	for (fn = 1; fn <= NUM_BLOCKS; fn++)
+		ASSERT_TRUE(submit(TRXC_SDCCH8_2, fn) == 0);
+	/* the oldest blocks had to be delivered to make room */
+	ASSERT_TRUE(num_delivered[2] >= NUM_BLOCKS - UL_DEC_RING_SIZE);
+
+	ul_dec_pool_flush(trx->pinst->phy_link->u.osmotrx.ul_dec);
+	print_delivered();
+}
+
+/* Blocks still in the decoder when the logical channel is released */
+static void test_stale(void)
+{
+	uint32_t fn;
+
+	printf("\n%s()\n", __func__);
+	reset_delivered();
+
+	for (fn = 1; fn <= 3; fn++)
+		ASSERT_TRUE(submit(TRXC_SDCCH8_3, fn) == 0);
+	l1ts.chan_state[TRXC_SDCCH8_3].active = false;
+	ul_dec_pool_flush(trx->pinst->phy_link->u.osmotrx.ul_dec);
+	printf("deactivated: %u blocks delivered\n", num_delivered[3]);
+
+	chan_activate(TRXC_SDCCH8_3, 3);
+	for (fn = 4; fn <= 6; fn++)
+		ASSERT_TRUE(submit(TRXC_SDCCH8_3, fn) == 0);
+	chan_activate(TRXC_SDCCH8_3, 3);
+	ASSERT_TRUE(submit(TRXC_SDCCH8_3, 7) == 0);
+	ul_dec_pool_flush(trx->pinst->phy_link->u.osmotrx.ul_dec);
+	printf("re-activated: %u blocks delivered, last fn=%u\n", num_delivered[3], last_fn[3]);
+}
+
+/* The results are delivered from the main loop */
+static void test_main_loop(void)
+{
+	unsigned int i;
+
+	printf("\n%s()\n", __func__);
+	reset_delivered();
+
+	ASSERT_TRUE(submit(TRXC_SDCCH8_4, 1) == 0);
+	ASSERT_TRUE(submit(TRXC_SACCH8_5, 2) == 0);
+	for (i = 0; i < 100 && num_delivered[4] + num_delivered[5] < 2; i++)
+		osmo_select_main(0);
+	print_delivered();
+}
+
+/* TCH, FACCH and SACCH/T are decoded by the caller */
+static void test_sacch_tch(void)
+{
+	printf("\n%s()\n", __func__);
+
+	chan_activate(TRXC_SACCHTF, 0);
+	printf("SACCH/TF: %s\n", strerror(-submit(TRXC_SACCHTF, 1)));
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_bts_ctx;
+	struct phy_link *plink;
+	struct phy_instance *pinst;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+
+	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
+	ASSERT_TRUE(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	ASSERT_TRUE(bts != NULL);
+	trx = gsm_bts_trx_alloc(bts);
+	ASSERT_TRUE(trx != NULL);
+
+	plink = phy_link_create(tall_bts_ctx, 0);
+	ASSERT_TRUE(plink != NULL);
+	pinst = phy_instance_create(plink, 0);
+	ASSERT_TRUE(pinst != NULL);
+	phy_instance_link_to_trx(pinst, trx);
+
+	l1ts.ts = &trx->ts[1];
+	trx->ts[1].priv = &l1ts;
+
+	/* no decoder threads: the caller decodes */
+	printf("without threads: %s\n", strerror(-submit(TRXC_SDCCH8_0, 0)));
+
+	plink->u.osmotrx.ul_dec = ul_dec_pool_alloc(plink, NUM_THREADS);
+	ASSERT_TRUE(plink->u.osmotrx.ul_dec != NULL);
+
+	test_order();
+	test_ring_full();
+	test_stale();
+	test_main_loop();
+	test_sacch_tch();
+
+	ul_dec_pool_free(plink->u.osmotrx.ul_dec);
+	plink->u.osmotrx.ul_dec = NULL;
+
+	printf("Success\n");
+
+	return 0;
+}
@@ -0,0 +1,179 @@
+/* testing the cache of channel coded xCCH blocks of osmo-bts-trx */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmo-bts/scheduler.h>
+
+#include <sched_xcch_cache.h>
+
+#define ASSERT_TRUE(rc) \
+	if (!(rc)) { \
+		printf("Assert failed in %s:%d.\n", \
+		       __FILE__, __LINE__); \
+		abort(); \
+	}
+
+static const struct rate_ctr_desc l1ts_ctr_desc[] = {
+	[L1SCHED_TS_CTR_DL_LATE] =	{"l1sched_ts:dl_late", "unused"},
+	[L1SCHED_TS_CTR_DL_NOT_FOUND] =	{"l1sched_ts:dl_not_found", "unused"},
+	[L1SCHED_TS_CTR_DL_XCCH_CACHE_HIT] = {"l1sched_ts:dl_xcch_cache_hit", "cache hits"},
+	[L1SCHED_TS_CTR_DL_XCCH_CACHE_MISS] = {"l1sched_ts:dl_xcch_cache_miss", "cache misses"},
+};
+static const struct rate_ctr_group_desc l1ts_ctrg_desc = {
+	"l1sched_ts",
+	"L1 scheduler timeslot",
+	OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(l1ts_ctr_desc),
+	l1ts_ctr_desc
+};
+
+static struct l1sched_ts l1ts;
+
+/* LAPDm fill frame and a System Information Type 3 */
+static const uint8_t fill_frame[GSM_MACBLOCK_LEN] = {
+	0x03, 0x03, 0x01, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+};
+static const uint8_t si3[GSM_MACBLOCK_LEN] = {
+	0x49, 0x06, 0x1b, 0x00, 0x01, 0x00, 0xf1, 0x10, 0x00, 0x01, 0xc9, 0x03,
+	0x05, 0x27, 0x47, 0x40, 0xe5, 0x04, 0x00, 0x2c, 0x0b, 0x2b, 0x2b,
+};
+
+static uint64_t ctr_get(unsigned int idx)
+{
+	return rate_ctr_group_get_ctr(l1ts.ctrs, idx)->current;
+}
+
+/* Encode a block through the cache, check the bursts against the encoder and
+ * return whether it was a hit, as counted */
+static bool encode(const uint8_t *l2)
+{
+	ubit_t bursts[4 * 116], expected[4 * 116];
+	uint64_t hits = ctr_get(L1SCHED_TS_CTR_DL_XCCH_CACHE_HIT);
+	uint64_t misses = ctr_get(L1SCHED_TS_CTR_DL_XCCH_CACHE_MISS);
+	bool hit;
+
+	memset(bursts, 0xff, sizeof(bursts));
+	xcch_encode_cached(&l1ts, bursts, l2);
+	gsm0503_xcch_encode(expected, l2);
+	ASSERT_TRUE(memcmp(bursts, expected, sizeof(expected)) == 0);
+
+	hit = ctr_get(L1SCHED_TS_CTR_DL_XCCH_CACHE_HIT) == hits + 1;
+	/* exactly one of both counters moved */
+	ASSERT_TRUE(ctr_get(L1SCHED_TS_CTR_DL_XCCH_CACHE_HIT) == hits + hit);
+	ASSERT_TRUE(ctr_get(L1SCHED_TS_CTR_DL_XCCH_CACHE_MISS) == misses + !hit);
+
+	return hit;
+}
+
+static void encode_print(const char *name, const uint8_t *l2)
+{
+	printf("%s: %s\n", name, encode(l2) ? "hit" : "miss");
+}
+
+/* A repeated block is taken from the cache */
+static void test_hit(void)
+{
+	printf("\n%s()\n", __func__);
+
+	encode_print("fill frame", fill_frame);
+	encode_print("fill frame", fill_frame);
+	encode_print("SI3", si3);
+	encode_print("fill frame", fill_frame);
+	encode_print("SI3", si3);
+}
+
+/* A changed block (e.g. a new SI) never hits the entry of the old one */
+static void test_changed(void)
+{
+	uint8_t si3_new[GSM_MACBLOCK_LEN];
+
+	printf("\n%s()\n", __func__);
+
+	memcpy(si3_new, si3, sizeof(si3_new));
+	si3_new[GSM_MACBLOCK_LEN - 3] ^= 0x01;
+
+	encode_print("SI3 changed", si3_new);
+	encode_print("SI3 changed", si3_new);
+	/* flip a single bit of the L2 header as well */
+	si3_new[0] ^= 0x80;
+	encode_print("SI3 changed again", si3_new);
+}
+
+/* Another block using the same entry replaces it */
+static void test_collision(void)
+{
+	uint8_t block[GSM_MACBLOCK_LEN];
+	unsigned int i;
+
+	printf("\n%s()\n", __func__);
+
+	/* make sure the fill frame is cached */
+	encode(fill_frame);
+	encode_print("fill frame", fill_frame);
+
+	memset(block, 0x55, sizeof(block));
+	for (i = 0; i < XCCH_ENC_CACHE_SIZE * XCCH_ENC_CACHE_SIZE; i++) {
+		osmo_store16be(i, &block[0]);
+		ASSERT_TRUE(!encode(block));
+		/* the fill frame was replaced if the block went into its entry */
+		if (!encode(fill_frame))
+			break;
+	}
+	ASSERT_TRUE(i < XCCH_ENC_CACHE_SIZE * XCCH_ENC_CACHE_SIZE);
+	printf("fill frame replaced by a colliding block, and encoded again\n");
+
+	/* ... which in turn replaced the colliding block */
+	encode_print("colliding block", block);
+	encode_print("fill frame", fill_frame);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_ctx;
+
+	tall_ctx = talloc_named_const(NULL, 1, "xcch_cache_test");
+	l1ts.ctrs = rate_ctr_group_alloc(tall_ctx, &l1ts_ctrg_desc, 0);
+	ASSERT_TRUE(l1ts.ctrs != NULL);
+
+	test_hit();
+	test_changed();
+	test_collision();
+
+	rate_ctr_group_free(l1ts.ctrs);
+	talloc_free(tall_ctx);
+
+	printf("Success\n");
+
+	return 0;
+}